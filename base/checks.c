@@ -38,6 +38,8 @@
 #include "../include/neberrors.h"
 #endif
 
+static int handle_host_state_change(host *);
+
 /******************************************************************/
 /********************** CHECK REAPER FUNCTIONS ********************/
 /******************************************************************/
@@ -261,8 +263,9 @@ int run_async_service_check(service *svc, int check_options, double latency, int
 	cr->exited_ok = TRUE;
 	cr->return_code = STATE_OK;
 	cr->output = NULL;
-	cr->host_name = (char *)strdup(svc->host_name);
-	cr->service_description = (char *)strdup(svc->description);
+	cr->host_name = (char *)intern_str(svc->host_name);
+	cr->service_description = (char *)intern_str(svc->description);
+	cr->command_name = (char *)intern_str(svc->check_command_ptr->name);
 
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker */
@@ -283,6 +286,7 @@ int run_async_service_check(service *svc, int check_options, double latency, int
 
 	/* set the execution flag */
 	svc->is_executing = TRUE;
+	sync_service_hot_state(svc);
 
 	/* reset latency (permanent value will be set later) */
 	svc->latency = old_latency;
@@ -302,6 +306,129 @@ int run_async_service_check(service *svc, int check_options, double latency, int
 
 
 
+/* service check results put aside until the host check aggressive host checking asks for is done, by service id */
+struct host_check_wait {
+	check_result cr;
+	int resumed;
+	time_t since;
+	};
+static struct host_check_wait **host_check_waits = NULL;
+static unsigned int num_host_check_waits = 0;
+
+
+/* takes a copy of the result, as the caller frees its own */
+static int add_host_check_wait(service *svc, check_result *cr) {
+	struct host_check_wait *wait = NULL;
+
+	if(host_check_waits == NULL && (host_check_waits = (struct host_check_wait **)calloc(num_objects.services, sizeof(*host_check_waits))) == NULL)
+		return ERROR;
+	if(svc->id >= num_objects.services || (wait = (struct host_check_wait *)calloc(1, sizeof(*wait))) == NULL)
+		return ERROR;
+
+	wait->cr = *cr;
+	wait->cr.host_name = (char *)intern_str(cr->host_name);
+	wait->cr.service_description = (char *)intern_str(cr->service_description);
+	wait->cr.command_name = (char *)intern_str(cr->command_name);
+	wait->cr.output_file = NULL;
+	wait->cr.output_file_fp = NULL;
+	wait->cr.output = (cr->output) ? (char *)strdup(cr->output) : NULL;
+	/* the worker it came from may be gone by the time we get back to it */
+	if(wait->cr.engine == &nagios_check_engine)
+		wait->cr.source = NULL;
+	wait->since = time(NULL);
+
+	/* handle_async_service_check_result() took any earlier one off the list, so there's nothing here */
+	host_check_waits[svc->id] = wait;
+	num_host_check_waits++;
+
+	return OK;
+	}
+
+
+static struct host_check_wait *take_host_check_wait(service *svc) {
+	struct host_check_wait *wait = NULL;
+
+	if(num_host_check_waits == 0 || (wait = host_check_waits[svc->id]) == NULL)
+		return NULL;
+
+	host_check_waits[svc->id] = NULL;
+	num_host_check_waits--;
+
+	return wait;
+	}
+
+
+static void free_host_check_wait(struct host_check_wait *wait) {
+
+	free_check_result(&wait->cr);
+	my_free(wait);
+	}
+
+
+/* process a result that was put aside, handle_async_service_check_result() takes it off the list */
+static void resume_host_check_wait(service *svc, struct host_check_wait *wait) {
+
+	log_debug_info(DEBUGL_CHECKS, 1, "Resuming check result processing for service '%s' on host '%s'\n", svc->description, svc->host_name);
+
+	wait->resumed = TRUE;
+	handle_async_service_check_result(svc, &wait->cr);
+	free_host_check_wait(wait);
+	}
+
+
+/* go on with services that were waiting for the result of their host */
+static void resume_host_check_waits(host *hst) {
+	servicesmember *temp_servicesmember = NULL;
+	service *temp_service = NULL;
+
+	if(num_host_check_waits == 0)
+		return;
+
+	for(temp_servicesmember = hst->services; temp_servicesmember != NULL; temp_servicesmember = temp_servicesmember->next) {
+		if((temp_service = temp_servicesmember->service_ptr) == NULL || host_check_waits[temp_service->id] == NULL)
+			continue;
+		resume_host_check_wait(temp_service, host_check_waits[temp_service->id]);
+		}
+	}
+
+
+/* go on with services that have been waiting for longer than any host check should take */
+void check_for_stale_host_check_waits(void) {
+	time_t current_time = 0L;
+	unsigned int i;
+
+	if(num_host_check_waits == 0)
+		return;
+
+	time(&current_time);
+
+	for(i = 0; i < num_objects.services && num_host_check_waits > 0; i++) {
+		if(host_check_waits[i] == NULL || host_check_waits[i]->since + host_check_timeout + check_reaper_interval + 60 > current_time)
+			continue;
+
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Check of host '%s' never came back, so we'll handle the result of service '%s' with what we know.\n", service_ary[i]->host_name, service_ary[i]->description);
+
+		resume_host_check_wait(service_ary[i], host_check_waits[i]);
+		}
+	}
+
+
+void free_host_check_waits(void) {
+	unsigned int i;
+
+	if(host_check_waits == NULL)
+		return;
+
+	for(i = 0; i < num_objects.services; i++) {
+		if(host_check_waits[i] != NULL)
+			free_host_check_wait(host_check_waits[i]);
+		}
+	my_free(host_check_waits);
+	num_host_check_waits = 0;
+	}
+
+
+
 /* handles asynchronous service check results */
 int handle_async_service_check_result(service *temp_service, check_result *queued_check_result) {
 	host *temp_host = NULL;
@@ -325,6 +452,7 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 	int run_async_check = TRUE;
 	int state_changes_use_cached_state = TRUE; /* TODO - 09/23/07 move this to a global variable */
 	int flapping_check_done = FALSE;
+	struct host_check_wait *wait = NULL;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "handle_async_service_check_result()\n");
@@ -339,8 +467,14 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 	log_debug_info(DEBUGL_CHECKS, 0, "** Handling check result for service '%s' on host '%s' from '%s'...\n", temp_service->description, temp_service->host_name, check_result_source(queued_check_result));
 	log_debug_info(DEBUGL_CHECKS, 1, "HOST: %s, SERVICE: %s, CHECK TYPE: %s, OPTIONS: %d, SCHEDULED: %s, RESCHEDULE: %s, EXITED OK: %s, RETURN CODE: %d, OUTPUT: %s\n", temp_service->host_name, temp_service->description, (queued_check_result->check_type == CHECK_TYPE_ACTIVE) ? "Active" : "Passive", queued_check_result->check_options, (queued_check_result->scheduled_check == TRUE) ? "Yes" : "No", (queued_check_result->reschedule_check == TRUE) ? "Yes" : "No", (queued_check_result->exited_ok == TRUE) ? "Yes" : "No", queued_check_result->return_code, queued_check_result->output);
 
+	/* a result we put aside while waiting for a host check has been through the first steps already, otherwise a newer one supersedes it */
+	if((wait = take_host_check_wait(temp_service)) != NULL && wait->resumed == FALSE) {
+		free_host_check_wait(wait);
+		wait = NULL;
+		}
+
 	/* decrement the number of service checks still out there... */
-	if(queued_check_result->check_type == CHECK_TYPE_ACTIVE && currently_running_service_checks > 0)
+	if(wait == NULL && queued_check_result->check_type == CHECK_TYPE_ACTIVE && currently_running_service_checks > 0)
 		currently_running_service_checks--;
 
 	/* skip this service check results if its passive and we aren't accepting passive check results */
@@ -360,7 +494,7 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 		temp_service->is_being_freshened = FALSE;
 
 	/* clear the execution flag if this was an active check */
-	if(queued_check_result->check_type == CHECK_TYPE_ACTIVE)
+	if(wait == NULL && queued_check_result->check_type == CHECK_TYPE_ACTIVE)
 		temp_service->is_executing = FALSE;
 
 	/* DISCARD INVALID FRESHNESS CHECK RESULTS */
@@ -369,9 +503,21 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 	   make the service fresh again, so we do a quick check to make sure the service is still stale before we accept the check result. */
 	if((queued_check_result->check_options & CHECK_OPTION_FRESHNESS_CHECK) && is_service_result_fresh(temp_service, current_time, FALSE) == TRUE) {
 		log_debug_info(DEBUGL_CHECKS, 0, "Discarding service freshness check result because the service is currently fresh (race condition avoided).\n");
+		sync_service_hot_state(temp_service);
 		return OK;
 		}
 
+	/* aggressive host checking wants a fresh host state before deciding what a problem means, so wait for the host check if one is needed */
+	if(use_aggressive_host_checking == TRUE && wait == NULL && (queued_check_result->exited_ok == FALSE || queued_check_result->return_code != STATE_OK)) {
+		temp_host = (host *)temp_service->host_ptr;
+		perform_on_demand_host_check(temp_host, NULL, CHECK_OPTION_NONE, TRUE, cached_host_check_horizon);
+		if(temp_host->is_executing == TRUE && add_host_check_wait(temp_service, queued_check_result) == OK) {
+			log_debug_info(DEBUGL_CHECKS, 1, "Putting the result aside until the check of host '%s' is done.\n", temp_host->name);
+			sync_service_hot_state(temp_service);
+			return OK;
+			}
+		}
+
 	/* check latency is passed to us */
 	temp_service->latency = queued_check_result->latency;
 
@@ -731,8 +877,9 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 
 			/* 08/04/07 EG launch an async (parallel) host check (possibly cached) unless aggressive host checking is enabled */
 			/* previous logic was to simply run a sync (serial) host check */
+			/* with aggressive host checking, the host was checked before we got here (see above) */
 			if(use_aggressive_host_checking == TRUE)
-				perform_on_demand_host_check(temp_host, &route_result, CHECK_OPTION_NONE, TRUE, cached_host_check_horizon);
+				route_result = temp_host->current_state;
 			else {
 				/* can we use the last cached host state? */
 				/* only use cached host state if no service state change has occurred */
@@ -770,8 +917,8 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 
 			/* we're using aggressive host checking, so really do recheck the host... */
 			if(use_aggressive_host_checking == TRUE) {
-				log_debug_info(DEBUGL_CHECKS, 1, "Agressive host checking is enabled, so we'll recheck the host state...\n");
-				perform_on_demand_host_check(temp_host, &route_result, CHECK_OPTION_NONE, TRUE, cached_host_check_horizon);
+				log_debug_info(DEBUGL_CHECKS, 1, "Agressive host checking is enabled, so the host state was rechecked before we got here...\n");
+				route_result = temp_host->current_state;
 				}
 
 			/* the service wobbled between non-OK states, so check the host... */
@@ -795,6 +942,7 @@ int handle_async_service_check_result(service *temp_service, check_result *queue
 				if(temp_host->has_been_checked == FALSE) {
 					temp_host->has_been_checked = TRUE;
 					temp_host->last_check = temp_service->last_check;
+					sync_host_hot_state(temp_host);
 					}
 
 				/* fake the route check result */
@@ -1255,14 +1403,26 @@ int check_service_check_viability(service *svc, int check_options, int *time_is_
 
 
 
-/* checks service dependencies */
-int check_service_dependencies(service *svc, int dependency_type) {
-	objectlist *list;
-	int state = STATE_OK;
-	time_t current_time = 0L;
+/*
+ * Dependencies are evaluated for every check and notification of
+ * every dependent object, so the result for each object is cached
+ * until the state of any object of the same type that dependencies
+ * look at changes (see hotstate.c). Dependency periods are made of
+ * whole minutes, so results that depend on one are only good until
+ * the end of the current minute.
+ */
+static inline time_t dependency_period_expiry(time_t current_time) {
 
+	return current_time - (current_time % 60) + 60;
+	}
 
-	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_service_dependencies()\n");
+
+static int service_dependencies_result(service *svc, int dependency_type, time_t current_time, time_t *expires) {
+	struct dependency_cache *cache = NULL;
+	objectlist *list;
+	int state = STATE_OK;
+	int result = DEPENDENCIES_OK;
+	time_t my_expires = 0L;
 
 	/* only check dependencies of the desired type */
 	if(dependency_type == NOTIFICATION_DEPENDENCY)
@@ -1270,6 +1430,17 @@ int check_service_dependencies(service *svc, int dependency_type) {
 	else
 		list = svc->exec_deps;
 
+	if(list == NULL)
+		return DEPENDENCIES_OK;
+
+	/* is the result we got last time still good? */
+	cache = get_dependency_cache(&service_hot, svc->id, dependency_type);
+	if(cache != NULL && cache->version == service_hot.dep_version && (cache->expires == 0 || current_time < cache->expires)) {
+		if(cache->expires != 0 && (*expires == 0 || cache->expires < *expires))
+			*expires = cache->expires;
+		return cache->result;
+		}
+
 	/* check all dependencies of the desired type... */
 	for(; list; list = list->next) {
 		service *temp_service;
@@ -1280,9 +1451,13 @@ int check_service_dependencies(service *svc, int dependency_type) {
 			continue;
 
 		/* skip this dependency if it has a timeperiod and the current time isn't valid */
-		time(&current_time);
-		if(temp_dependency->dependency_period != NULL && check_time_against_period(current_time, temp_dependency->dependency_period_ptr) == ERROR)
-			return FALSE;
+		if(temp_dependency->dependency_period != NULL) {
+			my_expires = dependency_period_expiry(current_time);
+			if(check_time_against_period(current_time, temp_dependency->dependency_period_ptr) == ERROR) {
+				result = FALSE;
+				break;
+				}
+			}
 
 		/* get the status to use (use last hard state if its currently in a soft state) */
 		if(temp_service->state_type == SOFT_STATE && soft_state_dependencies == FALSE)
@@ -1291,17 +1466,40 @@ int check_service_dependencies(service *svc, int dependency_type) {
 			state = temp_service->current_state;
 
 		/* is the service we depend on in state that fails the dependency tests? */
-		if(flag_isset(temp_dependency->failure_options, 1 << state))
-			return DEPENDENCIES_FAILED;
+		if(flag_isset(temp_dependency->failure_options, 1 << state)) {
+			result = DEPENDENCIES_FAILED;
+			break;
+			}
 
 		/* immediate dependencies ok at this point - check parent dependencies if necessary */
 		if(temp_dependency->inherits_parent == TRUE) {
-			if(check_service_dependencies(temp_service, dependency_type) != DEPENDENCIES_OK)
-				return DEPENDENCIES_FAILED;
+			if(service_dependencies_result(temp_service, dependency_type, current_time, &my_expires) != DEPENDENCIES_OK) {
+				result = DEPENDENCIES_FAILED;
+				break;
+				}
 			}
 		}
 
-	return DEPENDENCIES_OK;
+	if(cache != NULL) {
+		cache->version = service_hot.dep_version;
+		cache->expires = my_expires;
+		cache->result = result;
+		}
+	if(my_expires != 0 && (*expires == 0 || my_expires < *expires))
+		*expires = my_expires;
+
+	return result;
+	}
+
+
+/* checks service dependencies */
+int check_service_dependencies(service *svc, int dependency_type) {
+	time_t expires = 0L;
+
+
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_service_dependencies()\n");
+
+	return service_dependencies_result(svc, dependency_type, time(NULL), &expires);
 	}
 
 
@@ -1311,6 +1509,7 @@ void check_for_orphaned_services(void) {
 	service *temp_service = NULL;
 	time_t current_time = 0L;
 	time_t expected_time = 0L;
+	unsigned int i, next;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_for_orphaned_services()\n");
@@ -1318,12 +1517,17 @@ void check_for_orphaned_services(void) {
 	/* get the current time */
 	time(&current_time);
 
-	/* check all services... */
-	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
+	/* check the services whose results should have come in by now... */
+	for(i = twheel_expire(service_hot.orphaned, current_time); i != TWHEEL_NONE; i = next) {
+		next = twheel_next_expired(service_hot.orphaned, i);
+
+		temp_service = service_ary[i];
 
 		/* skip services that are not currently executing */
-		if(temp_service->is_executing == FALSE)
+		if(temp_service->is_executing == FALSE) {
+			sync_service_hot_state(temp_service);
 			continue;
+			}
 
 		/* determine the time at which the check results should have come in (allow 10 minutes slack time) */
 		expected_time = (time_t)(temp_service->next_check + temp_service->latency + service_check_timeout + check_reaper_interval + 600);
@@ -1345,10 +1549,13 @@ void check_for_orphaned_services(void) {
 
 			/* disable the executing flag */
 			temp_service->is_executing = FALSE;
+			sync_service_hot_state(temp_service);
 
 			/* schedule an immediate check of the service */
 			schedule_service_check(temp_service, current_time, CHECK_OPTION_ORPHAN_CHECK);
 			}
+		else
+			sync_service_hot_state(temp_service);
 
 		}
 
@@ -1361,6 +1568,7 @@ void check_for_orphaned_services(void) {
 void check_service_result_freshness(void) {
 	service *temp_service = NULL;
 	time_t current_time = 0L;
+	unsigned int i, next;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_service_result_freshness()\n");
@@ -1375,24 +1583,27 @@ void check_service_result_freshness(void) {
 	/* get the current time */
 	time(&current_time);
 
-	/* check all services... */
-	for(temp_service = service_list; temp_service != NULL; temp_service = temp_service->next) {
+	/*
+	 * check the services whose results may have gone stale by now.
+	 * the ones we skip get their deadline recomputed, except for the
+	 * ones outside their check period, which we'll look at again next
+	 * time around...
+	 */
+	for(i = twheel_expire(service_hot.freshness, current_time); i != TWHEEL_NONE; i = next) {
+		next = twheel_next_expired(service_hot.freshness, i);
+
+		temp_service = service_ary[i];
 
 		/* skip services we shouldn't be checking for freshness */
-		if(temp_service->check_freshness == FALSE)
-			continue;
-
 		/* skip services that are currently executing (problems here will be caught by orphaned service check) */
-		if(temp_service->is_executing == TRUE)
-			continue;
-
 		/* skip services that have both active and passive checks disabled */
-		if(temp_service->checks_enabled == FALSE && temp_service->accept_passive_checks == FALSE)
-			continue;
-
 		/* skip services that are already being freshened */
-		if(temp_service->is_being_freshened == TRUE)
+		if(temp_service->check_freshness == FALSE || temp_service->is_executing == TRUE ||
+		   (temp_service->checks_enabled == FALSE && temp_service->accept_passive_checks == FALSE) ||
+		   temp_service->is_being_freshened == TRUE) {
+			sync_service_hot_state(temp_service);
 			continue;
+			}
 
 		/* see if the time is right... */
 		if(check_time_against_period(current_time, temp_service->check_period_ptr) == ERROR)
@@ -1400,18 +1611,23 @@ void check_service_result_freshness(void) {
 
 		/* EXCEPTION */
 		/* don't check freshness of services without regular check intervals if we're using auto-freshness threshold */
-		if(temp_service->check_interval == 0 && temp_service->freshness_threshold == 0)
+		if(temp_service->check_interval == 0 && temp_service->freshness_threshold == 0) {
+			sync_service_hot_state(temp_service);
 			continue;
+			}
 
 		/* the results for the last check of this service are stale! */
 		if(is_service_result_fresh(temp_service, current_time, TRUE) == FALSE) {
 
 			/* set the freshen flag */
 			temp_service->is_being_freshened = TRUE;
+			sync_service_hot_state(temp_service);
 
 			/* schedule an immediate forced check of the service */
 			schedule_service_check(temp_service, current_time, CHECK_OPTION_FORCE_EXECUTION | CHECK_OPTION_FRESHNESS_CHECK);
 			}
+		else
+			sync_service_hot_state(temp_service);
 
 		}
 
@@ -1420,20 +1636,10 @@ void check_service_result_freshness(void) {
 
 
 
-/* tests whether or not a service's check results are fresh */
-int is_service_result_fresh(service *temp_service, time_t current_time, int log_this) {
+/* determines when a service's check results go stale */
+time_t get_service_freshness_expiration(service *temp_service, int *threshold) {
 	int freshness_threshold = 0;
 	time_t expiration_time = 0L;
-	int days = 0;
-	int hours = 0;
-	int minutes = 0;
-	int seconds = 0;
-	int tdays = 0;
-	int thours = 0;
-	int tminutes = 0;
-	int tseconds = 0;
-
-	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of service '%s' on host '%s'...\n", temp_service->description, temp_service->host_name);
 
 	/* use user-supplied freshness threshold or auto-calculate a freshness threshold to use? */
 	if(temp_service->freshness_threshold == 0) {
@@ -1445,8 +1651,6 @@ int is_service_result_fresh(service *temp_service, time_t current_time, int log_
 	else
 		freshness_threshold = temp_service->freshness_threshold;
 
-	log_debug_info(DEBUGL_CHECKS, 2, "Freshness thresholds: service=%d, use=%d\n", temp_service->freshness_threshold, freshness_threshold);
-
 	/* calculate expiration time */
 	/*
 	 * CHANGED 11/10/05 EG -
@@ -1500,6 +1704,34 @@ int is_service_result_fresh(service *temp_service, time_t current_time, int log_
 			expiration_time = event_start + freshness_threshold;
 		}
 	}
+
+	if(threshold != NULL)
+		*threshold = freshness_threshold;
+
+	return expiration_time;
+	}
+
+
+
+/* tests whether or not a service's check results are fresh */
+int is_service_result_fresh(service *temp_service, time_t current_time, int log_this) {
+	int freshness_threshold = 0;
+	time_t expiration_time = 0L;
+	int days = 0;
+	int hours = 0;
+	int minutes = 0;
+	int seconds = 0;
+	int tdays = 0;
+	int thours = 0;
+	int tminutes = 0;
+	int tseconds = 0;
+
+	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of service '%s' on host '%s'...\n", temp_service->description, temp_service->host_name);
+
+	expiration_time = get_service_freshness_expiration(temp_service, &freshness_threshold);
+
+	log_debug_info(DEBUGL_CHECKS, 2, "Freshness thresholds: service=%d, use=%d\n", temp_service->freshness_threshold, freshness_threshold);
+
 	log_debug_info(DEBUGL_CHECKS, 2, "HBC: %d, PS: %lu, ES: %lu, LC: %lu, CT: %lu, ET: %lu\n", temp_service->has_been_checked, (unsigned long)program_start, (unsigned long)event_start, (unsigned long)temp_service->last_check, (unsigned long)current_time, (unsigned long)expiration_time);
 
 	/* the results for the last check of this service are stale */
@@ -1647,16 +1879,14 @@ void schedule_host_check(host *hst, time_t check_time, int options) {
 
 
 
-/* checks host dependencies */
-int check_host_dependencies(host *hst, int dependency_type) {
+static int host_dependencies_result(host *hst, int dependency_type, time_t current_time, time_t *expires) {
+	struct dependency_cache *cache = NULL;
 	hostdependency *temp_dependency = NULL;
 	objectlist *list;
 	host *temp_host = NULL;
 	int state = HOST_UP;
-	time_t current_time = 0L;
-
-
-	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_host_dependencies()\n");
+	int result = DEPENDENCIES_OK;
+	time_t my_expires = 0L;
 
 	if (dependency_type == NOTIFICATION_DEPENDENCY) {
 		list = hst->notify_deps;
@@ -1664,6 +1894,17 @@ int check_host_dependencies(host *hst, int dependency_type) {
 		list = hst->exec_deps;
 	}
 
+	if(list == NULL)
+		return DEPENDENCIES_OK;
+
+	/* is the result we got last time still good? */
+	cache = get_dependency_cache(&host_hot, hst->id, dependency_type);
+	if(cache != NULL && cache->version == host_hot.dep_version && (cache->expires == 0 || current_time < cache->expires)) {
+		if(cache->expires != 0 && (*expires == 0 || cache->expires < *expires))
+			*expires = cache->expires;
+		return cache->result;
+		}
+
 	/* check all dependencies... */
 	for(; list; list = list->next) {
 		temp_dependency = (hostdependency *)list->object_ptr;
@@ -1673,9 +1914,13 @@ int check_host_dependencies(host *hst, int dependency_type) {
 			continue;
 
 		/* skip this dependency if it has a timeperiod and the current time isn't valid */
-		time(&current_time);
-		if(temp_dependency->dependency_period != NULL && check_time_against_period(current_time, temp_dependency->dependency_period_ptr) == ERROR)
-			return FALSE;
+		if(temp_dependency->dependency_period != NULL) {
+			my_expires = dependency_period_expiry(current_time);
+			if(check_time_against_period(current_time, temp_dependency->dependency_period_ptr) == ERROR) {
+				result = FALSE;
+				break;
+				}
+			}
 
 		/* get the status to use (use last hard state if its currently in a soft state) */
 		if(temp_host->state_type == SOFT_STATE && soft_state_dependencies == FALSE)
@@ -1684,17 +1929,40 @@ int check_host_dependencies(host *hst, int dependency_type) {
 			state = temp_host->current_state;
 
 		/* is the host we depend on in state that fails the dependency tests? */
-		if(flag_isset(temp_dependency->failure_options, 1 << state))
-			return DEPENDENCIES_FAILED;
+		if(flag_isset(temp_dependency->failure_options, 1 << state)) {
+			result = DEPENDENCIES_FAILED;
+			break;
+			}
 
 		/* immediate dependencies ok at this point - check parent dependencies if necessary */
 		if(temp_dependency->inherits_parent == TRUE) {
-			if(check_host_dependencies(temp_host, dependency_type) != DEPENDENCIES_OK)
-				return DEPENDENCIES_FAILED;
+			if(host_dependencies_result(temp_host, dependency_type, current_time, &my_expires) != DEPENDENCIES_OK) {
+				result = DEPENDENCIES_FAILED;
+				break;
+				}
 			}
 		}
 
-	return DEPENDENCIES_OK;
+	if(cache != NULL) {
+		cache->version = host_hot.dep_version;
+		cache->expires = my_expires;
+		cache->result = result;
+		}
+	if(my_expires != 0 && (*expires == 0 || my_expires < *expires))
+		*expires = my_expires;
+
+	return result;
+	}
+
+
+/* checks host dependencies */
+int check_host_dependencies(host *hst, int dependency_type) {
+	time_t expires = 0L;
+
+
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_host_dependencies()\n");
+
+	return host_dependencies_result(hst, dependency_type, time(NULL), &expires);
 	}
 
 
@@ -1704,6 +1972,7 @@ void check_for_orphaned_hosts(void) {
 	host *temp_host = NULL;
 	time_t current_time = 0L;
 	time_t expected_time = 0L;
+	unsigned int i, next;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_for_orphaned_hosts()\n");
@@ -1711,16 +1980,18 @@ void check_for_orphaned_hosts(void) {
 	/* get the current time */
 	time(&current_time);
 
-	/* check all hosts... */
-	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+	/* check the hosts whose results should have come in by now... */
+	for(i = twheel_expire(host_hot.orphaned, current_time); i != TWHEEL_NONE; i = next) {
+		next = twheel_next_expired(host_hot.orphaned, i);
 
-		/* skip hosts that don't have a set check interval (on-demand checks are missed by the orphan logic) */
-		if(temp_host->next_check == (time_t)0L)
-			continue;
+		temp_host = host_ary[i];
 
+		/* skip hosts that don't have a set check interval (on-demand checks are missed by the orphan logic) */
 		/* skip hosts that are not currently executing */
-		if(temp_host->is_executing == FALSE)
+		if(temp_host->next_check == (time_t)0L || temp_host->is_executing == FALSE) {
+			sync_host_hot_state(temp_host);
 			continue;
+			}
 
 		/* determine the time at which the check results should have come in (allow 10 minutes slack time) */
 		expected_time = (time_t)(temp_host->next_check + temp_host->latency + host_check_timeout + check_reaper_interval + 600);
@@ -1739,10 +2010,13 @@ void check_for_orphaned_hosts(void) {
 
 			/* disable the executing flag */
 			temp_host->is_executing = FALSE;
+			sync_host_hot_state(temp_host);
 
 			/* schedule an immediate check of the host */
 			schedule_host_check(temp_host, current_time, CHECK_OPTION_ORPHAN_CHECK);
 			}
+		else
+			sync_host_hot_state(temp_host);
 
 		}
 
@@ -1755,6 +2029,7 @@ void check_for_orphaned_hosts(void) {
 void check_host_result_freshness(void) {
 	host *temp_host = NULL;
 	time_t current_time = 0L;
+	unsigned int i, next;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_host_result_freshness()\n");
@@ -1769,24 +2044,22 @@ void check_host_result_freshness(void) {
 	/* get the current time */
 	time(&current_time);
 
-	/* check all hosts... */
-	for(temp_host = host_list; temp_host != NULL; temp_host = temp_host->next) {
+	/* check the hosts whose results may have gone stale by now, same as for services... */
+	for(i = twheel_expire(host_hot.freshness, current_time); i != TWHEEL_NONE; i = next) {
+		next = twheel_next_expired(host_hot.freshness, i);
 
-		/* skip hosts we shouldn't be checking for freshness */
-		if(temp_host->check_freshness == FALSE)
-			continue;
+		temp_host = host_ary[i];
 
+		/* skip hosts we shouldn't be checking for freshness */
 		/* skip hosts that have both active and passive checks disabled */
-		if(temp_host->checks_enabled == FALSE && temp_host->accept_passive_checks == FALSE)
-			continue;
-
 		/* skip hosts that are currently executing (problems here will be caught by orphaned host check) */
-		if(temp_host->is_executing == TRUE)
-			continue;
-
 		/* skip hosts that are already being freshened */
-		if(temp_host->is_being_freshened == TRUE)
+		if(temp_host->check_freshness == FALSE ||
+		   (temp_host->checks_enabled == FALSE && temp_host->accept_passive_checks == FALSE) ||
+		   temp_host->is_executing == TRUE || temp_host->is_being_freshened == TRUE) {
+			sync_host_hot_state(temp_host);
 			continue;
+			}
 
 		/* see if the time is right... */
 		if(check_time_against_period(current_time, temp_host->check_period_ptr) == ERROR)
@@ -1797,10 +2070,13 @@ void check_host_result_freshness(void) {
 
 			/* set the freshen flag */
 			temp_host->is_being_freshened = TRUE;
+			sync_host_hot_state(temp_host);
 
 			/* schedule an immediate forced check of the host */
 			schedule_host_check(temp_host, current_time, CHECK_OPTION_FORCE_EXECUTION | CHECK_OPTION_FRESHNESS_CHECK);
 			}
+		else
+			sync_host_hot_state(temp_host);
 		}
 
 	return;
@@ -1808,22 +2084,12 @@ void check_host_result_freshness(void) {
 
 
 
-/* checks to see if a hosts's check results are fresh */
-int is_host_result_fresh(host *temp_host, time_t current_time, int log_this) {
-	time_t expiration_time = 0L;
+/* determines when a host's check results go stale */
+time_t get_host_freshness_expiration(host *temp_host, int *threshold) {
 	int freshness_threshold = 0;
-	int days = 0;
-	int hours = 0;
-	int minutes = 0;
-	int seconds = 0;
-	int tdays = 0;
-	int thours = 0;
-	int tminutes = 0;
-	int tseconds = 0;
+	time_t expiration_time = 0L;
 	double interval = 0;
 
-	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of host '%s'...\n", temp_host->name);
-
 	/* use user-supplied freshness threshold or auto-calculate a freshness threshold to use? */
 	if(temp_host->freshness_threshold == 0) {
 		if(temp_host->state_type == HARD_STATE || temp_host->current_state == STATE_OK) {
@@ -1837,8 +2103,6 @@ int is_host_result_fresh(host *temp_host, time_t current_time, int log_this) {
 	else
 		freshness_threshold = temp_host->freshness_threshold;
 
-	log_debug_info(DEBUGL_CHECKS, 2, "Freshness thresholds: host=%d, use=%d\n", temp_host->freshness_threshold, freshness_threshold);
-
 	/* calculate expiration time */
 	/*
 	 * CHANGED 11/10/05 EG:
@@ -1883,6 +2147,33 @@ int is_host_result_fresh(host *temp_host, time_t current_time, int log_this) {
 		}
 	}
 
+	if(threshold != NULL)
+		*threshold = freshness_threshold;
+
+	return expiration_time;
+	}
+
+
+
+/* checks to see if a hosts's check results are fresh */
+int is_host_result_fresh(host *temp_host, time_t current_time, int log_this) {
+	time_t expiration_time = 0L;
+	int freshness_threshold = 0;
+	int days = 0;
+	int hours = 0;
+	int minutes = 0;
+	int seconds = 0;
+	int tdays = 0;
+	int thours = 0;
+	int tminutes = 0;
+	int tseconds = 0;
+
+	log_debug_info(DEBUGL_CHECKS, 2, "Checking freshness of host '%s'...\n", temp_host->name);
+
+	expiration_time = get_host_freshness_expiration(temp_host, &freshness_threshold);
+
+	log_debug_info(DEBUGL_CHECKS, 2, "Freshness thresholds: host=%d, use=%d\n", temp_host->freshness_threshold, freshness_threshold);
+
 	log_debug_info(DEBUGL_CHECKS, 2, "HBC: %d, PS: %lu, ES: %lu, LC: %lu, CT: %lu, ET: %lu\n", temp_host->has_been_checked, (unsigned long)program_start, (unsigned long)event_start, (unsigned long)temp_host->last_check, (unsigned long)current_time, (unsigned long)expiration_time);
 
 	/* the results for the last check of this host are stale */
@@ -1915,16 +2206,7 @@ int is_host_result_fresh(host *temp_host, time_t current_time, int log_this) {
 /*** ON-DEMAND HOST CHECKS USE THIS FUNCTION ***/
 /* check to see if we can reach the host */
 int perform_on_demand_host_check(host *hst, int *check_result_code, int check_options, int use_cached_result, unsigned long check_timestamp_horizon) {
-	int result = OK;
 	time_t current_time = 0L;
-	int host_result = HOST_UP;
-	char *old_plugin_output = NULL;
-	struct timeval start_time;
-	struct timeval end_time;
-	check_result cr;
-
-	cr.engine = &nagios_check_engine;
-	cr.source = NULL;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "perform_on_demand_host_check()\n");
 
@@ -1932,13 +2214,15 @@ int perform_on_demand_host_check(host *hst, int *check_result_code, int check_op
 	if(hst == NULL)
 		return ERROR;
 
-	log_debug_info(DEBUGL_CHECKS, 0, "** Run sync check of host '%s'...\n", hst->name);
+	log_debug_info(DEBUGL_CHECKS, 0, "** On-demand check of host '%s'...\n", hst->name);
+
+	/* the caller gets the state we know of now, whether or not we have the host checked */
+	if(check_result_code)
+		*check_result_code = hst->current_state;
 
 	/* is the host check viable at this time? */
 	/* if not, return current state and bail out */
 	if(check_host_check_viability(hst, check_options, NULL, NULL) == ERROR) {
-		if(check_result_code)
-			*check_result_code = hst->current_state;
 		log_debug_info(DEBUGL_CHECKS, 0, "Host check is not viable at this time.\n");
 		return OK;
 		}
@@ -1946,16 +2230,11 @@ int perform_on_demand_host_check(host *hst, int *check_result_code, int check_op
 	/* get the current time */
 	time(&current_time);
 
-	/* high resolution start time for event broker */
-	gettimeofday(&start_time, NULL);
-
 	/* can we use the last cached host state? */
 	if(use_cached_result == TRUE && !(check_options & CHECK_OPTION_FORCE_EXECUTION)) {
 
 		/* we can used the cached result, so return it and get out of here... */
 		if(hst->has_been_checked == TRUE && ((current_time - hst->last_check) <= check_timestamp_horizon)) {
-			if(check_result_code)
-				*check_result_code = hst->current_state;
 
 			log_debug_info(DEBUGL_CHECKS, 1, "* Using cached host state: %d\n", hst->current_state);
 
@@ -1967,243 +2246,22 @@ int perform_on_demand_host_check(host *hst, int *check_result_code, int check_op
 			}
 		}
 
+	/* have a worker run the check, so we don't block waiting for it */
+	/* the result is processed like any other when it comes in, and whoever needs it picks it up from there */
+	log_debug_info(DEBUGL_CHECKS, 1, "* Running async on-demand host check: old state=%d\n", hst->current_state);
 
-	log_debug_info(DEBUGL_CHECKS, 1, "* Running actual host check: old state=%d\n", hst->current_state);
+	return run_async_host_check(hst, check_options, 0.0, FALSE, FALSE, NULL, NULL);
+	}
 
 
-	/******** GOOD TO GO FOR A REAL HOST CHECK AT THIS POINT ********/
 
-	/* update check statistics */
-	update_check_stats(ACTIVE_ONDEMAND_HOST_CHECK_STATS, current_time);
-	update_check_stats(SERIAL_HOST_CHECK_STATS, start_time.tv_sec);
-
-	/* reset host check latency, since on-demand checks have none */
-	hst->latency = 0.0;
-
-	/* adjust host check attempt */
-	adjust_host_check_attempt(hst, TRUE);
-
-	/* save old host state */
-	hst->last_state = hst->current_state;
-	if(hst->state_type == HARD_STATE)
-		hst->last_hard_state = hst->current_state;
-
-	/* save old plugin output for state stalking */
-	if(hst->plugin_output)
-		old_plugin_output = (char *)strdup(hst->plugin_output);
-
-	/* set the checked flag */
-	hst->has_been_checked = TRUE;
-
-	/* clear the freshness flag */
-	hst->is_being_freshened = FALSE;
-
-	/* clear check options - we don't want old check options retained */
-	hst->check_options = CHECK_OPTION_NONE;
-
-	/* set the check type */
-	hst->check_type = CHECK_TYPE_ACTIVE;
-
-
-	/*********** EXECUTE THE CHECK AND PROCESS THE RESULTS **********/
-
-#ifdef USE_EVENT_BROKER
-	/* send data to event broker */
-	end_time.tv_sec = 0L;
-	end_time.tv_usec = 0L;
-	broker_host_check(NEBTYPE_HOSTCHECK_INITIATE, NEBFLAG_NONE, NEBATTR_NONE, hst, CHECK_TYPE_ACTIVE, hst->current_state, hst->state_type, start_time, end_time, hst->check_command, hst->latency, 0.0, host_check_timeout, FALSE, 0, NULL, NULL, NULL, NULL, NULL, NULL, &cr);
-#endif
-
-	/* execute the host check */
-	host_result = execute_sync_host_check(hst);
-
-	/* process the host check result */
-	process_host_check_result(hst, host_result, old_plugin_output, check_options, FALSE, use_cached_result, check_timestamp_horizon);
-
-	/* free memory */
-	my_free(old_plugin_output);
-
-	log_debug_info(DEBUGL_CHECKS, 1, "* Sync host check done: new state=%d\n", hst->current_state);
-
-	/* high resolution end time for event broker */
-	gettimeofday(&end_time, NULL);
-
-#ifdef USE_EVENT_BROKER
-	/* send data to event broker */
-	broker_host_check(NEBTYPE_HOSTCHECK_PROCESSED, NEBFLAG_NONE, NEBATTR_NONE, hst, CHECK_TYPE_ACTIVE, hst->current_state, hst->state_type, start_time, end_time, hst->check_command, hst->latency, hst->execution_time, host_check_timeout, FALSE, hst->current_state, NULL, hst->plugin_output, hst->long_plugin_output, hst->perf_data, hst->saved_data, NULL, &cr);
-#endif
-
-	return result;
-	}
-
-
-
-/* run an "alive" check on a host */
-/* on-demand host checks will use this... */
-int execute_sync_host_check(host *hst) {
-	nagios_macros mac;
-	int result = STATE_OK;
-	int return_result = HOST_UP;
-	char *processed_command = NULL;
-	char *raw_command = NULL;
-	struct timeval start_time;
-	struct timeval end_time;
-	char *temp_ptr;
-	int early_timeout = FALSE;
-	double exectime;
-	char *temp_plugin_output = NULL;
-#ifdef USE_EVENT_BROKER
-	int neb_result = OK;
-#endif
-
-
-	log_debug_info(DEBUGL_FUNCTIONS, 0, "execute_sync_host_check()\n");
-
-	if(hst == NULL)
-		return HOST_DOWN;
-
-	log_debug_info(DEBUGL_CHECKS, 0, "** Executing sync check of host '%s'...\n", hst->name);
-
-#ifdef USE_EVENT_BROKER
-	/* initialize start/end times */
-	start_time.tv_sec = 0L;
-	start_time.tv_usec = 0L;
-	end_time.tv_sec = 0L;
-	end_time.tv_usec = 0L;
-
-	/* send data to event broker */
-	neb_result = broker_host_check(NEBTYPE_HOSTCHECK_SYNC_PRECHECK, NEBFLAG_NONE, NEBATTR_NONE, hst, CHECK_TYPE_ACTIVE, hst->current_state, hst->state_type, start_time, end_time, hst->check_command, hst->latency, 0.0, host_check_timeout, FALSE, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
-
-	/* neb module wants to cancel the host check - return the current state of the host */
-	if(neb_result == NEBERROR_CALLBACKCANCEL)
-		return hst->current_state;
-
-	/* neb module wants to override the host check - perhaps it will check the host itself */
-	/* NOTE: if a module does this, it must check the status of the host and populate the data structures BEFORE it returns from the callback! */
-	if(neb_result == NEBERROR_CALLBACKOVERRIDE)
-		return hst->current_state;
-#endif
-
-	/* grab the host macros */
-	memset(&mac, 0, sizeof(mac));
-	grab_host_macros_r(&mac, hst);
-
-	/* high resolution start time for event broker */
-	gettimeofday(&start_time, NULL);
-
-	/* get the last host check time */
-	time(&hst->last_check);
-
-	/* get the raw command line */
-	get_raw_command_line_r(&mac, hst->check_command_ptr, hst->check_command, &raw_command, 0);
-	if(raw_command == NULL) {
-		clear_volatile_macros_r(&mac);
-		return ERROR;
-		}
-
-	/* process any macros contained in the argument */
-	process_macros_r(&mac, raw_command, &processed_command, 0);
-	if(processed_command == NULL) {
-		my_free(raw_command);
-		clear_volatile_macros_r(&mac);
-		return ERROR;
-		}
-
-#ifdef USE_EVENT_BROKER
-	/* send data to event broker */
-	end_time.tv_sec = 0L;
-	end_time.tv_usec = 0L;
-	broker_host_check(NEBTYPE_HOSTCHECK_RAW_START, NEBFLAG_NONE, NEBATTR_NONE, hst, CHECK_TYPE_ACTIVE, return_result, hst->state_type, start_time, end_time, hst->check_command, 0.0, 0.0, host_check_timeout, early_timeout, result, processed_command, hst->plugin_output, hst->long_plugin_output, hst->perf_data, hst->saved_data, NULL, NULL);
-#endif
-
-	log_debug_info(DEBUGL_COMMANDS, 1, "Raw host check command: %s\n", raw_command);
-	log_debug_info(DEBUGL_COMMANDS, 0, "Processed host check ommand: %s\n", processed_command);
-	my_free(raw_command);
-
-	/* clear plugin output and performance data buffers */
-	my_free(hst->plugin_output);
-	my_free(hst->long_plugin_output);
-	my_free(hst->perf_data);
-	my_free(hst->saved_data);
-
-	/* run the host check command */
-	result = my_system_r(&mac, processed_command, host_check_timeout, &early_timeout, &exectime, &temp_plugin_output, MAX_PLUGIN_OUTPUT_LENGTH);
-	clear_volatile_macros_r(&mac);
-
-	/* if the check timed out, report an error */
-	if(early_timeout == TRUE) {
-
-		my_free(temp_plugin_output);
-		(void) asprintf(&temp_plugin_output, "Host check timed out after %d seconds\n", host_check_timeout);
-
-		/* log the timeout */
-		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Host check command '%s' for host '%s' timed out after %d seconds\n", processed_command, hst->name, host_check_timeout);
-		}
-
-	/* calculate total execution time */
-	hst->execution_time = exectime;
-
-	/* record check type */
-	hst->check_type = CHECK_TYPE_ACTIVE;
-
-	/* parse the output: short and long output, and perf data */
-	parse_check_output(temp_plugin_output, &hst->plugin_output, &hst->long_plugin_output, &hst->perf_data, &hst->saved_data, TRUE, TRUE);
-
-	/* free memory */
-	my_free(temp_plugin_output);
-	my_free(processed_command);
-
-	/* a NULL host check command means we should assume the host is UP */
-	if(hst->check_command == NULL) {
-		my_free(hst->plugin_output);
-		hst->plugin_output = (char *)strdup("(Host assumed to be UP)");
-		result = STATE_OK;
-		}
-
-	/* make sure we have some data */
-	if(hst->plugin_output == NULL || !strcmp(hst->plugin_output, "")) {
-		my_free(hst->plugin_output);
-		hst->plugin_output = (char *)strdup("(No output returned from host check)");
-		}
-
-	/* replace semicolons in plugin output (but not performance data) with colons */
-	if((temp_ptr = hst->plugin_output)) {
-		while((temp_ptr = strchr(temp_ptr, ';')))
-			* temp_ptr = ':';
-		}
-
-	/* if we're not doing aggressive host checking, let WARNING states indicate the host is up (fake the result to be STATE_OK) */
-	if(use_aggressive_host_checking == FALSE && result == STATE_WARNING)
-		result = STATE_OK;
-
-
-	if(result == STATE_OK)
-		return_result = HOST_UP;
-	else
-		return_result = HOST_DOWN;
-
-	/* high resolution end time for event broker */
-	gettimeofday(&end_time, NULL);
-
-#ifdef USE_EVENT_BROKER
-	/* send data to event broker */
-	broker_host_check(NEBTYPE_HOSTCHECK_RAW_END, NEBFLAG_NONE, NEBATTR_NONE, hst, CHECK_TYPE_ACTIVE, return_result, hst->state_type, start_time, end_time, hst->check_command, 0.0, exectime, host_check_timeout, early_timeout, result, processed_command, hst->plugin_output, hst->long_plugin_output, hst->perf_data, hst->saved_data, NULL, NULL);
-#endif
-
-	log_debug_info(DEBUGL_CHECKS, 0, "** Sync host check done: state=%d\n", return_result);
-
-	return return_result;
-	}
-
-
-
-/* run a scheduled host check asynchronously */
-int run_scheduled_host_check(host *hst, int check_options, double latency) {
-	int result = OK;
-	time_t current_time = 0L;
-	time_t preferred_time = 0L;
-	time_t next_valid_time = 0L;
-	int time_is_valid = TRUE;
+/* run a scheduled host check asynchronously */
+int run_scheduled_host_check(host *hst, int check_options, double latency) {
+	int result = OK;
+	time_t current_time = 0L;
+	time_t preferred_time = 0L;
+	time_t next_valid_time = 0L;
+	int time_is_valid = TRUE;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "run_scheduled_host_check()\n");
@@ -2383,11 +2441,13 @@ int run_async_host_check(host *hst, int check_options, double latency, int sched
 
 	/* set the execution flag */
 	hst->is_executing = TRUE;
+	sync_host_hot_state(hst);
 
 	/* save check info */
 	cr->object_check_type = HOST_CHECK;
-	cr->host_name = (char *)strdup(hst->name);
+	cr->host_name = (char *)intern_str(hst->name);
 	cr->service_description = NULL;
+	cr->command_name = (char *)intern_str(hst->check_command_ptr->name);
 	cr->check_type = CHECK_TYPE_ACTIVE;
 	cr->check_options = check_options;
 	cr->scheduled_check = scheduled_check;
@@ -2479,6 +2539,7 @@ int handle_async_host_check_result(host *temp_host, check_result *queued_check_r
 	   make the host fresh again, so we do a quick check to make sure the host is still stale before we accept the check result. */
 	if((queued_check_result->check_options & CHECK_OPTION_FRESHNESS_CHECK) && is_host_result_fresh(temp_host, current_time, FALSE) == TRUE) {
 		log_debug_info(DEBUGL_CHECKS, 0, "Discarding host freshness check result because the host is currently fresh (race condition avoided).\n");
+		sync_host_hot_state(temp_host);
 		return OK;
 		}
 
@@ -2638,6 +2699,149 @@ int handle_async_host_check_result(host *temp_host, check_result *queued_check_r
 
 
 
+/* host check results put aside until the checks of the host's parents are done, by host id */
+struct parent_check_wait {
+	int new_state;
+	char *old_plugin_output;
+	int check_options;
+	int reschedule_check;
+	unsigned int *pending; /* ids of the parents we haven't heard back from */
+	int num_pending;
+	int resumed;
+	time_t since;
+	};
+static struct parent_check_wait **parent_check_waits = NULL;
+static unsigned int num_parent_check_waits = 0;
+
+
+/* takes over the array of pending parent ids, which has room for all of the host's parents */
+static int add_parent_check_wait(host *hst, int new_state, char *old_plugin_output, int check_options, int reschedule_check, unsigned int *pending, int num_pending) {
+	struct parent_check_wait *wait = NULL;
+
+	if(pending == NULL)
+		return ERROR;
+	if(parent_check_waits == NULL && (parent_check_waits = (struct parent_check_wait **)calloc(num_objects.hosts, sizeof(*parent_check_waits))) == NULL)
+		return ERROR;
+	if(hst->id >= num_objects.hosts || (wait = (struct parent_check_wait *)calloc(1, sizeof(*wait))) == NULL)
+		return ERROR;
+
+	wait->new_state = new_state;
+	if(old_plugin_output)
+		wait->old_plugin_output = (char *)strdup(old_plugin_output);
+	wait->check_options = check_options;
+	wait->reschedule_check = reschedule_check;
+	wait->pending = pending;
+	wait->num_pending = num_pending;
+	wait->since = time(NULL);
+
+	/* process_host_check_result() took any earlier one off the list, so there's nothing here */
+	parent_check_waits[hst->id] = wait;
+	num_parent_check_waits++;
+
+	return OK;
+	}
+
+
+static struct parent_check_wait *take_parent_check_wait(host *hst) {
+	struct parent_check_wait *wait = NULL;
+
+	if(num_parent_check_waits == 0 || (wait = parent_check_waits[hst->id]) == NULL)
+		return NULL;
+
+	parent_check_waits[hst->id] = NULL;
+	num_parent_check_waits--;
+
+	return wait;
+	}
+
+
+static void free_parent_check_wait(struct parent_check_wait *wait) {
+
+	my_free(wait->old_plugin_output);
+	my_free(wait->pending);
+	my_free(wait);
+	}
+
+
+/* process a result that was put aside, process_host_check_result() takes it off the list */
+static void resume_parent_check_wait(host *hst, struct parent_check_wait *wait) {
+
+	log_debug_info(DEBUGL_CHECKS, 1, "Resuming check result processing for host '%s'\n", hst->name);
+
+	wait->resumed = TRUE;
+	process_host_check_result(hst, wait->new_state, wait->old_plugin_output, wait->check_options, wait->reschedule_check, TRUE, cached_host_check_horizon);
+	free_parent_check_wait(wait);
+	}
+
+
+/* go on with child hosts that were waiting for the result of this one */
+static void resume_parent_check_waits(host *hst) {
+	hostsmember *temp_hostsmember = NULL;
+	host *child_host = NULL;
+	struct parent_check_wait *wait = NULL;
+	int i;
+
+	if(num_parent_check_waits == 0)
+		return;
+
+	for(temp_hostsmember = hst->child_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
+		if((child_host = temp_hostsmember->host_ptr) == NULL || (wait = parent_check_waits[child_host->id]) == NULL)
+			continue;
+
+		/* one parent that's UP is all it takes, otherwise we need all of them */
+		if(hst->current_state != HOST_UP) {
+
+			/* a parent we've already heard back from doesn't count twice */
+			for(i = 0; i < wait->num_pending && wait->pending[i] != hst->id; i++);
+			if(i == wait->num_pending)
+				continue;
+			wait->pending[i] = wait->pending[--wait->num_pending];
+			if(wait->num_pending > 0)
+				continue;
+			}
+
+		resume_parent_check_wait(child_host, wait);
+		}
+	}
+
+
+/* go on with hosts that have been waiting for longer than any parent check should take */
+void check_for_stale_parent_check_waits(void) {
+	time_t current_time = 0L;
+	unsigned int i;
+
+	if(num_parent_check_waits == 0)
+		return;
+
+	time(&current_time);
+
+	for(i = 0; i < num_objects.hosts && num_parent_check_waits > 0; i++) {
+		if(parent_check_waits[i] == NULL || parent_check_waits[i]->since + host_check_timeout + check_reaper_interval + 60 > current_time)
+			continue;
+
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Checks of the parents of host '%s' never came back, so we'll go with what we know.\n", host_ary[i]->name);
+
+		resume_parent_check_wait(host_ary[i], parent_check_waits[i]);
+		}
+	}
+
+
+void free_parent_check_waits(void) {
+	unsigned int i;
+
+	if(parent_check_waits == NULL)
+		return;
+
+	for(i = 0; i < num_objects.hosts; i++) {
+		if(parent_check_waits[i] != NULL)
+			free_parent_check_wait(parent_check_waits[i]);
+		}
+	my_free(parent_check_waits);
+	num_parent_check_waits = 0;
+	}
+
+
+
 /* processes the result of a synchronous or asynchronous host check */
 int process_host_check_result(host *hst, int new_state, char *old_plugin_output, int check_options, int reschedule_check, int use_cached_result, unsigned long check_timestamp_horizon) {
 	hostsmember *temp_hostsmember = NULL;
@@ -2647,7 +2851,9 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 	host *temp_host = NULL;
 	objectlist *check_hostlist = NULL;
 	objectlist *hostlist_item = NULL;
-	int parent_state = HOST_UP;
+	struct parent_check_wait *wait = NULL;
+	unsigned int *pending_parents = NULL;
+	int parent_checks = 0;
 	time_t current_time = 0L;
 	time_t next_check = 0L;
 	time_t preferred_time = 0L;
@@ -2662,6 +2868,12 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 	/* get the current time */
 	time(&current_time);
 
+	/* a result we put aside while waiting for parent host checks is superseded by a newer one */
+	if((wait = take_parent_check_wait(hst)) != NULL && wait->resumed == FALSE) {
+		free_parent_check_wait(wait);
+		wait = NULL;
+		}
+
 	/* default next check time */
 	next_check = (unsigned long)(current_time + (hst->check_interval * interval_length));
 
@@ -2822,46 +3034,85 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 				reschedule_check = TRUE;
 				next_check = (unsigned long)(current_time + (hst->check_interval * interval_length));
 
-				/* we need to run SYNCHRONOUS checks of all parent hosts to accurately determine the state of this host */
-				/* this is extremely inefficient (reminiscent of Nagios 2.x logic), but there's no other good way around it */
-				/* check all parent hosts to see if we're DOWN or UNREACHABLE */
+				/* we need fresh results for all parent hosts to accurately determine the state of this host */
+				/* parents that haven't been checked recently are checked by the workers, and rather than waiting */
+				/* for them here, we put this result aside and pick it up again when theirs are in */
 				/* only do this for ACTIVE checks, as PASSIVE checks contain a pre-determined state */
 				if(hst->check_type == CHECK_TYPE_ACTIVE) {
 
-					log_debug_info(DEBUGL_CHECKS, 1, "** WARNING: Max attempts = 1, so we have to run serial checks of all parent hosts!\n");
+					/* a result we put aside earlier, now that the parent checks are done */
+					if(wait != NULL) {
+						log_debug_info(DEBUGL_CHECKS, 1, "Parent host checks are done, so we can tell if this host is DOWN or UNREACHABLE.\n");
+						hst->current_state = new_state;
+						hst->current_state = determine_host_reachability(hst);
+						}
 
-					for(temp_hostsmember = hst->parent_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
+					else {
 
-						if((parent_host = temp_hostsmember->host_ptr) == NULL)
-							continue;
+						log_debug_info(DEBUGL_CHECKS, 1, "Max attempts = 1, so we need to know the state of all parent hosts.\n");
 
-						log_debug_info(DEBUGL_CHECKS, 1, "Running serial check parent host '%s'...\n", parent_host->name);
+						/* room to note which parents we end up waiting for */
+						for(temp_hostsmember = hst->parent_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next)
+							parent_checks++;
+						if(parent_checks > 0)
+							pending_parents = (unsigned int *)calloc(parent_checks, sizeof(*pending_parents));
+						parent_checks = 0;
 
-						/* run an immediate check of the parent host */
-						perform_on_demand_host_check(parent_host, &parent_state, check_options, use_cached_result, check_timestamp_horizon);
+						for(temp_hostsmember = hst->parent_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
 
-						/* bail out as soon as we find one parent host that is UP */
-						if(parent_state == HOST_UP) {
+							if((parent_host = temp_hostsmember->host_ptr) == NULL)
+								continue;
 
-							log_debug_info(DEBUGL_CHECKS, 1, "Parent host is UP, so this one is DOWN.\n");
+							/* a recent enough result will do */
+							if(use_cached_result == TRUE && parent_host->has_been_checked == TRUE && ((current_time - parent_host->last_check) <= check_timestamp_horizon)) {
+								log_debug_info(DEBUGL_CHECKS, 1, "* Using cached state of parent host '%s': %d\n", parent_host->name, parent_host->current_state);
+								update_check_stats(ACTIVE_ONDEMAND_HOST_CHECK_STATS, current_time);
+								update_check_stats(ACTIVE_CACHED_HOST_CHECK_STATS, current_time);
+								}
 
-							/* set the current state */
-							hst->current_state = HOST_DOWN;
-							break;
-							}
-						}
+							/* otherwise we'll wait for the check (or the one already running) to come back */
+							else if(parent_host->is_executing == TRUE || run_async_host_check(parent_host, check_options, 0.0, FALSE, FALSE, NULL, NULL) == OK) {
+								log_debug_info(DEBUGL_CHECKS, 1, "Waiting for check of parent host '%s'...\n", parent_host->name);
+								if(pending_parents != NULL)
+									pending_parents[parent_checks] = parent_host->id;
+								parent_checks++;
+								continue;
+								}
+
+							/* bail out as soon as we find one parent host that is UP */
+							if(parent_host->current_state == HOST_UP) {
 
-					if(temp_hostsmember == NULL) {
-						/* host has no parents, so its up */
-						if(hst->parent_hosts == NULL) {
-							log_debug_info(DEBUGL_CHECKS, 1, "Host has no parents, so it's DOWN.\n");
-							hst->current_state = HOST_DOWN;
+								log_debug_info(DEBUGL_CHECKS, 1, "Parent host is UP, so this one is DOWN.\n");
+
+								/* set the current state */
+								hst->current_state = HOST_DOWN;
+								break;
+								}
 							}
-						else {
-							/* no parents were up, so this host is UNREACHABLE */
-							log_debug_info(DEBUGL_CHECKS, 1, "No parents were UP, so this host is UNREACHABLE.\n");
-							hst->current_state = HOST_UNREACHABLE;
+
+						if(temp_hostsmember == NULL) {
+							/* host has no parents, so its up */
+							if(hst->parent_hosts == NULL) {
+								log_debug_info(DEBUGL_CHECKS, 1, "Host has no parents, so it's DOWN.\n");
+								hst->current_state = HOST_DOWN;
+								}
+							/* we'll know when the parent checks are done */
+							else if(parent_checks > 0) {
+								log_debug_info(DEBUGL_CHECKS, 1, "Putting the result aside until %d parent host check(s) are done.\n", parent_checks);
+								if(add_parent_check_wait(hst, new_state, old_plugin_output, check_options, reschedule_check, pending_parents, parent_checks) == OK)
+									return OK;
+								hst->current_state = new_state;
+								hst->current_state = determine_host_reachability(hst);
+								}
+							else {
+								/* no parents were up, so this host is UNREACHABLE */
+								log_debug_info(DEBUGL_CHECKS, 1, "No parents were UP, so this host is UNREACHABLE.\n");
+								hst->current_state = HOST_UNREACHABLE;
+								}
 							}
+
+						/* nothing took it over, so it's not needed */
+						my_free(pending_parents);
 						}
 					}
 
@@ -2879,14 +3130,18 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 
 				/* propagate checks to immediate children if they are not UNREACHABLE */
 				/* we do this because we may now be blocking the route to child hosts */
-				log_debug_info(DEBUGL_CHECKS, 1, "Propagating check to immediate non-UNREACHABLE child hosts...\n");
+				/* during an outage storm, the whole subtree is taken care of in one go instead */
+				if(outage_storm_active(current_time) == FALSE || propagate_host_outage(hst, &check_hostlist) == ERROR) {
 
-				for(temp_hostsmember = hst->child_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
-					if((child_host = temp_hostsmember->host_ptr) == NULL)
-						continue;
-					if(child_host->current_state != HOST_UNREACHABLE) {
-						log_debug_info(DEBUGL_CHECKS, 1, "Check of child host '%s' queued.\n", child_host->name);
-						add_object_to_objectlist(&check_hostlist, (void *)child_host);
+					log_debug_info(DEBUGL_CHECKS, 1, "Propagating check to immediate non-UNREACHABLE child hosts...\n");
+
+					for(temp_hostsmember = hst->child_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
+						if((child_host = temp_hostsmember->host_ptr) == NULL)
+							continue;
+						if(child_host->current_state != HOST_UNREACHABLE) {
+							log_debug_info(DEBUGL_CHECKS, 1, "Check of child host '%s' queued.\n", child_host->name);
+							add_object_to_objectlist(&check_hostlist, (void *)child_host);
+							}
 						}
 					}
 				}
@@ -2944,14 +3199,18 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 
 				/* propagate checks to immediate children if they are not UNREACHABLE */
 				/* we do this because we may now be blocking the route to child hosts */
-				log_debug_info(DEBUGL_CHECKS, 1, "Propagating checks to immediate non-UNREACHABLE child hosts...\n");
+				/* during an outage storm, the whole subtree is taken care of in one go instead */
+				if(outage_storm_active(current_time) == FALSE || propagate_host_outage(hst, &check_hostlist) == ERROR) {
 
-				for(temp_hostsmember = hst->child_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
-					if((child_host = temp_hostsmember->host_ptr) == NULL)
-						continue;
-					if(child_host->current_state != HOST_UNREACHABLE) {
-						log_debug_info(DEBUGL_CHECKS, 1, "Check of child host '%s' queued.\n", child_host->name);
-						add_object_to_objectlist(&check_hostlist, (void *)child_host);
+					log_debug_info(DEBUGL_CHECKS, 1, "Propagating checks to immediate non-UNREACHABLE child hosts...\n");
+
+					for(temp_hostsmember = hst->child_hosts; temp_hostsmember != NULL; temp_hostsmember = temp_hostsmember->next) {
+						if((child_host = temp_hostsmember->host_ptr) == NULL)
+							continue;
+						if(child_host->current_state != HOST_UNREACHABLE) {
+							log_debug_info(DEBUGL_CHECKS, 1, "Check of child host '%s' queued.\n", child_host->name);
+							add_object_to_objectlist(&check_hostlist, (void *)child_host);
+							}
 						}
 					}
 
@@ -3042,6 +3301,12 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 	/* update host status - for both active (scheduled) and passive (non-scheduled) hosts */
 	update_host_status(hst, FALSE);
 
+	/* pick up the results of child hosts that were waiting for this one */
+	resume_parent_check_waits(hst);
+
+	/* and the results of services that were waiting for it */
+	resume_host_check_waits(hst);
+
 	/* run async checks of all hosts we added above */
 	/* don't run a check if one is already executing or we can get by with a cached state */
 	for(hostlist_item = check_hostlist; hostlist_item != NULL; hostlist_item = hostlist_item->next) {
@@ -3054,6 +3319,8 @@ int process_host_check_result(host *hst, int new_state, char *old_plugin_output,
 			run_async_check = FALSE;
 		if(temp_host->is_executing == TRUE)
 			run_async_check = FALSE;
+		if(run_async_check == TRUE && outage_host_check_is_redundant(temp_host, current_time) == TRUE)
+			run_async_check = FALSE;
 		if(run_async_check == TRUE)
 			run_async_host_check(temp_host, CHECK_OPTION_NONE, 0.0, FALSE, FALSE, NULL, NULL);
 		}
@@ -3212,6 +3479,39 @@ int determine_host_reachability(host *hst) {
 
 
 
+/* re-evaluate DOWN/UNREACHABLE for a host that isn't UP from its last check result, without checking it again */
+/* used when the route to a host changes during an outage storm, returns TRUE if the host's state changed */
+int translate_host_reachability(host *hst) {
+	int new_state = HOST_DOWN;
+
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "translate_host_reachability()\n");
+
+	if(hst == NULL || hst->current_state == HOST_UP)
+		return FALSE;
+
+	new_state = determine_host_reachability(hst);
+	if(new_state == hst->current_state)
+		return FALSE;
+
+	log_debug_info(DEBUGL_CHECKS, 1, "Host '%s' changes from state %d to %d because of its parents\n", hst->name, hst->current_state, new_state);
+
+	/* save old host state, like we do before processing a check result */
+	hst->last_state = hst->current_state;
+	if(hst->state_type == HARD_STATE)
+		hst->last_hard_state = hst->current_state;
+
+	hst->current_state = new_state;
+
+	/* there's no new check result, so skip the obsessing and performance data */
+	handle_host_state_change(hst);
+
+	update_host_status(hst, FALSE);
+
+	return TRUE;
+	}
+
+
+
 /******************************************************************/
 /****************** HOST STATE HANDLER FUNCTIONS ******************/
 /******************************************************************/
@@ -3219,8 +3519,6 @@ int determine_host_reachability(host *hst) {
 
 /* top level host state handler - occurs after every host check (soft/hard and active/passive) */
 int handle_host_state(host *hst) {
-	int state_change = FALSE;
-	int hard_state_change = FALSE;
 	time_t current_time = 0L;
 
 
@@ -3235,6 +3533,27 @@ int handle_host_state(host *hst) {
 	/* update performance data */
 	update_host_performance_data(hst);
 
+	/* count state changes, so we know when we're in an outage storm */
+	if(hst->last_state != hst->current_state)
+		outage_host_state_change(current_time);
+
+	return handle_host_state_change(hst);
+	}
+
+
+
+/* handles host state changes, notifications and event handlers */
+static int handle_host_state_change(host *hst) {
+	int state_change = FALSE;
+	int hard_state_change = FALSE;
+	time_t current_time = 0L;
+
+
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "handle_host_state_change()\n");
+
+	/* get current time */
+	time(&current_time);
+
 	/* record latest time for current state */
 	switch(hst->current_state) {
 		case HOST_UP:
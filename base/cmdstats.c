@@ -0,0 +1,281 @@
+/*
+ * Per-command resource usage
+ *
+ * Workers tell us how much cpu time, how many page faults and how
+ * much block io each job cost. This adds it all up per plugin and
+ * per check_command, so it's easy to find the ones that are eating
+ * the monitoring host alive. The numbers are exposed through the
+ * @core query handler and written to status data.
+ *
+ * Rates are taken over the last CMDSTATS_MINUTES minutes, while the
+ * totals and the runtime histogram cover everything since the entry
+ * was created or last reset.
+ */
+
+#include "include/config.h"
+#include "include/nagios.h"
+#include "lib/libnagios.h"
+#include "lib/nsock.h"
+
+#define CMDSTATS_MINUTES 5
+
+#define CMDSTATS_PLUGIN 0
+#define CMDSTATS_CHECK_COMMAND 1
+
+struct cmdstats_minute {
+	time_t minute; /* time / 60 */
+	double cpu;
+	unsigned long runs, minflt, majflt;
+};
+
+struct cmdstats {
+	int type;
+	char *name;
+	time_t since;
+	unsigned long runs, timeouts;
+	double utime, stime;
+	unsigned long long minflt, majflt, inblock, oublock;
+	struct latency_histogram runtime;
+	struct cmdstats_minute recent[CMDSTATS_MINUTES];
+};
+
+static const char *cmdstats_types[] = { "plugin", "check_command" };
+
+static dkhash_table *cmdstats_table;
+static struct cmdstats **cmdstats_list;
+static unsigned int cmdstats_len, cmdstats_alloc;
+
+#define tv2double(tv) ((double)(tv)->tv_sec + ((double)(tv)->tv_usec / 1000000.0))
+
+static struct cmdstats *cmdstats_get(int type, const char *name)
+{
+	struct cmdstats *cs;
+
+	if (cmdstats_table && (cs = dkhash_get(cmdstats_table, cmdstats_types[type], name)))
+		return cs;
+
+	if (!cmdstats_table && !(cmdstats_table = dkhash_create(1024)))
+		return NULL;
+	if (cmdstats_len >= cmdstats_alloc) {
+		struct cmdstats **list;
+		unsigned int alloc = cmdstats_alloc ? cmdstats_alloc * 2 : 64;
+		if (!(list = realloc(cmdstats_list, alloc * sizeof(*list))))
+			return NULL;
+		cmdstats_list = list;
+		cmdstats_alloc = alloc;
+	}
+	if (!(cs = calloc(1, sizeof(*cs))))
+		return NULL;
+	cs->type = type;
+	cs->since = time(NULL);
+	if (!(cs->name = strdup(name)) ||
+	    dkhash_insert(cmdstats_table, cmdstats_types[type], cs->name, cs) < 0) {
+		free(cs->name);
+		free(cs);
+		return NULL;
+	}
+	cmdstats_list[cmdstats_len++] = cs;
+
+	return cs;
+}
+
+static void cmdstats_add(struct cmdstats *cs, time_t now, unsigned long long usec,
+                         const struct rusage *ru, int timed_out)
+{
+	struct cmdstats_minute *m = &cs->recent[(now / 60) % CMDSTATS_MINUTES];
+	double cpu = tv2double(&ru->ru_utime) + tv2double(&ru->ru_stime);
+
+	cs->runs++;
+	if (timed_out)
+		cs->timeouts++;
+	cs->utime += tv2double(&ru->ru_utime);
+	cs->stime += tv2double(&ru->ru_stime);
+	cs->minflt += ru->ru_minflt;
+	cs->majflt += ru->ru_majflt;
+	cs->inblock += ru->ru_inblock;
+	cs->oublock += ru->ru_oublock;
+	latency_histogram_add(&cs->runtime, usec);
+
+	if (m->minute != now / 60) {
+		memset(m, 0, sizeof(*m));
+		m->minute = now / 60;
+	}
+	m->runs++;
+	m->cpu += cpu;
+	m->minflt += ru->ru_minflt;
+	m->majflt += ru->ru_majflt;
+}
+
+void cmdstats_record(const char *check_command, const char *command_line,
+                     const struct timeval *start, const struct timeval *stop,
+                     const struct rusage *ru, int timed_out)
+{
+	struct cmdstats *cs;
+	const char *plugin = NULL, *p;
+	char name[256];
+	size_t len = 0;
+	long long usec;
+	time_t now = time(NULL);
+
+	usec = ((long long)(stop->tv_sec - start->tv_sec) * 1000000) + (stop->tv_usec - start->tv_usec);
+	if (usec < 0)
+		usec = 0;
+
+	/* the plugin is the basename of the first word of the command */
+	if (command_line) {
+		while (*command_line == ' ' || *command_line == '\t')
+			command_line++;
+		for (p = plugin = command_line; *p && *p != ' ' && *p != '\t'; p++) {
+			if (*p == '/')
+				plugin = p + 1;
+		}
+		len = p - plugin;
+	}
+	if (len && len < sizeof(name)) {
+		memcpy(name, plugin, len);
+		name[len] = 0;
+		if ((cs = cmdstats_get(CMDSTATS_PLUGIN, name)))
+			cmdstats_add(cs, now, usec, ru, timed_out);
+	}
+
+	if (check_command && (cs = cmdstats_get(CMDSTATS_CHECK_COMMAND, check_command)))
+		cmdstats_add(cs, now, usec, ru, timed_out);
+}
+
+/* per-minute rates over the last few minutes, current one included */
+static void cmdstats_rates(struct cmdstats *cs, time_t now, double *cpu, double *runs, double *minflt, double *majflt)
+{
+	time_t first = (now / 60) - CMDSTATS_MINUTES + 1, span;
+	int i;
+
+	*cpu = *runs = *minflt = *majflt = 0;
+	for (i = 0; i < CMDSTATS_MINUTES; i++) {
+		struct cmdstats_minute *m = &cs->recent[i];
+		if (m->minute < first || m->minute > now / 60)
+			continue;
+		*cpu += m->cpu;
+		*runs += m->runs;
+		*minflt += m->minflt;
+		*majflt += m->majflt;
+	}
+
+	span = now - (cs->since > first * 60 ? cs->since : first * 60);
+	if (span < 1)
+		span = 1;
+	*cpu = *cpu * 60 / span;
+	*runs = *runs * 60 / span;
+	*minflt = *minflt * 60 / span;
+	*majflt = *majflt * 60 / span;
+}
+
+static void cmdstats_print(int sd, struct cmdstats *cs, time_t now)
+{
+	double cpu_rate, run_rate, minflt_rate, majflt_rate;
+
+	cmdstats_rates(cs, now, &cpu_rate, &run_rate, &minflt_rate, &majflt_rate);
+	nsock_printf(sd, "type=%s;name=%s;since=%lu;runs=%lu;timeouts=%lu;"
+	             "utime=%.3f;stime=%.3f;cpu_per_min=%.3f;runs_per_min=%.2f;"
+	             "runtime_p50=%llu;runtime_p99=%llu;runtime_max=%llu;"
+	             "minflt=%llu;majflt=%llu;minflt_per_min=%.2f;majflt_per_min=%.2f;"
+	             "inblock=%llu;oublock=%llu\n",
+	             cmdstats_types[cs->type], cs->name, (unsigned long)cs->since, cs->runs, cs->timeouts,
+	             cs->utime, cs->stime, cpu_rate, run_rate,
+	             latency_histogram_percentile(&cs->runtime, 50),
+	             latency_histogram_percentile(&cs->runtime, 99), cs->runtime.usec_max,
+	             cs->minflt, cs->majflt, minflt_rate, majflt_rate,
+	             cs->inblock, cs->oublock);
+}
+
+static time_t cmdstats_sort_now;
+
+/* hungriest first */
+static int cmdstats_cmp(const void *a_, const void *b_)
+{
+	struct cmdstats *a = *(struct cmdstats **)a_, *b = *(struct cmdstats **)b_;
+	double a_cpu, b_cpu, dummy;
+
+	cmdstats_rates(a, cmdstats_sort_now, &a_cpu, &dummy, &dummy, &dummy);
+	cmdstats_rates(b, cmdstats_sort_now, &b_cpu, &dummy, &dummy, &dummy);
+	if (a_cpu != b_cpu)
+		return a_cpu < b_cpu ? 1 : -1;
+	if (a->utime + a->stime != b->utime + b->stime)
+		return a->utime + a->stime < b->utime + b->stime ? 1 : -1;
+	return strcmp(a->name, b->name);
+}
+
+void cmdstats_reset(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < cmdstats_len; i++) {
+		free(cmdstats_list[i]->name);
+		free(cmdstats_list[i]);
+	}
+	free(cmdstats_list);
+	cmdstats_list = NULL;
+	cmdstats_len = cmdstats_alloc = 0;
+	if (cmdstats_table)
+		dkhash_destroy(cmdstats_table);
+	cmdstats_table = NULL;
+}
+
+int cmdstats_qh(int sd, char *buf, unsigned int len)
+{
+	unsigned int i, found = 0;
+	time_t now = time(NULL);
+
+	if (!buf || !*buf) {
+		cmdstats_sort_now = now;
+		qsort(cmdstats_list, cmdstats_len, sizeof(*cmdstats_list), cmdstats_cmp);
+		for (i = 0; i < cmdstats_len; i++)
+			cmdstats_print(sd, cmdstats_list[i], now);
+		return 0;
+	}
+
+	if (!strcmp(buf, "reset")) {
+		cmdstats_reset();
+		return 200;
+	}
+
+	/* either kind of entry, by name */
+	for (i = 0; i < cmdstats_len; i++) {
+		if (!strcmp(buf, cmdstats_list[i]->name)) {
+			cmdstats_print(sd, cmdstats_list[i], now);
+			found++;
+		}
+	}
+
+	return found ? 0 : 404;
+}
+
+void cmdstats_write_status(FILE *fp)
+{
+	unsigned int i;
+	time_t now = time(NULL);
+
+	for (i = 0; i < cmdstats_len; i++) {
+		struct cmdstats *cs = cmdstats_list[i];
+		double cpu_rate, run_rate, minflt_rate, majflt_rate;
+
+		cmdstats_rates(cs, now, &cpu_rate, &run_rate, &minflt_rate, &majflt_rate);
+		fprintf(fp, "commandstats {\n");
+		fprintf(fp, "\ttype=%s\n", cmdstats_types[cs->type]);
+		fprintf(fp, "\tname=%s\n", cs->name);
+		fprintf(fp, "\tsince=%lu\n", (unsigned long)cs->since);
+		fprintf(fp, "\truns=%lu\n", cs->runs);
+		fprintf(fp, "\ttimeouts=%lu\n", cs->timeouts);
+		fprintf(fp, "\tutime=%.3f\n", cs->utime);
+		fprintf(fp, "\tstime=%.3f\n", cs->stime);
+		fprintf(fp, "\tcpu_per_min=%.3f\n", cpu_rate);
+		fprintf(fp, "\truns_per_min=%.2f\n", run_rate);
+		fprintf(fp, "\truntime_p50=%llu\n", latency_histogram_percentile(&cs->runtime, 50));
+		fprintf(fp, "\truntime_p99=%llu\n", latency_histogram_percentile(&cs->runtime, 99));
+		fprintf(fp, "\tminflt=%llu\n", cs->minflt);
+		fprintf(fp, "\tmajflt=%llu\n", cs->majflt);
+		fprintf(fp, "\tminflt_per_min=%.2f\n", minflt_rate);
+		fprintf(fp, "\tmajflt_per_min=%.2f\n", majflt_rate);
+		fprintf(fp, "\tinblock=%llu\n", cs->inblock);
+		fprintf(fp, "\toublock=%llu\n", cs->oublock);
+		fprintf(fp, "\t}\n\n");
+	}
+}
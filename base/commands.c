@@ -3418,8 +3418,9 @@ int cmd_change_object_char_var(int cmd, char *args) {
 			break;
 
 		case CMD_CHANGE_HOST_CHECK_COMMAND:
-			my_free(temp_host->check_command);
-			temp_host->check_command = temp_ptr;
+			intern_free(temp_host->check_command);
+			temp_host->check_command = (char *)intern_str(temp_ptr);
+			my_free(temp_ptr);
 			temp_host->check_command_ptr = temp_command;
 			attr = MODATTR_CHECK_COMMAND;
 			break;
@@ -3446,8 +3447,9 @@ int cmd_change_object_char_var(int cmd, char *args) {
 			break;
 
 		case CMD_CHANGE_SVC_CHECK_COMMAND:
-			my_free(temp_service->check_command);
-			temp_service->check_command = temp_ptr;
+			intern_free(temp_service->check_command);
+			temp_service->check_command = (char *)intern_str(temp_ptr);
+			my_free(temp_ptr);
 			temp_service->check_command_ptr = temp_command;
 			attr = MODATTR_CHECK_COMMAND;
 			break;
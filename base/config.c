@@ -27,6 +27,7 @@
 #include "../include/broker.h"
 #include "../include/nebmods.h"
 #include "../include/nebmodules.h"
+#include "../include/workers.h"
 
 
 /*** helpers ****/
@@ -154,6 +155,17 @@ int read_main_config_file(char *main_config_file) {
 			error = set_loadctl_options(value, strlen(value)) != OK;
 		else if(!strcmp(variable, "check_workers"))
 			num_check_workers = atoi(value);
+		else if(!strcmp(variable, "max_check_workers"))
+			max_check_workers = atoi(value);
+		else if(!strcmp(variable, "outage_storm_threshold"))
+			outage_storm_threshold = atoi(value);
+		else if(!strcmp(variable, "resident_plugin")) {
+			if(wproc_add_resident_plugin(value) != OK) {
+				(void)asprintf(&error_message, "Illegal value for resident_plugin (must be '<plugin> <helper command>')");
+				error = TRUE;
+				break;
+				}
+			}
 		else if(!strcmp(variable, "query_socket"))
 			qh_socket_path = (char *)strdup(value);
 		else if(!strcmp(variable, "log_file")) {
@@ -193,6 +205,18 @@ int read_main_config_file(char *main_config_file) {
 		else if(!strcmp(variable, "max_debug_file_size"))
 			max_debug_file_size = strtoul(value, NULL, 0);
 
+		else if(!strcmp(variable, "debug_file_format")) {
+			if(!strcmp(value, "text"))
+				debug_file_format = DEBUG_FORMAT_TEXT;
+			else if(!strcmp(value, "binary"))
+				debug_file_format = DEBUG_FORMAT_BINARY;
+			else {
+				(void)asprintf(&error_message, "Illegal value for debug_file_format (must be 'text' or 'binary')");
+				error = TRUE;
+				break;
+				}
+			}
+
 		else if(!strcmp(variable, "command_file")) {
 
 			if(strlen(value) > MAX_FILENAME_LENGTH - 1) {
@@ -1024,6 +1048,9 @@ int read_main_config_file(char *main_config_file) {
 				event_broker_options = strtoul(value, NULL, 0);
 			}
 
+		else if(!strcmp(variable, "broker_callback_profiling"))
+			broker_callback_profiling = (atoi(value) > 0) ? TRUE : FALSE;
+
 		else if(!strcmp(variable, "illegal_object_name_chars"))
 			illegal_object_chars = (char *)strdup(value);
 
@@ -532,9 +532,8 @@ void init_timing_loop(void) {
 	/* add a check result reaper event */
 	schedule_new_event(EVENT_CHECK_REAPER, TRUE, current_time + check_reaper_interval, TRUE, check_reaper_interval, NULL, TRUE, NULL, NULL, 0);
 
-	/* add an orphaned check event */
-	if(check_orphaned_services == TRUE || check_orphaned_hosts == TRUE)
-		schedule_new_event(EVENT_ORPHAN_CHECK, TRUE, current_time + DEFAULT_ORPHAN_CHECK_INTERVAL, TRUE, DEFAULT_ORPHAN_CHECK_INTERVAL, NULL, TRUE, NULL, NULL, 0);
+	/* add an orphaned check event, which also looks after host results waiting for parent checks */
+	schedule_new_event(EVENT_ORPHAN_CHECK, TRUE, current_time + DEFAULT_ORPHAN_CHECK_INTERVAL, TRUE, DEFAULT_ORPHAN_CHECK_INTERVAL, NULL, TRUE, NULL, NULL, 0);
 
 	/* add a service result "freshness" check event */
 	if(check_service_freshness == TRUE)
@@ -544,6 +543,10 @@ void init_timing_loop(void) {
 	if(check_host_freshness == TRUE)
 		schedule_new_event(EVENT_HFRESHNESS_CHECK, TRUE, current_time + host_freshness_check_interval, TRUE, host_freshness_check_interval, NULL, TRUE, NULL, NULL, 0);
 
+	/* add a worker pool autoscaling event */
+	if(max_check_workers > (int)wproc_num_workers_desired)
+		schedule_new_event(EVENT_USER_FUNCTION, TRUE, current_time + WPROC_AUTOSCALE_INTERVAL, TRUE, WPROC_AUTOSCALE_INTERVAL, NULL, TRUE, (void *)wproc_autoscale, NULL, 0);
+
 	/* add a status save event */
 	schedule_new_event(EVENT_STATUS_SAVE, TRUE, current_time + status_update_interval, TRUE, status_update_interval, NULL, TRUE, NULL, NULL, 0);
 
@@ -936,6 +939,7 @@ int event_execution_loop(void) {
 	time_t current_time = 0L;
 	time_t last_status_update = 0L;
 	int poll_time_ms;
+	struct timeval loop_start = {0, 0};
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "event_execution_loop() start\n");
 
@@ -993,12 +997,17 @@ int event_execution_loop(void) {
 		last_event = temp_event;
 
 		gettimeofday(&now, NULL);
+		if(loop_start.tv_sec)
+			latency_record(LATENCY_LOOP, &loop_start, &now);
 		poll_time_ms = tv_delta_msec(&now, event_runtime) - 25;
 		if (poll_time_ms < 0)
 			poll_time_ms = 0;
 		else if(poll_time_ms >= 1500)
 			poll_time_ms = 1500;
 
+		/* write out log lines if we're going idle or they've waited long enough */
+		flush_log_file_if_due(&now, poll_time_ms > 0);
+
 		log_debug_info(DEBUGL_SCHEDULING | DEBUGL_IPC, 1, "## Polling %dms; sockets=%d; events=%u; iobs=%p\n",
 		               poll_time_ms, iobroker_get_num_fds(nagios_iobs),
 		               squeue_size(nagios_squeue), nagios_iobs);
@@ -1011,7 +1020,9 @@ int event_execution_loop(void) {
 		log_debug_info(DEBUGL_IPC, 2, "## %d descriptors had input\n", inputs);
 
 		/* 100 milliseconds allowance for firing off events early */
-		gettimeofday(&now, NULL);
+		gettimeofday(&loop_start, NULL);
+		latency_record(LATENCY_POLL, &now, &loop_start);
+		now = loop_start;
 		if (tv_delta_msec(&now, event_runtime) > 100)
 			continue;
 
@@ -1070,6 +1081,7 @@ int handle_timed_event(timed_event *event) {
 	latency = (double)(tv_delta_f(event_runtime, &tv));
 	if (latency < 0.0) /* events may run up to 0.1 seconds early */
 		latency = 0.0;
+	latency_record_usec(LATENCY_EVENT_DISPATCH, (unsigned long long)(latency * 1000000));
 
 	/* how should we handle the event? */
 	switch(event->event_type) {
@@ -1141,6 +1153,12 @@ int handle_timed_event(timed_event *event) {
 				check_for_orphaned_hosts();
 			if(check_orphaned_services == TRUE)
 				check_for_orphaned_services();
+
+			/* results of on-demand parent checks are missed by the above, so hosts waiting for them need a look too */
+			check_for_stale_parent_check_waits();
+
+			/* the same goes for services waiting for on-demand host checks */
+			check_for_stale_host_check_waits();
 			break;
 
 		case EVENT_RETENTION_SAVE:
@@ -1191,8 +1209,12 @@ int handle_timed_event(timed_event *event) {
 
 			log_debug_info(DEBUGL_EVENTS, 0, "** Expire Downtime Event. Latency: %.3fs\n", latency);
 
-			/* check for expired scheduled downtime entries */
-			check_for_expired_downtime();
+			/* end or expire scheduled downtime */
+			if(event->event_data) {
+				check_for_expired_downtime(*(unsigned long *)event->event_data);
+				free(event->event_data);
+				event->event_data = NULL;
+				}
 			break;
 
 		case EVENT_RESCHEDULE_CHECKS:
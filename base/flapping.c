@@ -31,6 +31,119 @@
 #include "../include/broker.h"
 
 
+/******************************************************************/
+/********************* STATE HISTORY FUNCTIONS ********************/
+/******************************************************************/
+
+/*
+ * All the weighted percent state change cares about is whether each
+ * recorded state differs from the one recorded before it, so that's
+ * all the state history keeps: one bit per transition between the
+ * last MAX_STATE_HISTORY_ENTRIES states, the newest in bit 0, and
+ * the last recorded state itself in the top byte.
+ *
+ * The percent change is the sum of the weights of the transitions
+ * that were changes. Floating point addition isn't associative, so
+ * to give exactly the same numbers as the old loop over 21 recorded
+ * states, the weights are added up in the same order, oldest first.
+ * The sums for every combination of the 10 oldest transitions are
+ * looked up in a table, and the newer changes are added to that.
+ */
+#define STATE_HISTORY_CHANGES	(MAX_STATE_HISTORY_ENTRIES - 1)
+#define STATE_HISTORY_MASK	((1U << STATE_HISTORY_CHANGES) - 1)
+#define STATE_HISTORY_SHIFT	24
+#define STATE_HISTORY_OLD_BITS	10
+
+static double state_change_weight[STATE_HISTORY_CHANGES];	/* oldest transition first */
+static double old_state_change_sum[1 << STATE_HISTORY_OLD_BITS];
+static int state_change_tables_ready = FALSE;
+
+
+static void init_state_change_tables(void) {
+	double low_curve_value = 0.75;
+	double high_curve_value = 1.25;
+	register int x = 0;
+	register int bits = 0;
+
+	for(x = 1; x < MAX_STATE_HISTORY_ENTRIES; x++)
+		state_change_weight[x - 1] = (((double)(x - 1) * (high_curve_value - low_curve_value)) / ((double)(MAX_STATE_HISTORY_ENTRIES - 2))) + low_curve_value;
+
+	/* the top bit of the index is the oldest transition */
+	for(bits = 0; bits < (1 << STATE_HISTORY_OLD_BITS); bits++) {
+		old_state_change_sum[bits] = 0.0;
+		for(x = 0; x < STATE_HISTORY_OLD_BITS; x++) {
+			if(bits & (1 << (STATE_HISTORY_OLD_BITS - 1 - x)))
+				old_state_change_sum[bits] += state_change_weight[x];
+			}
+		}
+
+	state_change_tables_ready = TRUE;
+	}
+
+
+/* records a new state in a host or service state history */
+void update_state_history(unsigned int *state_history, int state) {
+	unsigned int last_state = *state_history >> STATE_HISTORY_SHIFT;
+	unsigned int changes = *state_history & STATE_HISTORY_MASK;
+
+	changes = ((changes << 1) | ((unsigned int)state != last_state)) & STATE_HISTORY_MASK;
+	*state_history = changes | ((unsigned int)(state & 0xff) << STATE_HISTORY_SHIFT);
+	}
+
+
+/* returns the weighted percent state change of a state history */
+double get_state_history_percent_change(unsigned int state_history) {
+	unsigned int changes = state_history & STATE_HISTORY_MASK;
+	double curved_changes = 0.0;
+	register int x = 0;
+
+	if(state_change_tables_ready == FALSE)
+		init_state_change_tables();
+
+	curved_changes = old_state_change_sum[changes >> (STATE_HISTORY_CHANGES - STATE_HISTORY_OLD_BITS)];
+	for(x = STATE_HISTORY_OLD_BITS; x < STATE_HISTORY_CHANGES; x++) {
+		if(changes & (1U << (STATE_HISTORY_CHANGES - 1 - x)))
+			curved_changes += state_change_weight[x];
+		}
+
+	return (double)(((double)curved_changes * 100.0) / (double)(MAX_STATE_HISTORY_ENTRIES - 1));
+	}
+
+
+/* builds a state history from MAX_STATE_HISTORY_ENTRIES recorded states, oldest first */
+unsigned int state_history_from_states(int *states) {
+	unsigned int state_history = 0;
+	register int x = 0;
+
+	state_history = (unsigned int)(states[0] & 0xff) << STATE_HISTORY_SHIFT;
+	for(x = 1; x < MAX_STATE_HISTORY_ENTRIES; x++)
+		update_state_history(&state_history, states[x]);
+
+	return state_history;
+	}
+
+
+/*
+ * fills in MAX_STATE_HISTORY_ENTRIES states, oldest first, that give
+ * the same state history. Only the newest one is a state that was
+ * actually recorded; the older ones merely change where it changed.
+ */
+void state_history_to_states(unsigned int state_history, int *states) {
+	register int x = 0;
+
+	states[MAX_STATE_HISTORY_ENTRIES - 1] = state_history >> STATE_HISTORY_SHIFT;
+	for(x = MAX_STATE_HISTORY_ENTRIES - 2; x >= 0; x--) {
+		if(state_history & (1U << (STATE_HISTORY_CHANGES - 1 - x)))
+			states[x] = (states[x + 1] == 0) ? 1 : 0;
+		else
+			states[x] = states[x + 1];
+		}
+
+	return;
+	}
+
+
+
 /******************************************************************/
 /******************** FLAP DETECTION FUNCTIONS ********************/
 /******************************************************************/
@@ -40,15 +153,9 @@
 void check_for_service_flapping(service *svc, int update, int allow_flapstart_notification) {
 	int update_history = TRUE;
 	int is_flapping = FALSE;
-	register int x = 0;
-	register int y = 0;
-	int last_state_history_value = STATE_OK;
-	double curved_changes = 0.0;
 	double curved_percent_change = 0.0;
 	double low_threshold = 0.0;
 	double high_threshold = 0.0;
-	double low_curve_value = 0.75;
-	double high_curve_value = 1.25;
 
 	/* large install tweaks skips all flap detection logic - including state change calculation */
 
@@ -83,37 +190,11 @@ void check_for_service_flapping(service *svc, int update, int allow_flapstart_no
 	if(update_history == TRUE) {
 
 		/* record the current state in the state history */
-		svc->state_history[svc->state_history_index] = svc->current_state;
-
-		/* increment state history index to next available slot */
-		svc->state_history_index++;
-		if(svc->state_history_index >= MAX_STATE_HISTORY_ENTRIES)
-			svc->state_history_index = 0;
-		}
-
-	/* calculate overall and curved percent state changes */
-	for(x = 0, y = svc->state_history_index; x < MAX_STATE_HISTORY_ENTRIES; x++) {
-
-		if(x == 0) {
-			last_state_history_value = svc->state_history[y];
-			y++;
-			if(y >= MAX_STATE_HISTORY_ENTRIES)
-				y = 0;
-			continue;
-			}
-
-		if(last_state_history_value != svc->state_history[y])
-			curved_changes += (((double)(x - 1) * (high_curve_value - low_curve_value)) / ((double)(MAX_STATE_HISTORY_ENTRIES - 2))) + low_curve_value;
-
-		last_state_history_value = svc->state_history[y];
-
-		y++;
-		if(y >= MAX_STATE_HISTORY_ENTRIES)
-			y = 0;
+		update_state_history(&svc->state_history, svc->current_state);
 		}
 
 	/* calculate overall percent change in state */
-	curved_percent_change = (double)(((double)curved_changes * 100.0) / (double)(MAX_STATE_HISTORY_ENTRIES - 1));
+	curved_percent_change = get_state_history_percent_change(svc->state_history);
 
 	svc->percent_state_change = curved_percent_change;
 
@@ -160,17 +241,11 @@ void check_for_service_flapping(service *svc, int update, int allow_flapstart_no
 void check_for_host_flapping(host *hst, int update, int actual_check, int allow_flapstart_notification) {
 	int update_history = TRUE;
 	int is_flapping = FALSE;
-	register int x = 0;
-	register int y = 0;
-	int last_state_history_value = HOST_UP;
 	unsigned long wait_threshold = 0L;
-	double curved_changes = 0.0;
 	double curved_percent_change = 0.0;
 	time_t current_time = 0L;
 	double low_threshold = 0.0;
 	double high_threshold = 0.0;
-	double low_curve_value = 0.75;
-	double high_curve_value = 1.25;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_for_host_flapping()\n");
@@ -216,37 +291,11 @@ void check_for_host_flapping(host *hst, int update, int actual_check, int allow_
 		hst->last_state_history_update = current_time;
 
 		/* record the current state in the state history */
-		hst->state_history[hst->state_history_index] = hst->current_state;
-
-		/* increment state history index to next available slot */
-		hst->state_history_index++;
-		if(hst->state_history_index >= MAX_STATE_HISTORY_ENTRIES)
-			hst->state_history_index = 0;
-		}
-
-	/* calculate overall changes in state */
-	for(x = 0, y = hst->state_history_index; x < MAX_STATE_HISTORY_ENTRIES; x++) {
-
-		if(x == 0) {
-			last_state_history_value = hst->state_history[y];
-			y++;
-			if(y >= MAX_STATE_HISTORY_ENTRIES)
-				y = 0;
-			continue;
-			}
-
-		if(last_state_history_value != hst->state_history[y])
-			curved_changes += (((double)(x - 1) * (high_curve_value - low_curve_value)) / ((double)(MAX_STATE_HISTORY_ENTRIES - 2))) + low_curve_value;
-
-		last_state_history_value = hst->state_history[y];
-
-		y++;
-		if(y >= MAX_STATE_HISTORY_ENTRIES)
-			y = 0;
+		update_state_history(&hst->state_history, hst->current_state);
 		}
 
 	/* calculate overall percent change in state */
-	curved_percent_change = (double)(((double)curved_changes * 100.0) / (double)(MAX_STATE_HISTORY_ENTRIES - 1));
+	curved_percent_change = get_state_history_percent_change(hst->state_history);
 
 	hst->percent_state_change = curved_percent_change;
 
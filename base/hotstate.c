@@ -0,0 +1,173 @@
+/*
+ * Runtime state periodic sweeps and dependency checks look at
+ *
+ * The freshness and orphan sweeps used to look at every host and
+ * service each time they ran, to find the few whose results had gone
+ * stale or never came back. Instead, each object type gets two timing
+ * wheels (see lib/twheel.h), indexed by object id, holding the time
+ * each object's results go stale and the time its running check is
+ * considered orphaned. The sweeps only look at what has expired on
+ * them, so their cost goes with the number of stale and orphaned
+ * objects rather than with the number of objects.
+ *
+ * The objects themselves remain authoritative, and the deadlines are
+ * only hints. Everything that changes a field the deadlines depend on
+ * ends up calling update_host_status() or update_service_status(),
+ * which recompute them, and the few paths in checks.c that change
+ * them without telling anyone recompute them directly. A deadline
+ * that turns out to be early (event_start isn't known yet when the
+ * first ones are computed, for instance) costs one look at the object
+ * and gets it moved to the right time.
+ *
+ * The same goes for the state host and service dependencies look
+ * at, which is the last hard state for objects in a soft state
+ * unless soft_state_dependencies is set. Whenever it changes for
+ * any object, dep_version is bumped, and every dependency result
+ * cached for that object type (see check_service_dependencies())
+ * becomes stale. State changes are rare compared to the checks and
+ * notifications that evaluate dependencies, so most evaluations
+ * come straight from the cache.
+ */
+
+#include "include/config.h"
+#include "include/nagios.h"
+#include "lib/libnagios.h"
+
+struct hot_state host_hot, service_hot;
+
+/* one turn of the timing wheels */
+#define HOT_STATE_WHEEL_SLOTS 1024
+
+static int hot_state_alloc(struct hot_state *hs, unsigned int count)
+{
+	memset(hs, 0, sizeof(*hs));
+	if (!count)
+		return OK;
+
+	hs->dep_state = calloc(count, sizeof(*hs->dep_state));
+	hs->dep_cache = calloc(count * 2, sizeof(*hs->dep_cache));
+	hs->freshness = twheel_create(count, HOT_STATE_WHEEL_SLOTS);
+	hs->orphaned = twheel_create(count, HOT_STATE_WHEEL_SLOTS);
+	hs->count = count;
+	if (!hs->dep_state || !hs->dep_cache || !hs->freshness || !hs->orphaned)
+		return ERROR;
+
+	/* 0 means never computed */
+	hs->dep_version = 1;
+
+	return OK;
+}
+
+static void hot_state_free(struct hot_state *hs)
+{
+	free(hs->dep_state);
+	free(hs->dep_cache);
+	twheel_destroy(hs->freshness);
+	twheel_destroy(hs->orphaned);
+	memset(hs, 0, sizeof(*hs));
+}
+
+static inline void sync_dep_state(struct hot_state *hs, unsigned int id, int dep_state)
+{
+	if (hs->dep_state[id] != dep_state) {
+		hs->dep_state[id] = dep_state;
+		hs->dep_version++;
+	}
+}
+
+struct dependency_cache *get_dependency_cache(struct hot_state *hs, unsigned int id, int dependency_type)
+{
+	if (id >= hs->count)
+		return NULL;
+
+	return &hs->dep_cache[(id * 2) + (dependency_type == NOTIFICATION_DEPENDENCY)];
+}
+
+/*
+ * Results are stale once the expiration time has passed, so the
+ * deadlines are the second after it. Objects the freshness sweeps
+ * would skip anyway get none.
+ */
+void sync_host_hot_state(host *hst)
+{
+	unsigned int id;
+	time_t when = 0;
+
+	/* updates before the arrays exist are picked up by init_hot_state() */
+	if (!hst || (id = hst->id) >= host_hot.count)
+		return;
+
+	if (hst->check_freshness == TRUE && hst->is_executing == FALSE &&
+	    hst->is_being_freshened == FALSE &&
+	    (hst->checks_enabled == TRUE || hst->accept_passive_checks == TRUE))
+	{
+		when = get_host_freshness_expiration(hst, NULL) + 1;
+	}
+	twheel_set(host_hot.freshness, id, when);
+
+	/* on-demand checks are missed by the orphan logic */
+	when = 0;
+	if (hst->is_executing == TRUE && hst->next_check != (time_t)0L)
+		when = (time_t)(hst->next_check + hst->latency + host_check_timeout + check_reaper_interval + 600) + 1;
+	twheel_set(host_hot.orphaned, id, when);
+
+	if (hst->state_type == SOFT_STATE && soft_state_dependencies == FALSE)
+		sync_dep_state(&host_hot, id, hst->last_hard_state);
+	else
+		sync_dep_state(&host_hot, id, hst->current_state);
+}
+
+void sync_service_hot_state(service *svc)
+{
+	unsigned int id;
+	time_t when = 0;
+
+	if (!svc || (id = svc->id) >= service_hot.count)
+		return;
+
+	if (svc->check_freshness == TRUE && svc->is_executing == FALSE &&
+	    svc->is_being_freshened == FALSE &&
+	    (svc->checks_enabled == TRUE || svc->accept_passive_checks == TRUE) &&
+	    (svc->check_interval != 0 || svc->freshness_threshold != 0))
+	{
+		when = get_service_freshness_expiration(svc, NULL) + 1;
+	}
+	twheel_set(service_hot.freshness, id, when);
+
+	when = 0;
+	if (svc->is_executing == TRUE)
+		when = (time_t)(svc->next_check + svc->latency + service_check_timeout + check_reaper_interval + 600) + 1;
+	twheel_set(service_hot.orphaned, id, when);
+
+	if (svc->state_type == SOFT_STATE && soft_state_dependencies == FALSE)
+		sync_dep_state(&service_hot, id, svc->last_hard_state);
+	else
+		sync_dep_state(&service_hot, id, svc->current_state);
+}
+
+int init_hot_state(void)
+{
+	unsigned int i;
+
+	free_hot_state();
+
+	if (hot_state_alloc(&host_hot, num_objects.hosts) != OK ||
+	    hot_state_alloc(&service_hot, num_objects.services) != OK)
+	{
+		free_hot_state();
+		return ERROR;
+	}
+
+	for (i = 0; i < num_objects.hosts; i++)
+		sync_host_hot_state(host_ary[i]);
+	for (i = 0; i < num_objects.services; i++)
+		sync_service_hot_state(service_ary[i]);
+
+	return OK;
+}
+
+void free_hot_state(void)
+{
+	hot_state_free(&host_hot);
+	hot_state_free(&service_hot);
+}
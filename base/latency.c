@@ -0,0 +1,171 @@
+/*
+ * Hot-path latency counters
+ *
+ * Keeps log-linear histograms of how long the core spends in the
+ * parts of the main loop that decide how many checks it can handle,
+ * so capacity can be planned without attaching a profiler. The
+ * histograms are exposed through the @core query handler.
+ *
+ * Each power of two is split into LATENCY_SUB_BUCKETS linear
+ * buckets, so the relative error of any reported value stays below
+ * 25% no matter how large it is, while recording a sample is just a
+ * couple of shifts and increments.
+ */
+
+#include "include/config.h"
+#include "include/nagios.h"
+#include "lib/libnagios.h"
+#include "lib/nsock.h"
+
+static const char *latency_names[LATENCY_NUMITEMS] = {
+	"loop", "poll", "event_dispatch", "service_result", "host_result",
+	"status_write", "retention_write", "worker_rtt",
+};
+
+static struct latency_histogram latency[LATENCY_NUMITEMS];
+static time_t latency_since;
+
+static inline unsigned int latency_bucket(unsigned long long usec)
+{
+	unsigned int msb;
+
+	if (usec < LATENCY_SUB_BUCKETS)
+		return usec;
+
+	msb = (sizeof(usec) * 8) - 1 - __builtin_clzll(usec);
+	if (msb > LATENCY_MAX_BITS)
+		return LATENCY_BUCKETS - 1;
+
+	/* the top LATENCY_SUB_BITS below the msb pick the linear bucket */
+	return ((msb - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) +
+		((usec >> (msb - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+/* the smallest value that ends up in bucket 'b' */
+static unsigned long long latency_bucket_floor(unsigned int b)
+{
+	unsigned int shift;
+
+	if (b < LATENCY_SUB_BUCKETS)
+		return b;
+
+	shift = (b >> LATENCY_SUB_BITS) - 1;
+	return (unsigned long long)(LATENCY_SUB_BUCKETS + (b & (LATENCY_SUB_BUCKETS - 1))) << shift;
+}
+
+void latency_histogram_add(struct latency_histogram *h, unsigned long long usec)
+{
+	if (!h->count || usec < h->usec_min)
+		h->usec_min = usec;
+	if (usec > h->usec_max)
+		h->usec_max = usec;
+	h->count++;
+	h->usec_total += usec;
+	h->buckets[latency_bucket(usec)]++;
+}
+
+void latency_record_usec(int type, unsigned long long usec)
+{
+	if (type < 0 || type >= LATENCY_NUMITEMS)
+		return;
+
+	latency_histogram_add(&latency[type], usec);
+}
+
+void latency_record(int type, const struct timeval *start, const struct timeval *stop)
+{
+	long long usec;
+
+	usec = ((long long)(stop->tv_sec - start->tv_sec) * 1000000) + (stop->tv_usec - start->tv_usec);
+
+	/* the clock was stepped back. Don't let that skew the histogram */
+	if (usec < 0)
+		usec = 0;
+
+	latency_record_usec(type, usec);
+}
+
+const struct latency_histogram *latency_get(int type)
+{
+	if (type < 0 || type >= LATENCY_NUMITEMS)
+		return NULL;
+	return &latency[type];
+}
+
+void latency_reset(void)
+{
+	memset(latency, 0, sizeof(latency));
+	latency_since = time(NULL);
+}
+
+/* an upper bound for the value at the given percentile */
+unsigned long long latency_histogram_percentile(struct latency_histogram *h, double pct)
+{
+	unsigned long long want, seen = 0;
+	unsigned int b;
+
+	want = (unsigned long long)((h->count * pct) / 100.0);
+	if (want >= h->count)
+		return h->usec_max;
+
+	for (b = 0; b < LATENCY_BUCKETS; b++) {
+		seen += h->buckets[b];
+		if (seen > want) {
+			unsigned long long ceiling = latency_bucket_floor(b + 1) - 1;
+			return ceiling < h->usec_max ? ceiling : h->usec_max;
+		}
+	}
+
+	return h->usec_max;
+}
+
+static int latency_print(int sd, int type)
+{
+	struct latency_histogram *h = &latency[type];
+	unsigned int b;
+	int first = 1;
+
+	nsock_printf(sd, "name=%s;since=%lu;count=%llu;usec_total=%llu;usec_min=%llu;usec_avg=%llu;usec_max=%llu;"
+	             "p50=%llu;p90=%llu;p99=%llu;p999=%llu;buckets=",
+	             latency_names[type], (unsigned long)latency_since, h->count, h->usec_total,
+	             h->usec_min, h->count ? h->usec_total / h->count : 0, h->usec_max,
+	             latency_histogram_percentile(h, 50), latency_histogram_percentile(h, 90),
+	             latency_histogram_percentile(h, 99), latency_histogram_percentile(h, 99.9));
+
+	/* sparse list of bucket-floor:count pairs */
+	for (b = 0; b < LATENCY_BUCKETS; b++) {
+		if (!h->buckets[b])
+			continue;
+		nsock_printf(sd, "%s%llu:%lu", first ? "" : ",", latency_bucket_floor(b), h->buckets[b]);
+		first = 0;
+	}
+	nsock_printf(sd, "\n");
+
+	return 0;
+}
+
+int latency_qh(int sd, char *buf, unsigned int len)
+{
+	int i;
+
+	if (!latency_since)
+		latency_since = program_start;
+
+	if (!buf || !*buf) {
+		for (i = 0; i < LATENCY_NUMITEMS; i++)
+			latency_print(sd, i);
+		return 0;
+	}
+
+	if (!strcmp(buf, "reset")) {
+		latency_reset();
+		return 200;
+	}
+
+	for (i = 0; i < LATENCY_NUMITEMS; i++) {
+		if (!strcmp(buf, latency_names[i]))
+			return latency_print(sd, i);
+	}
+
+	return 400;
+}
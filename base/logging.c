@@ -30,8 +30,51 @@
 
 
 static FILE *debug_file_fp;
+static trace_ring *debug_trace;
+static pid_t debug_trace_pid;
+static char *child_debug_trace_path;
 static FILE *log_fp;
 
+/*
+ * Every line we log has to know which process it's from, and
+ * getpid() is a syscall, so the pid is looked up once and again
+ * in each child after fork().
+ */
+static pid_t log_pid;
+
+#ifdef HAVE_PTHREAD_H
+static void log_pid_after_fork(void) {
+	log_pid = getpid();
+	}
+#endif
+
+static pid_t get_log_pid(void) {
+#ifdef HAVE_PTHREAD_H
+	if(log_pid == 0) {
+		log_pid = getpid();
+		pthread_atfork(NULL, NULL, log_pid_after_fork);
+		}
+	return log_pid;
+#else
+	return getpid();
+#endif
+	}
+
+/*
+ * Lines for the main log are batched up here and written with a
+ * single write() when the event loop is about to go idle or the
+ * oldest line has waited LOG_FLUSH_MSEC, when the buffer fills up,
+ * when something important is logged and when the log is rotated
+ * or closed. Modules still see each line, in order, as soon as
+ * it's logged.
+ */
+#define LOG_BUFFER_SIZE (64 * 1024)
+#define LOG_FLUSH_MSEC 5
+static char log_buf[LOG_BUFFER_SIZE];
+static size_t log_buf_len;
+static pid_t log_buf_pid;
+static struct timeval log_buf_start;
+
 /******************************************************************/
 /************************ LOGGING FUNCTIONS ***********************/
 /******************************************************************/
@@ -116,28 +159,110 @@ FILE *open_log_file(void)
 		return log_fp;
 
 	log_fp = fopen(log_file, "a+");
-	if(log_fp == NULL && daemon_mode == FALSE) {
-		printf("Warning: Cannot open log file '%s' for writing\n", log_file);
+	if(log_fp == NULL) {
+		if(daemon_mode == FALSE)
+			printf("Warning: Cannot open log file '%s' for writing\n", log_file);
+		return NULL;
 		}
 
 	(void)fcntl(fileno(log_fp), F_SETFD, FD_CLOEXEC);
 	return log_fp;
 }
 
+static void write_log_buffer(const char *buf, size_t len)
+{
+	ssize_t ret;
+
+	if(!open_log_file())
+		return;
+
+	while(len > 0) {
+		ret = write(fileno(log_fp), buf, len);
+		if(ret < 0) {
+			if(errno == EINTR)
+				continue;
+			return;
+			}
+		buf += ret;
+		len -= ret;
+		}
+}
+
+/* write out everything that's been logged so far */
+int flush_log_file(void)
+{
+	if(!log_buf_len)
+		return 0;
+
+	/* a child we forked mustn't write its parent's lines */
+	if(log_buf_pid == get_log_pid())
+		write_log_buffer(log_buf, log_buf_len);
+	log_buf_len = 0;
+
+	return 0;
+}
+
+/* called from the event loop, which knows if it's going to sleep */
+int flush_log_file_if_due(const struct timeval *now, int idle)
+{
+	if(!log_buf_len)
+		return 0;
+
+	if(idle || tv_delta_msec(&log_buf_start, now) >= LOG_FLUSH_MSEC)
+		return flush_log_file();
+
+	return 0;
+}
+
 int close_log_file(void)
 {
+	flush_log_file();
 	if(!log_fp)
 		return 0;
 
-	fflush(log_fp);
 	fclose(log_fp);
 	log_fp = NULL;
 	return 0;
 }
 
+static void buffer_log_line(time_t log_time, const char *buffer, unsigned long data_type)
+{
+	char prefix[32];
+	size_t plen, blen;
+	pid_t pid = get_log_pid();
+
+	if(log_buf_len && log_buf_pid != pid)
+		log_buf_len = 0;
+	log_buf_pid = pid;
+	if(!log_buf_len)
+		gettimeofday(&log_buf_start, NULL);
+
+	plen = snprintf(prefix, sizeof(prefix), "[%lu] ", log_time);
+	blen = strlen(buffer);
+
+	if(log_buf_len + plen + blen + 1 > sizeof(log_buf))
+		flush_log_file();
+
+	if(plen + blen + 1 > sizeof(log_buf)) {
+		/* huge lines bypass the buffer */
+		write_log_buffer(prefix, plen);
+		write_log_buffer(buffer, blen);
+		write_log_buffer("\n", 1);
+		return;
+		}
+
+	memcpy(log_buf + log_buf_len, prefix, plen);
+	memcpy(log_buf + log_buf_len + plen, buffer, blen);
+	log_buf_len += plen + blen;
+	log_buf[log_buf_len++] = '\n';
+
+	/* these are rare and we don't want to lose them if we crash */
+	if(data_type & (NSLOG_RUNTIME_ERROR | NSLOG_PROCESS_INFO))
+		flush_log_file();
+}
+
 /* write something to the nagios log file */
 int write_to_log(char *buffer, unsigned long data_type, time_t *timestamp) {
-	FILE *fp;
 	time_t log_time = 0L;
 
 	if(buffer == NULL)
@@ -151,7 +276,6 @@ int write_to_log(char *buffer, unsigned long data_type, time_t *timestamp) {
 	if(!(data_type & logging_options))
 		return OK;
 
-	fp = open_log_file();
 	/* what timestamp should we use? */
 	if(timestamp == NULL)
 		time(&log_time);
@@ -161,9 +285,8 @@ int write_to_log(char *buffer, unsigned long data_type, time_t *timestamp) {
 	/* strip any newlines from the end of the buffer */
 	strip(buffer);
 
-	/* write the buffer to the log file */
-	fprintf(fp, "[%lu] %s\n", log_time, buffer);
-	fflush(fp);
+	/* queue the buffer for the log file */
+	buffer_log_line(log_time, buffer, data_type);
 
 #ifdef USE_EVENT_BROKER
 	/* send data to the event broker */
@@ -357,6 +480,10 @@ int rotate_log_file(time_t rotation_time) {
 
 	stat_result = stat(log_file, &log_file_stat);
 
+	/* make sure everything we've logged is on disk before we rename it */
+	flush_log_file();
+	if(log_fp)
+		fsync(fileno(log_fp));
 	close_log_file();
 
 	/* get the archived filename to use */
@@ -412,6 +539,7 @@ int write_log_file_info(time_t *timestamp) {
 
 /* opens the debug log for writing */
 int open_debug_log(void) {
+	unsigned long size;
 
 	/* don't do anything if we're not actually running... */
 	if(verify_config || test_scheduling == TRUE)
@@ -421,6 +549,15 @@ int open_debug_log(void) {
 	if(debug_level == DEBUGL_NONE)
 		return OK;
 
+	if(debug_file_format == DEBUG_FORMAT_BINARY) {
+		/* the trace ring wraps instead of growing, so max size is its size */
+		size = max_debug_file_size ? max_debug_file_size : DEFAULT_DEBUG_TRACE_SIZE;
+		if((debug_trace = trace_open(debug_file, size)) == NULL)
+			return ERROR;
+		debug_trace_pid = get_log_pid();
+		return OK;
+		}
+
 	if((debug_file_fp = fopen(debug_file, "a+")) == NULL)
 		return ERROR;
 
@@ -438,10 +575,56 @@ int close_debug_log(void) {
 
 	debug_file_fp = NULL;
 
+	trace_close(debug_trace);
+	debug_trace = NULL;
+
 	return OK;
 	}
 
 
+/*
+ * A child's ring is only interesting if the child didn't exit
+ * normally, so it's removed when it does. Children of the child
+ * inherit this handler but not the ring, hence the pid check.
+ */
+static void remove_child_debug_trace(void) {
+
+	if(child_debug_trace_path == NULL || debug_trace_pid != get_log_pid())
+		return;
+
+	trace_close(debug_trace);
+	debug_trace = NULL;
+	unlink(child_debug_trace_path);
+	my_free(child_debug_trace_path);
+	}
+
+
+/*
+ * A trace ring can only have a single writer, so forked children
+ * that log debug info get a ring of their own.
+ */
+static int open_child_debug_trace(void) {
+	static int registered = FALSE;
+	unsigned long size;
+
+	trace_close(debug_trace);
+	debug_trace = NULL;
+	my_free(child_debug_trace_path);
+
+	debug_trace_pid = get_log_pid();
+	if(asprintf(&child_debug_trace_path, "%s.%lu", debug_file, (unsigned long)debug_trace_pid) < 0 || !child_debug_trace_path) {
+		child_debug_trace_path = NULL;
+		return ERROR;
+		}
+	if(registered == FALSE && atexit(remove_child_debug_trace) == 0)
+		registered = TRUE;
+	size = max_debug_file_size ? max_debug_file_size : DEFAULT_DEBUG_TRACE_SIZE;
+	debug_trace = trace_open(child_debug_trace_path, size);
+
+	return debug_trace ? OK : ERROR;
+	}
+
+
 /* write to the debug log */
 int log_debug_info(int level, int verbosity, const char *fmt, ...) {
 	va_list ap;
@@ -454,12 +637,25 @@ int log_debug_info(int level, int verbosity, const char *fmt, ...) {
 	if(verbosity > debug_verbosity)
 		return OK;
 
+	if(debug_file_format == DEBUG_FORMAT_BINARY) {
+		if(debug_trace == NULL)
+			return ERROR;
+		if(debug_trace_pid != get_log_pid() && open_child_debug_trace() != OK)
+			return ERROR;
+
+		/* arguments are stored raw and formatted by nagios-trace */
+		va_start(ap, fmt);
+		trace_vlog(debug_trace, level, verbosity, fmt, ap);
+		va_end(ap);
+		return OK;
+		}
+
 	if(debug_file_fp == NULL)
 		return ERROR;
 
 	/* write the timestamp */
 	gettimeofday(&current_time, NULL);
-	fprintf(debug_file_fp, "[%lu.%06lu] [%03d.%d] [pid=%lu] ", current_time.tv_sec, current_time.tv_usec, level, verbosity, (unsigned long)getpid());
+	fprintf(debug_file_fp, "[%lu.%06lu] [%03d.%d] [pid=%lu] ", current_time.tv_sec, current_time.tv_usec, level, verbosity, (unsigned long)get_log_pid());
 
 	/* write the data */
 	va_start(ap, fmt);
@@ -0,0 +1,104 @@
+/*****************************************************************************
+ *
+ * NAGIOS-TRACE.C - Decodes binary Nagios debug trace rings
+ *
+ * License: GPL
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ *****************************************************************************/
+
+#include "../include/config.h"
+#include "../include/common.h"
+#include "../include/nagios.h"
+#include "../lib/libnagios.h"
+
+struct trace_filter {
+	int level;
+	int verbosity;
+	};
+
+
+/* prints a message the same way log_debug_info() does in text mode */
+static int print_message(const struct timeval *tv, int pid, int level, int verbosity, const char *msg, void *arg) {
+	struct trace_filter *filter = (struct trace_filter *)arg;
+	size_t len;
+
+	if(!(filter->level == DEBUGL_ALL || (level & filter->level)))
+		return 0;
+	if(verbosity > filter->verbosity)
+		return 0;
+
+	printf("[%lu.%06lu] [%03d.%d] [pid=%lu] %s", (unsigned long)tv->tv_sec, (unsigned long)tv->tv_usec, level, verbosity, (unsigned long)pid, msg);
+
+	/* debug messages normally carry their own newline */
+	len = strlen(msg);
+	if(!len || msg[len - 1] != '\n')
+		putchar('\n');
+
+	return ferror(stdout) ? -1 : 0;
+	}
+
+
+static void usage(const char *name) {
+	printf("Usage: %s [-l <debug level>] [-v <verbosity>] <trace file>...\n\n", name);
+	printf("Decodes debug trace rings written with debug_file_format=binary\n");
+	printf("and prints their messages in the same format as the text debug log.\n\n");
+	printf("Options:\n");
+	printf("  -l <level>      Only print messages matching this debug level mask\n");
+	printf("  -v <verbosity>  Only print messages up to this verbosity\n");
+	printf("\nForked children write to their own ring, named <debug_file>.<pid>,\n");
+	printf("which is removed when the child exits normally.\n");
+	}
+
+
+int main(int argc, char **argv) {
+	struct trace_filter filter = { DEBUGL_ALL, DEBUGV_MOST };
+	trace_ring *tr;
+	int c, i, result = 0;
+
+	while((c = getopt(argc, argv, "hl:v:")) != -1) {
+		switch(c) {
+			case 'l':
+				filter.level = atoi(optarg);
+				break;
+			case 'v':
+				filter.verbosity = atoi(optarg);
+				break;
+			case 'h':
+				usage(argv[0]);
+				exit(0);
+			default:
+				usage(argv[0]);
+				exit(1);
+			}
+		}
+
+	if(optind >= argc) {
+		usage(argv[0]);
+		exit(1);
+		}
+
+	for(i = optind; i < argc; i++) {
+		if((tr = trace_open_ro(argv[i])) == NULL) {
+			fprintf(stderr, "Failed to open trace file '%s': %s\n", argv[i], strerror(errno));
+			result = 1;
+			continue;
+			}
+		trace_walk(tr, print_message, &filter);
+		trace_close(tr);
+		}
+
+	return result;
+	}
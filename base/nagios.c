@@ -640,6 +640,19 @@ int main(int argc, char **argv, char **env) {
 			init_timing_loop();
 			timing_point("Event timing loop initialized\n");
 
+			/* copy the state periodic sweeps look at into compact arrays */
+			if(init_hot_state() != OK) {
+				logit(NSLOG_PROCESS_INFO | NSLOG_RUNTIME_ERROR, TRUE, "Bailing out due to failure to allocate host and service state arrays. (PID=%d)", (int)getpid());
+
+#ifdef USE_EVENT_BROKER
+				/* send program data to broker */
+				broker_program_state(NEBTYPE_PROCESS_SHUTDOWN, NEBFLAG_PROCESS_INITIATED, NEBATTR_SHUTDOWN_ABNORMAL, NULL);
+#endif
+				cleanup();
+				exit(ERROR);
+				}
+			timing_point("Host and service state arrays initialized\n");
+
 			/* initialize check statistics */
 			init_check_stats();
 			timing_point("check stats initialized\n");
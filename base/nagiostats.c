@@ -189,6 +189,15 @@ int external_commands_last_1min = 0;
 int external_commands_last_5min = 0;
 int external_commands_last_15min = 0;
 
+unsigned long neb_async_queue_depth = 0L;
+unsigned long neb_async_queue_max_depth = 0L;
+unsigned long neb_async_events_delivered = 0L;
+unsigned long neb_async_events_dropped = 0L;
+
+unsigned long neb_callback_calls = 0L;
+unsigned long long neb_callback_usec_total = 0L;
+unsigned long neb_callback_usec_max = 0L;
+
 int display_mrtg_values(void);
 int display_stats(void);
 int read_config_file(void);
@@ -375,6 +384,12 @@ int main(int argc, char **argv) {
 		printf(" NUMSACTSVCCHECKSxM   number of scheduled active service checks occuring in last 1/5/15 minutes.\n");
 		printf(" NUMPSVSVCCHECKSxM    number of passive service checks occuring in last 1/5/15 minutes.\n");
 		printf(" NUMEXTCMDSxM         number of external commands processed in last 1/5/15 minutes.\n");
+		printf(" NEBASYNCDEPTH        number of events queued for asynchronous broker callbacks.\n");
+		printf(" NEBASYNCMAXDEPTH     highest number of events ever queued for asynchronous broker callbacks.\n");
+		printf(" NEBASYNCDELIVERED    number of events delivered to asynchronous broker callbacks.\n");
+		printf(" NEBASYNCDROPPED      number of events dropped because an asynchronous broker queue was full.\n");
+		printf(" NEBCBCALLS           number of profiled broker module callbacks.\n");
+		printf(" NEBCBxUSEC           AVG/MAX time spent in a single profiled broker module callback, in microseconds.\n");
 
 		printf("\n");
 		printf(" Note: Replace x's in MRTG variable names with 'MIN', 'MAX', 'AVG', or the\n");
@@ -684,6 +699,24 @@ int display_mrtg_values(void) {
 		else if(!strcmp(temp_ptr, "NUMEXTCMDS15M"))
 			printf("%d%s", external_commands_last_15min, mrtg_delimiter);
 
+		/* asynchronous broker callback stats */
+		else if(!strcmp(temp_ptr, "NEBASYNCDEPTH"))
+			printf("%lu%s", neb_async_queue_depth, mrtg_delimiter);
+		else if(!strcmp(temp_ptr, "NEBASYNCMAXDEPTH"))
+			printf("%lu%s", neb_async_queue_max_depth, mrtg_delimiter);
+		else if(!strcmp(temp_ptr, "NEBASYNCDELIVERED"))
+			printf("%lu%s", neb_async_events_delivered, mrtg_delimiter);
+		else if(!strcmp(temp_ptr, "NEBASYNCDROPPED"))
+			printf("%lu%s", neb_async_events_dropped, mrtg_delimiter);
+
+		/* broker callback profiling stats */
+		else if(!strcmp(temp_ptr, "NEBCBCALLS"))
+			printf("%lu%s", neb_callback_calls, mrtg_delimiter);
+		else if(!strcmp(temp_ptr, "NEBCBAVGUSEC"))
+			printf("%llu%s", neb_callback_calls ? neb_callback_usec_total / neb_callback_calls : 0, mrtg_delimiter);
+		else if(!strcmp(temp_ptr, "NEBCBMAXUSEC"))
+			printf("%lu%s", neb_callback_usec_max, mrtg_delimiter);
+
 		/* service states */
 		else if(!strcmp(temp_ptr, "NUMSVCOK"))
 			printf("%d%s", services_ok, mrtg_delimiter);
@@ -811,6 +844,11 @@ int display_stats(void) {
 	printf("\n");
 	printf("External Commands Last 1/5/15 min:      %d / %d / %d\n", external_commands_last_1min, external_commands_last_5min, external_commands_last_15min);
 	printf("\n");
+	printf("Async Broker Queue Depth/Max:           %lu / %lu\n", neb_async_queue_depth, neb_async_queue_max_depth);
+	printf("Async Broker Events Delivered/Dropped:  %lu / %lu\n", neb_async_events_delivered, neb_async_events_dropped);
+	printf("Profiled Broker Callbacks:              %lu\n", neb_callback_calls);
+	printf("Broker Callback Time Avg/Max:           %.3f / %.3f ms\n", neb_callback_calls ? (double)neb_callback_usec_total / neb_callback_calls / 1000.0 : 0.0, (double)neb_callback_usec_max / 1000.0);
+	printf("\n");
 	printf("\n");
 
 
@@ -1276,6 +1314,24 @@ int read_status_file(void) {
 						if((temp_ptr = strtok(NULL, ",")))
 							serial_host_checks_last_15min = atoi(temp_ptr);
 						}
+					else if(!strcmp(var, "neb_async_queue_depth")) {
+						if((temp_ptr = strtok(val, ",")))
+							neb_async_queue_depth = strtoul(temp_ptr, NULL, 10);
+						if((temp_ptr = strtok(NULL, ",")))
+							neb_async_queue_max_depth = strtoul(temp_ptr, NULL, 10);
+						}
+					else if(!strcmp(var, "neb_async_events_delivered"))
+						neb_async_events_delivered = strtoul(val, NULL, 10);
+					else if(!strcmp(var, "neb_async_events_dropped"))
+						neb_async_events_dropped = strtoul(val, NULL, 10);
+					else if(!strcmp(var, "neb_callback_stats")) {
+						if((temp_ptr = strtok(val, ",")))
+							neb_callback_calls = strtoul(temp_ptr, NULL, 10);
+						if((temp_ptr = strtok(NULL, ",")))
+							neb_callback_usec_total = strtoull(temp_ptr, NULL, 10);
+						if((temp_ptr = strtok(NULL, ",")))
+							neb_callback_usec_max = strtoul(temp_ptr, NULL, 10);
+						}
 					break;
 
 				case STATUS_HOST_DATA:
@@ -23,8 +23,10 @@
 #include "../include/config.h"
 #include "../include/common.h"
 #include "../include/nebmods.h"
+#include "../include/nebstructs.h"
 #include "../include/neberrors.h"
 #include "../include/nagios.h"
+#include <stddef.h>
 
 
 #ifdef USE_EVENT_BROKER
@@ -32,6 +34,167 @@
 
 static nebmodule *neb_module_list;
 static nebcallback **neb_callback_list;
+static struct neb_callback_profile *neb_profiles;
+static void neb_profile_destroy(void *mod_handle);
+static int neb_qh_stats(int sd, char *buf, unsigned int len);
+
+static const char *neb_callback_names[NEBCALLBACK_NUMITEMS] = {
+	"process_data", "timed_event_data", "log_data", "system_command_data",
+	"event_handler_data", "notification_data", "service_check_data",
+	"host_check_data", "comment_data", "downtime_data", "flapping_data",
+	"program_status_data", "host_status_data", "service_status_data",
+	"adaptive_program_data", "adaptive_host_data", "adaptive_service_data",
+	"external_command_data", "aggregated_status_data", "retention_data",
+	"contact_notification_data", "contact_notification_method_data",
+	"acknowledgement_data", "state_change_data", "contact_status_data",
+	"adaptive_contact_data",
+	};
+
+#ifdef HAVE_PTHREAD_H
+/*
+ * A single-producer, single-consumer ring of copied events for one
+ * module. The main thread is the only producer and the module's
+ * delivery thread the only consumer, so neither side ever needs to
+ * take a lock. 'tail' is only written by the producer and 'head'
+ * only by the consumer.
+ */
+struct neb_async_event {
+	int callback_type;
+	int (*callback_func)(int, void *);
+	void *data;
+	};
+
+struct neb_async_queue {
+	void *module_handle;
+	struct neb_async_event *events;
+	volatile unsigned long head, tail;
+	volatile int sleeping, stop;
+	unsigned long max_depth, delivered, dropped;
+	int running; /* delivery thread started in this process */
+	int closed; /* module is being unloaded, so don't take new events */
+	int wakeup[2];
+	pthread_t thread;
+	struct neb_async_queue *next;
+	};
+
+static struct neb_async_queue *neb_async_queues;
+static void neb_async_stop(void *mod_handle, int closed);
+static void neb_async_destroy(void *mod_handle);
+
+/*
+ * Event data passed to callbacks lives on the caller's stack and the
+ * strings in it may be freed as soon as the callback returns, so async
+ * callbacks get a copy. Each entry lists the size of the struct for a
+ * callback type, the offsets of the strings that must be copied along
+ * with it (0-terminated, since offset 0 is always 'type') and a pointer
+ * to transient data that can't be copied and is NULL'ed out instead.
+ */
+#define NEB_ASYNC_MAX_STRS 10
+static const struct neb_async_type {
+	size_t size;
+	size_t strs[NEB_ASYNC_MAX_STRS];
+	size_t clear;
+	} neb_async_types[NEBCALLBACK_NUMITEMS] = {
+#define nas(t, m) offsetof(nebstruct_##t, m)
+	/* NEBCALLBACK_PROCESS_DATA */
+	{ sizeof(nebstruct_process_data), { 0 }, 0 },
+	/* NEBCALLBACK_TIMED_EVENT_DATA */
+	{ sizeof(nebstruct_timed_event_data), { 0 }, nas(timed_event_data, event_ptr) },
+	/* NEBCALLBACK_LOG_DATA */
+	{ sizeof(nebstruct_log_data), { nas(log_data, data), 0 }, 0 },
+	/* NEBCALLBACK_SYSTEM_COMMAND_DATA */
+	{ sizeof(nebstruct_system_command_data),
+		{ nas(system_command_data, command_line), nas(system_command_data, output), 0 }, 0 },
+	/* NEBCALLBACK_EVENT_HANDLER_DATA */
+	{ sizeof(nebstruct_event_handler_data),
+		{ nas(event_handler_data, host_name), nas(event_handler_data, service_description),
+		  nas(event_handler_data, command_name), nas(event_handler_data, command_args),
+		  nas(event_handler_data, command_line), nas(event_handler_data, output), 0 }, 0 },
+	/* NEBCALLBACK_NOTIFICATION_DATA */
+	{ sizeof(nebstruct_notification_data),
+		{ nas(notification_data, host_name), nas(notification_data, service_description),
+		  nas(notification_data, output), nas(notification_data, ack_author),
+		  nas(notification_data, ack_data), 0 }, 0 },
+	/* NEBCALLBACK_SERVICE_CHECK_DATA */
+	{ sizeof(nebstruct_service_check_data),
+		{ nas(service_check_data, host_name), nas(service_check_data, service_description),
+		  nas(service_check_data, command_name), nas(service_check_data, command_args),
+		  nas(service_check_data, command_line), nas(service_check_data, output),
+		  nas(service_check_data, long_output), nas(service_check_data, perf_data),
+		  nas(service_check_data, saved_data), 0 },
+		nas(service_check_data, check_result_ptr) },
+	/* NEBCALLBACK_HOST_CHECK_DATA */
+	{ sizeof(nebstruct_host_check_data),
+		{ nas(host_check_data, host_name), nas(host_check_data, command_name),
+		  nas(host_check_data, command_args), nas(host_check_data, command_line),
+		  nas(host_check_data, output), nas(host_check_data, long_output),
+		  nas(host_check_data, perf_data), nas(host_check_data, saved_data), 0 },
+		nas(host_check_data, check_result_ptr) },
+	/* NEBCALLBACK_COMMENT_DATA */
+	{ sizeof(nebstruct_comment_data),
+		{ nas(comment_data, host_name), nas(comment_data, service_description),
+		  nas(comment_data, author_name), nas(comment_data, comment_data), 0 }, 0 },
+	/* NEBCALLBACK_DOWNTIME_DATA */
+	{ sizeof(nebstruct_downtime_data),
+		{ nas(downtime_data, host_name), nas(downtime_data, service_description),
+		  nas(downtime_data, author_name), nas(downtime_data, comment_data), 0 }, 0 },
+	/* NEBCALLBACK_FLAPPING_DATA */
+	{ sizeof(nebstruct_flapping_data),
+		{ nas(flapping_data, host_name), nas(flapping_data, service_description), 0 }, 0 },
+	/* NEBCALLBACK_PROGRAM_STATUS_DATA */
+	{ sizeof(nebstruct_program_status_data),
+		{ nas(program_status_data, global_host_event_handler),
+		  nas(program_status_data, global_service_event_handler), 0 }, 0 },
+	/* NEBCALLBACK_HOST_STATUS_DATA */
+	{ sizeof(nebstruct_host_status_data), { 0 }, 0 },
+	/* NEBCALLBACK_SERVICE_STATUS_DATA */
+	{ sizeof(nebstruct_service_status_data), { 0 }, 0 },
+	/* NEBCALLBACK_ADAPTIVE_PROGRAM_DATA */
+	{ sizeof(nebstruct_adaptive_program_data), { 0 }, 0 },
+	/* NEBCALLBACK_ADAPTIVE_HOST_DATA */
+	{ sizeof(nebstruct_adaptive_host_data), { 0 }, 0 },
+	/* NEBCALLBACK_ADAPTIVE_SERVICE_DATA */
+	{ sizeof(nebstruct_adaptive_service_data), { 0 }, 0 },
+	/* NEBCALLBACK_EXTERNAL_COMMAND_DATA */
+	{ sizeof(nebstruct_external_command_data),
+		{ nas(external_command_data, command_string), nas(external_command_data, command_args), 0 }, 0 },
+	/* NEBCALLBACK_AGGREGATED_STATUS_DATA */
+	{ sizeof(nebstruct_aggregated_status_data), { 0 }, 0 },
+	/* NEBCALLBACK_RETENTION_DATA */
+	{ sizeof(nebstruct_retention_data), { 0 }, 0 },
+	/* NEBCALLBACK_CONTACT_NOTIFICATION_DATA */
+	{ sizeof(nebstruct_contact_notification_data),
+		{ nas(contact_notification_data, host_name), nas(contact_notification_data, service_description),
+		  nas(contact_notification_data, contact_name), nas(contact_notification_data, output),
+		  nas(contact_notification_data, ack_author), nas(contact_notification_data, ack_data), 0 }, 0 },
+	/* NEBCALLBACK_CONTACT_NOTIFICATION_METHOD_DATA */
+	{ sizeof(nebstruct_contact_notification_method_data),
+		{ nas(contact_notification_method_data, host_name),
+		  nas(contact_notification_method_data, service_description),
+		  nas(contact_notification_method_data, contact_name),
+		  nas(contact_notification_method_data, command_name),
+		  nas(contact_notification_method_data, command_args),
+		  nas(contact_notification_method_data, output),
+		  nas(contact_notification_method_data, ack_author),
+		  nas(contact_notification_method_data, ack_data), 0 }, 0 },
+	/* NEBCALLBACK_ACKNOWLEDGEMENT_DATA */
+	{ sizeof(nebstruct_acknowledgement_data),
+		{ nas(acknowledgement_data, host_name), nas(acknowledgement_data, service_description),
+		  nas(acknowledgement_data, author_name), nas(acknowledgement_data, comment_data), 0 }, 0 },
+	/* NEBCALLBACK_STATE_CHANGE_DATA */
+	{ sizeof(nebstruct_statechange_data),
+		{ nas(statechange_data, host_name), nas(statechange_data, service_description),
+		  nas(statechange_data, output), 0 }, 0 },
+	/* NEBCALLBACK_CONTACT_STATUS_DATA */
+	{ sizeof(nebstruct_contact_status_data), { 0 }, 0 },
+	/* NEBCALLBACK_ADAPTIVE_CONTACT_DATA */
+	{ sizeof(nebstruct_adaptive_contact_data), { 0 }, 0 },
+#undef nas
+	};
+#else
+# define neb_async_stop(mod_handle, closed)
+# define neb_async_destroy(mod_handle)
+#endif
 
 /* compat stuff for USE_LTDL */
 #ifdef USE_LTDL
@@ -149,6 +312,11 @@ int neb_free_module_list(void) {
 int neb_load_all_modules(void) {
 	nebmodule *temp_module = NULL;
 
+	if(!qh_register_handler("nebstats", 0, neb_qh_stats))
+		logit(NSLOG_INFO_MESSAGE, FALSE, "neb: Registered @nebstats query handler\n");
+	else
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "neb: Failed to register @nebstats query handler\n");
+
 	for(temp_module = neb_module_list; temp_module; temp_module = temp_module->next) {
 		neb_load_module(temp_module);
 		}
@@ -314,6 +482,9 @@ int neb_unload_module(nebmodule *mod, int flags, int reason) {
 
 	log_debug_info(DEBUGL_EVENTBROKER, 0, "Attempting to unload module '%s': flags=%d, reason=%d\n", mod->filename, flags, reason);
 
+	/* modules must see all their pending events before they go away */
+	neb_async_stop(mod->module_handle, TRUE);
+
 	/* call the de-initialization function if available (and the module was initialized) */
 	if(mod->deinit_func && reason != NEBMODULE_ERROR_BAD_INIT) {
 
@@ -323,12 +494,16 @@ int neb_unload_module(nebmodule *mod, int flags, int reason) {
 		result = (*deinitfunc)(flags, reason);
 
 		/* if module doesn't want to be unloaded, exit with error (unless its being forced) */
-		if(result != OK && !(flags & NEBMODULE_FORCE_UNLOAD))
+		if(result != OK && !(flags & NEBMODULE_FORCE_UNLOAD)) {
+			neb_async_stop(mod->module_handle, FALSE);
 			return ERROR;
+			}
 		}
 
 	/* deregister all of the module's callbacks */
 	neb_deregister_module_callbacks(mod);
+	neb_async_destroy(mod->module_handle);
+	neb_profile_destroy(mod->module_handle);
 
 	if(mod->core_module == FALSE) {
 
@@ -386,6 +561,443 @@ int neb_set_module_info(void *handle, int type, char *data) {
 
 
 
+/****************************************************************************/
+/****************************************************************************/
+/* ASYNCHRONOUS CALLBACK FUNCTIONS                                          */
+/****************************************************************************/
+/****************************************************************************/
+
+#ifdef HAVE_PTHREAD_H
+/* copy event data (and the strings it points to) in a single chunk */
+static void *neb_async_copy(int callback_type, void *data) {
+	const struct neb_async_type *t = &neb_async_types[callback_type];
+	size_t len = t->size, slen;
+	char *copy, *p;
+	int i;
+
+	for(i = 0; i < NEB_ASYNC_MAX_STRS && t->strs[i]; i++) {
+		char *str = *(char **)((char *)data + t->strs[i]);
+		if(str)
+			len += strlen(str) + 1;
+		}
+
+	if(!(copy = malloc(len)))
+		return NULL;
+	memcpy(copy, data, t->size);
+	p = copy + t->size;
+
+	for(i = 0; i < NEB_ASYNC_MAX_STRS && t->strs[i]; i++) {
+		char *str = *(char **)((char *)data + t->strs[i]);
+		if(!str)
+			continue;
+		slen = strlen(str) + 1;
+		memcpy(p, str, slen);
+		*(char **)(copy + t->strs[i]) = p;
+		p += slen;
+		}
+
+	if(t->clear)
+		*(void **)(copy + t->clear) = NULL;
+
+	return copy;
+	}
+
+
+/* the module-owned thread that delivers queued events */
+static void *neb_async_thread(void *arg) {
+	struct neb_async_queue *aq = (struct neb_async_queue *)arg;
+	struct neb_async_event *ev;
+	char buf[64];
+
+	for(;;) {
+		while(aq->head != aq->tail) {
+			__sync_synchronize();
+			ev = &aq->events[aq->head & (NEB_ASYNC_QUEUE_SIZE - 1)];
+			ev->callback_func(ev->callback_type, ev->data);
+			free(ev->data);
+			aq->delivered++;
+			__sync_synchronize();
+			aq->head++;
+			}
+
+		/* everything's delivered, so we can leave if asked to */
+		if(aq->stop)
+			break;
+
+		/*
+		 * announce that we're going to sleep, then check the queue
+		 * once more so we can't miss an event that was added just
+		 * before the producer saw the flag
+		 */
+		aq->sleeping = 1;
+		__sync_synchronize();
+		if(aq->head != aq->tail || aq->stop) {
+			aq->sleeping = 0;
+			continue;
+			}
+		if(read(aq->wakeup[0], buf, sizeof(buf)) < 0 && errno != EINTR)
+			break;
+		aq->sleeping = 0;
+		}
+
+	return NULL;
+	}
+
+
+static void neb_async_wakeup(struct neb_async_queue *aq) {
+	__sync_synchronize();
+	if(aq->sleeping) {
+		aq->sleeping = 0;
+		(void)write(aq->wakeup[1], "", 1);
+		}
+	}
+
+
+/*
+ * Threads don't survive fork(), so a child (such as the one we
+ * continue in after daemonizing) starts its own delivery threads
+ * on demand, and those deliver whatever was queued before the fork.
+ */
+static void neb_async_atfork_child(void) {
+	struct neb_async_queue *aq;
+
+	for(aq = neb_async_queues; aq; aq = aq->next) {
+		if(!aq->running)
+			continue;
+		close(aq->wakeup[0]);
+		close(aq->wakeup[1]);
+		aq->running = 0;
+		}
+	}
+
+
+static int neb_async_start(struct neb_async_queue *aq) {
+	sigset_t all, old;
+	int result;
+
+	aq->sleeping = 0;
+	aq->stop = 0;
+	if(pipe(aq->wakeup) < 0)
+		return ERROR;
+	(void)fcntl(aq->wakeup[0], F_SETFD, FD_CLOEXEC);
+	(void)fcntl(aq->wakeup[1], F_SETFD, FD_CLOEXEC);
+
+	/* signals belong to the main thread */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	result = pthread_create(&aq->thread, NULL, neb_async_thread, aq);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if(result) {
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Failed to start callback delivery thread for module: %s\n", strerror(result));
+		close(aq->wakeup[0]);
+		close(aq->wakeup[1]);
+		return ERROR;
+		}
+	aq->running = 1;
+
+	return OK;
+	}
+
+
+static void neb_async_enqueue(struct neb_async_queue *aq, int callback_type, int (*callback_func)(int, void *), void *data) {
+	struct neb_async_event *ev;
+	unsigned long depth;
+
+	if(aq->closed || (!aq->running && neb_async_start(aq) == ERROR)) {
+		aq->dropped++;
+		return;
+		}
+
+	depth = aq->tail - aq->head;
+	if(depth >= NEB_ASYNC_QUEUE_SIZE) {
+		aq->dropped++;
+		neb_async_wakeup(aq);
+		return;
+		}
+
+	ev = &aq->events[aq->tail & (NEB_ASYNC_QUEUE_SIZE - 1)];
+	if(!(ev->data = neb_async_copy(callback_type, data))) {
+		aq->dropped++;
+		return;
+		}
+	ev->callback_type = callback_type;
+	ev->callback_func = callback_func;
+	if(++depth > aq->max_depth)
+		aq->max_depth = depth;
+
+	/* the event must be complete before the consumer can see it */
+	__sync_synchronize();
+	aq->tail++;
+	neb_async_wakeup(aq);
+	}
+
+
+static struct neb_async_queue *neb_async_get_queue(void *mod_handle) {
+	static int atfork_registered = FALSE;
+	struct neb_async_queue *aq;
+
+	for(aq = neb_async_queues; aq; aq = aq->next) {
+		if(aq->module_handle == mod_handle)
+			return aq;
+		}
+
+	if(atfork_registered == FALSE) {
+		if(pthread_atfork(NULL, NULL, neb_async_atfork_child))
+			return NULL;
+		atfork_registered = TRUE;
+		}
+
+	if(!(aq = calloc(1, sizeof(*aq))))
+		return NULL;
+	if(!(aq->events = calloc(NEB_ASYNC_QUEUE_SIZE, sizeof(*aq->events)))) {
+		free(aq);
+		return NULL;
+		}
+	aq->module_handle = mod_handle;
+	aq->next = neb_async_queues;
+	neb_async_queues = aq;
+
+	return aq;
+	}
+
+
+/*
+ * deliver everything still queued for a module and stop its thread.
+ * The queue stays, so callbacks that still point to it keep working
+ * and get a new thread if they're called again.
+ */
+static void neb_async_drain(struct neb_async_queue *aq) {
+	struct neb_async_event *ev;
+
+	if(aq->running) {
+		aq->stop = 1;
+		__sync_synchronize();
+		(void)write(aq->wakeup[1], "", 1);
+		pthread_join(aq->thread, NULL);
+		close(aq->wakeup[0]);
+		close(aq->wakeup[1]);
+		aq->running = 0;
+		}
+
+	/* no thread in this process, so deliver from here */
+	while(aq->head != aq->tail) {
+		ev = &aq->events[aq->head++ & (NEB_ASYNC_QUEUE_SIZE - 1)];
+		ev->callback_func(ev->callback_type, ev->data);
+		free(ev->data);
+		aq->delivered++;
+		}
+	}
+
+
+static struct neb_async_queue *neb_async_find_queue(void *mod_handle, struct neb_async_queue **prev) {
+	struct neb_async_queue *aq;
+
+	*prev = NULL;
+	for(aq = neb_async_queues; aq; *prev = aq, aq = aq->next) {
+		if(aq->module_handle == mod_handle)
+			return aq;
+		}
+
+	return NULL;
+	}
+
+
+/*
+ * drain a module's queue and close it, or open it again. Events
+ * that come in while it's closed are dropped.
+ */
+static void neb_async_stop(void *mod_handle, int closed) {
+	struct neb_async_queue *aq, *prev;
+
+	if(!(aq = neb_async_find_queue(mod_handle, &prev)))
+		return;
+	if(closed)
+		neb_async_drain(aq);
+	aq->closed = closed;
+	}
+
+
+/*
+ * drain and free a module's queue. No callback may point to it
+ * anymore, so this must come after they're deregistered.
+ */
+static void neb_async_destroy(void *mod_handle) {
+	struct neb_async_queue *aq, *prev;
+
+	if(!(aq = neb_async_find_queue(mod_handle, &prev)))
+		return;
+
+	neb_async_drain(aq);
+
+	if(prev)
+		prev->next = aq->next;
+	else
+		neb_async_queues = aq->next;
+	my_free(aq->events);
+	my_free(aq);
+	}
+#endif
+
+
+/* get delivery statistics for all asynchronous callbacks */
+void neb_get_async_stats(struct neb_async_stats *stats) {
+	memset(stats, 0, sizeof(*stats));
+#ifdef HAVE_PTHREAD_H
+	{
+		struct neb_async_queue *aq;
+
+		for(aq = neb_async_queues; aq; aq = aq->next) {
+			stats->queues++;
+			stats->depth += aq->tail - aq->head;
+			if(aq->max_depth > stats->max_depth)
+				stats->max_depth = aq->max_depth;
+			stats->delivered += aq->delivered;
+			stats->dropped += aq->dropped;
+			}
+	}
+#endif
+	}
+
+
+
+/****************************************************************************/
+/****************************************************************************/
+/* PROFILING FUNCTIONS                                                      */
+/****************************************************************************/
+/****************************************************************************/
+
+/*
+ * Profiles live until their module is unloaded rather than until
+ * the callback is deregistered, since modules may deregister a
+ * callback from within that very callback.
+ */
+static struct neb_callback_profile *neb_profile_get(void *mod_handle, int callback_type) {
+	struct neb_callback_profile *p;
+
+	for(p = neb_profiles; p; p = p->next) {
+		if(p->module_handle == mod_handle && p->callback_type == callback_type)
+			return p;
+		}
+
+	if(!(p = calloc(1, sizeof(*p))))
+		return NULL;
+	p->module_handle = mod_handle;
+	p->callback_type = callback_type;
+	p->next = neb_profiles;
+	neb_profiles = p;
+
+	return p;
+	}
+
+
+/* free profiles for a module, or all of them if mod_handle is NULL */
+static void neb_profile_destroy(void *mod_handle) {
+	struct neb_callback_profile *p, *next, *prev = NULL;
+
+	for(p = neb_profiles; p; p = next) {
+		next = p->next;
+		if(mod_handle && p->module_handle != mod_handle) {
+			prev = p;
+			continue;
+			}
+		if(prev)
+			prev->next = next;
+		else
+			neb_profiles = next;
+		free(p);
+		}
+	}
+
+
+static void neb_profile_record(struct neb_callback_profile *p, struct timeval *start) {
+	struct timeval stop;
+	long usec;
+	unsigned long rest;
+	int bucket;
+
+	gettimeofday(&stop, NULL);
+	usec = (stop.tv_sec - start->tv_sec) * 1000000L + (stop.tv_usec - start->tv_usec);
+	if(usec < 0)
+		usec = 0; /* the clock was set back */
+
+	p->calls++;
+	p->usec_total += usec;
+	if((unsigned long)usec > p->usec_max)
+		p->usec_max = usec;
+
+	for(bucket = 0, rest = usec; rest && bucket < NEB_PROFILE_BUCKETS - 1; bucket++)
+		rest >>= 1;
+	p->histogram[bucket]++;
+	}
+
+
+/* sum up the profiles of all modules and callback types */
+void neb_get_profile_summary(struct neb_callback_profile *sum) {
+	struct neb_callback_profile *p;
+	int i;
+
+	memset(sum, 0, sizeof(*sum));
+	for(p = neb_profiles; p; p = p->next) {
+		sum->calls += p->calls;
+		sum->usec_total += p->usec_total;
+		if(p->usec_max > sum->usec_max)
+			sum->usec_max = p->usec_max;
+		for(i = 0; i < NEB_PROFILE_BUCKETS; i++)
+			sum->histogram[i] += p->histogram[i];
+		}
+	}
+
+
+static const char *neb_module_name(void *mod_handle) {
+	nebmodule *mod;
+
+	for(mod = neb_module_list; mod; mod = mod->next) {
+		if(mod->module_handle == mod_handle)
+			return mod->filename ? mod->filename : "core";
+		}
+
+	return "unknown";
+	}
+
+
+static int neb_qh_stats(int sd, char *buf, unsigned int len) {
+	struct neb_callback_profile *p;
+	int i;
+
+	if(!strcmp(buf, "enable")) {
+		broker_callback_profiling = TRUE;
+		return 200;
+		}
+	if(!strcmp(buf, "disable")) {
+		broker_callback_profiling = FALSE;
+		return 200;
+		}
+	if(!strcmp(buf, "reset")) {
+		for(p = neb_profiles; p; p = p->next) {
+			p->calls = p->usec_max = 0;
+			p->usec_total = 0;
+			memset(p->histogram, 0, sizeof(p->histogram));
+			}
+		return 200;
+		}
+	if(strcmp(buf, "list"))
+		return 400;
+
+	for(p = neb_profiles; p; p = p->next) {
+		if(!p->calls)
+			continue;
+		nsock_printf(sd, "module=%s;type=%s;calls=%lu;usec_total=%llu;usec_avg=%llu;usec_max=%lu;histogram=",
+		             neb_module_name(p->module_handle), neb_callback_names[p->callback_type],
+		             p->calls, p->usec_total, p->usec_total / p->calls, p->usec_max);
+		for(i = 0; i < NEB_PROFILE_BUCKETS; i++)
+			nsock_printf(sd, "%lu%c", p->histogram[i], i == NEB_PROFILE_BUCKETS - 1 ? '\n' : ',');
+		}
+
+	return 0;
+	}
+
+
+
 /****************************************************************************/
 /****************************************************************************/
 /* CALLBACK FUNCTIONS                                                       */
@@ -394,6 +1006,12 @@ int neb_set_module_info(void *handle, int type, char *data) {
 
 /* allows a module to register a callback function */
 int neb_register_callback(int callback_type, void *mod_handle, int priority, int (*callback_func)(int, void *)) {
+	return neb_register_callback_full(callback_type, mod_handle, priority, 0, callback_func);
+	}
+
+
+/* allows a module to register a callback function with special delivery options */
+int neb_register_callback_full(int callback_type, void *mod_handle, int priority, unsigned int flags, int (*callback_func)(int, void *)) {
 	nebmodule *temp_module = NULL;
 	nebcallback *new_callback = NULL;
 	nebcallback *temp_callback = NULL;
@@ -428,6 +1046,23 @@ int neb_register_callback(int callback_type, void *mod_handle, int priority, int
 	new_callback->priority = priority;
 	new_callback->module_handle = mod_handle;
 	new_callback->callback_func = callback_func;
+	new_callback->flags = flags;
+	new_callback->async_queue = NULL;
+	if(!(new_callback->profile = neb_profile_get(mod_handle, callback_type))) {
+		my_free(new_callback);
+		return NEBERROR_NOMEM;
+		}
+
+	if(flags & NEBCALLBACK_ASYNC) {
+#ifdef HAVE_PTHREAD_H
+		if(!(new_callback->async_queue = neb_async_get_queue(mod_handle))) {
+			my_free(new_callback);
+			return NEBERROR_NOMEM;
+			}
+#else
+		log_debug_info(DEBUGL_EVENTBROKER, 0, "No thread support. Async callback (type %d) will be called synchronously\n", callback_type);
+#endif
+		}
 
 	/* add new function to callback list, sorted by priority (first come, first served for same priority) */
 	new_callback->next = NULL;
@@ -469,6 +1104,8 @@ int neb_deregister_module_callbacks(nebmodule *mod) {
 	if(neb_callback_list == NULL)
 		return OK;
 
+	neb_async_destroy(mod->module_handle);
+
 	for(callback_type = 0; callback_type < NEBCALLBACK_NUMITEMS; callback_type++) {
 		for(temp_callback = neb_callback_list[callback_type]; temp_callback != NULL; temp_callback = next_callback) {
 			next_callback = temp_callback->next;
@@ -531,6 +1168,8 @@ int neb_deregister_callback(int callback_type, int (*callback_func)(int, void *)
 int neb_make_callbacks(int callback_type, void *data) {
 	nebcallback *temp_callback, *next_callback;
 	int (*callbackfunc)(int, void *);
+	struct neb_callback_profile *profile;
+	struct timeval start;
 	register int cbresult = 0;
 	int total_callbacks = 0;
 
@@ -548,7 +1187,22 @@ int neb_make_callbacks(int callback_type, void *data) {
 	for(temp_callback = neb_callback_list[callback_type]; temp_callback; temp_callback = next_callback) {
 		next_callback = temp_callback->next;
 		callbackfunc = temp_callback->callback_func;
+		profile = broker_callback_profiling == TRUE ? temp_callback->profile : NULL;
+		if(profile)
+			gettimeofday(&start, NULL);
+#ifdef HAVE_PTHREAD_H
+		/* observers get a copy, and can't affect what happens next */
+		if(temp_callback->async_queue) {
+			neb_async_enqueue(temp_callback->async_queue, callback_type, callbackfunc, data);
+			if(profile)
+				neb_profile_record(profile, &start);
+			total_callbacks++;
+			continue;
+			}
+#endif
 		cbresult = callbackfunc(callback_type, data);
+		if(profile)
+			neb_profile_record(profile, &start);
 		temp_callback = next_callback;
 
 		total_callbacks++;
@@ -595,6 +1249,12 @@ int neb_free_callback_list(void) {
 	if(neb_callback_list == NULL)
 		return OK;
 
+#ifdef HAVE_PTHREAD_H
+	while(neb_async_queues)
+		neb_async_destroy(neb_async_queues->module_handle);
+#endif
+	neb_profile_destroy(NULL);
+
 	for(x = 0; x < NEBCALLBACK_NUMITEMS; x++) {
 
 		for(temp_callback = neb_callback_list[x]; temp_callback != NULL; temp_callback = next_callback) {
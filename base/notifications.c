@@ -30,6 +30,8 @@
 #include "../include/neberrors.h"
 #include "../include/workers.h"
 
+static void set_notification_recipients(nagios_macros *mac);
+
 /*** silly helpers ****/
 static contact *find_contact_by_name_or_alias(const char *name)
 {
@@ -208,7 +210,8 @@ int service_notification(service *svc, int type, char *not_author, char *not_dat
 		/* set the notification id macro */
 		asprintf(&mac.x[MACRO_SERVICENOTIFICATIONID], "%lu", svc->current_notification_id);
 
-		/* notify each contact (duplicates have been removed) */
+		/* notify each contact (duplicates have been removed), shipping the commands to workers in one go */
+		wproc_batch_begin();
 		for(temp_notification = notification_list; temp_notification != NULL; temp_notification = temp_notification->next) {
 
 			/* grab the macro variables for this contact */
@@ -221,6 +224,7 @@ int service_notification(service *svc, int type, char *not_author, char *not_dat
 			if(result == OK)
 				contacts_notified++;
 			}
+		wproc_batch_end();
 
 		/* free memory allocated to the notification list */
 		free_notification_list();
@@ -239,7 +243,7 @@ int service_notification(service *svc, int type, char *not_author, char *not_dat
 		my_free(mac.x[MACRO_SERVICEACKAUTHOR]);
 		my_free(mac.x[MACRO_SERVICEACKCOMMENT]);
 
-		/* this gets set in add_notification() */
+		/* this gets set in create_notification_list_from_service() */
 		my_free(mac.x[MACRO_NOTIFICATIONRECIPIENTS]);
 
 		/*
@@ -748,9 +752,7 @@ int notify_contact_of_service(nagios_macros *mac, contact *cntct, service *svc,
 
 		/* get the command name */
 		command_name = (char *)strdup(temp_commandsmember->command);
-		command_name_ptr = strchr(command_name,'!');
-		if (strchr(command_name_ptr,'!')!=NULL)
-			*(strchr(command_name_ptr,'!'))='\0';
+		command_name_ptr = strtok(command_name, "!");
 
 		/* run the notification command... */
 
@@ -1003,6 +1005,8 @@ int create_notification_list_from_service(nagios_macros *mac, service *svc, int
 			}
 		}
 
+	set_notification_recipients(mac);
+
 	return OK;
 	}
 
@@ -1163,7 +1167,8 @@ int host_notification(host *hst, int type, char *not_author, char *not_data, int
 		/* set the notification id macro */
 		asprintf(&mac.x[MACRO_HOSTNOTIFICATIONID], "%lu", hst->current_notification_id);
 
-		/* notify each contact (duplicates have been removed) */
+		/* notify each contact (duplicates have been removed), shipping the commands to workers in one go */
+		wproc_batch_begin();
 		for(temp_notification = notification_list; temp_notification != NULL; temp_notification = temp_notification->next) {
 
 			/* grab the macro variables for this contact */
@@ -1179,6 +1184,7 @@ int host_notification(host *hst, int type, char *not_author, char *not_data, int
 			if(result == OK)
 				contacts_notified++;
 			}
+		wproc_batch_end();
 
 		/* free memory allocated to the notification list */
 		free_notification_list();
@@ -1196,7 +1202,7 @@ int host_notification(host *hst, int type, char *not_author, char *not_data, int
 		my_free(mac.x[MACRO_HOSTACKAUTHORALIAS]);
 		my_free(mac.x[MACRO_HOSTACKAUTHOR]);
 		my_free(mac.x[MACRO_HOSTACKCOMMENT]);
-		/* this gets set in add_notification() */
+		/* this gets set in create_notification_list_from_host() */
 		my_free(mac.x[MACRO_NOTIFICATIONRECIPIENTS]);
 
 		/*
@@ -1654,9 +1660,7 @@ int notify_contact_of_host(nagios_macros *mac, contact *cntct, host *hst, int ty
 
 		/* get the command name */
 		command_name = (char *)strdup(temp_commandsmember->command);
-                command_name_ptr = strchr(command_name,'!');
-		if (strchr(command_name_ptr,'!')!=NULL) 
-			*(strchr(command_name_ptr,'!'))='\0';
+		command_name_ptr = strtok(command_name, "!");
 
 		/* run the notification command... */
 
@@ -1916,6 +1920,8 @@ int create_notification_list_from_host(nagios_macros *mac, host *hst, int option
 			}
 		}
 
+	set_notification_recipients(mac);
+
 	return OK;
 	}
 
@@ -2060,6 +2066,10 @@ notification * find_notification(contact *cntct) {
 	if(cntct == NULL)
 		return NULL;
 
+	/* most contacts aren't on the list, and those are easy to tell */
+	if(notification_contacts != NULL && cntct->id < bitmap_cardinality(notification_contacts) && !bitmap_isset(notification_contacts, cntct->id))
+		return NULL;
+
 	for(temp_notification = notification_list; temp_notification != NULL; temp_notification = temp_notification->next) {
 		if(temp_notification->contact == cntct)
 			return temp_notification;
@@ -2071,10 +2081,36 @@ notification * find_notification(contact *cntct) {
 
 
 
+/*
+ * makes sure the bitmap of contacts on the notification list has
+ * room for the given contact id, which it won't the first time
+ * around or after a reload that added contacts
+ */
+static int grow_notification_contacts(unsigned int id) {
+	notification *temp_notification = NULL;
+	unsigned long size = num_objects.contacts;
+
+	if(notification_contacts != NULL && id < bitmap_cardinality(notification_contacts))
+		return OK;
+
+	if(size <= id)
+		size = id + 1;
+
+	bitmap_destroy(notification_contacts);
+	if((notification_contacts = bitmap_create(size)) == NULL)
+		return ERROR;
+
+	for(temp_notification = notification_list; temp_notification != NULL; temp_notification = temp_notification->next)
+		bitmap_set(notification_contacts, temp_notification->contact->id);
+
+	return OK;
+	}
+
+
+
 /* add a new notification to the list in memory */
 int add_notification(nagios_macros *mac, contact *cntct) {
 	notification *new_notification = NULL;
-	notification *temp_notification = NULL;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "add_notification() start\n");
 
@@ -2084,7 +2120,11 @@ int add_notification(nagios_macros *mac, contact *cntct) {
 	log_debug_info(DEBUGL_NOTIFICATIONS, 2, "Adding contact '%s' to notification list.\n", cntct->name);
 
 	/* don't add anything if this contact is already on the notification list */
-	if((temp_notification = find_notification(cntct)) != NULL)
+	if(grow_notification_contacts(cntct->id) != OK) {
+		if(find_notification(cntct) != NULL)
+			return OK;
+		}
+	else if(bitmap_isset(notification_contacts, cntct->id))
 		return OK;
 
 	/* allocate memory for a new contact in the notification list */
@@ -2097,16 +2137,42 @@ int add_notification(nagios_macros *mac, contact *cntct) {
 	/* add new notification to head of list */
 	new_notification->next = notification_list;
 	notification_list = new_notification;
+	if(notification_contacts != NULL)
+		bitmap_set(notification_contacts, cntct->id);
 
-	/* add contact to notification recipients macro */
-	if(mac->x[MACRO_NOTIFICATIONRECIPIENTS] == NULL)
-		mac->x[MACRO_NOTIFICATIONRECIPIENTS] = (char *)strdup(cntct->name);
-	else {
-		if((mac->x[MACRO_NOTIFICATIONRECIPIENTS] = (char *)realloc(mac->x[MACRO_NOTIFICATIONRECIPIENTS], strlen(mac->x[MACRO_NOTIFICATIONRECIPIENTS]) + strlen(cntct->name) + 2))) {
-			strcat(mac->x[MACRO_NOTIFICATIONRECIPIENTS], ",");
-			strcat(mac->x[MACRO_NOTIFICATIONRECIPIENTS], cntct->name);
-			}
-		}
+	/* the notification recipients macro is set once the list is complete */
 
 	return OK;
 	}
+
+
+
+/* sets the notification recipients macro to the contacts on the notification list, in the order they were added */
+static void set_notification_recipients(nagios_macros *mac) {
+	notification *temp_notification = NULL;
+	char *recipients = NULL;
+	size_t len = 0;
+	size_t pos = 0;
+	size_t name_len = 0;
+
+	my_free(mac->x[MACRO_NOTIFICATIONRECIPIENTS]);
+
+	for(temp_notification = notification_list; temp_notification != NULL; temp_notification = temp_notification->next)
+		len += strlen(temp_notification->contact->name) + 1;
+
+	if(len == 0 || (recipients = malloc(len)) == NULL)
+		return;
+
+	/* the most recently added contact is first on the list, so fill in from the end */
+	pos = len - 1;
+	recipients[pos] = '\x0';
+	for(temp_notification = notification_list; temp_notification != NULL; temp_notification = temp_notification->next) {
+		name_len = strlen(temp_notification->contact->name);
+		pos -= name_len;
+		memcpy(recipients + pos, temp_notification->contact->name, name_len);
+		if(pos > 0)
+			recipients[--pos] = ',';
+		}
+
+	mac->x[MACRO_NOTIFICATIONRECIPIENTS] = recipients;
+	}
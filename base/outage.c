@@ -0,0 +1,203 @@
+/*
+ * Outage storms
+ *
+ * When a router or switch near the top of the parent/child tree goes
+ * away, every host below it fails at about the same time. Normally
+ * each host that goes DOWN queues on-demand checks of its children,
+ * whose results queue checks of their children and so on, so the
+ * whole subtree is checked once per level it sits below the failed
+ * host, with hosts that have several parents getting it once per
+ * parent. That's a lot of checks whose outcome we already know.
+ *
+ * So we keep count of how many host state changes we've seen in the
+ * last OUTAGE_STORM_WINDOW seconds. Once that reaches
+ * outage_storm_threshold we're in a storm, and stay in it until the
+ * count drops below half of that. While in a storm, a host that goes
+ * DOWN or UNREACHABLE walks the part of the tree below it that is
+ * cut off by it in one pass instead of queueing checks of its
+ * children. Hosts in there whose last check already found them not
+ * UP get their reachability worked out from their parents right
+ * away, without a check of their own, and only hosts that were UP
+ * last we heard are checked, once each. On-demand checks of hosts
+ * with results newer than cached_host_check_horizon are skipped
+ * too, even where the caller asked for a fresh result.
+ *
+ * The number of checks avoided and hosts updated this way is logged
+ * when a storm ends and available through "@core outages".
+ */
+
+#include "include/config.h"
+#include "include/nagios.h"
+#include "lib/libnagios.h"
+#include "lib/nsock.h"
+
+#define OUTAGE_STORM_WINDOW 60
+
+static struct {
+	int active;
+	time_t started, ended;
+	unsigned long storms;
+	unsigned long checks_avoided, hosts_updated;
+	unsigned long storm_checks_avoided, storm_hosts_updated;
+} outage;
+
+/* host state changes per second, over the last OUTAGE_STORM_WINDOW seconds */
+static unsigned int window[OUTAGE_STORM_WINDOW];
+static unsigned int window_changes;
+static time_t window_now;
+
+/* for walking the tree, allocated on first use */
+static bitmap *outage_seen;
+static host **outage_queue;
+
+static void outage_window_advance(time_t now)
+{
+	if (now <= window_now)
+		return;
+
+	if (now - window_now >= OUTAGE_STORM_WINDOW) {
+		memset(window, 0, sizeof(window));
+		window_changes = 0;
+	} else {
+		while (window_now < now) {
+			window_now++;
+			window_changes -= window[window_now % OUTAGE_STORM_WINDOW];
+			window[window_now % OUTAGE_STORM_WINDOW] = 0;
+		}
+	}
+	window_now = now;
+}
+
+int outage_storm_active(time_t now)
+{
+	if (outage_storm_threshold <= 0) {
+		outage.active = FALSE;
+		return FALSE;
+	}
+
+	outage_window_advance(now);
+
+	if (!outage.active && window_changes >= (unsigned int)outage_storm_threshold) {
+		outage.active = TRUE;
+		outage.started = now;
+		outage.storms++;
+		outage.storm_checks_avoided = outage.storm_hosts_updated = 0;
+		logit(NSLOG_INFO_MESSAGE, FALSE, "OUTAGE STORM STARTED: %u host state changes in the last %d seconds\n",
+		      window_changes, OUTAGE_STORM_WINDOW);
+	} else if (outage.active && window_changes * 2 < (unsigned int)outage_storm_threshold) {
+		outage.active = FALSE;
+		outage.ended = now;
+		logit(NSLOG_INFO_MESSAGE, FALSE, "OUTAGE STORM ENDED: lasted %lu seconds, %lu on-demand host checks avoided, %lu hosts marked DOWN/UNREACHABLE without a check\n",
+		      (unsigned long)(now - outage.started), outage.storm_checks_avoided, outage.storm_hosts_updated);
+	}
+
+	return outage.active;
+}
+
+void outage_host_state_change(time_t now)
+{
+	if (outage_storm_threshold <= 0)
+		return;
+
+	outage_window_advance(now);
+	window[now % OUTAGE_STORM_WINDOW]++;
+	window_changes++;
+}
+
+int outage_host_check_is_redundant(host *hst, time_t now)
+{
+	if (!outage.active || hst->has_been_checked == FALSE)
+		return FALSE;
+	if ((unsigned long)(now - hst->last_check) > cached_host_check_horizon)
+		return FALSE;
+
+	log_debug_info(DEBUGL_CHECKS, 1, "Outage storm: using cached state of host '%s' instead of checking it again\n", hst->name);
+	outage.checks_avoided++;
+	outage.storm_checks_avoided++;
+	update_check_stats(ACTIVE_ONDEMAND_HOST_CHECK_STATS, now);
+	update_check_stats(ACTIVE_CACHED_HOST_CHECK_STATS, now);
+	return TRUE;
+}
+
+int propagate_host_outage(host *hst, objectlist **check_hostlist)
+{
+	unsigned int head = 0, tail = 0;
+
+	if (!outage_seen) {
+		outage_seen = bitmap_create(num_objects.hosts);
+		outage_queue = malloc(num_objects.hosts * sizeof(*outage_queue));
+		if (!outage_seen || !outage_queue) {
+			free_outage_data();
+			return ERROR;
+		}
+	}
+
+	log_debug_info(DEBUGL_CHECKS, 1, "Outage storm: propagating state of host '%s' to the hosts behind it...\n", hst->name);
+
+	bitmap_clear(outage_seen);
+	bitmap_set(outage_seen, hst->id);
+	outage_queue[tail++] = hst;
+
+	while (head < tail) {
+		hostsmember *hm;
+
+		for (hm = outage_queue[head++]->child_hosts; hm; hm = hm->next) {
+			host *child = hm->host_ptr;
+
+			if (!child || bitmap_isset(outage_seen, child->id))
+				continue;
+			bitmap_set(outage_seen, child->id);
+
+			/* it may be cut off now, and only a check can tell */
+			if (child->current_state == HOST_UP) {
+				log_debug_info(DEBUGL_CHECKS, 1, "Check of host '%s' queued.\n", child->name);
+				add_object_to_objectlist(check_hostlist, (void *)child);
+				continue;
+			}
+
+			/* its last check already failed, so checking it again won't tell us anything new */
+			if ((unsigned long)(time(NULL) - child->last_check) > cached_host_check_horizon) {
+				outage.checks_avoided++;
+				outage.storm_checks_avoided++;
+			}
+			if (translate_host_reachability(child) == TRUE) {
+				outage.hosts_updated++;
+				outage.storm_hosts_updated++;
+			}
+			outage_queue[tail++] = child;
+		}
+	}
+
+	return OK;
+}
+
+int outage_qh(int sd, char *buf, unsigned int len)
+{
+	time_t now = time(NULL);
+
+	if (!buf || !*buf) {
+		outage_storm_active(now);
+		nsock_printf_nul(sd, "threshold=%d;window=%d;changes=%u;storm=%d;storms=%lu;started=%lu;ended=%lu;"
+		                 "checks_avoided=%lu;hosts_updated=%lu;storm_checks_avoided=%lu;storm_hosts_updated=%lu;",
+		                 outage_storm_threshold, OUTAGE_STORM_WINDOW, window_changes, outage.active,
+		                 outage.storms, (unsigned long)outage.started, (unsigned long)outage.ended,
+		                 outage.checks_avoided, outage.hosts_updated,
+		                 outage.storm_checks_avoided, outage.storm_hosts_updated);
+		return 0;
+	}
+
+	if (!strcmp(buf, "reset")) {
+		outage.storms = outage.checks_avoided = outage.hosts_updated = 0;
+		return 200;
+	}
+
+	return 404;
+}
+
+void free_outage_data(void)
+{
+	bitmap_destroy(outage_seen);
+	outage_seen = NULL;
+	free(outage_queue);
+	outage_queue = NULL;
+}
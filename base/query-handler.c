@@ -282,6 +282,25 @@ static int qh_core(int sd, char *buf, unsigned int len)
 		return 0;
 	}
 
+	if (!strcmp(buf, "latency")) {
+		return latency_qh(sd, space, space ? len - (space - buf) : 0);
+	}
+
+	if (!strcmp(buf, "cmdstats")) {
+		return cmdstats_qh(sd, space, space ? len - (space - buf) : 0);
+	}
+
+	if (!strcmp(buf, "outages")) {
+		return outage_qh(sd, space, space ? len - (space - buf) : 0);
+	}
+
+	if (!space && !strcmp(buf, "strings")) {
+		nsock_printf_nul(sd, "strings=%u;refs=%lu;bytes=%lu;bytes_saved=%lu;",
+		                 intern_num_strings(), intern_num_refs(),
+		                 intern_bytes(), intern_bytes_saved());
+		return 0;
+	}
+
 	if (space) {
 		len -= (unsigned long)space - (unsigned long)buf;
 		if (!strcmp(buf, "loadctl")) {
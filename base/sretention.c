@@ -77,10 +77,13 @@ int cleanup_retention_data(char *config_file) {
 /* save all host and service state information */
 int save_state_information(int autosave) {
 	int result = OK;
+	struct timeval start, stop;
 
 	if(retain_state_information == FALSE)
 		return OK;
 
+	gettimeofday(&start, NULL);
+
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker */
 	broker_retention_data(NEBTYPE_RETENTIONDATA_STARTSAVE, NEBFLAG_NONE, NEBATTR_NONE, NULL);
@@ -96,6 +99,9 @@ int save_state_information(int autosave) {
 	broker_retention_data(NEBTYPE_RETENTIONDATA_ENDSAVE, NEBFLAG_NONE, NEBATTR_NONE, NULL);
 #endif
 
+	gettimeofday(&stop, NULL);
+	latency_record(LATENCY_RETENTION_WRITE, &start, &stop);
+
 	if(result == ERROR)
 		return ERROR;
 
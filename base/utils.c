@@ -44,6 +44,8 @@ char *check_result_path = NULL;
 char *lock_file = NULL;
 
 int num_check_workers = 0; /* auto-decide */
+int max_check_workers = 0; /* don't autoscale */
+int outage_storm_threshold = 0; /* no storm mode */
 char *qh_socket_path = NULL; /* disabled */
 
 char *nagios_user = NULL;
@@ -178,6 +180,7 @@ int status_update_interval = DEFAULT_STATUS_UPDATE_INTERVAL;
 int time_change_threshold = DEFAULT_TIME_CHANGE_THRESHOLD;
 
 unsigned long   event_broker_options = BROKER_NOTHING;
+int broker_callback_profiling = FALSE;
 
 double low_service_flap_threshold = DEFAULT_LOW_SERVICE_FLAP_THRESHOLD;
 double high_service_flap_threshold = DEFAULT_HIGH_SERVICE_FLAP_THRESHOLD;
@@ -194,6 +197,7 @@ char *use_timezone = NULL;
 int allow_empty_hostgroup_assignment = DEFAULT_ALLOW_EMPTY_HOSTGROUP_ASSIGNMENT;
 
 notification    *notification_list;
+bitmap          *notification_contacts;
 
 unsigned long	max_check_result_file_age = DEFAULT_MAX_CHECK_RESULT_AGE;
 
@@ -203,6 +207,7 @@ char *debug_file;
 int debug_level = DEFAULT_DEBUG_LEVEL;
 int debug_verbosity = DEFAULT_DEBUG_VERBOSITY;
 unsigned long   max_debug_file_size = DEFAULT_MAX_DEBUG_FILE_SIZE;
+int debug_file_format = DEFAULT_DEBUG_FILE_FORMAT;
 
 iobroker_set *nagios_iobs = NULL;
 squeue_t *nagios_squeue = NULL; /* our scheduling queue */
@@ -1810,6 +1815,9 @@ int daemon_init(void) {
 		return OK;
 		}
 
+	/* the parent exits without writing out buffered log lines */
+	flush_log_file();
+
 	/* exit on errors... */
 	if((pid = fork()) < 0)
 		return(ERROR);
@@ -1820,6 +1828,10 @@ int daemon_init(void) {
 
 	/* child continues... */
 
+	/* keep writing debug info to the parent's trace ring, if any */
+	close_debug_log();
+	open_debug_log();
+
 	/* child becomes session leader... */
 	setsid();
 
@@ -2071,6 +2083,9 @@ int process_check_result_queue(char *dirname) {
 int process_check_result(check_result *cr)
 {
 	const char *source_name;
+	struct timeval start, stop;
+	int result;
+
 	if (!cr)
 		return ERROR;
 
@@ -2082,7 +2097,11 @@ int process_check_result(check_result *cr)
 		if (!svc)
 			return ERROR;
 		svc->check_source = source_name;
-		return handle_async_service_check_result(svc, cr);
+		gettimeofday(&start, NULL);
+		result = handle_async_service_check_result(svc, cr);
+		gettimeofday(&stop, NULL);
+		latency_record(LATENCY_SERVICE_RESULT, &start, &stop);
+		return result;
 		}
 	if (cr->object_check_type == HOST_CHECK) {
 		host *hst;
@@ -2090,7 +2109,11 @@ int process_check_result(check_result *cr)
 		if (!hst)
 			return ERROR;
 		hst->check_source = source_name;
-		return handle_async_host_check_result(hst, cr);
+		gettimeofday(&start, NULL);
+		result = handle_async_host_check_result(hst, cr);
+		gettimeofday(&stop, NULL);
+		latency_record(LATENCY_HOST_RESULT, &start, &stop);
+		return result;
 		}
 	return ERROR;
 	}
@@ -2172,9 +2195,9 @@ int process_check_result_file(char *fname) {
 		/* else we have check result data */
 		else {
 			if(!strcmp(var, "host_name"))
-				cr.host_name = (char *)strdup(val);
+				cr.host_name = (char *)intern_str(val);
 			else if(!strcmp(var, "service_description")) {
-				cr.service_description = (char *)strdup(val);
+				cr.service_description = (char *)intern_str(val);
 				cr.object_check_type = SERVICE_CHECK;
 				}
 			else if(!strcmp(var, "check_type"))
@@ -2268,6 +2291,7 @@ int init_check_result(check_result *info) {
 	info->object_check_type = HOST_CHECK;
 	info->host_name = NULL;
 	info->service_description = NULL;
+	info->command_name = NULL;
 	info->check_type = CHECK_TYPE_ACTIVE;
 	info->check_options = CHECK_OPTION_NONE;
 	info->scheduled_check = FALSE;
@@ -2296,8 +2320,9 @@ int free_check_result(check_result *info) {
 	if(info == NULL)
 		return OK;
 
-	my_free(info->host_name);
-	my_free(info->service_description);
+	intern_free(info->host_name);
+	intern_free(info->service_description);
+	intern_free(info->command_name);
 	my_free(info->output);
 
 	return OK;
@@ -3144,6 +3169,15 @@ void cleanup(void) {
 
 /* free the memory allocated to the linked lists */
 void free_memory(nagios_macros *mac) {
+	/* free the state arrays before the objects they're copied from */
+	free_hot_state();
+
+	/* free host check results waiting for parent host checks, while we still know how many hosts there are */
+	free_parent_check_waits();
+
+	/* and service check results waiting for host checks, while we still know how many services there are */
+	free_host_check_waits();
+
 	/* free all allocated memory for the object definitions */
 	free_object_data();
 
@@ -3160,6 +3194,11 @@ void free_memory(nagios_macros *mac) {
 
 	/* free any notification list that may have been overlooked */
 	free_notification_list();
+	bitmap_destroy(notification_contacts);
+	notification_contacts = NULL;
+
+	/* free the outage storm state, it's sized for the old objects */
+	free_outage_data();
 
 	/* free obsessive compulsive commands */
 	my_free(ocsp_command);
@@ -3214,6 +3253,8 @@ void free_notification_list(void) {
 	temp_notification = notification_list;
 	while(temp_notification != NULL) {
 		next_notification = temp_notification->next;
+		if(notification_contacts != NULL)
+			bitmap_unset(notification_contacts, temp_notification->contact->id);
 		my_free(temp_notification);
 		temp_notification = next_notification;
 		}
@@ -3276,6 +3317,7 @@ int reset_variables(void) {
 
 	use_aggressive_host_checking = DEFAULT_AGGRESSIVE_HOST_CHECKING;
 	cached_host_check_horizon = DEFAULT_CACHED_HOST_CHECK_HORIZON;
+	outage_storm_threshold = 0;
 	cached_service_check_horizon = DEFAULT_CACHED_SERVICE_CHECK_HORIZON;
 	enable_predictive_host_dependency_checks = DEFAULT_ENABLE_PREDICTIVE_HOST_DEPENDENCY_CHECKS;
 	enable_predictive_service_dependency_checks = DEFAULT_ENABLE_PREDICTIVE_SERVICE_DEPENDENCY_CHECKS;
@@ -3335,6 +3377,7 @@ int reset_variables(void) {
 	status_update_interval = DEFAULT_STATUS_UPDATE_INTERVAL;
 
 	event_broker_options = BROKER_NOTHING;
+	broker_callback_profiling = FALSE;
 
 	time_change_threshold = DEFAULT_TIME_CHANGE_THRESHOLD;
 
@@ -3359,6 +3402,8 @@ int reset_variables(void) {
 	debug_level = DEFAULT_DEBUG_LEVEL;
 	debug_verbosity = DEFAULT_DEBUG_VERBOSITY;
 	max_debug_file_size = DEFAULT_MAX_DEBUG_FILE_SIZE;
+	debug_file_format = DEFAULT_DEBUG_FILE_FORMAT;
+	wproc_clear_resident_plugins();
 
 	date_format = DATE_FORMAT_US;
 
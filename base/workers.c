@@ -23,8 +23,62 @@ struct wproc_list {
 
 static struct wproc_list workers = {0, 0, NULL};
 
+/* workers we no longer give jobs, waiting for theirs to finish */
+static struct wproc_list retiring = {0, 0, NULL};
+
+/*
+ * When max_check_workers is set, we add core workers when timed
+ * events start running late or jobs can't find a worker with room
+ * for them, and retire core workers again when things have been
+ * quiet for a few rounds. Every change is kept in a short history
+ * for the @wproc query handler.
+ */
+#define WPROC_SCALE_UP_LATENCY 1000000 /* usec of average event lateness */
+#define WPROC_SCALE_DOWN_LATENCY 100000
+#define WPROC_SCALE_UP_JOBS 250 /* running jobs per worker */
+#define WPROC_SCALE_DOWN_JOBS 25
+#define WPROC_SCALE_DOWN_ROUNDS 4 /* quiet rounds before we retire a worker */
+#define WPROC_SCALE_HISTORY 32
+
+struct wproc_scaling {
+	time_t when;
+	int from, to;
+	char reason[160];
+};
+
+static struct {
+	int target; /* workers we should have once spawned ones show up */
+	time_t last_run, last_change;
+	unsigned int quiet_rounds;
+	unsigned long long dispatch_count, dispatch_usec; /* as of last round */
+	unsigned long long late_usec; /* average event lateness last round */
+	unsigned int jobs_per_worker;
+	unsigned long no_worker, no_worker_last; /* jobs that found no worker */
+	unsigned int ups, downs;
+	char last_decision[160];
+	struct wproc_scaling history[WPROC_SCALE_HISTORY];
+	unsigned int num_changes;
+} autoscale;
+
 static dkhash_table *specialized_workers;
 
+/* plugin name -> command starting its resident helper */
+struct resident_plugin {
+	char *plugin;
+	char *helper;
+};
+static dkhash_table *resident_plugins;
+
+static int free_resident_plugin(void *data)
+{
+	struct resident_plugin *rp = (struct resident_plugin *)data;
+
+	free(rp->plugin);
+	free(rp->helper);
+	free(rp);
+	return DKHASH_WALK_REMOVE;
+}
+
 typedef struct wproc_object_job {
 	char *contact_name;
 	char *host_name;
@@ -202,6 +256,198 @@ static void destroy_job(worker_process *wp, worker_job *job)
 	free(job);
 }
 
+/*
+ * A notification usually goes to a bunch of contacts at once, and
+ * each of them may have several notification commands. Between
+ * wproc_batch_begin() and wproc_batch_end() jobs are queued up per
+ * worker and shipped with one write() each instead of one per job.
+ * Queues are flushed early when they grow large, so we never hand
+ * the kernel much more than a worker socket buffer can take.
+ * Whatever a write() doesn't take stays queued, and the iobroker
+ * tells handle_worker_result() when the worker can take the rest.
+ * Single jobs go through the same queues, so a job never overtakes
+ * the unwritten end of an earlier one on the wire.
+ */
+#define WPROC_BATCH_FLUSH (32 * 1024)
+
+struct wproc_batch {
+	worker_process *wp;
+	char *buf;
+	size_t len, size;
+	worker_job **jobs;
+	size_t *job_end; /* where each job's request ends in buf */
+	unsigned int num_jobs, max_jobs;
+};
+static struct wproc_batch *batches;
+static unsigned int num_batches, batch_depth;
+
+static void wproc_batch_flush(struct wproc_batch *b)
+{
+	ssize_t ret;
+	unsigned int i, done;
+
+	if (!b->wp || !b->len)
+		return;
+
+	ret = write(b->wp->sd, b->buf, b->len);
+	if (ret < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: '%s' seems to be choked. ret = %ld; bufsize = %lu: errno = %d (%s)\n",
+				  b->wp->source_name, (long)ret, (unsigned long)b->len, errno, strerror(errno));
+			for (i = 0; i < b->num_jobs; i++)
+				destroy_job(b->wp, b->jobs[i]);
+			b->len = 0;
+			b->num_jobs = 0;
+			iobroker_watch_out(nagios_iobs, b->wp->sd, 0);
+			return;
+		}
+		ret = 0;
+	}
+
+	/* jobs that made it all the way are the worker's problem now */
+	for (done = 0; done < b->num_jobs && b->job_end[done] <= (size_t)ret; done++)
+		;
+	for (i = done; i < b->num_jobs; i++) {
+		b->jobs[i - done] = b->jobs[i];
+		b->job_end[i - done] = b->job_end[i] - ret;
+	}
+	b->num_jobs -= done;
+	b->len -= ret;
+	if (b->len)
+		memmove(b->buf, b->buf + ret, b->len);
+
+	iobroker_watch_out(nagios_iobs, b->wp->sd, b->len != 0);
+}
+
+/* the queue with a write still pending for this worker, if any */
+static struct wproc_batch *wproc_batch_pending(worker_process *wp)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_batches; i++) {
+		if (batches[i].wp == wp && batches[i].len)
+			return &batches[i];
+	}
+	return NULL;
+}
+
+/* send what is queued for a worker, as far as it will take it */
+static void wproc_batch_resume(worker_process *wp)
+{
+	struct wproc_batch *b;
+
+	if (!(b = wproc_batch_pending(wp))) {
+		iobroker_watch_out(nagios_iobs, wp->sd, 0);
+		return;
+	}
+	wproc_batch_flush(b);
+	if (!b->len && !batch_depth)
+		b->wp = NULL;
+}
+
+static int wproc_batch_add(worker_process *wp, worker_job *job, struct kvvec_buf *kvvb)
+{
+	struct wproc_batch *b = NULL;
+	unsigned int i;
+
+	for (i = 0; i < num_batches; i++) {
+		if (batches[i].wp == wp || (!b && !batches[i].wp))
+			b = &batches[i];
+		if (batches[i].wp == wp)
+			break;
+	}
+	if (!b) {
+		struct wproc_batch *nb = realloc(batches, (num_batches + 1) * sizeof(*nb));
+		if (!nb)
+			return -1;
+		batches = nb;
+		b = &batches[num_batches++];
+		memset(b, 0, sizeof(*b));
+	}
+
+	if (b->len + kvvb->bufsize > b->size) {
+		size_t size = b->size ? b->size : WPROC_BATCH_FLUSH;
+		char *buf;
+
+		while (size < b->len + kvvb->bufsize)
+			size *= 2;
+		if (!(buf = realloc(b->buf, size)))
+			return -1;
+		b->buf = buf;
+		b->size = size;
+	}
+	if (b->num_jobs == b->max_jobs) {
+		unsigned int max = b->max_jobs ? b->max_jobs * 2 : 64;
+		worker_job **jobs;
+		size_t *job_end;
+
+		if (!(jobs = realloc(b->jobs, max * sizeof(*jobs))))
+			return -1;
+		b->jobs = jobs;
+		if (!(job_end = realloc(b->job_end, max * sizeof(*job_end))))
+			return -1;
+		b->job_end = job_end;
+		b->max_jobs = max;
+	}
+
+	b->wp = wp;
+	memcpy(b->buf + b->len, kvvb->buf, kvvb->bufsize);
+	b->len += kvvb->bufsize;
+	b->jobs[b->num_jobs] = job;
+	b->job_end[b->num_jobs++] = b->len;
+
+	if (b->len >= WPROC_BATCH_FLUSH)
+		wproc_batch_flush(b);
+
+	return 0;
+}
+
+void wproc_batch_begin(void)
+{
+	batch_depth++;
+}
+
+void wproc_batch_end(void)
+{
+	unsigned int i;
+
+	if (!batch_depth || --batch_depth)
+		return;
+
+	for (i = 0; i < num_batches; i++) {
+		wproc_batch_flush(&batches[i]);
+		if (!batches[i].len)
+			batches[i].wp = NULL;
+	}
+}
+
+/* a worker going away takes its queued jobs with it */
+static void wproc_batch_forget(worker_process *wp)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_batches; i++) {
+		if (batches[i].wp != wp)
+			continue;
+		batches[i].wp = NULL;
+		batches[i].len = 0;
+		batches[i].num_jobs = 0;
+	}
+}
+
+static void wproc_batch_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_batches; i++) {
+		free(batches[i].buf);
+		free(batches[i].jobs);
+		free(batches[i].job_end);
+	}
+	my_free(batches);
+	num_batches = batch_depth = 0;
+}
+
 static int wproc_is_alive(worker_process *wp)
 {
 	if (!wp || !wp->pid)
@@ -227,6 +473,7 @@ int wproc_destroy(worker_process *wp, int flags)
 		return 0;
 
 	/* free all memory when either forcing or a worker called us */
+	wproc_batch_forget(wp);
 	iocache_destroy(wp->ioc);
 	wp->ioc = NULL;
 	my_free(wp->source_name);
@@ -289,6 +536,53 @@ static int remove_specialized(void *data)
 	return 0;
 }
 
+/* take a worker off the list of retiring ones */
+static int unretire(worker_process *wp)
+{
+	int i;
+
+	for (i = 0; i < retiring.len; i++) {
+		if (retiring.wps[i] != wp)
+			continue;
+		retiring.wps[i] = retiring.wps[--retiring.len];
+		return 1;
+	}
+
+	return 0;
+}
+
+/* shut down a retiring worker once its last job has finished */
+static void wproc_retire_done(worker_process *wp)
+{
+	pid_t pid = wp->pid;
+
+	if (wp->jobs_running || !unretire(wp))
+		return;
+
+	logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: Retired worker %s\n", wp->source_name);
+	wproc_num_workers_online--;
+	/* we only retire workers we spawned ourselves */
+	wproc_num_workers_spawned--;
+	wproc_destroy(wp, WPROC_FORCE);
+	if (pid > 0)
+		(void)waitpid(pid, NULL, 0);
+}
+
+/*
+ * Stop giving jobs to a worker, and shut it down when the ones
+ * it's running now have finished.
+ */
+static void wproc_retire(worker_process *wp)
+{
+	to_remove = wp;
+	remove_specialized(&workers);
+	to_remove = NULL;
+
+	retiring.wps = realloc(retiring.wps, (retiring.len + 1) * sizeof(worker_process *));
+	retiring.wps[retiring.len++] = wp;
+	wproc_retire_done(wp);
+}
+
 /*
  * This gets called from both parent and worker process, so
  * we must take care not to blindly shut down everything here
@@ -308,14 +602,87 @@ void free_worker_memory(int flags)
 
 		free(workers.wps);
 	}
+	while (retiring.len > 0)
+		wproc_destroy(retiring.wps[--retiring.len], flags);
+	free(retiring.wps);
+	retiring.wps = NULL;
 	to_remove = NULL;
 	dkhash_walk_data(specialized_workers, remove_specialized);
 	dkhash_destroy(specialized_workers);
+	wproc_batch_free();
 	workers.wps = NULL;
 	workers.len = 0;
 	workers.idx = 0;
 }
 
+/*
+ * Parses "<plugin> <helper command>" from resident_plugin= in the
+ * main config file. These are dropped again when we reload.
+ */
+int wproc_add_resident_plugin(const char *spec)
+{
+	struct resident_plugin *rp, *old;
+	const char *space, *helper;
+
+	if (!(space = strchr(spec, ' ')) || space == spec)
+		return ERROR;
+	for (helper = space; *helper == ' ' || *helper == '\t'; helper++)
+		;
+	if (!*helper)
+		return ERROR;
+
+	if (!resident_plugins && !(resident_plugins = dkhash_create(64)))
+		return ERROR;
+
+	if (!(rp = calloc(1, sizeof(*rp))))
+		return ERROR;
+	rp->plugin = strndup(spec, space - spec);
+	rp->helper = strdup(helper);
+	if (!rp->plugin || !rp->helper) {
+		free_resident_plugin(rp);
+		return ERROR;
+	}
+
+	/* last one wins */
+	if ((old = dkhash_remove(resident_plugins, rp->plugin, NULL)))
+		free_resident_plugin(old);
+	if (dkhash_insert(resident_plugins, rp->plugin, NULL, rp) < 0) {
+		free_resident_plugin(rp);
+		return ERROR;
+	}
+
+	return OK;
+}
+
+void wproc_clear_resident_plugins(void)
+{
+	if (!resident_plugins)
+		return;
+	dkhash_walk_data(resident_plugins, free_resident_plugin);
+	dkhash_destroy(resident_plugins);
+	resident_plugins = NULL;
+}
+
+/* the helper for the plugin this command runs, if any */
+static const char *get_resident_helper(char *command)
+{
+	char *space, *slash;
+	struct resident_plugin *rp;
+
+	if (!resident_plugins)
+		return NULL;
+
+	if ((space = strchr(command, ' ')) != NULL)
+		*space = '\0';
+	rp = dkhash_get(resident_plugins, command, NULL);
+	if (!rp && (slash = strrchr(command, '/')) != NULL)
+		rp = dkhash_get(resident_plugins, slash + 1, NULL);
+	if (space != NULL)
+		*space = ' ';
+
+	return rp ? rp->helper : NULL;
+}
+
 static int str2timeval(char *str, struct timeval *tv)
 {
 	char *ptr, *ptr2;
@@ -468,6 +835,12 @@ static int handle_worker_result(int sd, int events, void *arg)
 	static struct kvvec kvv = KVVEC_INITIALIZER;
 	worker_process *wp = (worker_process *)arg;
 
+	if (events & IOBROKER_POLLOUT) {
+		wproc_batch_resume(wp);
+		if (!(events & ~IOBROKER_POLLOUT))
+			return 0;
+	}
+
 	if(iocache_capacity(wp->ioc) == 0) {
 		logit(NSLOG_RUNTIME_WARNING, TRUE, "wproc: iocache_capacity() is 0 for worker %s.\n", wp->source_name);
 	}
@@ -482,9 +855,11 @@ static int handle_worker_result(int sd, int events, void *arg)
 		logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: Socket to worker %s broken, removing", wp->source_name);
 		wproc_num_workers_online--;
 		iobroker_unregister(nagios_iobs, sd);
+		wproc_batch_forget(wp);
 		to_remove = wp;
 		dkhash_walk_data(specialized_workers, remove_specialized);
-		if (remove_specialized((void *)&workers) == DKHASH_WALK_REMOVE) {
+		/* retiring workers aren't among the global ones anymore */
+		if (!unretire(wp) && remove_specialized((void *)&workers) == DKHASH_WALK_REMOVE) {
 			/* there aren't global workers left, we can't run any more checks
 			 * we should try respawning a few of the standard ones
 			 */
@@ -507,11 +882,12 @@ static int handle_worker_result(int sd, int events, void *arg)
 		return 0;
 	}
 	while ((buf = iocache_use_delim(wp->ioc, MSG_DELIM, MSG_DELIM_LEN, &size))) {
-		int job_id = -1;
+		int job_id = -1, is_stats;
 		worker_job *job;
 		wproc_result wpres;
 
-		/* log messages are handled first */
+		/* log messages and counters are handled first */
+		is_stats = size > 6 && !memcmp(buf, "stats=", 6);
 		if (size > 5 && !memcmp(buf, "log=", 4)) {
 			logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: %s: %s\n", wp->source_name, buf + 4);
 			continue;
@@ -523,6 +899,20 @@ static int handle_worker_result(int sd, int events, void *arg)
 			continue;
 		}
 
+		if (is_stats) {
+			int i;
+			for (i = 0; i < kvv.kv_pairs; i++) {
+				struct key_value *kv = &kvv.kv[i];
+				if (!strcmp(kv->key, "reaped"))
+					wp->reaped = strtoul(kv->value, NULL, 10);
+				else if (!strcmp(kv->key, "timed_out"))
+					wp->timed_out = strtoul(kv->value, NULL, 10);
+				else if (!strcmp(kv->key, "orphaned"))
+					wp->orphaned = strtoul(kv->value, NULL, 10);
+			}
+			continue;
+		}
+
 		memset(&wpres, 0, sizeof(wpres));
 		wpres.job_id = -1;
 		wpres.type = -1;
@@ -542,6 +932,12 @@ static int handle_worker_result(int sd, int events, void *arg)
 		}
 		oj = (wproc_object_job *)job->arg;
 
+		if (job->start.tv_sec) {
+			struct timeval now;
+			gettimeofday(&now, NULL);
+			latency_record(LATENCY_WORKER_RTT, &job->start, &now);
+		}
+
 		/*
 		 * ETIME ("Timer expired") doesn't really happen
 		 * on any modern systems, so we reuse it to mean
@@ -550,6 +946,10 @@ static int handle_worker_result(int sd, int events, void *arg)
 		if (wpres.error_code == ETIME) {
 			wpres.early_timeout = TRUE;
 		}
+
+		cmdstats_record(job->type == WPJOB_CHECK ? ((check_result *)job->arg)->command_name : NULL,
+		                job->command, &wpres.start, &wpres.stop, &wpres.rusage, wpres.early_timeout);
+
 		switch (job->type) {
 		case WPJOB_CHECK:
 			ret = handle_worker_check(&wpres, wp, job);
@@ -617,6 +1017,10 @@ static int handle_worker_result(int sd, int events, void *arg)
 		destroy_job(wp, job);
 	}
 
+	/* retiring workers go away once their last job is done */
+	if (!wp->jobs_running && retiring.len)
+		wproc_retire_done(wp);
+
 	return 0;
 }
 
@@ -711,6 +1115,8 @@ static int register_worker(int sd, char *buf, unsigned int len)
 	return QH_TAKEOVER;
 }
 
+static int wproc_autoscale_qh(int sd);
+
 static int wproc_query_handler(int sd, char *buf, unsigned int len)
 {
 	char *space, *rbuf = NULL;
@@ -728,12 +1134,15 @@ static int wproc_query_handler(int sd, char *buf, unsigned int len)
 
 		for (i = 0; i < workers.len; i++) {
 			worker_process *wp = workers.wps[i];
-			nsock_printf(sd, "name=%s;pid=%d;jobs_running=%u;jobs_started=%u\n",
+			nsock_printf(sd, "name=%s;pid=%d;jobs_running=%u;jobs_started=%u;reaped=%lu;timed_out=%lu;orphaned=%lu\n",
 						 wp->source_name, wp->pid,
-						 wp->jobs_running, wp->jobs_started);
+						 wp->jobs_running, wp->jobs_started,
+						 wp->reaped, wp->timed_out, wp->orphaned);
 		}
 		return 0;
 	}
+	if (!strcmp(buf, "autoscale"))
+		return wproc_autoscale_qh(sd);
 
 	return 400;
 }
@@ -752,10 +1161,161 @@ static int spawn_core_worker(void)
 }
 
 
-int init_workers(int desired_workers)
+/* core workers are the ones we spawn. Others we leave alone */
+static int is_core_worker(worker_process *wp)
+{
+	return wp->source_name && !strncmp(wp->source_name, "Core Worker ", 12);
+}
+
+static void autoscale_decision(const char *fmt, ...)
 {
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(autoscale.last_decision, sizeof(autoscale.last_decision), fmt, ap);
+	va_end(ap);
+}
+
+static void autoscale_change(int to, const char *reason)
+{
+	struct wproc_scaling *ws;
+
+	ws = &autoscale.history[autoscale.num_changes++ % WPROC_SCALE_HISTORY];
+	ws->when = time(NULL);
+	ws->from = workers.len;
+	ws->to = to;
+	snprintf(ws->reason, sizeof(ws->reason), "%s", reason);
+	autoscale.last_change = ws->when;
+	autoscale.target = to;
+	autoscale_decision("%s from %d to %d workers: %s", to > ws->from ? "scaled up" : "scaled down", ws->from, to, reason);
+	logit(NSLOG_INFO_MESSAGE, TRUE, "wproc: Autoscaling from %d to %d workers: %s\n", ws->from, to, reason);
+}
+
+static int autoscale_max(void)
+{
+	return max_check_workers > (int)wproc_num_workers_desired ? max_check_workers : (int)wproc_num_workers_desired;
+}
+
+void wproc_autoscale(void *discard)
+{
+	const struct latency_histogram *h = latency_get(LATENCY_EVENT_DISPATCH);
+	worker_process *victim = NULL;
+	unsigned long no_worker;
+	unsigned int jobs = 0;
+	char reason[160];
+	time_t now = time(NULL);
 	int i;
 
+	/* see what happened since the last round */
+	if (h->count < autoscale.dispatch_count) {
+		/* someone reset the latency counters */
+		autoscale.dispatch_count = autoscale.dispatch_usec = 0;
+	}
+	if (h->count > autoscale.dispatch_count)
+		autoscale.late_usec = (h->usec_total - autoscale.dispatch_usec) / (h->count - autoscale.dispatch_count);
+	else
+		autoscale.late_usec = 0;
+	autoscale.dispatch_count = h->count;
+	autoscale.dispatch_usec = h->usec_total;
+	no_worker = autoscale.no_worker - autoscale.no_worker_last;
+	autoscale.no_worker_last = autoscale.no_worker;
+	for (i = 0; i < workers.len; i++)
+		jobs += workers.wps[i]->jobs_running;
+	autoscale.jobs_per_worker = workers.len ? jobs / workers.len : 0;
+	autoscale.last_run = now;
+
+	/* give workers we've spawned a chance to show up */
+	if (workers.len < autoscale.target && now < autoscale.last_change + 2 * WPROC_AUTOSCALE_INTERVAL) {
+		autoscale_decision("waiting for %d new workers to register", autoscale.target - workers.len);
+		return;
+	}
+	autoscale.target = workers.len;
+
+	if (no_worker || autoscale.late_usec > WPROC_SCALE_UP_LATENCY || autoscale.jobs_per_worker > WPROC_SCALE_UP_JOBS) {
+		autoscale.quiet_rounds = 0;
+		snprintf(reason, sizeof(reason), "%lu jobs found no worker, events ran %llu usec late on average, %u jobs per worker",
+		         no_worker, autoscale.late_usec, autoscale.jobs_per_worker);
+		if (workers.len >= autoscale_max()) {
+			autoscale_decision("busy, but already at max_check_workers: %s", reason);
+			return;
+		}
+		/* more workers won't help if load control holds jobs back */
+		if ((loadctl.options & LOADCTL_ENABLED) &&
+		    (loadctl.load[0] > loadctl.backoff_limit || loadctl.jobs_running >= loadctl.jobs_limit))
+		{
+			autoscale_decision("busy, but held back by load control (load %.2f, %u of %u jobs): %s",
+			                   loadctl.load[0], loadctl.jobs_running, loadctl.jobs_limit, reason);
+			return;
+		}
+		if (spawn_core_worker() < 0) {
+			autoscale_decision("busy, but failed to spawn a worker: %s", reason);
+			return;
+		}
+		autoscale.ups++;
+		autoscale_change(workers.len + 1, reason);
+		return;
+	}
+
+	if (autoscale.late_usec >= WPROC_SCALE_DOWN_LATENCY || autoscale.jobs_per_worker >= WPROC_SCALE_DOWN_JOBS) {
+		autoscale.quiet_rounds = 0;
+		autoscale_decision("steady: events ran %llu usec late on average, %u jobs per worker",
+		                   autoscale.late_usec, autoscale.jobs_per_worker);
+		return;
+	}
+
+	autoscale.quiet_rounds++;
+	if (autoscale.quiet_rounds < WPROC_SCALE_DOWN_ROUNDS || workers.len <= (int)wproc_num_workers_desired) {
+		autoscale_decision("quiet for %u rounds with %d workers", autoscale.quiet_rounds, workers.len);
+		return;
+	}
+
+	/* the least busy worker has the fewest jobs to finish */
+	for (i = 0; i < workers.len; i++) {
+		if (is_core_worker(workers.wps[i]) && (!victim || workers.wps[i]->jobs_running < victim->jobs_running))
+			victim = workers.wps[i];
+	}
+	if (!victim) {
+		autoscale_decision("quiet, but there's no core worker to retire");
+		return;
+	}
+
+	snprintf(reason, sizeof(reason), "quiet for %u rounds, events ran %llu usec late on average, %u jobs per worker",
+	         autoscale.quiet_rounds, autoscale.late_usec, autoscale.jobs_per_worker);
+	autoscale.quiet_rounds = 0;
+	autoscale.downs++;
+	autoscale_change(workers.len - 1, reason);
+	wproc_retire(victim);
+}
+
+static int wproc_autoscale_qh(int sd)
+{
+	unsigned int i, first = 0;
+
+	nsock_printf(sd, "enabled=%d;min=%u;max=%d;workers=%d;retiring=%d;target=%d;"
+	             "last_run=%lu;late_usec=%llu;jobs_per_worker=%u;no_worker=%lu;quiet_rounds=%u;"
+	             "scale_ups=%u;scale_downs=%u;last_decision=%s\n",
+	             max_check_workers > (int)wproc_num_workers_desired, wproc_num_workers_desired,
+	             autoscale_max(), workers.len, retiring.len, autoscale.target,
+	             (unsigned long)autoscale.last_run, autoscale.late_usec, autoscale.jobs_per_worker,
+	             autoscale.no_worker, autoscale.quiet_rounds,
+	             autoscale.ups, autoscale.downs, autoscale.last_decision);
+
+	/* oldest change first */
+	if (autoscale.num_changes > WPROC_SCALE_HISTORY)
+		first = autoscale.num_changes - WPROC_SCALE_HISTORY;
+	for (i = first; i < autoscale.num_changes; i++) {
+		struct wproc_scaling *ws = &autoscale.history[i % WPROC_SCALE_HISTORY];
+		nsock_printf(sd, "when=%lu;from=%d;to=%d;reason=%s\n",
+		             (unsigned long)ws->when, ws->from, ws->to, ws->reason);
+	}
+
+	return 0;
+}
+
+int init_workers(int desired_workers)
+{
+	int i, alive;
+
 	/*
 	 * we register our query handler before launching workers,
 	 * so other workers can join us whenever they're ready
@@ -783,14 +1343,17 @@ int init_workers(int desired_workers)
 	}
 	wproc_num_workers_desired = desired_workers;
 
-	if (workers_alive() == desired_workers)
+	alive = workers_alive();
+	if (alive >= desired_workers && alive <= autoscale_max())
 		return 0;
 
-	/* can't shrink the number of workers (yet) */
-	if (desired_workers < workers.len)
-		return -1;
+	/* retire the core workers we don't want anymore */
+	for (i = workers.len - 1; i >= 0 && workers.len > autoscale_max(); i--) {
+		if (is_core_worker(workers.wps[i]))
+			wproc_retire(workers.wps[i]);
+	}
 
-	for (i = 0; i < desired_workers; i++)
+	for (i = alive; i < desired_workers; i++)
 		spawn_core_worker();
 
 	return 0;
@@ -867,6 +1430,7 @@ static int wproc_run_job(worker_job *job, nagios_macros *mac)
 	static struct kvvec kvv = KVVEC_INITIALIZER;
 	struct kvvec_buf *kvvb;
 	worker_process *wp;
+	const char *resident;
 	int ret;
 
 	/*
@@ -874,8 +1438,10 @@ static int wproc_run_job(worker_job *job, nagios_macros *mac)
 	 * and sets job_id
 	 */
 	wp = get_worker(job);
-	if (!wp || job->id < 0)
+	if (!wp || job->id < 0) {
+		autoscale.no_worker++;
 		return ERROR;
+	}
 
 	/*
 	 * XXX FIXME: add environment macros as
@@ -884,18 +1450,30 @@ static int wproc_run_job(worker_job *job, nagios_macros *mac)
 	 * so workers know to add them to environment. For now,
 	 * we don't support that though.
 	 */
-	if (!kvvec_init(&kvv, 4))	/* job_id, type, command and timeout */
+	if (!kvvec_init(&kvv, 5))	/* job_id, type, command, timeout and resident */
 		return ERROR;
 
 	kvvec_addkv(&kvv, "job_id", (char *)mkstr("%d", job->id));
 	kvvec_addkv(&kvv, "type", (char *)mkstr("%d", job->type));
 	kvvec_addkv(&kvv, "command", job->command);
 	kvvec_addkv(&kvv, "timeout", (char *)mkstr("%u", job->timeout));
+	if ((resident = get_resident_helper(job->command)) != NULL)
+		kvvec_addkv(&kvv, "resident", (char *)resident);
 	kvvb = build_kvvec_buf(&kvv);
-	ret = write(wp->sd, kvvb->buf, kvvb->bufsize);
+	gettimeofday(&job->start, NULL);
 	wp->jobs_running++;
 	wp->jobs_started++;
 	loadctl.jobs_running++;
+	if (!wproc_batch_add(wp, job, kvvb)) {
+		ret = kvvb->bufsize;
+		/* outside of a batch it goes out right away, as far as it can */
+		if (!batch_depth)
+			wproc_batch_resume(wp);
+	} else if (!wproc_batch_pending(wp)) {
+		ret = write(wp->sd, kvvb->buf, kvvb->bufsize);
+	} else {
+		ret = -1;
+	}
 	if (ret != kvvb->bufsize) {
 		logit(NSLOG_RUNTIME_ERROR, TRUE, "wproc: '%s' seems to be choked. ret = %d; bufsize = %lu: errno = %d (%s)\n",
 			  wp->source_name, ret, kvvb->bufsize, errno, strerror(errno));
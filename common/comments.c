@@ -43,7 +43,249 @@
 
 comment     *comment_list = NULL;
 int	    defer_comment_sorting = 0;
-comment     **comment_hashlist = NULL;
+
+/*
+ * comment_list is sorted by comment id, which is the order status and
+ * retention data are written in. Acknowledgements come and go all the
+ * time though, so nothing should have to walk it to find a comment.
+ * We also keep:
+ *  - a hash on the comment id, for finding and deleting comments
+ *  - a chain of all comments for each host, service comments included,
+ *    linked through nexthash
+ *  - a chain of the comments for each host or service on its own,
+ *    linked through obj_next
+ * Chains are found through dkhash tables on the names and are sorted
+ * by comment id, just like the list. Ids mostly grow, so new comments
+ * are linked in by looking backwards from the end of each.
+ */
+struct comment_chain {
+	const char *host_name;
+	const char *service_description;
+	comment *head, *tail;
+	};
+
+/* which of the links in a comment a chain uses */
+#define COMMENT_LINK_LIST 0
+#define COMMENT_LINK_HOST 1
+#define COMMENT_LINK_OBJ  2
+
+static struct comment_chain comment_all;
+static comment **comment_id_hash;
+static unsigned int comment_id_hash_size, comment_id_hash_entries;
+static dkhash_table *comment_host_table, *comment_obj_table;
+
+/* ids are handed out sequentially, so the low bits spread them evenly */
+#define comment_id_slot(id) ((id) & (comment_id_hash_size - 1))
+
+static inline comment **comment_next_link(comment *c, int link) {
+	if(link == COMMENT_LINK_HOST)
+		return &c->nexthash;
+	if(link == COMMENT_LINK_OBJ)
+		return &c->obj_next;
+	return &c->next;
+	}
+
+static inline comment **comment_prev_link(comment *c, int link) {
+	if(link == COMMENT_LINK_HOST)
+		return &c->prevhash;
+	if(link == COMMENT_LINK_OBJ)
+		return &c->obj_prev;
+	return &c->prev;
+	}
+
+static void comment_chain_link(struct comment_chain *chain, comment *c, int link) {
+	comment *after;
+
+	for(after = chain->tail; after != NULL && after->comment_id > c->comment_id; after = *comment_prev_link(after, link))
+		;
+
+	*comment_prev_link(c, link) = after;
+	if(after != NULL) {
+		*comment_next_link(c, link) = *comment_next_link(after, link);
+		*comment_next_link(after, link) = c;
+		}
+	else {
+		*comment_next_link(c, link) = chain->head;
+		chain->head = c;
+		}
+	if(*comment_next_link(c, link) != NULL)
+		*comment_prev_link(*comment_next_link(c, link), link) = c;
+	else
+		chain->tail = c;
+	}
+
+/* finds the chain for a host or service, creating it if asked to */
+static struct comment_chain *comment_chain_get(dkhash_table **table, const char *host_name, const char *svc_description, int create) {
+	struct comment_chain *chain;
+
+	if(host_name == NULL)
+		return NULL;
+	if(*table != NULL && (chain = dkhash_get(*table, host_name, svc_description)) != NULL)
+		return chain;
+	if(create == FALSE)
+		return NULL;
+
+	if(*table == NULL && (*table = dkhash_create(1024)) == NULL)
+		return NULL;
+	if((chain = (struct comment_chain *)calloc(1, sizeof(*chain))) == NULL)
+		return NULL;
+	chain->host_name = intern_str(host_name);
+	chain->service_description = svc_description ? intern_str(svc_description) : NULL;
+	if(chain->host_name == NULL || (svc_description && chain->service_description == NULL) || dkhash_insert(*table, chain->host_name, chain->service_description, chain) != DKHASH_OK) {
+		intern_free(chain->host_name);
+		intern_free(chain->service_description);
+		my_free(chain);
+		return NULL;
+		}
+
+	return chain;
+	}
+
+static void comment_chain_free(struct comment_chain *chain) {
+
+	intern_free(chain->host_name);
+	intern_free(chain->service_description);
+	my_free(chain);
+	}
+
+/* chains go away with their last comment */
+static void comment_chain_drop_empty(dkhash_table *table, struct comment_chain *chain) {
+
+	if(chain == NULL || chain->head != NULL)
+		return;
+
+	dkhash_remove(table, chain->host_name, chain->service_description);
+	comment_chain_free(chain);
+	}
+
+static int comment_chain_walk_free(void *data) {
+
+	comment_chain_free((struct comment_chain *)data);
+	return DKHASH_WALK_REMOVE;
+	}
+
+/* makes sure there's room for one more comment in the id hash */
+static int comment_id_hash_grow(void) {
+	comment **new_hash, *temp_comment, *next_comment;
+	unsigned int i, new_size, slot;
+
+	if(comment_id_hash_entries < comment_id_hash_size)
+		return OK;
+
+	new_size = comment_id_hash_size ? comment_id_hash_size * 2 : 1024;
+	if((new_hash = (comment **)calloc(new_size, sizeof(*new_hash))) == NULL)
+		return ERROR;
+	for(i = 0; i < comment_id_hash_size; i++) {
+		for(temp_comment = comment_id_hash[i]; temp_comment != NULL; temp_comment = next_comment) {
+			next_comment = temp_comment->id_next;
+			slot = temp_comment->comment_id & (new_size - 1);
+			temp_comment->id_next = new_hash[slot];
+			new_hash[slot] = temp_comment;
+			}
+		}
+	my_free(comment_id_hash);
+	comment_id_hash = new_hash;
+	comment_id_hash_size = new_size;
+
+	return OK;
+	}
+
+static comment *comment_id_hash_get(unsigned long comment_id) {
+	comment *temp_comment;
+
+	if(comment_id_hash == NULL)
+		return NULL;
+
+	for(temp_comment = comment_id_hash[comment_id_slot(comment_id)]; temp_comment != NULL; temp_comment = temp_comment->id_next) {
+		if(temp_comment->comment_id == comment_id)
+			return temp_comment;
+		}
+
+	return NULL;
+	}
+
+/* hooks a comment into the id hash and the chains of its host and service */
+static int comment_add_to_index(comment *c) {
+	struct comment_chain *host_chain, *obj_chain;
+	unsigned int slot;
+
+	if(comment_id_hash_grow() != OK)
+		return ERROR;
+	if((host_chain = comment_chain_get(&comment_host_table, c->host_name, NULL, TRUE)) == NULL)
+		return ERROR;
+	if((obj_chain = comment_chain_get(&comment_obj_table, c->host_name, c->service_description, TRUE)) == NULL) {
+		comment_chain_drop_empty(comment_host_table, host_chain);
+		return ERROR;
+		}
+
+	slot = comment_id_slot(c->comment_id);
+	c->id_next = comment_id_hash[slot];
+	comment_id_hash[slot] = c;
+	comment_id_hash_entries++;
+
+	comment_chain_link(host_chain, c, COMMENT_LINK_HOST);
+	comment_chain_link(obj_chain, c, COMMENT_LINK_OBJ);
+
+	return OK;
+	}
+
+/* the old name for the above, for modules that link their own comments */
+int add_comment_to_hashlist(comment *new_comment) {
+
+	if(new_comment == NULL)
+		return 0;
+
+	return (comment_add_to_index(new_comment) == OK) ? 1 : 0;
+	}
+
+#ifdef NSCORE
+static void comment_chain_unlink(struct comment_chain *chain, comment *c, int link) {
+	comment *next_comment = *comment_next_link(c, link);
+	comment *prev_comment = *comment_prev_link(c, link);
+
+	if(prev_comment != NULL)
+		*comment_next_link(prev_comment, link) = next_comment;
+	else
+		chain->head = next_comment;
+	if(next_comment != NULL)
+		*comment_prev_link(next_comment, link) = prev_comment;
+	else
+		chain->tail = prev_comment;
+
+	*comment_next_link(c, link) = *comment_prev_link(c, link) = NULL;
+	}
+
+static void comment_id_hash_remove(comment *c) {
+	comment **link;
+
+	if(comment_id_hash == NULL)
+		return;
+
+	for(link = &comment_id_hash[comment_id_slot(c->comment_id)]; *link != NULL; link = &(*link)->id_next) {
+		if(*link == c) {
+			*link = c->id_next;
+			c->id_next = NULL;
+			comment_id_hash_entries--;
+			return;
+			}
+		}
+	}
+
+static void comment_remove_from_index(comment *c) {
+	struct comment_chain *chain;
+
+	comment_id_hash_remove(c);
+	if((chain = comment_chain_get(&comment_host_table, c->host_name, NULL, FALSE)) != NULL) {
+		comment_chain_unlink(chain, c, COMMENT_LINK_HOST);
+		comment_chain_drop_empty(comment_host_table, chain);
+		}
+	if((chain = comment_chain_get(&comment_obj_table, c->host_name, c->service_description, FALSE)) != NULL) {
+		comment_chain_unlink(chain, c, COMMENT_LINK_OBJ);
+		comment_chain_drop_empty(comment_obj_table, chain);
+		}
+	}
+#endif
+
 
 
 
@@ -83,10 +325,6 @@ int add_new_comment(int type, int entry_type, char *host_name, char *svc_descrip
 	else
 		result = add_new_service_comment(entry_type, host_name, svc_description, entry_time, author_name, comment_data, persistent, source, expires, expire_time, &new_comment_id);
 
-	/* add an event to expire comment data if necessary... */
-	if(expires == TRUE)
-		schedule_new_event(EVENT_EXPIRE_COMMENT, FALSE, expire_time, FALSE, 0, NULL, TRUE, (void *)new_comment_id, NULL, 0);
-
 	/* save comment id */
 	if(comment_id != NULL)
 		*comment_id = new_comment_id;
@@ -150,24 +388,9 @@ int add_new_service_comment(int entry_type, char *host_name, char *svc_descripti
 /* deletes a host or service comment */
 int delete_comment(int type, unsigned long comment_id) {
 	comment *this_comment = NULL;
-	comment *last_comment = NULL;
-	comment *next_comment = NULL;
-	int hashslot = 0;
-	comment *this_hash = NULL;
-	comment *last_hash = NULL;
 
 	/* find the comment we should remove */
-	for(this_comment = comment_list, last_comment = comment_list; this_comment != NULL; this_comment = next_comment) {
-		next_comment = this_comment->next;
-
-		/* we found the comment we should delete */
-		if(this_comment->comment_id == comment_id && this_comment->comment_type == type)
-			break;
-
-		last_comment = this_comment;
-		}
-
-	if(this_comment == NULL)
+	if((this_comment = find_comment(comment_id, type)) == NULL)
 		return ERROR;
 
 	/* remove the comment from the list in memory */
@@ -176,33 +399,16 @@ int delete_comment(int type, unsigned long comment_id) {
 	broker_comment_data(NEBTYPE_COMMENT_DELETE, NEBFLAG_NONE, NEBATTR_NONE, type, this_comment->entry_type, this_comment->host_name, this_comment->service_description, this_comment->entry_time, this_comment->author, this_comment->comment_data, this_comment->persistent, this_comment->source, this_comment->expires, this_comment->expire_time, comment_id, NULL);
 #endif
 
-	/* first remove from chained hash list */
-	hashslot = hashfunc(this_comment->host_name, NULL, COMMENT_HASHSLOTS);
-	last_hash = NULL;
-	for(this_hash = comment_hashlist[hashslot]; this_hash; this_hash = this_hash->nexthash) {
-		if(this_hash == this_comment) {
-			if(last_hash)
-				last_hash->nexthash = this_hash->nexthash;
-			else {
-				if(this_hash->nexthash)
-					comment_hashlist[hashslot] = this_hash->nexthash;
-				else
-					comment_hashlist[hashslot] = NULL;
-				}
-			break;
-			}
-			last_hash = this_hash;
-		}
+	/* first remove it from the indexes */
+	comment_remove_from_index(this_comment);
 
 	/* then removed from linked list */
-	if(comment_list == this_comment)
-		comment_list = this_comment->next;
-	else
-		last_comment->next = next_comment;
+	comment_chain_unlink(&comment_all, this_comment, COMMENT_LINK_LIST);
+	comment_list = comment_all.head;
 
 	/* free memory */
-	my_free(this_comment->host_name);
-	my_free(this_comment->service_description);
+	intern_free(this_comment->host_name);
+	intern_free(this_comment->service_description);
 	my_free(this_comment->author);
 	my_free(this_comment->comment_data);
 	my_free(this_comment);
@@ -257,10 +463,9 @@ int delete_all_host_comments(char *host_name) {
 		return ERROR;
 
 	/* delete host comments from memory */
-	for(temp_comment = get_first_comment_by_host(host_name); temp_comment != NULL; temp_comment = next_comment) {
-		next_comment = get_next_comment_by_host(host_name, temp_comment);
-		if(temp_comment->comment_type == HOST_COMMENT)
-			delete_comment(HOST_COMMENT, temp_comment->comment_id);
+	for(temp_comment = get_first_comment_by_object(host_name, NULL); temp_comment != NULL; temp_comment = next_comment) {
+		next_comment = temp_comment->obj_next;
+		delete_comment(HOST_COMMENT, temp_comment->comment_id);
 		}
 
 	return result;
@@ -277,13 +482,10 @@ int delete_host_acknowledgement_comments(host *hst) {
 		return ERROR;
 
 	/* delete comments from memory */
-	temp_comment = get_first_comment_by_host(hst->name);
-	while (temp_comment) {
-		next_comment = get_next_comment_by_host(hst->name, temp_comment);
-		if(temp_comment->comment_type == HOST_COMMENT && temp_comment->entry_type == ACKNOWLEDGEMENT_COMMENT && temp_comment->persistent == FALSE) {
+	for(temp_comment = get_first_comment_by_object(hst->name, NULL); temp_comment != NULL; temp_comment = next_comment) {
+		next_comment = temp_comment->obj_next;
+		if(temp_comment->entry_type == ACKNOWLEDGEMENT_COMMENT && temp_comment->persistent == FALSE)
 			delete_comment(HOST_COMMENT, temp_comment->comment_id);
-			}
-		temp_comment = next_comment;
 		}
 
 	return result;
@@ -300,10 +502,9 @@ int delete_all_service_comments(char *host_name, char *svc_description) {
 		return ERROR;
 
 	/* delete service comments from memory */
-	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = next_comment) {
-		next_comment = temp_comment->next;
-		if(temp_comment->comment_type == SERVICE_COMMENT && !strcmp(temp_comment->host_name, host_name) && !strcmp(temp_comment->service_description, svc_description))
-			delete_comment(SERVICE_COMMENT, temp_comment->comment_id);
+	for(temp_comment = get_first_comment_by_object(host_name, svc_description); temp_comment != NULL; temp_comment = next_comment) {
+		next_comment = temp_comment->obj_next;
+		delete_comment(SERVICE_COMMENT, temp_comment->comment_id);
 		}
 
 	return result;
@@ -320,9 +521,9 @@ int delete_service_acknowledgement_comments(service *svc) {
 		return ERROR;
 
 	/* delete comments from memory */
-	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = next_comment) {
-		next_comment = temp_comment->next;
-		if(temp_comment->comment_type == SERVICE_COMMENT && !strcmp(temp_comment->host_name, svc->host_name) && !strcmp(temp_comment->service_description, svc->description)  && temp_comment->entry_type == ACKNOWLEDGEMENT_COMMENT && temp_comment->persistent == FALSE)
+	for(temp_comment = get_first_comment_by_object(svc->host_name, svc->description); temp_comment != NULL; temp_comment = next_comment) {
+		next_comment = temp_comment->obj_next;
+		if(temp_comment->entry_type == ACKNOWLEDGEMENT_COMMENT && temp_comment->persistent == FALSE)
 			delete_comment(SERVICE_COMMENT, temp_comment->comment_id);
 		}
 
@@ -334,15 +535,10 @@ int delete_service_acknowledgement_comments(service *svc) {
 int check_for_expired_comment(unsigned long comment_id) {
 	comment *temp_comment = NULL;
 
-	/* check all comments */
-	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = temp_comment->next) {
-
-		/* delete the now expired comment */
-		if(temp_comment->comment_id == comment_id && temp_comment->expires == TRUE && temp_comment->expire_time < time(NULL)) {
-			delete_comment(temp_comment->comment_type, comment_id);
-			break;
-			}
-		}
+	/* delete the now expired comment */
+	temp_comment = comment_id_hash_get(comment_id);
+	if(temp_comment != NULL && temp_comment->expires == TRUE && temp_comment->expire_time <= time(NULL))
+		delete_comment(temp_comment->comment_type, comment_id);
 
 	return OK;
 	}
@@ -354,51 +550,6 @@ int check_for_expired_comment(unsigned long comment_id) {
 
 
 
-/******************************************************************/
-/****************** CHAINED HASH FUNCTIONS ************************/
-/******************************************************************/
-
-/* adds comment to hash list in memory */
-int add_comment_to_hashlist(comment *new_comment) {
-	comment *temp_comment = NULL;
-	comment *lastpointer = NULL;
-	int hashslot = 0;
-
-	/* initialize hash list */
-	if(comment_hashlist == NULL) {
-		int i;
-
-		comment_hashlist = (comment **)malloc(sizeof(comment *) * COMMENT_HASHSLOTS);
-		if(comment_hashlist == NULL)
-			return 0;
-
-		for(i = 0; i < COMMENT_HASHSLOTS; i++)
-			comment_hashlist[i] = NULL;
-		}
-
-	if(!new_comment)
-		return 0;
-
-	hashslot = hashfunc(new_comment->host_name, NULL, COMMENT_HASHSLOTS);
-	lastpointer = NULL;
-	for(temp_comment = comment_hashlist[hashslot]; temp_comment && compare_hashdata(temp_comment->host_name, NULL, new_comment->host_name, NULL) < 0; temp_comment = temp_comment->nexthash) {
-		if(compare_hashdata(temp_comment->host_name, NULL, new_comment->host_name, NULL) >= 0)
-			break;
-		lastpointer = temp_comment;
-		}
-
-	/* multiples are allowed */
-	if(lastpointer)
-		lastpointer->nexthash = new_comment;
-	else
-		comment_hashlist[hashslot] = new_comment;
-	new_comment->nexthash = temp_comment;
-
-	return 1;
-	}
-
-
-
 /******************************************************************/
 /******************** ADDITION FUNCTIONS **************************/
 /******************************************************************/
@@ -429,8 +580,6 @@ int add_service_comment(int entry_type, char *host_name, char *svc_description,
 /* adds a comment to the list in memory */
 int add_comment(int comment_type, int entry_type, char *host_name, char *svc_description, time_t entry_time, char *author, char *comment_data, unsigned long comment_id, int persistent, int expires, time_t expire_time, int source) {
 	comment *new_comment = NULL;
-	comment *last_comment = NULL;
-	comment *temp_comment = NULL;
 	int result = OK;
 
 	/* make sure we have the data we need */
@@ -442,10 +591,10 @@ int add_comment(int comment_type, int entry_type, char *host_name, char *svc_des
 		return ERROR;
 
 	/* duplicate vars */
-	if((new_comment->host_name = (char *)strdup(host_name)) == NULL)
+	if((new_comment->host_name = (char *)intern_str(host_name)) == NULL)
 		result = ERROR;
 	if(comment_type == SERVICE_COMMENT) {
-		if((new_comment->service_description = (char *)strdup(svc_description)) == NULL)
+		if((new_comment->service_description = (char *)intern_str(svc_description)) == NULL)
 			result = ERROR;
 		}
 	if((new_comment->author = (char *)strdup(author)) == NULL)
@@ -462,9 +611,9 @@ int add_comment(int comment_type, int entry_type, char *host_name, char *svc_des
 	new_comment->expires = (expires == TRUE) ? TRUE : FALSE;
 	new_comment->expire_time = expire_time;
 
-	/* add comment to hash list */
+	/* add comment to the indexes */
 	if(result == OK) {
-		if(!add_comment_to_hashlist(new_comment))
+		if(comment_add_to_index(new_comment) != OK)
 			result = ERROR;
 		}
 
@@ -472,42 +621,35 @@ int add_comment(int comment_type, int entry_type, char *host_name, char *svc_des
 	if(result == ERROR) {
 		my_free(new_comment->comment_data);
 		my_free(new_comment->author);
-		my_free(new_comment->service_description);
-		my_free(new_comment->host_name);
+		intern_free(new_comment->service_description);
+		intern_free(new_comment->host_name);
 		my_free(new_comment);
 		return ERROR;
 		}
 
 	if(defer_comment_sorting) {
-		new_comment->next = comment_list;
-		comment_list = new_comment;
+		new_comment->next = comment_all.head;
+		if(comment_all.head != NULL)
+			comment_all.head->prev = new_comment;
+		else
+			comment_all.tail = new_comment;
+		comment_all.head = new_comment;
 		}
 	else {
 		/* add new comment to comment list, sorted by comment id */
-		last_comment = comment_list;
-		for(temp_comment = comment_list; temp_comment != NULL; temp_comment = temp_comment->next) {
-			if(new_comment->comment_id < temp_comment->comment_id) {
-				new_comment->next = temp_comment;
-				if(temp_comment == comment_list)
-					comment_list = new_comment;
-				else
-					last_comment->next = new_comment;
-				break;
-				}
-			else
-				last_comment = temp_comment;
-			}
-		if(comment_list == NULL) {
-			new_comment->next = NULL;
-			comment_list = new_comment;
-			}
-		else if(temp_comment == NULL) {
-			new_comment->next = NULL;
-			last_comment->next = new_comment;
-			}
+		comment_chain_link(&comment_all, new_comment, COMMENT_LINK_LIST);
 		}
+	comment_list = comment_all.head;
 
 #ifdef NSCORE
+	/*
+	 * add an event to expire comment data if necessary. This also covers
+	 * comments read from retention data. Events may run a little early,
+	 * so make sure it's really expired by the time it runs.
+	 */
+	if(new_comment->expires == TRUE)
+		schedule_new_event(EVENT_EXPIRE_COMMENT, FALSE, expire_time + 1, FALSE, 0, NULL, TRUE, (void *)comment_id, NULL, 0);
+
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker */
 	broker_comment_data(NEBTYPE_COMMENT_LOAD, NEBFLAG_NONE, NEBATTR_NONE, comment_type, entry_type, host_name, svc_description, entry_time, author, comment_data, persistent, source, expires, expire_time, comment_id, NULL);
@@ -549,11 +691,15 @@ int sort_comments(void) {
 
 	qsort((void *)array, i, sizeof(*array), comment_compar);
 	comment_list = temp_comment = array[0];
+	temp_comment->prev = NULL;
 	for(i = 1; i < unsorted_comments; i++) {
 		temp_comment->next = array[i];
+		array[i]->prev = temp_comment;
 		temp_comment = temp_comment->next;
 		}
 	temp_comment->next = NULL;
+	comment_all.head = comment_list;
+	comment_all.tail = temp_comment;
 	my_free(array);
 	return OK;
 	}
@@ -570,16 +716,27 @@ void free_comment_data(void) {
 	/* free memory for the comment list */
 	for(this_comment = comment_list; this_comment != NULL; this_comment = next_comment) {
 		next_comment = this_comment->next;
-		my_free(this_comment->host_name);
-		my_free(this_comment->service_description);
+		intern_free(this_comment->host_name);
+		intern_free(this_comment->service_description);
 		my_free(this_comment->author);
 		my_free(this_comment->comment_data);
 		my_free(this_comment);
 		}
 
-	/* free hash list and reset list pointer */
-	my_free(comment_hashlist);
-	comment_hashlist = NULL;
+	/* free the indexes and reset list pointer */
+	my_free(comment_id_hash);
+	comment_id_hash_size = comment_id_hash_entries = 0;
+	if(comment_host_table != NULL) {
+		dkhash_walk_data(comment_host_table, comment_chain_walk_free);
+		dkhash_destroy(comment_host_table);
+		comment_host_table = NULL;
+		}
+	if(comment_obj_table != NULL) {
+		dkhash_walk_data(comment_obj_table, comment_chain_walk_free);
+		dkhash_destroy(comment_obj_table);
+		comment_obj_table = NULL;
+		}
+	comment_all.head = comment_all.tail = NULL;
 	comment_list = NULL;
 
 	return;
@@ -600,10 +757,8 @@ int number_of_host_comments(char *host_name) {
 	if(host_name == NULL)
 		return 0;
 
-	for(temp_comment = get_first_comment_by_host(host_name); temp_comment != NULL; temp_comment = get_next_comment_by_host(host_name, temp_comment)) {
-		if(temp_comment->comment_type == HOST_COMMENT)
-			total_comments++;
-		}
+	for(temp_comment = get_first_comment_by_object(host_name, NULL); temp_comment != NULL; temp_comment = temp_comment->obj_next)
+		total_comments++;
 
 	return total_comments;
 	}
@@ -617,10 +772,8 @@ int number_of_service_comments(char *host_name, char *svc_description) {
 	if(host_name == NULL || svc_description == NULL)
 		return 0;
 
-	for(temp_comment = get_first_comment_by_host(host_name); temp_comment != NULL; temp_comment = get_next_comment_by_host(host_name, temp_comment)) {
-		if(temp_comment->comment_type == SERVICE_COMMENT && !strcmp(temp_comment->service_description, svc_description))
-			total_comments++;
-		}
+	for(temp_comment = get_first_comment_by_object(host_name, svc_description); temp_comment != NULL; temp_comment = temp_comment->obj_next)
+		total_comments++;
 
 	return total_comments;
 	}
@@ -631,29 +784,34 @@ int number_of_service_comments(char *host_name, char *svc_description) {
 /********************* TRAVERSAL FUNCTIONS ************************/
 /******************************************************************/
 
+/* host and service comments for a host, oldest first */
 comment *get_first_comment_by_host(char *host_name) {
+	struct comment_chain *chain;
+
+	if((chain = comment_chain_get(&comment_host_table, host_name, NULL, FALSE)) == NULL)
+		return NULL;
 
-	return get_next_comment_by_host(host_name, NULL);
+	return chain->head;
 	}
 
 
 comment *get_next_comment_by_host(char *host_name, comment *start) {
-	comment *temp_comment = NULL;
-
-	if(host_name == NULL || comment_hashlist == NULL)
-		return NULL;
 
 	if(start == NULL)
-		temp_comment = comment_hashlist[hashfunc(host_name, NULL, COMMENT_HASHSLOTS)];
-	else
-		temp_comment = start->nexthash;
+		return get_first_comment_by_host(host_name);
 
-	for(; temp_comment && compare_hashdata(temp_comment->host_name, NULL, host_name, NULL) < 0; temp_comment = temp_comment->nexthash);
+	return start->nexthash;
+	}
 
-	if(temp_comment && compare_hashdata(temp_comment->host_name, NULL, host_name, NULL) == 0)
-		return temp_comment;
 
-	return NULL;
+/* comments for just a host (svc_description is NULL) or a service, oldest first */
+comment *get_first_comment_by_object(const char *host_name, const char *svc_description) {
+	struct comment_chain *chain;
+
+	if((chain = comment_chain_get(&comment_obj_table, host_name, svc_description, FALSE)) == NULL)
+		return NULL;
+
+	return chain->head;
 	}
 
 
@@ -680,10 +838,8 @@ comment *find_host_comment(unsigned long comment_id) {
 comment *find_comment(unsigned long comment_id, int comment_type) {
 	comment *temp_comment = NULL;
 
-	for(temp_comment = comment_list; temp_comment != NULL; temp_comment = temp_comment->next) {
-		if(temp_comment->comment_id == comment_id && temp_comment->comment_type == comment_type)
-			return temp_comment;
-		}
+	if((temp_comment = comment_id_hash_get(comment_id)) != NULL && temp_comment->comment_type == comment_type)
+		return temp_comment;
 
 	return NULL;
 	}
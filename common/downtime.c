@@ -51,10 +51,223 @@ int		   defer_downtime_sorting = 0;
 extern squeue_t *nagios_squeue;
 #endif
 
+/*
+ * scheduled_downtime_list stays sorted by start time for everyone who
+ * walks it, but with 100k+ entries during large maintenance windows
+ * we can't afford to walk it for every lookup, so we also keep:
+ *  - a hash on the downtime id, for find_downtime()
+ *  - a list of downtime per host and service, found through a dkhash
+ *    on the (interned) names, so starting flexible downtime for an
+ *    object only looks at that object's own entries
+ *  - a skiplist ordered by start time, so new entries find their
+ *    place in the list without walking it
+ * Nothing walks the list to find downtime that should start, stop or
+ * expire either. In the core, each entry has an event for its start
+ * and one for whichever of its end or its expiry comes next.
+ */
+static scheduled_downtime **downtime_id_hash;
+static unsigned int downtime_id_hash_size, downtime_id_hash_entries;
+static dkhash_table *downtime_obj_table;
+static skiplist *downtime_start_index;
+static scheduled_downtime *scheduled_downtime_tail;
+
+/* ids are handed out sequentially, so the low bits spread them evenly */
+#define downtime_id_slot(id) ((id) & (downtime_id_hash_size - 1))
+
+static int downtime_id_hash_add(scheduled_downtime *dt) {
+	scheduled_downtime **new_hash, *temp_downtime, *next_downtime;
+	unsigned int i, new_size, slot;
+
+	if(downtime_id_hash_entries >= downtime_id_hash_size) {
+		new_size = downtime_id_hash_size ? downtime_id_hash_size * 2 : 1024;
+		if((new_hash = (scheduled_downtime **)calloc(new_size, sizeof(*new_hash))) == NULL)
+			return ERROR;
+		for(i = 0; i < downtime_id_hash_size; i++) {
+			for(temp_downtime = downtime_id_hash[i]; temp_downtime != NULL; temp_downtime = next_downtime) {
+				next_downtime = temp_downtime->id_next;
+				slot = temp_downtime->downtime_id & (new_size - 1);
+				temp_downtime->id_next = new_hash[slot];
+				new_hash[slot] = temp_downtime;
+				}
+			}
+		my_free(downtime_id_hash);
+		downtime_id_hash = new_hash;
+		downtime_id_hash_size = new_size;
+		}
+
+	slot = downtime_id_slot(dt->downtime_id);
+	dt->id_next = downtime_id_hash[slot];
+	downtime_id_hash[slot] = dt;
+	downtime_id_hash_entries++;
+
+	return OK;
+	}
+
+static int downtime_obj_add(scheduled_downtime *dt) {
+	scheduled_downtime *head;
+
+	if(downtime_obj_table == NULL && (downtime_obj_table = dkhash_create(1024)) == NULL)
+		return ERROR;
+
+	/* new entries go first, so the table needs to point to them */
+	if((head = dkhash_remove(downtime_obj_table, dt->host_name, dt->service_description)) != NULL)
+		head->obj_prev = dt;
+	dt->obj_next = head;
+	dt->obj_prev = NULL;
+
+	return dkhash_insert(downtime_obj_table, dt->host_name, dt->service_description, dt) == DKHASH_OK ? OK : ERROR;
+	}
+
+/* ties are broken by id, so every entry has a place of its own */
+static int downtime_start_compare(void *a, void *b) {
+	scheduled_downtime *d1 = (scheduled_downtime *)a;
+	scheduled_downtime *d2 = (scheduled_downtime *)b;
 
+	if(d1->start_time != d2->start_time)
+		return d1->start_time < d2->start_time ? -1 : 1;
+	if(d1->downtime_id != d2->downtime_id)
+		return d1->downtime_id < d2->downtime_id ? -1 : 1;
+	return 0;
+	}
+
+static int downtime_start_add(scheduled_downtime *dt) {
+
+	if(downtime_start_index == NULL && (downtime_start_index = skiplist_new(20, 0.5, TRUE, FALSE, downtime_start_compare)) == NULL)
+		return ERROR;
+
+	return skiplist_insert(downtime_start_index, dt) == SKIPLIST_OK ? OK : ERROR;
+	}
+
+/* links a new entry into scheduled_downtime_list, sorted by start time */
+static void downtime_list_add(scheduled_downtime *dt) {
+	scheduled_downtime *temp_downtime = NULL;
+	void *node = NULL;
+
+	/* the entry that follows it in the index follows it in the list, if they're all in it */
+	if(skiplist_num_items(downtime_start_index) == downtime_id_hash_entries && downtime_start_add(dt) == OK) {
+		if(skiplist_find_first(downtime_start_index, dt, &node) != NULL)
+			temp_downtime = (scheduled_downtime *)skiplist_get_next(&node);
+		}
+
+	/* fall back to walking the list if the index failed us */
+	else {
+		for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
+			if(dt->start_time < temp_downtime->start_time)
+				break;
+			}
+		}
+
+	dt->next = temp_downtime;
+	if(temp_downtime == NULL) {
+		dt->prev = scheduled_downtime_tail;
+		scheduled_downtime_tail = dt;
+		}
+	else {
+		dt->prev = temp_downtime->prev;
+		temp_downtime->prev = dt;
+		}
+	if(dt->prev == NULL)
+		scheduled_downtime_list = dt;
+	else
+		dt->prev->next = dt;
+	}
 
 #ifdef NSCORE
+/* the first downtime entry of a host or service */
+static scheduled_downtime *downtime_obj_head(const char *host_name, const char *svc_description) {
+
+	return (scheduled_downtime *)dkhash_get(downtime_obj_table, host_name, svc_description);
+	}
 
+static void downtime_id_hash_remove(scheduled_downtime *dt) {
+	scheduled_downtime **link;
+
+	if(downtime_id_hash == NULL)
+		return;
+
+	for(link = &downtime_id_hash[downtime_id_slot(dt->downtime_id)]; *link != NULL; link = &(*link)->id_next) {
+		if(*link == dt) {
+			*link = dt->id_next;
+			dt->id_next = NULL;
+			downtime_id_hash_entries--;
+			return;
+			}
+		}
+	}
+
+static void downtime_obj_remove(scheduled_downtime *dt) {
+
+	if(dt->obj_next != NULL)
+		dt->obj_next->obj_prev = dt->obj_prev;
+	if(dt->obj_prev != NULL)
+		dt->obj_prev->obj_next = dt->obj_next;
+	else {
+		dkhash_remove(downtime_obj_table, dt->host_name, dt->service_description);
+		if(dt->obj_next != NULL)
+			dkhash_insert(downtime_obj_table, dt->obj_next->host_name, dt->obj_next->service_description, dt->obj_next);
+		}
+	dt->obj_next = dt->obj_prev = NULL;
+	}
+
+static void downtime_index_remove(scheduled_downtime *dt) {
+
+	downtime_id_hash_remove(dt);
+	downtime_obj_remove(dt);
+	if(downtime_start_index != NULL)
+		skiplist_delete_first(downtime_start_index, dt);
+	}
+
+/* schedules an event for a downtime entry, which gets its id */
+static timed_event *downtime_schedule_event(int event_type, scheduled_downtime *dt, time_t run_time) {
+	unsigned long *event_data = NULL;
+	timed_event *new_event = NULL;
+
+	if((event_data = (unsigned long *)malloc(sizeof(unsigned long))) == NULL)
+		return NULL;
+	*event_data = dt->downtime_id;
+
+	if((new_event = schedule_new_event(event_type, TRUE, run_time, FALSE, 0, NULL, FALSE, (void *)event_data, NULL, 0)) == NULL)
+		my_free(event_data);
+
+	return new_event;
+	}
+
+/* removes an event that hasn't run yet */
+static void downtime_remove_event(timed_event **event) {
+
+	if(*event == NULL)
+		return;
+
+	remove_event(nagios_squeue, *event);
+	my_free((*event)->event_data);
+	my_free(*event);
+	}
+#endif
+
+/* hooks a new entry, already linked into scheduled_downtime_list, into the indexes */
+static int downtime_index_add(scheduled_downtime *dt) {
+	int result = OK;
+
+	if(downtime_id_hash_add(dt) != OK)
+		result = ERROR;
+	if(downtime_obj_add(dt) != OK)
+		result = ERROR;
+
+	return result;
+	}
+
+static void downtime_index_free(void) {
+
+	my_free(downtime_id_hash);
+	downtime_id_hash_size = downtime_id_hash_entries = 0;
+	dkhash_destroy(downtime_obj_table);
+	downtime_obj_table = NULL;
+	skiplist_free(&downtime_start_index);
+	scheduled_downtime_tail = NULL;
+	}
+
+
+#ifdef NSCORE
 /******************************************************************/
 /**************** INITIALIZATION/CLEANUP FUNCTIONS ****************/
 /******************************************************************/
@@ -184,16 +397,6 @@ int unschedule_downtime(int type, unsigned long downtime_id) {
 			}
 		}
 
-	/* remove scheduled entries from event queue */
-	if (temp_downtime->start_event) {
-		remove_event(nagios_squeue, temp_downtime->start_event);
-		my_free(temp_downtime->start_event);
-		}
-	if (temp_downtime->stop_event) {
-		remove_event(nagios_squeue, temp_downtime->stop_event);
-		my_free(temp_downtime->stop_event);
-		}
-
 	/* delete downtime entry */
 	if(temp_downtime->type == HOST_DOWNTIME)
 		delete_host_downtime(downtime_id);
@@ -237,7 +440,6 @@ int register_downtime(int type, unsigned long downtime_id) {
 	int hours = 0;
 	int minutes = 0;
 	int seconds = 0;
-	unsigned long *new_downtime_id = NULL;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "register_downtime()\n");
 
@@ -301,12 +503,12 @@ int register_downtime(int type, unsigned long downtime_id) {
 	/*** SCHEDULE DOWNTIME - FLEXIBLE (NON-FIXED) DOWNTIME IS HANDLED AT A LATER POINT ***/
 
 	/* only non-triggered downtime is scheduled... */
-	if(temp_downtime->triggered_by == 0) {
-		if((new_downtime_id = (unsigned long *)malloc(sizeof(unsigned long *)))) {
-			*new_downtime_id = downtime_id;
-			temp_downtime->start_event = schedule_new_event(EVENT_SCHEDULED_DOWNTIME, TRUE, temp_downtime->start_time, FALSE, 0, NULL, FALSE, (void *)new_downtime_id, NULL, 0);
-			}
-		}
+	if(temp_downtime->triggered_by == 0)
+		temp_downtime->start_event = downtime_schedule_event(EVENT_SCHEDULED_DOWNTIME, temp_downtime, temp_downtime->start_time);
+
+	/* ...but anything that isn't in effect by the end of its window expires then */
+	if(temp_downtime->is_in_effect == FALSE)
+		temp_downtime->stop_event = downtime_schedule_event(EVENT_EXPIRE_DOWNTIME, temp_downtime, temp_downtime->end_time + 1);
 
 #ifdef PROBABLY_NOT_NEEDED
 	/*** FLEXIBLE DOWNTIME SANITY CHECK - ADDED 02/17/2008 ****/
@@ -334,12 +536,112 @@ int handle_scheduled_downtime_by_id(unsigned long downtime_id) {
 	if((temp_downtime = find_downtime(ANY_DOWNTIME, downtime_id)) == NULL)
 		return ERROR;
 
+	/* the event that got us here is freed by the event loop */
+	temp_downtime->start_event = NULL;
+
 	/* handle the downtime */
 	return handle_scheduled_downtime(temp_downtime);
 	}
 
 
 
+/* ends downtime that is in effect */
+static int stop_scheduled_downtime(scheduled_downtime *temp_downtime) {
+	scheduled_downtime *this_downtime = NULL;
+	host *hst = NULL;
+	service *svc = NULL;
+#ifdef USE_EVENT_BROKER
+	int attr = 0;
+#endif
+
+	/* find the host or service associated with this downtime */
+	if(temp_downtime->type == HOST_DOWNTIME) {
+		if((hst = find_host(temp_downtime->host_name)) == NULL)
+			return ERROR;
+		}
+	else {
+		if((svc = find_service(temp_downtime->host_name, temp_downtime->service_description)) == NULL)
+			return ERROR;
+		}
+
+#ifdef USE_EVENT_BROKER
+	/* send data to event broker */
+	attr = NEBATTR_DOWNTIME_STOP_NORMAL;
+	broker_downtime_data(NEBTYPE_DOWNTIME_STOP, NEBFLAG_NONE, attr, temp_downtime->type, temp_downtime->host_name, temp_downtime->service_description, temp_downtime->entry_time, temp_downtime->author, temp_downtime->comment, temp_downtime->start_time, temp_downtime->end_time, temp_downtime->fixed, temp_downtime->triggered_by, temp_downtime->duration, temp_downtime->downtime_id, NULL);
+#endif
+
+	/* decrement the downtime depth variable */
+	if(temp_downtime->type == HOST_DOWNTIME)
+		hst->scheduled_downtime_depth--;
+	else
+		svc->scheduled_downtime_depth--;
+
+	if(temp_downtime->type == HOST_DOWNTIME && hst->scheduled_downtime_depth == 0) {
+
+		log_debug_info(DEBUGL_DOWNTIME, 0, "Host '%s' has exited from a period of scheduled downtime (id=%lu).\n", hst->name, temp_downtime->downtime_id);
+
+		/* log a notice - this one is parsed by the history CGI */
+		logit(NSLOG_INFO_MESSAGE, FALSE, "HOST DOWNTIME ALERT: %s;STOPPED; Host has exited from a period of scheduled downtime", hst->name);
+
+		/* send a notification */
+		host_notification(hst, NOTIFICATION_DOWNTIMEEND, temp_downtime->author, temp_downtime->comment, NOTIFICATION_OPTION_NONE);
+		}
+
+	else if(temp_downtime->type == SERVICE_DOWNTIME && svc->scheduled_downtime_depth == 0) {
+
+		log_debug_info(DEBUGL_DOWNTIME, 0, "Service '%s' on host '%s' has exited from a period of scheduled downtime (id=%lu).\n", svc->description, svc->host_name, temp_downtime->downtime_id);
+
+		/* log a notice - this one is parsed by the history CGI */
+		logit(NSLOG_INFO_MESSAGE, FALSE, "SERVICE DOWNTIME ALERT: %s;%s;STOPPED; Service has exited from a period of scheduled downtime", svc->host_name, svc->description);
+
+		/* send a notification */
+		service_notification(svc, NOTIFICATION_DOWNTIMEEND, temp_downtime->author, temp_downtime->comment, NOTIFICATION_OPTION_NONE);
+		}
+
+
+	/* update the status data */
+	if(temp_downtime->type == HOST_DOWNTIME)
+		update_host_status(hst, FALSE);
+	else
+		update_service_status(svc, FALSE);
+
+	/* decrement pending flex downtime if necessary */
+	if(temp_downtime->fixed == FALSE && temp_downtime->incremented_pending_downtime == TRUE) {
+		if(temp_downtime->type == HOST_DOWNTIME) {
+			if(hst->pending_flex_downtime > 0)
+				hst->pending_flex_downtime--;
+			}
+		else {
+			if(svc->pending_flex_downtime > 0)
+				svc->pending_flex_downtime--;
+			}
+		}
+
+	/* handle (stop) downtime that is triggered by this one */
+	while(1) {
+
+		/* list contents might change by recursive calls, so we use this inefficient method to prevent segfaults */
+		for(this_downtime = scheduled_downtime_list; this_downtime != NULL; this_downtime = this_downtime->next) {
+			if(this_downtime->triggered_by == temp_downtime->downtime_id) {
+				handle_scheduled_downtime(this_downtime);
+				break;
+				}
+			}
+
+		if(this_downtime == NULL)
+			break;
+		}
+
+	/* delete downtime entry */
+	if(temp_downtime->type == HOST_DOWNTIME)
+		delete_host_downtime(temp_downtime->downtime_id);
+	else
+		delete_service_downtime(temp_downtime->downtime_id);
+
+	return OK;
+	}
+
+
 /* handles scheduled host or service downtime */
 int handle_scheduled_downtime(scheduled_downtime *temp_downtime) {
 	scheduled_downtime *this_downtime = NULL;
@@ -347,10 +649,6 @@ int handle_scheduled_downtime(scheduled_downtime *temp_downtime) {
 	service *svc = NULL;
 	time_t event_time = 0L;
 	time_t current_time = 0L;
-	unsigned long *new_downtime_id = NULL;
-#ifdef USE_EVENT_BROKER
-	int attr = 0;
-#endif
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "handle_scheduled_downtime()\n");
@@ -387,16 +685,22 @@ int handle_scheduled_downtime(scheduled_downtime *temp_downtime) {
 
 				/*** SINCE THE FLEX DOWNTIME MAY NEVER START, WE HAVE TO PROVIDE A WAY OF EXPIRING UNUSED DOWNTIME... ***/
 
-				temp_downtime->stop_event = schedule_new_event(EVENT_EXPIRE_DOWNTIME, TRUE, (temp_downtime->end_time + 1), FALSE, 0, NULL, FALSE, NULL, NULL, 0);
+				/* register_downtime() normally took care of that already */
+				if(temp_downtime->stop_event == NULL)
+					temp_downtime->stop_event = downtime_schedule_event(EVENT_EXPIRE_DOWNTIME, temp_downtime, temp_downtime->end_time + 1);
 
 				return OK;
 				}
 			}
 		}
 
-	/* if downtime handler gets triggerd in between then there seems to be a restart */
+	/*
+	 * if downtime handler gets triggerd in between then there seems to be a restart.
+	 * Downtime we've started ourselves always has its end scheduled, so this
+	 * only ever applies to downtime that was in effect when we were restarted.
+	 */
 	time(&current_time);
-	if(temp_downtime->start_time < current_time && current_time < temp_downtime->end_time && temp_downtime->is_in_effect == TRUE) {
+	if(temp_downtime->start_time < current_time && current_time < temp_downtime->end_time && temp_downtime->is_in_effect == TRUE && temp_downtime->stop_event == NULL) {
 #ifdef USE_EVENT_BROKER
 		/* send data to event broker */
 		broker_downtime_data(NEBTYPE_DOWNTIME_START, NEBFLAG_NONE, NEBATTR_NONE, temp_downtime->type, temp_downtime->host_name, temp_downtime->service_description, temp_downtime->entry_time, temp_downtime->author, temp_downtime->comment, temp_downtime->start_time, temp_downtime->end_time, temp_downtime->fixed, temp_downtime->triggered_by, temp_downtime->duration, temp_downtime->downtime_id, NULL);
@@ -417,90 +721,13 @@ int handle_scheduled_downtime(scheduled_downtime *temp_downtime) {
 			event_time = (time_t)((unsigned long)time(NULL) + temp_downtime->duration);
 		else
 			event_time = temp_downtime->end_time;
-		if((new_downtime_id = (unsigned long *)malloc(sizeof(unsigned long)))) {
-			*new_downtime_id = temp_downtime->downtime_id;
-			schedule_new_event(EVENT_SCHEDULED_DOWNTIME, TRUE, event_time, FALSE, 0, NULL, FALSE, (void *)new_downtime_id, NULL, 0);
-			}
+		temp_downtime->stop_event = downtime_schedule_event(EVENT_EXPIRE_DOWNTIME, temp_downtime, event_time);
 		return OK;
 		}
 
 	/* have we come to the end of the scheduled downtime? */
-	if(temp_downtime->is_in_effect == TRUE) {
-
-#ifdef USE_EVENT_BROKER
-		/* send data to event broker */
-		attr = NEBATTR_DOWNTIME_STOP_NORMAL;
-		broker_downtime_data(NEBTYPE_DOWNTIME_STOP, NEBFLAG_NONE, attr, temp_downtime->type, temp_downtime->host_name, temp_downtime->service_description, temp_downtime->entry_time, temp_downtime->author, temp_downtime->comment, temp_downtime->start_time, temp_downtime->end_time, temp_downtime->fixed, temp_downtime->triggered_by, temp_downtime->duration, temp_downtime->downtime_id, NULL);
-#endif
-
-		/* decrement the downtime depth variable */
-		if(temp_downtime->type == HOST_DOWNTIME)
-			hst->scheduled_downtime_depth--;
-		else
-			svc->scheduled_downtime_depth--;
-
-		if(temp_downtime->type == HOST_DOWNTIME && hst->scheduled_downtime_depth == 0) {
-
-			log_debug_info(DEBUGL_DOWNTIME, 0, "Host '%s' has exited from a period of scheduled downtime (id=%lu).\n", hst->name, temp_downtime->downtime_id);
-
-			/* log a notice - this one is parsed by the history CGI */
-			logit(NSLOG_INFO_MESSAGE, FALSE, "HOST DOWNTIME ALERT: %s;STOPPED; Host has exited from a period of scheduled downtime", hst->name);
-
-			/* send a notification */
-			host_notification(hst, NOTIFICATION_DOWNTIMEEND, temp_downtime->author, temp_downtime->comment, NOTIFICATION_OPTION_NONE);
-			}
-
-		else if(temp_downtime->type == SERVICE_DOWNTIME && svc->scheduled_downtime_depth == 0) {
-
-			log_debug_info(DEBUGL_DOWNTIME, 0, "Service '%s' on host '%s' has exited from a period of scheduled downtime (id=%lu).\n", svc->description, svc->host_name, temp_downtime->downtime_id);
-
-			/* log a notice - this one is parsed by the history CGI */
-			logit(NSLOG_INFO_MESSAGE, FALSE, "SERVICE DOWNTIME ALERT: %s;%s;STOPPED; Service has exited from a period of scheduled downtime", svc->host_name, svc->description);
-
-			/* send a notification */
-			service_notification(svc, NOTIFICATION_DOWNTIMEEND, temp_downtime->author, temp_downtime->comment, NOTIFICATION_OPTION_NONE);
-			}
-
-
-		/* update the status data */
-		if(temp_downtime->type == HOST_DOWNTIME)
-			update_host_status(hst, FALSE);
-		else
-			update_service_status(svc, FALSE);
-
-		/* decrement pending flex downtime if necessary */
-		if(temp_downtime->fixed == FALSE && temp_downtime->incremented_pending_downtime == TRUE) {
-			if(temp_downtime->type == HOST_DOWNTIME) {
-				if(hst->pending_flex_downtime > 0)
-					hst->pending_flex_downtime--;
-				}
-			else {
-				if(svc->pending_flex_downtime > 0)
-					svc->pending_flex_downtime--;
-				}
-			}
-
-		/* handle (stop) downtime that is triggered by this one */
-		while(1) {
-
-			/* list contents might change by recursive calls, so we use this inefficient method to prevent segfaults */
-			for(this_downtime = scheduled_downtime_list; this_downtime != NULL; this_downtime = this_downtime->next) {
-				if(this_downtime->triggered_by == temp_downtime->downtime_id) {
-					handle_scheduled_downtime(this_downtime);
-					break;
-					}
-				}
-
-			if(this_downtime == NULL)
-				break;
-			}
-
-		/* delete downtime entry */
-		if(temp_downtime->type == HOST_DOWNTIME)
-			delete_host_downtime(temp_downtime->downtime_id);
-		else
-			delete_service_downtime(temp_downtime->downtime_id);
-		}
+	if(temp_downtime->is_in_effect == TRUE)
+		return stop_scheduled_downtime(temp_downtime);
 
 	/* else we are just starting the scheduled downtime */
 	else {
@@ -547,15 +774,16 @@ int handle_scheduled_downtime(scheduled_downtime *temp_downtime) {
 		else
 			update_service_status(svc, FALSE);
 
+		/* flexible downtime may start before its start event runs, and nothing expires once started */
+		downtime_remove_event(&temp_downtime->start_event);
+		downtime_remove_event(&temp_downtime->stop_event);
+
 		/* schedule an event */
 		if(temp_downtime->fixed == FALSE)
 			event_time = (time_t)((unsigned long)time(NULL) + temp_downtime->duration);
 		else
 			event_time = temp_downtime->end_time;
-		if((new_downtime_id = (unsigned long *)malloc(sizeof(unsigned long *)))) {
-			*new_downtime_id = temp_downtime->downtime_id;
-			schedule_new_event(EVENT_SCHEDULED_DOWNTIME, TRUE, event_time, FALSE, 0, NULL, FALSE, (void *)new_downtime_id, NULL, 0);
-			}
+		temp_downtime->stop_event = downtime_schedule_event(EVENT_EXPIRE_DOWNTIME, temp_downtime, event_time);
 
 		/* handle (start) downtime that is triggered by this one */
 		for(this_downtime = scheduled_downtime_list; this_downtime != NULL; this_downtime = this_downtime->next) {
@@ -572,6 +800,7 @@ int handle_scheduled_downtime(scheduled_downtime *temp_downtime) {
 /* checks for flexible (non-fixed) host downtime that should start now */
 int check_pending_flex_host_downtime(host *hst) {
 	scheduled_downtime *temp_downtime = NULL;
+	scheduled_downtime *next_downtime = NULL;
 	time_t current_time = 0L;
 
 
@@ -586,8 +815,9 @@ int check_pending_flex_host_downtime(host *hst) {
 	if(hst->current_state == HOST_UP)
 		return OK;
 
-	/* check all downtime entries */
-	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
+	/* check all downtime entries for this host */
+	for(temp_downtime = downtime_obj_head(hst->name, NULL); temp_downtime != NULL; temp_downtime = next_downtime) {
+		next_downtime = temp_downtime->obj_next;
 
 		if(temp_downtime->type != HOST_DOWNTIME)
 			continue;
@@ -602,17 +832,13 @@ int check_pending_flex_host_downtime(host *hst) {
 		if(temp_downtime->triggered_by != 0)
 			continue;
 
-		/* this entry matches our host! */
-		if(find_host(temp_downtime->host_name) == hst) {
+		/* if the time boundaries are okay, start this scheduled downtime */
+		if(temp_downtime->start_time <= current_time && current_time <= temp_downtime->end_time) {
 
-			/* if the time boundaries are okay, start this scheduled downtime */
-			if(temp_downtime->start_time <= current_time && current_time <= temp_downtime->end_time) {
+			log_debug_info(DEBUGL_DOWNTIME, 0, "Flexible downtime (id=%lu) for host '%s' starting now...\n", temp_downtime->downtime_id, hst->name);
 
-				log_debug_info(DEBUGL_DOWNTIME, 0, "Flexible downtime (id=%lu) for host '%s' starting now...\n", temp_downtime->downtime_id, hst->name);
-
-				temp_downtime->start_flex_downtime = TRUE;
-				handle_scheduled_downtime(temp_downtime);
-				}
+			temp_downtime->start_flex_downtime = TRUE;
+			handle_scheduled_downtime(temp_downtime);
 			}
 		}
 
@@ -623,6 +849,7 @@ int check_pending_flex_host_downtime(host *hst) {
 /* checks for flexible (non-fixed) service downtime that should start now */
 int check_pending_flex_service_downtime(service *svc) {
 	scheduled_downtime *temp_downtime = NULL;
+	scheduled_downtime *next_downtime = NULL;
 	time_t current_time = 0L;
 
 
@@ -637,8 +864,9 @@ int check_pending_flex_service_downtime(service *svc) {
 	if(svc->current_state == STATE_OK)
 		return OK;
 
-	/* check all downtime entries */
-	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
+	/* check all downtime entries for this service */
+	for(temp_downtime = downtime_obj_head(svc->host_name, svc->description); temp_downtime != NULL; temp_downtime = next_downtime) {
+		next_downtime = temp_downtime->obj_next;
 
 		if(temp_downtime->type != SERVICE_DOWNTIME)
 			continue;
@@ -653,17 +881,13 @@ int check_pending_flex_service_downtime(service *svc) {
 		if(temp_downtime->triggered_by != 0)
 			continue;
 
-		/* this entry matches our service! */
-		if(find_service(temp_downtime->host_name, temp_downtime->service_description) == svc) {
-
-			/* if the time boundaries are okay, start this scheduled downtime */
-			if(temp_downtime->start_time <= current_time && current_time <= temp_downtime->end_time) {
+		/* if the time boundaries are okay, start this scheduled downtime */
+		if(temp_downtime->start_time <= current_time && current_time <= temp_downtime->end_time) {
 
-				log_debug_info(DEBUGL_DOWNTIME, 0, "Flexible downtime (id=%lu) for service '%s' on host '%s' starting now...\n", temp_downtime->downtime_id, svc->description, svc->host_name);
+			log_debug_info(DEBUGL_DOWNTIME, 0, "Flexible downtime (id=%lu) for service '%s' on host '%s' starting now...\n", temp_downtime->downtime_id, svc->description, svc->host_name);
 
-				temp_downtime->start_flex_downtime = TRUE;
-				handle_scheduled_downtime(temp_downtime);
-				}
+			temp_downtime->start_flex_downtime = TRUE;
+			handle_scheduled_downtime(temp_downtime);
 			}
 		}
 
@@ -671,35 +895,47 @@ int check_pending_flex_service_downtime(service *svc) {
 	}
 
 
-/* checks for (and removes) expired downtime entries */
-int check_for_expired_downtime(void) {
+/* ends or expires a downtime entry (id passed from timed event queue) */
+int check_for_expired_downtime(unsigned long downtime_id) {
 	scheduled_downtime *temp_downtime = NULL;
-	scheduled_downtime *next_downtime = NULL;
-	time_t current_time = 0L;
+	host *hst = NULL;
+	service *svc = NULL;
 
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "check_for_expired_downtime()\n");
 
-	time(&current_time);
-
-	/* check all downtime entries... */
-	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = next_downtime) {
+	/* it may have been deleted already */
+	if((temp_downtime = find_downtime(ANY_DOWNTIME, downtime_id)) == NULL)
+		return OK;
 
-		next_downtime = temp_downtime->next;
+	/* the event that got us here is freed by the event loop */
+	temp_downtime->stop_event = NULL;
 
-		/* this entry should be removed */
-		if(temp_downtime->is_in_effect == FALSE && temp_downtime->end_time < current_time) {
+	/* downtime that is in effect has come to its end */
+	if(temp_downtime->is_in_effect == TRUE)
+		return stop_scheduled_downtime(temp_downtime);
 
-			log_debug_info(DEBUGL_DOWNTIME, 0, "Expiring %s downtime (id=%lu)...\n", (temp_downtime->type == HOST_DOWNTIME) ? "host" : "service", temp_downtime->downtime_id);
+	/* the rest never took effect, so it should be removed */
+	log_debug_info(DEBUGL_DOWNTIME, 0, "Expiring %s downtime (id=%lu)...\n", (temp_downtime->type == HOST_DOWNTIME) ? "host" : "service", temp_downtime->downtime_id);
 
-			/* delete the downtime entry */
-			if(temp_downtime->type == HOST_DOWNTIME)
-				delete_host_downtime(temp_downtime->downtime_id);
-			else
-				delete_service_downtime(temp_downtime->downtime_id);
+	/* flexible downtime that never started is no longer pending */
+	if(temp_downtime->incremented_pending_downtime == TRUE) {
+		if(temp_downtime->type == HOST_DOWNTIME) {
+			if((hst = find_host(temp_downtime->host_name)) != NULL && hst->pending_flex_downtime > 0)
+				hst->pending_flex_downtime--;
+			}
+		else {
+			if((svc = find_service(temp_downtime->host_name, temp_downtime->service_description)) != NULL && svc->pending_flex_downtime > 0)
+				svc->pending_flex_downtime--;
 			}
 		}
 
+	/* delete the downtime entry */
+	if(temp_downtime->type == HOST_DOWNTIME)
+		delete_host_downtime(temp_downtime->downtime_id);
+	else
+		delete_service_downtime(temp_downtime->downtime_id);
+
 	return OK;
 	}
 
@@ -785,19 +1021,9 @@ int add_new_service_downtime(char *host_name, char *service_description, time_t
 int delete_downtime(int type, unsigned long downtime_id) {
 	int result = OK;
 	scheduled_downtime *this_downtime = NULL;
-	scheduled_downtime *last_downtime = NULL;
-	scheduled_downtime *next_downtime = NULL;
 
 	/* find the downtime we should remove */
-	for(this_downtime = scheduled_downtime_list, last_downtime = scheduled_downtime_list; this_downtime != NULL; this_downtime = next_downtime) {
-		next_downtime = this_downtime->next;
-
-		/* we found the downtime we should delete */
-		if(this_downtime->downtime_id == downtime_id && this_downtime->type == type)
-			break;
-
-		last_downtime = this_downtime;
-		}
+	this_downtime = find_downtime(type, downtime_id);
 
 	/* remove the downtime from the list in memory */
 	if(this_downtime != NULL) {
@@ -813,14 +1039,23 @@ int delete_downtime(int type, unsigned long downtime_id) {
 		broker_downtime_data(NEBTYPE_DOWNTIME_DELETE, NEBFLAG_NONE, NEBATTR_NONE, type, this_downtime->host_name, this_downtime->service_description, this_downtime->entry_time, this_downtime->author, this_downtime->comment, this_downtime->start_time, this_downtime->end_time, this_downtime->fixed, this_downtime->triggered_by, this_downtime->duration, downtime_id, NULL);
 #endif
 
+		/* remove scheduled entries from event queue */
+		downtime_remove_event(&this_downtime->start_event);
+		downtime_remove_event(&this_downtime->stop_event);
+
 		if(scheduled_downtime_list == this_downtime)
 			scheduled_downtime_list = this_downtime->next;
 		else
-			last_downtime->next = next_downtime;
+			this_downtime->prev->next = this_downtime->next;
+		if(this_downtime->next != NULL)
+			this_downtime->next->prev = this_downtime->prev;
+		else
+			scheduled_downtime_tail = this_downtime->prev;
+		downtime_index_remove(this_downtime);
 
 		/* free memory */
-		my_free(this_downtime->host_name);
-		my_free(this_downtime->service_description);
+		intern_free(this_downtime->host_name);
+		intern_free(this_downtime->service_description);
 		my_free(this_downtime->author);
 		my_free(this_downtime->comment);
 		my_free(this_downtime);
@@ -876,13 +1111,13 @@ int delete_downtime_by_hostname_service_description_start_time_comment(char *hos
 			/* If service is specified, then do not delete the host downtime */
 			if(service_description != NULL)
 				continue;
-			if(hostname != NULL && strcmp(temp_downtime->host_name, hostname) != 0)
+			if(hostname != NULL && !intern_streq(temp_downtime->host_name, hostname))
 				continue;
 			}
 		else if(temp_downtime->type == SERVICE_DOWNTIME) {
-			if(hostname != NULL && strcmp(temp_downtime->host_name, hostname) != 0)
+			if(hostname != NULL && !intern_streq(temp_downtime->host_name, hostname))
 				continue;
-			if(service_description != NULL && strcmp(temp_downtime->service_description, service_description) != 0)
+			if(service_description != NULL && !intern_streq(temp_downtime->service_description, service_description))
 				continue;
 			}
 
@@ -926,8 +1161,6 @@ int add_service_downtime(char *host_name, char *svc_description, time_t entry_ti
 /* adds a host or service downtime entry to the list in memory */
 int add_downtime(int downtime_type, char *host_name, char *svc_description, time_t entry_time, char *author, char *comment_data, time_t start_time, time_t end_time, int fixed, unsigned long triggered_by, unsigned long duration, unsigned long downtime_id, int is_in_effect){
 	scheduled_downtime *new_downtime = NULL;
-	scheduled_downtime *last_downtime = NULL;
-	scheduled_downtime *temp_downtime = NULL;
 	int result = OK;
 
 	/* don't add triggered downtimes that don't have a valid parent */
@@ -943,10 +1176,10 @@ int add_downtime(int downtime_type, char *host_name, char *svc_description, time
 		return ERROR;
 
 	/* duplicate vars */
-	if((new_downtime->host_name = (char *)strdup(host_name)) == NULL)
+	if((new_downtime->host_name = (char *)intern_str(host_name)) == NULL)
 		result = ERROR;
 	if(downtime_type == SERVICE_DOWNTIME) {
-		if((new_downtime->service_description = (char *)strdup(svc_description)) == NULL)
+		if((new_downtime->service_description = (char *)intern_str(svc_description)) == NULL)
 			result = ERROR;
 		}
 	if(author) {
@@ -962,8 +1195,8 @@ int add_downtime(int downtime_type, char *host_name, char *svc_description, time
 	if(result == ERROR) {
 		my_free(new_downtime->comment);
 		my_free(new_downtime->author);
-		my_free(new_downtime->service_description);
-		my_free(new_downtime->host_name);
+		intern_free(new_downtime->service_description);
+		intern_free(new_downtime->host_name);
 		my_free(new_downtime);
 		return ERROR;
 		}
@@ -980,32 +1213,20 @@ int add_downtime(int downtime_type, char *host_name, char *svc_description, time
 
 	if(defer_downtime_sorting) {
 		new_downtime->next = scheduled_downtime_list;
+		if(scheduled_downtime_list != NULL)
+			scheduled_downtime_list->prev = new_downtime;
+		else
+			scheduled_downtime_tail = new_downtime;
 		scheduled_downtime_list = new_downtime;
 		}
 	else {
 		/* add new downtime to downtime list, sorted by start time */
-		last_downtime = scheduled_downtime_list;
-		for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
-			if(new_downtime->start_time < temp_downtime->start_time) {
-				new_downtime->next = temp_downtime;
-				if(temp_downtime == scheduled_downtime_list)
-					scheduled_downtime_list = new_downtime;
-				else
-					last_downtime->next = new_downtime;
-				break;
-				}
-			else
-				last_downtime = temp_downtime;
-			}
-		if(scheduled_downtime_list == NULL) {
-			new_downtime->next = NULL;
-			scheduled_downtime_list = new_downtime;
-			}
-		else if(temp_downtime == NULL) {
-			new_downtime->next = NULL;
-			last_downtime->next = new_downtime;
-			}
+		downtime_list_add(new_downtime);
 		}
+
+	/* a downtime we can't find is worse than a slow one, so keep going */
+	if(downtime_index_add(new_downtime) != OK)
+		logit(NSLOG_RUNTIME_ERROR, TRUE, "Error: Failed to index downtime (id=%lu)\n", downtime_id);
 #ifdef NSCORE
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker */
@@ -1017,9 +1238,7 @@ int add_downtime(int downtime_type, char *host_name, char *svc_description, time
 	}
 
 static int downtime_compar(const void *p1, const void *p2) {
-	scheduled_downtime *d1 = *(scheduled_downtime **)p1;
-	scheduled_downtime *d2 = *(scheduled_downtime **)p2;
-	return (d1->start_time < d2->start_time) ? -1 : (d1->start_time - d2->start_time);
+	return downtime_start_compare(*(scheduled_downtime **)p1, *(scheduled_downtime **)p2);
 	}
 
 int sort_downtime(void) {
@@ -1048,11 +1267,21 @@ int sort_downtime(void) {
 
 	qsort((void *)array, i, sizeof(*array), downtime_compar);
 	scheduled_downtime_list = temp_downtime = array[0];
+	temp_downtime->prev = NULL;
 	for(i = 1; i < unsorted_downtimes; i++) {
 		temp_downtime->next = array[i];
+		array[i]->prev = temp_downtime;
 		temp_downtime = temp_downtime->next;
 		}
 	temp_downtime->next = NULL;
+	scheduled_downtime_tail = temp_downtime;
+
+	/* entries added from now on find their place through the index */
+	skiplist_free(&downtime_start_index);
+	for(i = 0; i < unsorted_downtimes; i++) {
+		if(downtime_start_add(array[i]) != OK)
+			break;
+		}
 	my_free(array);
 	return OK;
 	}
@@ -1067,7 +1296,10 @@ int sort_downtime(void) {
 scheduled_downtime *find_downtime(int type, unsigned long downtime_id) {
 	scheduled_downtime *temp_downtime = NULL;
 
-	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
+	if(downtime_id_hash == NULL)
+		return NULL;
+
+	for(temp_downtime = downtime_id_hash[downtime_id_slot(downtime_id)]; temp_downtime != NULL; temp_downtime = temp_downtime->id_next) {
 		if(type != ANY_DOWNTIME && temp_downtime->type != type)
 			continue;
 		if(temp_downtime->downtime_id == downtime_id)
@@ -1105,8 +1337,8 @@ void free_downtime_data(void) {
 	/* free memory for the scheduled_downtime list */
 	for(this_downtime = scheduled_downtime_list; this_downtime != NULL; this_downtime = next_downtime) {
 		next_downtime = this_downtime->next;
-		my_free(this_downtime->host_name);
-		my_free(this_downtime->service_description);
+		intern_free(this_downtime->host_name);
+		intern_free(this_downtime->service_description);
 		my_free(this_downtime->author);
 		my_free(this_downtime->comment);
 		my_free(this_downtime);
@@ -1115,6 +1347,8 @@ void free_downtime_data(void) {
 	/* reset list pointer */
 	scheduled_downtime_list = NULL;
 
+	downtime_index_free();
+
 	return;
 	}
 
@@ -95,6 +95,23 @@ const struct macro_key_code *find_macro_key(const char *name) {
 	return NULL;
 	}
 
+/*
+ * get the code and clean options of a standard macro, so callers
+ * that expand the same macros over and over can look them up once
+ * and use grab_macrox_value_r() from then on
+ */
+int get_macro_code(const char *name, int *clean_options) {
+	const struct macro_key_code *mkey;
+
+	if(name == NULL || (mkey = find_macro_key(name)) == NULL)
+		return -1;
+
+	if(clean_options != NULL)
+		*clean_options = mkey->clean_options;
+
+	return mkey->code;
+	}
+
 
 /*
  * replace macros in notification commands with their values,
@@ -2546,7 +2563,7 @@ int init_macros(void) {
 			/* output, perfdata, comments and author names need cleaning */
 		case MACRO_HOSTOUTPUT: case MACRO_SERVICEOUTPUT:
 		case MACRO_HOSTPERFDATA: case MACRO_SERVICEPERFDATA:
-		case MACRO_HOSTSAVEDDATA; case MACRO_SERVICESAVEDDATA:
+		case MACRO_HOSTSAVEDDATA: case MACRO_SERVICESAVEDDATA:
 		case MACRO_HOSTACKAUTHOR: case MACRO_HOSTACKCOMMENT:
 		case MACRO_SERVICEACKAUTHOR: case MACRO_SERVICEACKCOMMENT:
 		case MACRO_LONGHOSTOUTPUT: case MACRO_LONGSERVICEOUTPUT:
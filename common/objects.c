@@ -645,9 +645,11 @@ host *add_host(char *name, char *display_name, char *alias, char *address, char
 	new_host = calloc(1, sizeof(*new_host));
 
 	/* duplicate string vars */
-	if((new_host->name = (char *)strdup(name)) == NULL)
+	if((new_host->name = (char *)intern_str(name)) == NULL)
 		result = ERROR;
-	else if((new_host->display_name = (char *)strdup((display_name == NULL) ? name : display_name)) == NULL)
+	else if(display_name == NULL)
+		new_host->display_name = new_host->name;
+	else if((new_host->display_name = (char *)strdup(display_name)) == NULL)
 		result = ERROR;
 	else if((new_host->alias = (char *)strdup((alias == NULL) ? name : alias)) == NULL)
 		result = ERROR;
@@ -662,7 +664,7 @@ host *add_host(char *name, char *display_name, char *alias, char *address, char
 #endif
 
 	if(check_command && result!=ERROR) {
-		if((new_host->check_command = (char *)strdup(check_command)) == NULL)
+		if((new_host->check_command = (char *)intern_str(check_command)) == NULL)
 			result = ERROR;
 		}
 	if(event_handler && result!=ERROR) {
@@ -767,12 +769,12 @@ host *add_host(char *name, char *display_name, char *alias, char *address, char
 		my_free(new_host->notes_url);
 		my_free(new_host->notes);
 		my_free(new_host->event_handler);
-		my_free(new_host->check_command);
+		intern_free(new_host->check_command);
 		my_free(new_host->address);
 		my_free(new_host->alias);
 		if(display_name)
 			my_free(new_host->display_name);
-		my_free(new_host->name);
+		intern_free(new_host->name);
 		return NULL;
 		}
 
@@ -805,7 +807,7 @@ hostsmember *add_parent_host_to_host(host *hst, char *host_name) {
 		return NULL;
 
 	/* duplicate string vars */
-	if((new_hostsmember->host_name = (char *)strdup(host_name)) == NULL) { 
+	if((new_hostsmember->host_name = (char *)intern_str(host_name)) == NULL) {
 		my_free(new_hostsmember);
 		return NULL;
 		}
@@ -826,9 +828,9 @@ servicesmember *add_parent_service_to_service(service *svc, char *host_name, cha
 	if((sm = calloc(1, sizeof(*sm))) == NULL)
 		return NULL;
 
-	if ((sm->host_name = strdup(host_name)) == NULL || (sm->service_description = strdup(description)) == NULL) {
+	if ((sm->host_name = (char *)intern_str(host_name)) == NULL || (sm->service_description = (char *)intern_str(description)) == NULL) {
 		/* there was an error copying (description is NULL now) */
-		my_free(sm->host_name);
+		intern_free(sm->host_name);
 		free(sm);
 		return NULL;
 		}
@@ -1026,7 +1028,7 @@ hostsmember *add_host_to_hostgroup(hostgroup *temp_hostgroup, char *host_name) {
 		return NULL;
 
 	/* duplicate vars */
-	if((new_member->host_name = (char *)strdup(host_name)) == NULL) {
+	if((new_member->host_name = (char *)intern_str(host_name)) == NULL) {
 		my_free(new_member);
 		return NULL;
 		}
@@ -1150,13 +1152,13 @@ servicesmember *add_service_to_servicegroup(servicegroup *temp_servicegroup, cha
 		return NULL;
 
 	/* duplicate vars */
-	if((new_member->host_name = (char *)strdup(host_name)) == NULL) {
+	if((new_member->host_name = (char *)intern_str(host_name)) == NULL) {
 		my_free(new_member);
 		return NULL;
 		}
 
-	if((new_member->service_description = (char *)strdup(svc_description)) == NULL) {
-		my_free(new_member->host_name);
+	if((new_member->service_description = (char *)intern_str(svc_description)) == NULL) {
+		intern_free(new_member->host_name);
 		my_free(new_member);
 		return NULL;
 		}
@@ -1244,7 +1246,7 @@ contact *add_contact(char *name, char *alias, char *email, char *pager, char **a
 	new_contact->host_notification_period_ptr = htp;
 	new_contact->service_notification_period_ptr = stp;
 #endif
-	if((new_contact->name = (char *)strdup(name)) == NULL)
+	if((new_contact->name = (char *)intern_str(name)) == NULL)
 		result = ERROR;
 	else if((new_contact->alias = (char *)strdup((alias == NULL) ? name : alias)) == NULL)
 		result = ERROR;
@@ -1296,7 +1298,7 @@ contact *add_contact(char *name, char *alias, char *email, char *pager, char **a
 	if(result == ERROR) {
 		for(x = 0; x < MAX_CONTACT_ADDRESSES; x++)
 			my_free(new_contact->address[x]);
-		my_free(new_contact->name);
+		intern_free(new_contact->name);
 		my_free(new_contact->alias);
 		my_free(new_contact->email);
 		my_free(new_contact->pager);
@@ -1327,7 +1329,7 @@ commandsmember *add_host_notification_command_to_contact(contact *cntct, char *c
 		return NULL;
 
 	/* duplicate vars */
-	if((new_commandsmember->command = (char *)strdup(command_name)) == NULL) {
+	if((new_commandsmember->command = (char *)intern_str(command_name)) == NULL) {
 		my_free(new_commandsmember);
 		return NULL;
 		}
@@ -1356,7 +1358,7 @@ commandsmember *add_service_notification_command_to_contact(contact *cntct, char
 		return NULL;
 
 	/* duplicate vars */
-	if((new_commandsmember->command = (char *)strdup(command_name)) == NULL) {
+	if((new_commandsmember->command = (char *)intern_str(command_name)) == NULL) {
 		my_free(new_commandsmember);
 		return NULL;
 		}
@@ -1448,7 +1450,7 @@ contactsmember *add_contact_to_contactgroup(contactgroup *grp, char *contact_nam
 		return NULL;
 
 	/* duplicate vars */
-	if((new_contactsmember->contact_name = (char *)strdup(contact_name)) == NULL) {
+	if((new_contactsmember->contact_name = (char *)intern_str(contact_name)) == NULL) {
 		my_free(new_contactsmember);
 		return NULL;
 		}
@@ -1515,11 +1517,13 @@ service *add_service(char *host_name, char *description, char *display_name, cha
 	new_service->check_period = cp ? cp->name : NULL;
 	new_service->notification_period = np ? np->name : NULL;
 	new_service->host_name = h->name;
-	if((new_service->description = (char *)strdup(description)) == NULL)
+	if((new_service->description = (char *)intern_str(description)) == NULL)
 		result = ERROR;
-	else if((new_service->display_name = (char *)strdup((display_name == NULL) ? description : display_name)) == NULL)
+	else if(display_name == NULL)
+		new_service->display_name = new_service->description;
+	else if((new_service->display_name = (char *)strdup(display_name)) == NULL)
 		result = ERROR;
-	else if((new_service->check_command = (char *)strdup(check_command)) == NULL)
+	if(result != ERROR && (new_service->check_command = (char *)intern_str(check_command)) == NULL)
 		result = ERROR;
 	if(event_handler && result!=ERROR) {
 		if((new_service->event_handler = (char *)strdup(event_handler)) == NULL)
@@ -1609,9 +1613,10 @@ service *add_service(char *host_name, char *description, char *display_name, cha
 		my_free(new_service->saved_data);
 #endif
 		my_free(new_service->event_handler);
-		my_free(new_service->check_command);
-		my_free(new_service->description);
-		my_free(new_service->display_name);
+		intern_free(new_service->check_command);
+		if(new_service->display_name != new_service->description)
+			my_free(new_service->display_name);
+		intern_free(new_service->description);
 		my_free(new_service->notes);
 		my_free(new_service->notes_url);
 		my_free(new_service->action_url);
@@ -1671,10 +1676,10 @@ command *add_command(char *name, char *value) {
 		return NULL;
 
 	/* duplicate vars */
-	if((new_command->name = (char *)strdup(name)) == NULL)
+	if((new_command->name = (char *)intern_str(name)) == NULL)
 		return NULL;
 	if((new_command->command_line = (char *)strdup(value)) == NULL) {
-		my_free(new_command->name);
+		intern_free(new_command->name);
 		return NULL;
 		}
 
@@ -1697,7 +1702,7 @@ command *add_command(char *name, char *value) {
 	/* handle errors */
 	if(result == ERROR) {
 		my_free(new_command->command_line);
-		my_free(new_command->name);
+		intern_free(new_command->name);
 		return NULL;
 		}
 
@@ -2206,7 +2211,7 @@ int is_host_immediate_child_of_host(host *parent_host, host *child_host) {
 			if(temp_hostsmember->host_ptr == parent_host)
 				return TRUE;
 #else
-			if(!strcmp(temp_hostsmember->host_name, parent_host->name))
+			if(intern_streq(temp_hostsmember->host_name, parent_host->name))
 				return TRUE;
 #endif
 			}
@@ -2261,7 +2266,7 @@ int is_host_member_of_hostgroup(hostgroup *group, host *hst) {
 		if(temp_hostsmember->host_ptr == hst)
 			return TRUE;
 #else
-		if(!strcmp(temp_hostsmember->host_name, hst->name))
+		if(intern_streq(temp_hostsmember->host_name, hst->name))
 			return TRUE;
 #endif
 		}
@@ -2283,7 +2288,7 @@ int is_host_member_of_servicegroup(servicegroup *group, host *hst) {
 		if(temp_servicesmember->service_ptr != NULL && temp_servicesmember->service_ptr->host_ptr == hst)
 			return TRUE;
 #else
-		if(!strcmp(temp_servicesmember->host_name, hst->name))
+		if(intern_streq(temp_servicesmember->host_name, hst->name))
 			return TRUE;
 #endif
 		}
@@ -2305,7 +2310,7 @@ int is_service_member_of_servicegroup(servicegroup *group, service *svc) {
 		if(temp_servicesmember->service_ptr == svc)
 			return TRUE;
 #else
-		if(!strcmp(temp_servicesmember->host_name, svc->host_name) && !strcmp(temp_servicesmember->service_description, svc->description))
+		if(intern_streq(temp_servicesmember->host_name, svc->host_name) && intern_streq(temp_servicesmember->service_description, svc->description))
 			return TRUE;
 #endif
 		}
@@ -2328,12 +2333,16 @@ int is_contact_member_of_contactgroup(contactgroup *group, contact *cntct) {
 	if(!group || !cntct)
 		return FALSE;
 
-	/* search all contacts in this contact group */
+	/*
+	 * search all contacts in this contact group. Contact names
+	 * are interned, so comparing them is usually just comparing
+	 * pointers, which beats looking up each member's contact
+	 */
 	for(member = group->members; member; member = member->next) {
 #ifdef NSCORE
 		temp_contact = member->contact_ptr;
 #else
-		temp_contact = find_contact(member->contact_name);
+		temp_contact = intern_streq(member->contact_name, cntct->name) ? cntct : NULL;
 #endif
 		if(temp_contact == NULL)
 			continue;
@@ -2360,7 +2369,7 @@ int is_contact_for_host(host *hst, contact *cntct) {
 #ifdef NSCORE
 		temp_contact = temp_contactsmember->contact_ptr;
 #else
-		temp_contact = find_contact(temp_contactsmember->contact_name);
+		temp_contact = intern_streq(temp_contactsmember->contact_name, cntct->name) ? cntct : NULL;
 #endif
 		if(temp_contact == NULL)
 			continue;
@@ -2404,7 +2413,7 @@ int is_escalated_contact_for_host(host *hst, contact *cntct) {
 #ifdef NSCORE
 			temp_contact = temp_contactsmember->contact_ptr;
 #else
-			temp_contact = find_contact(temp_contactsmember->contact_name);
+			temp_contact = intern_streq(temp_contactsmember->contact_name, cntct->name) ? cntct : NULL;
 #endif
 			if(temp_contact == NULL)
 				continue;
@@ -2446,7 +2455,7 @@ int is_contact_for_service(service *svc, contact *cntct) {
 #ifdef NSCORE
 		temp_contact = temp_contactsmember->contact_ptr;
 #else
-		temp_contact = find_contact(temp_contactsmember->contact_name);
+		temp_contact = intern_streq(temp_contactsmember->contact_name, cntct->name) ? cntct : NULL;
 #endif
 
 		if(temp_contact == cntct)
@@ -2490,7 +2499,7 @@ int is_escalated_contact_for_service(service *svc, contact *cntct) {
 #ifdef NSCORE
 			temp_contact = temp_contactsmember->contact_ptr;
 #else
-			temp_contact = find_contact(temp_contactsmember->contact_name);
+			temp_contact = intern_streq(temp_contactsmember->contact_name, cntct->name) ? cntct : NULL;
 #endif
 			if(temp_contact == NULL)
 				continue;
@@ -2605,7 +2614,7 @@ int free_object_data(void) {
 		this_hostsmember = this_host->parent_hosts;
 		while(this_hostsmember != NULL) {
 			next_hostsmember = this_hostsmember->next;
-			my_free(this_hostsmember->host_name);
+			intern_free(this_hostsmember->host_name);
 			my_free(this_hostsmember);
 			this_hostsmember = next_hostsmember;
 			}
@@ -2658,7 +2667,7 @@ int free_object_data(void) {
 			my_free(this_host->alias);
 		if(this_host->address != this_host->name)
 			my_free(this_host->address);
-		my_free(this_host->name);
+		intern_free(this_host->name);
 #ifdef NSCORE
 		my_free(this_host->plugin_output);
 		my_free(this_host->long_plugin_output);
@@ -2669,7 +2678,7 @@ int free_object_data(void) {
 		free_objectlist(&this_host->notify_deps);
 		free_objectlist(&this_host->exec_deps);
 		free_objectlist(&this_host->escalation_list);
-		my_free(this_host->check_command);
+		intern_free(this_host->check_command);
 		my_free(this_host->event_handler);
 		my_free(this_host->notes);
 		my_free(this_host->notes_url);
@@ -2693,7 +2702,7 @@ int free_object_data(void) {
 		this_hostsmember = this_hostgroup->members;
 		while(this_hostsmember != NULL) {
 			next_hostsmember = this_hostsmember->next;
-			my_free(this_hostsmember->host_name);
+			intern_free(this_hostsmember->host_name);
 			my_free(this_hostsmember);
 			this_hostsmember = next_hostsmember;
 			}
@@ -2717,8 +2726,8 @@ int free_object_data(void) {
 		this_servicesmember = this_servicegroup->members;
 		while(this_servicesmember != NULL) {
 			next_servicesmember = this_servicesmember->next;
-			my_free(this_servicesmember->host_name);
-			my_free(this_servicesmember->service_description);
+			intern_free(this_servicesmember->host_name);
+			intern_free(this_servicesmember->service_description);
 			my_free(this_servicesmember);
 			this_servicesmember = next_servicesmember;
 			}
@@ -2743,7 +2752,7 @@ int free_object_data(void) {
 		while(this_commandsmember != NULL) {
 			next_commandsmember = this_commandsmember->next;
 			if(this_commandsmember->command != NULL)
-				my_free(this_commandsmember->command);
+				intern_free(this_commandsmember->command);
 			my_free(this_commandsmember);
 			this_commandsmember = next_commandsmember;
 			}
@@ -2753,7 +2762,7 @@ int free_object_data(void) {
 		while(this_commandsmember != NULL) {
 			next_commandsmember = this_commandsmember->next;
 			if(this_commandsmember->command != NULL)
-				my_free(this_commandsmember->command);
+				intern_free(this_commandsmember->command);
 			my_free(this_commandsmember);
 			this_commandsmember = next_commandsmember;
 			}
@@ -2768,7 +2777,7 @@ int free_object_data(void) {
 			this_customvariablesmember = next_customvariablesmember;
 			}
 
-		my_free(this_contact->name);
+		intern_free(this_contact->name);
 		my_free(this_contact->alias);
 		my_free(this_contact->email);
 		my_free(this_contact->pager);
@@ -2794,7 +2803,7 @@ int free_object_data(void) {
 		this_contactsmember = this_contactgroup->members;
 		while(this_contactsmember != NULL) {
 			next_contactsmember = this_contactsmember->next;
-			my_free(this_contactsmember->contact_name);
+			intern_free(this_contactsmember->contact_name);
 			my_free(this_contactsmember);
 			this_contactsmember = next_contactsmember;
 			}
@@ -2838,10 +2847,20 @@ int free_object_data(void) {
 			this_customvariablesmember = next_customvariablesmember;
 			}
 
+		/* free memory for parent services */
+		this_servicesmember = this_service->parents;
+		while(this_servicesmember != NULL) {
+			next_servicesmember = this_servicesmember->next;
+			intern_free(this_servicesmember->host_name);
+			intern_free(this_servicesmember->service_description);
+			my_free(this_servicesmember);
+			this_servicesmember = next_servicesmember;
+			}
+
 		if(this_service->display_name != this_service->description)
 			my_free(this_service->display_name);
-		my_free(this_service->description);
-		my_free(this_service->check_command);
+		intern_free(this_service->description);
+		intern_free(this_service->check_command);
 #ifdef NSCORE
 		my_free(this_service->plugin_output);
 		my_free(this_service->long_plugin_output);
@@ -2871,7 +2890,7 @@ int free_object_data(void) {
 	/**** free command memory ****/
 	for (i = 0; i < num_objects.commands; i++) {
 		command *this_command = command_ary[i];
-		my_free(this_command->name);
+		intern_free(this_command->name);
 		my_free(this_command->command_line);
 		my_free(this_command);
 		}
@@ -78,6 +78,9 @@ int initialize_status_data(char *config_file) {
 /* update all status data (aggregated dump) */
 int update_all_status_data(void) {
 	int result = OK;
+	struct timeval start, stop;
+
+	gettimeofday(&start, NULL);
 
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker */
@@ -94,6 +97,9 @@ int update_all_status_data(void) {
 	broker_aggregated_status_data(NEBTYPE_AGGREGATEDSTATUS_ENDDUMP, NEBFLAG_NONE, NEBATTR_NONE, NULL);
 #endif
 
+	gettimeofday(&stop, NULL);
+	latency_record(LATENCY_STATUS_WRITE, &start, &stop);
+
 	if(result != OK)
 		return ERROR;
 
@@ -132,6 +138,9 @@ int update_program_status(int aggregated_dump) {
 /* updates host status info */
 int update_host_status(host *hst, int aggregated_dump) {
 
+	/* keep the compact copies the periodic sweeps use current */
+	sync_host_hot_state(hst);
+
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker (non-aggregated dumps only) */
 	if(aggregated_dump == FALSE)
@@ -146,6 +155,9 @@ int update_host_status(host *hst, int aggregated_dump) {
 /* updates service status info */
 int update_service_status(service *svc, int aggregated_dump) {
 
+	/* keep the compact copies the periodic sweeps use current */
+	sync_service_hot_state(svc);
+
 #ifdef USE_EVENT_BROKER
 	/* send data to event broker (non-aggregated dumps only) */
 	if(aggregated_dump == FALSE)
@@ -447,7 +459,7 @@ void free_status_data(void) {
 	/* free memory for the host status list */
 	for(this_hoststatus = hoststatus_list; this_hoststatus != NULL; this_hoststatus = next_hoststatus) {
 		next_hoststatus = this_hoststatus->next;
-		my_free(this_hoststatus->host_name);
+		intern_free(this_hoststatus->host_name);
 		my_free(this_hoststatus->plugin_output);
 		my_free(this_hoststatus->long_plugin_output);
 		my_free(this_hoststatus->perf_data);
@@ -457,8 +469,8 @@ void free_status_data(void) {
 	/* free memory for the service status list */
 	for(this_svcstatus = servicestatus_list; this_svcstatus != NULL; this_svcstatus = next_svcstatus) {
 		next_svcstatus = this_svcstatus->next;
-		my_free(this_svcstatus->host_name);
-		my_free(this_svcstatus->description);
+		intern_free(this_svcstatus->host_name);
+		intern_free(this_svcstatus->description);
 		my_free(this_svcstatus->plugin_output);
 		my_free(this_svcstatus->long_plugin_output);
 		my_free(this_svcstatus->perf_data);
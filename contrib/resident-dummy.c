@@ -0,0 +1,73 @@
+/*
+ * A resident helper that behaves like check_dummy, meant as an
+ * example for writing resident helpers and for testing the
+ * resident_plugin= option.
+ *
+ * The worker writes one request per job to our stdin:
+ *   "<slot> <timeout> <command length>\n<command>"
+ * and we answer each of them on stdout with:
+ *   "<slot> <exit code> <stdout length> <stderr length>\n<stdout><stderr>"
+ *
+ * Slots are opaque to us. Answers may come in any order, so a
+ * helper is free to run jobs concurrently, but this one doesn't.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *state_name[] = { "OK", "WARNING", "CRITICAL", "UNKNOWN" };
+
+static void respond(unsigned long slot, int code, const char *out, const char *err)
+{
+	printf("%lu %d %lu %lu\n%s%s", slot, code,
+	       (unsigned long)strlen(out), (unsigned long)strlen(err), out, err);
+}
+
+/* "check_dummy <state> [text]" */
+static void run_job(unsigned long slot, char *cmd)
+{
+	char *arg, *end, out[8192];
+	long state;
+
+	/* skip the plugin name */
+	arg = strchr(cmd, ' ');
+	if (!arg) {
+		respond(slot, 3, "Could not parse arguments\n", "");
+		return;
+	}
+	state = strtol(arg, &end, 10);
+	if (end == arg || state < 0 || state > 3) {
+		respond(slot, 3, "Status should be one of 0, 1, 2 or 3\n", "");
+		return;
+	}
+	while (*end == ' ')
+		end++;
+
+	snprintf(out, sizeof(out), "%s%s%s\n", state_name[state], *end ? ": " : "", end);
+	respond(slot, state, out, "");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long slot, len;
+	unsigned int timeout;
+	char *cmd;
+
+	while (scanf("%lu %u %lu", &slot, &timeout, &len) == 3) {
+		if (getchar() != '\n')
+			return 1;
+		if (!(cmd = malloc(len + 1)))
+			return 1;
+		if (fread(cmd, 1, len, stdin) != len) {
+			free(cmd);
+			return 1;
+		}
+		cmd[len] = 0;
+		run_job(slot, cmd);
+		free(cmd);
+		/* the worker is waiting for this, so don't sit on it */
+		fflush(stdout);
+	}
+
+	return 0;
+}
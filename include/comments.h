@@ -50,7 +50,7 @@
 
 /*************************** CHAINED HASH LIMITS ***************************/
 
-#define COMMENT_HASHSLOTS      1024
+#define COMMENT_HASHSLOTS      1024	/* unused, comments are indexed by id and name now */
 
 
 /**************************** DATA STRUCTURES ******************************/
@@ -72,7 +72,12 @@ typedef struct comment {
 	char 	*author;
 	char 	*comment_data;
 	struct 	comment *next;
-	struct 	comment *nexthash;
+	struct 	comment *nexthash;	/* next comment for the same host */
+	/* indexes, see comments.c */
+	struct	comment *prev;
+	struct	comment *prevhash;
+	struct	comment *id_next;
+	struct	comment *obj_next, *obj_prev;
 	} comment;
 
 extern struct comment *comment_list;
@@ -100,6 +105,7 @@ struct comment *find_host_comment(unsigned long);                            /*
 
 struct comment *get_first_comment_by_host(char *);
 struct comment *get_next_comment_by_host(char *, struct comment *);
+struct comment *get_first_comment_by_object(const char *, const char *); /* continue with ->obj_next */
 
 int number_of_host_comments(char *);			              /* returns the number of comments associated with a particular host */
 int number_of_service_comments(char *, char *);		              /* returns the number of comments associated with a particular service */
@@ -109,7 +115,7 @@ int sort_comments(void);
 int add_host_comment(int, char *, time_t, char *, char *, unsigned long, int, int, time_t, int);   /* adds a host comment */
 int add_service_comment(int, char *, char *, time_t, char *, char *, unsigned long, int, int, time_t, int); /* adds a service comment */
 
-int add_comment_to_hashlist(struct comment *);
+int add_comment_to_hashlist(struct comment *);                           /* adds a comment to the id and name indexes */
 
 void free_comment_data(void);                                             /* frees memory allocated to the comment list */
 
@@ -46,6 +46,8 @@
 #define DEFAULT_DEBUG_LEVEL                                     0       /* don't log any debugging information */
 #define DEFAULT_DEBUG_VERBOSITY                                 1
 #define DEFAULT_MAX_DEBUG_FILE_SIZE                             1000000 /* max size of debug log */
+#define DEFAULT_DEBUG_FILE_FORMAT                               DEBUG_FORMAT_TEXT /* plain text debug log */
+#define DEFAULT_DEBUG_TRACE_SIZE                                (16 * 1024 * 1024) /* size of binary debug ring if max_debug_file_size is 0 */
 
 #define DEFAULT_AGGRESSIVE_HOST_CHECKING			0	/* don't use "aggressive" host checking */
 #define DEFAULT_CHECK_EXTERNAL_COMMANDS				1 	/* check for external commands */
@@ -56,6 +56,10 @@ typedef struct scheduled_downtime {
 #ifdef NSCORE
 	struct timed_event *start_event, *stop_event;
 #endif
+	/* indexes, see downtime.c */
+	struct scheduled_downtime *prev;
+	struct scheduled_downtime *id_next;
+	struct scheduled_downtime *obj_next, *obj_prev;
 	} scheduled_downtime;
 
 extern struct scheduled_downtime *scheduled_downtime_list;
@@ -83,7 +87,7 @@ int handle_scheduled_downtime_by_id(unsigned long);
 int check_pending_flex_host_downtime(struct host *);
 int check_pending_flex_service_downtime(struct service *);
 
-int check_for_expired_downtime(void);
+int check_for_expired_downtime(unsigned long);
 #endif
 
 int add_host_downtime(char *, time_t, char *, char *, time_t, time_t, int, unsigned long, unsigned long, unsigned long, int);
@@ -63,6 +63,10 @@
 #define DEBUGV_MORE			1
 #define DEBUGV_MOST                     2
 
+/* debug_file_format values */
+#define DEBUG_FORMAT_TEXT               0
+#define DEBUG_FORMAT_BINARY             1
+
 NAGIOS_BEGIN_DECL
 /**** Logging Functions ****/
 void logit(int, int, const char *, ...)
@@ -82,6 +86,8 @@ int rotate_log_file(time_t);			     	/* rotates the main log file */
 int write_log_file_info(time_t *); 			/* records log file/version info */
 int open_debug_log(void);
 int close_debug_log(void);
+int flush_log_file(void);
+int flush_log_file_if_due(const struct timeval *, int);
 int close_log_file(void);
 #endif /* !NSCGI */
 
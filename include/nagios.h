@@ -48,6 +48,8 @@ extern char *object_precache_file;
 extern unsigned int nofile_limit, nproc_limit, max_apps;
 
 extern int num_check_workers;
+extern int max_check_workers;
+extern int outage_storm_threshold;
 extern char *qh_socket_path;
 
 extern char *nagios_user;
@@ -183,6 +185,7 @@ extern int status_update_interval;
 extern int time_change_threshold;
 
 extern unsigned long event_broker_options;
+extern int broker_callback_profiling;
 
 extern int process_performance_data;
 
@@ -206,6 +209,7 @@ extern char *debug_file;
 extern int debug_level;
 extern int debug_verbosity;
 extern unsigned long max_debug_file_size;
+extern int debug_file_format;
 
 extern int allow_empty_hostgroup_assignment;
 
@@ -233,6 +237,7 @@ extern iobroker_set *nagios_iobs;
 extern struct check_stats check_statistics[MAX_CHECK_STATS_TYPES];
 
 extern struct notify_list *notification_list;
+extern bitmap *notification_contacts;	/* ids of the contacts on notification_list */
 
 extern struct check_engine nagios_check_engine;
 
@@ -359,7 +364,7 @@ extern struct load_control loadctl;
 #define EVENT_STATUS_SAVE		8	/* save (dump) status data */
 #define EVENT_SCHEDULED_DOWNTIME	9	/* scheduled host or service downtime */
 #define EVENT_SFRESHNESS_CHECK          10      /* checks service result "freshness" */
-#define EVENT_EXPIRE_DOWNTIME		11      /* checks for (and removes) expired scheduled downtime */
+#define EVENT_EXPIRE_DOWNTIME		11      /* ends scheduled downtime, or removes it if it never took effect */
 #define EVENT_HOST_CHECK                12      /* active host check */
 #define EVENT_HFRESHNESS_CHECK          13      /* checks host result "freshness" */
 #define EVENT_RESCHEDULE_CHECKS		14      /* adjust scheduling of host and service checks */
@@ -413,6 +418,77 @@ extern const char *check_result_source(check_result *cr);
 extern int nerd_init(void);
 extern int nerd_mkchan(const char *name, int (*handler)(int, void *), unsigned int callbacks);
 
+/*** Hot-path latency counters ***/
+#define LATENCY_LOOP            0 /* event loop iteration, not counting the poll wait */
+#define LATENCY_POLL            1 /* time spent waiting in iobroker_poll() */
+#define LATENCY_EVENT_DISPATCH  2 /* how late timed events run, from their scheduled time */
+#define LATENCY_SERVICE_RESULT  3 /* processing a service check result */
+#define LATENCY_HOST_RESULT     4 /* processing a host check result */
+#define LATENCY_STATUS_WRITE    5 /* writing status data */
+#define LATENCY_RETENTION_WRITE 6 /* writing retention data */
+#define LATENCY_WORKER_RTT      7 /* shipping a job to a worker until its result arrives */
+#define LATENCY_NUMITEMS        8
+
+/*
+ * Each power of two is split into LATENCY_SUB_BUCKETS linear buckets.
+ * See latency.c
+ */
+#define LATENCY_SUB_BITS 2
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_BITS 40 /* ~12 days, in microseconds */
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 2) * LATENCY_SUB_BUCKETS)
+struct latency_histogram {
+	unsigned long long count;
+	unsigned long long usec_total;
+	unsigned long long usec_min;
+	unsigned long long usec_max;
+	unsigned long buckets[LATENCY_BUCKETS];
+};
+extern void latency_histogram_add(struct latency_histogram *h, unsigned long long usec);
+extern unsigned long long latency_histogram_percentile(struct latency_histogram *h, double pct);
+extern const struct latency_histogram *latency_get(int type);
+extern void latency_record(int type, const struct timeval *start, const struct timeval *stop);
+extern void latency_record_usec(int type, unsigned long long usec);
+extern void latency_reset(void);
+extern int latency_qh(int sd, char *buf, unsigned int len);
+
+/*** Per-command resource usage ***/
+extern void cmdstats_record(const char *check_command, const char *command_line,
+                            const struct timeval *start, const struct timeval *stop,
+                            const struct rusage *ru, int timed_out);
+extern void cmdstats_reset(void);
+extern int cmdstats_qh(int sd, char *buf, unsigned int len);
+extern void cmdstats_write_status(FILE *fp);
+
+/*** Runtime state periodic sweeps and dependency checks look at, see hotstate.c ***/
+struct dependency_cache {
+	unsigned long version; /* dep_version it was computed at, 0 for never */
+	time_t expires; /* when a dependency period may change, 0 for never */
+	int result;
+};
+struct hot_state {
+	unsigned int count;
+	struct twheel *freshness; /* when each object's results go stale */
+	struct twheel *orphaned; /* when each running check is orphaned */
+	unsigned char *dep_state; /* the state dependencies on the object look at */
+	unsigned long dep_version; /* bumped whenever a dep_state changes */
+	struct dependency_cache *dep_cache; /* execution and notification, per object */
+};
+extern struct hot_state host_hot, service_hot;
+extern int init_hot_state(void);
+extern void free_hot_state(void);
+extern void sync_host_hot_state(host *hst);
+extern void sync_service_hot_state(service *svc);
+extern struct dependency_cache *get_dependency_cache(struct hot_state *hs, unsigned int id, int dependency_type);
+
+/*** Outage storms, see outage.c ***/
+extern int outage_storm_active(time_t now);
+extern void outage_host_state_change(time_t now);
+extern int outage_host_check_is_redundant(host *hst, time_t now);
+extern int propagate_host_outage(host *hst, objectlist **check_hostlist);
+extern int outage_qh(int sd, char *buf, unsigned int len);
+extern void free_outage_data(void);
+
 /*** Query Handler functions, types and macros*/
 typedef int (*qh_handler)(int, char *, unsigned int);
 
@@ -473,15 +549,23 @@ int check_service_dependencies(service *, int);          	/* checks service depe
 int check_host_dependencies(host *, int);                	/* checks host dependencies */
 void check_for_orphaned_services(void);				/* checks for orphaned services */
 void check_for_orphaned_hosts(void);				/* checks for orphaned hosts */
+void check_for_stale_parent_check_waits(void);			/* resumes host results that waited too long for parent checks */
+void check_for_stale_host_check_waits(void);			/* resumes service results that waited too long for host checks */
 void check_service_result_freshness(void);              	/* checks the "freshness" of service check results */
 int is_service_result_fresh(service *, time_t, int);            /* determines if a service's check results are fresh */
+time_t get_service_freshness_expiration(service *, int *);	/* determines when a service's check results go stale */
 void check_host_result_freshness(void);                 	/* checks the "freshness" of host check results */
 int is_host_result_fresh(host *, time_t, int);                  /* determines if a host's check results are fresh */
+time_t get_host_freshness_expiration(host *, int *);		/* determines when a host's check results go stale */
 int my_system(char *, int, int *, double *, char **, int);         	/* executes a command via popen(), but also protects against timeouts */
 int my_system_r(nagios_macros *mac, char *, int, int *, double *, char **, int); /* thread-safe version of the above */
 
 
 /**** Flap Detection Functions ****/
+void update_state_history(unsigned int *, int);			/* records a new state in a flap detection state history */
+double get_state_history_percent_change(unsigned int);		/* returns the weighted percent state change of a state history */
+unsigned int state_history_from_states(int *);			/* builds a state history from MAX_STATE_HISTORY_ENTRIES states, oldest first */
+void state_history_to_states(unsigned int, int *);		/* fills in MAX_STATE_HISTORY_ENTRIES states, oldest first, giving the same history */
 void check_for_service_flapping(service *, int, int);	      /* determines whether or not a service is "flapping" between states */
 void check_for_host_flapping(host *, int, int, int);		/* determines whether or not a host is "flapping" between states */
 void set_service_flap(service *, double, double, double, int);	/* handles a service that is flapping */
@@ -503,9 +587,11 @@ int perform_on_demand_host_check(host *, int *, int, int, unsigned long);
 int check_host_check_viability(host *, int, int *, time_t *);
 int adjust_host_check_attempt(host *, int);
 int determine_host_reachability(host *);
+int translate_host_reachability(host *);
 int process_host_check_result(host *, int, char *, int, int, int, unsigned long);
 int perform_on_demand_host_check(host *, int *, int, int, unsigned long);
-int execute_sync_host_check(host *);
+void free_parent_check_waits(void);
+void free_host_check_waits(void);
 int run_scheduled_host_check(host *, int, double);
 int run_async_host_check(host *, int, double, int, int, int *, time_t *);
 int handle_async_host_check_result(host *, check_result *);
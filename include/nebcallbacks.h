@@ -59,10 +59,23 @@
 
 #define nebcallback_flag(x) (1 << (x))
 
+/***** CALLBACK REGISTRATION FLAGS *****/
+
+/*
+ * Callbacks registered with this flag are pure observers. They
+ * get a private copy of the event data, which is delivered from
+ * a thread owned by the module, so their return value is ignored
+ * and they can never cancel or override the core's handling of
+ * an event. Strings are copied, but object pointers still point
+ * to live core data that the module must not touch from there.
+ */
+#define NEBCALLBACK_ASYNC                             (1 << 0)
+
 /***** CALLBACK FUNCTIONS *****/
 NAGIOS_BEGIN_DECL
 
 int neb_register_callback(int callback_type, void *mod_handle, int priority, int (*callback_func)(int, void *));
+int neb_register_callback_full(int callback_type, void *mod_handle, int priority, unsigned int flags, int (*callback_func)(int, void *));
 int neb_deregister_callback(int callback_type, int (*callback_func)(int, void *));
 int neb_deregister_module_callbacks(nebmodule *);
 
@@ -36,8 +36,42 @@ typedef struct nebcallback_struct {
 	void            *module_handle;
 	int             priority;
 	struct nebcallback_struct *next;
+	unsigned int    flags;
+	struct neb_async_queue *async_queue;
+	struct neb_callback_profile *profile;
 	} nebcallback;
 
+/*
+ * number of latency buckets kept per module and callback type.
+ * Bucket 0 holds calls that took less than a microsecond, and
+ * bucket N those that took less than 2^N microseconds, except
+ * for the last one which holds everything slower than that.
+ */
+#define NEB_PROFILE_BUCKETS     20
+
+/* call statistics for one module and callback type */
+struct neb_callback_profile {
+	void            *module_handle;
+	int             callback_type;
+	unsigned long   calls;
+	unsigned long long usec_total;
+	unsigned long   usec_max;
+	unsigned long   histogram[NEB_PROFILE_BUCKETS];
+	struct neb_callback_profile *next;
+	};
+
+/* asynchronous delivery statistics, summed over all modules */
+struct neb_async_stats {
+	unsigned int    queues;     /* modules with async callbacks */
+	unsigned long   depth;      /* events currently queued */
+	unsigned long   max_depth;  /* highest queue depth seen */
+	unsigned long   delivered;  /* events handed to modules */
+	unsigned long   dropped;    /* events lost to full queues */
+	};
+
+/* max number of events queued for a single module */
+#define NEB_ASYNC_QUEUE_SIZE    (1 << 14)
+
 
 
 /***** MODULE FUNCTIONS *****/
@@ -57,6 +91,8 @@ int neb_add_core_module(nebmodule *mod);
 int neb_init_callback_list(void);
 int neb_free_callback_list(void);
 int neb_make_callbacks(int, void *);
+void neb_get_async_stats(struct neb_async_stats *);
+void neb_get_profile_summary(struct neb_callback_profile *);
 
 NAGIOS_END_DECL
 #endif
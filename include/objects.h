@@ -152,6 +152,7 @@ typedef struct check_result {
 	int object_check_type;                          /* is this a service or a host check? */
 	char *host_name;                                /* host name */
 	char *service_description;                      /* service description */
+	char *command_name;                             /* name of the command that was run */
 	int check_type;					/* was this an active or passive service check? */
 	int check_options;
 	int scheduled_check;                            /* was this a scheduled or an on-demand check? */
@@ -506,8 +507,7 @@ struct host {
 	int     check_flapping_recovery_notification;
 	int     scheduled_downtime_depth;
 	int     pending_flex_downtime;
-	int     state_history[MAX_STATE_HISTORY_ENTRIES];    /* flap detection */
-	int     state_history_index;
+	unsigned int state_history;                          /* flap detection, see flapping.c */
 	time_t  last_state_history_update;
 	int     is_flapping;
 	unsigned long flapping_comment_id;
@@ -631,8 +631,7 @@ struct service {
 	int     check_options;
 	int     scheduled_downtime_depth;
 	int     pending_flex_downtime;
-	int     state_history[MAX_STATE_HISTORY_ENTRIES];    /* flap detection */
-	int     state_history_index;
+	unsigned int state_history;                          /* flap detection, see flapping.c */
 	int     is_flapping;
 	unsigned long flapping_comment_id;
 	double  percent_state_change;
@@ -16,6 +16,8 @@
 
 #define WPROC_FORCE  (1 << 0)
 
+#define WPROC_AUTOSCALE_INTERVAL 30 /* seconds between autoscaling rounds */
+
 extern unsigned int wproc_num_workers_spawned;
 extern unsigned int wproc_num_workers_online;
 extern unsigned int wproc_num_workers_desired;
@@ -25,10 +27,15 @@ extern int wproc_can_spawn(struct load_control *lc);
 extern void free_worker_memory(int flags);
 extern int workers_alive(void);
 extern int init_workers(int desired_workers);
+extern void wproc_autoscale(void *discard);
 extern int wproc_run_check(check_result *cr, char *cmd, nagios_macros *mac);
 extern int wproc_notify(char *cname, char *hname, char *sdesc, char *cmd, nagios_macros *mac);
+extern void wproc_batch_begin(void);
+extern void wproc_batch_end(void);
 extern int wproc_run(int job_type, char *cmd, int timeout, nagios_macros *mac);
 extern int wproc_run_service_job(int jtype, int timeout, service *svc, char *cmd, nagios_macros *mac);
 extern int wproc_run_host_job(int jtype, int timeout, host *hst, char *cmd, nagios_macros *mac);
 extern int wproc_destroy(worker_process *wp, int flags);
+extern int wproc_add_resident_plugin(const char *spec);
+extern void wproc_clear_resident_plugins(void);
 #endif
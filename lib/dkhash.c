@@ -1,21 +1,48 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "dkhash.h"
 #include "lnag-utils.h"
 
-#define dkhash_func(k) hash((unsigned char *)k)
-#define dkhash_func2(k1, k2) (dkhash_func(k1) ^ dkhash_func(k2))
+/*
+ * Open addressing with linear probing in one contiguous array. Each
+ * slot remembers the full hash of its keys, so probing past entries
+ * that merely share a slot never has to look at their keys, and the
+ * keys themselves are only compared when the hashes match.
+ *
+ * Hash values 0 and 1 are reserved to mark empty and deleted slots.
+ */
+#define DKHASH_EMPTY   0
+#define DKHASH_DELETED 1
 
-typedef struct dkhash_bucket {
+/*
+ * Tables grow when more than 3/4 of their slots are in use. Rather
+ * than rehashing everything at once, which would stall whoever is
+ * unlucky enough to add the entry that tips it over, entries are
+ * moved from the old array to the new one a few slots at a time on
+ * each insert, lookup and removal. Lookups check both arrays until
+ * the old one is empty. Nothing is moved while the table is being
+ * walked, so a table that fills up again before the walk is done
+ * just gets crowded, with room kept for what's left to move.
+ */
+#define DKHASH_MIGRATE_STEP 64
+
+typedef struct dkhash_entry {
+	unsigned int hash;
 	const char *key;
 	const char *key2;
 	void *data;
-	struct dkhash_bucket *next;
-} dkhash_bucket;
+} dkhash_entry;
 
 struct dkhash_table {
-	dkhash_bucket **buckets;
-	unsigned int num_buckets;
+	dkhash_entry *slots;
+	unsigned int num_slots;
+	unsigned int used; /* live and deleted slots in 'slots' */
+	dkhash_entry *old; /* being migrated to 'slots' */
+	unsigned int old_num_slots;
+	unsigned int old_pos; /* everything before this has been moved */
+	unsigned int old_live; /* entries in 'old' still waiting to be moved */
+	unsigned int walking;
 	unsigned int added, removed;
 	unsigned int entries;
 	unsigned int max_entries;
@@ -50,83 +77,199 @@ unsigned int dkhash_num_entries_removed(dkhash_table *t)
 
 unsigned int dkhash_table_size(dkhash_table *t)
 {
-	return t ? t->num_buckets : 0;
+	return t ? t->num_slots : 0;
 }
 
 /*
- * polynomial conversion ignoring overflows.
- * Pretty standard hash, once based on Ozan Yigit's sdbm() hash
- * but later modified for Nagios to produce better results on our
- * typical data.
+ * Multiply-xorshift over eight bytes at a time. Host names and
+ * service descriptions are usually a few words long, so this does
+ * a fraction of the work of a per-byte loop, and strlen() is about
+ * as fast as it gets. Both keys feed the same state, so swapping
+ * them or using the same string twice doesn't give the same hash
+ * as it would if we XOR'ed two separate ones together.
  */
-#define PRIME 509
-static inline unsigned int hash(register const unsigned char *k)
+#define DKHASH_MUL 0x9e3779b97f4a7c15ULL
+
+static inline uint64_t hash_mix(uint64_t h, uint64_t w)
+{
+	h ^= w;
+	h *= DKHASH_MUL;
+	return h ^ (h >> 29);
+}
+
+static inline uint64_t hash_str(uint64_t h, const char *k)
 {
-	register unsigned int h = 0x123; /* magic */
+	size_t len = strlen(k);
+	uint64_t w;
 
-	while (*k)
-		h = *k++ + PRIME * h;
+	h = hash_mix(h, len);
+	for (; len >= 8; len -= 8, k += 8) {
+		memcpy(&w, k, 8);
+		h = hash_mix(h, w);
+	}
+	if (len) {
+		w = 0;
+		memcpy(&w, k, len);
+		h = hash_mix(h, w);
+	}
 
 	return h;
 }
 
-static inline unsigned int dkhash_slot(dkhash_table *t, const char *k1, const char *k2)
+static inline unsigned int dkhash_func(const char *k1, const char *k2)
+{
+	uint64_t h = hash_str(0x123, k1); /* magic */
+	unsigned int ret;
+
+	if (k2)
+		h = hash_str(h, k2);
+	h = hash_mix(h, h >> 32);
+	ret = (unsigned int)(h >> 32);
+
+	return ret > DKHASH_DELETED ? ret : ret + 2;
+}
+
+/* interned keys are usually the very same pointers */
+static inline int dkhash_match(const dkhash_entry *e, unsigned int h, const char *k1, const char *k2)
 {
-	if(k2)
-		return dkhash_func2(k1, k2) % t->num_buckets;
-	return dkhash_func(k1) % t->num_buckets;
+	if (e->hash != h || (k1 != e->key && strcmp(k1, e->key)))
+		return 0;
+	if (!k2 || !e->key2)
+		return !k2 && !e->key2;
+	return k2 == e->key2 || !strcmp(k2, e->key2);
 }
 
-static dkhash_bucket *dkhash_get_bucket(dkhash_table *t, const char *key, unsigned int slot)
+static dkhash_entry *dkhash_find_in(dkhash_entry *slots, unsigned int num_slots, unsigned int h,
+                                    const char *k1, const char *k2)
 {
-	dkhash_bucket *bkt;
+	unsigned int i, mask = num_slots - 1;
 
-	for (bkt = t->buckets[slot]; bkt; bkt = bkt->next) {
-		if (!strcmp(key, bkt->key))
-			return bkt;
+	for (i = h & mask; slots[i].hash != DKHASH_EMPTY; i = (i + 1) & mask) {
+		if (dkhash_match(&slots[i], h, k1, k2))
+			return &slots[i];
 	}
 
 	return NULL;
 }
 
-static dkhash_bucket *dkhash_get_bucket2(dkhash_table *t, const char *k1, const char *k2, unsigned int slot)
+static dkhash_entry *dkhash_find(dkhash_table *t, unsigned int h, const char *k1, const char *k2)
 {
-	dkhash_bucket *bkt;
+	dkhash_entry *e;
 
-	for (bkt = t->buckets[slot]; bkt; bkt = bkt->next) {
-		if (!strcmp(k1, bkt->key) && bkt->key2 && !strcmp(k2, bkt->key2))
-			return bkt;
-		}
+	if ((e = dkhash_find_in(t->slots, t->num_slots, h, k1, k2)))
+		return e;
+	if (t->old)
+		return dkhash_find_in(t->old, t->old_num_slots, h, k1, k2);
 
 	return NULL;
 }
 
+/* put an entry we know isn't in the table in the first free slot */
+static dkhash_entry *dkhash_place(dkhash_table *t, unsigned int h)
+{
+	unsigned int i, mask = t->num_slots - 1;
+
+	for (i = h & mask; t->slots[i].hash > DKHASH_DELETED; i = (i + 1) & mask)
+		;
+	if (t->slots[i].hash == DKHASH_EMPTY)
+		t->used++;
+	t->slots[i].hash = h;
+
+	return &t->slots[i];
+}
+
+static void dkhash_migrate(dkhash_table *t, unsigned int max)
+{
+	unsigned int end;
+
+	if (!t->old || t->walking)
+		return;
+
+	end = t->old_num_slots - t->old_pos > max ? t->old_pos + max : t->old_num_slots;
+	for (; t->old_pos < end; t->old_pos++) {
+		dkhash_entry *from = &t->old[t->old_pos], *to;
+
+		if (from->hash <= DKHASH_DELETED)
+			continue;
+		to = dkhash_place(t, from->hash);
+		*to = *from;
+		t->old_live--;
+		/* keep probe chains through this slot intact until we're done */
+		from->hash = DKHASH_DELETED;
+	}
+
+	if (t->old_pos == t->old_num_slots) {
+		free(t->old);
+		t->old = NULL;
+		t->old_num_slots = t->old_pos = t->old_live = 0;
+	}
+}
+
+static int dkhash_grow(dkhash_table *t)
+{
+	dkhash_entry *slots;
+	unsigned int num_slots = t->num_slots;
+
+	/*
+	 * only one migration at a time. One that's in progress can't be
+	 * finished while the table is being walked, so we'll have to make
+	 * do with a crowded table until the walk is done
+	 */
+	if (t->old) {
+		if (t->walking)
+			return -1;
+		dkhash_migrate(t, t->old_num_slots);
+	}
+
+	/* if it's mostly deleted entries, a clean array of the same size will do */
+	if (t->entries >= t->num_slots / 2)
+		num_slots *= 2;
+	if (!num_slots || !(slots = calloc(num_slots, sizeof(*slots))))
+		return -1;
+
+	t->old = t->slots;
+	t->old_num_slots = t->num_slots;
+	t->old_pos = 0;
+	t->old_live = t->entries; /* the last migration is done, so that's all of them */
+	t->slots = slots;
+	t->num_slots = num_slots;
+	t->used = 0;
+	dkhash_migrate(t, DKHASH_MIGRATE_STEP);
+
+	return 0;
+}
+
 int dkhash_insert(dkhash_table *t, const char *k1, const char *k2, void *data)
 {
-	unsigned int slot;
-	dkhash_bucket *bkt;
+	unsigned int h;
+	dkhash_entry *e;
 
 	if (!t || !k1)
 		return DKHASH_EINVAL;
 
-	slot = dkhash_slot(t, k1, k2);
-	bkt = k2 ? dkhash_get_bucket2(t, k1, k2, slot) : dkhash_get_bucket(t, k1, slot);
-
-	if (bkt)
+	dkhash_migrate(t, DKHASH_MIGRATE_STEP);
+	h = dkhash_func(k1, k2);
+	if (dkhash_find(t, h, k1, k2))
 		return DKHASH_EDUPE;
 
-	if (!(bkt = malloc(sizeof(*bkt))))
-		return DKHASH_ENOMEM;
+	/* what's still in the old array counts, since it all ends up in the new one */
+	if ((t->used + t->old_live + 1) * 4 > t->num_slots * 3 && dkhash_grow(t) < 0) {
+		/*
+		 * we can live with crowding, but not with a full table, and
+		 * what's still in the old array must fit when it's moved
+		 */
+		if (t->used + t->old_live + 1 >= t->num_slots)
+			return DKHASH_ENOMEM;
+	}
 
-	if (t->buckets[slot])
+	if (t->slots[h & (t->num_slots - 1)].hash > DKHASH_DELETED)
 		t->collisions++; /* "soft" collision */
 
 	t->added++;
-	bkt->data = data;
-	bkt->key = k1;
-	bkt->key2 = k2;
-	bkt->next = t->buckets[slot];
-	t->buckets[slot] = bkt;
+	e = dkhash_place(t, h);
+	e->data = data;
+	e->key = k1;
+	e->key2 = k2;
 
 	if (++t->entries > t->max_entries)
 		t->max_entries = t->entries;
@@ -136,128 +279,103 @@ int dkhash_insert(dkhash_table *t, const char *k1, const char *k2, void *data)
 
 void *dkhash_get(dkhash_table *t, const char *k1, const char *k2)
 {
-	dkhash_bucket *bkt;
-	unsigned int slot;
+	dkhash_entry *e;
 
 	if (!t || !k1)
 		return NULL;
 
-	slot = dkhash_slot(t, k1, k2);
-	bkt = k2 ? dkhash_get_bucket2(t, k1, k2, slot) : dkhash_get_bucket(t, k1, slot);
+	dkhash_migrate(t, DKHASH_MIGRATE_STEP);
+	e = dkhash_find(t, dkhash_func(k1, k2), k1, k2);
 
-	return bkt ? bkt->data : NULL;
+	return e ? e->data : NULL;
 }
 
 dkhash_table *dkhash_create(unsigned int size)
 {
 	dkhash_table *t;
+	unsigned int num_slots = 8;
 
 	if (!size)
 		return NULL;
 
+	while (num_slots < size && num_slots < 1U << 31)
+		num_slots <<= 1;
+
 	if(!(t = calloc(1, sizeof(*t))))
 		return NULL;
 
-	if(!(t->buckets = calloc(size, sizeof(dkhash_bucket *)))) {
+	if(!(t->slots = calloc(num_slots, sizeof(dkhash_entry)))) {
 		free(t);
 		return NULL;
 	}
 
-	t->num_buckets = size;
+	t->num_slots = num_slots;
 	return t;
 }
 
 int dkhash_destroy(dkhash_table *t)
 {
-	unsigned int i;
-
 	if (!t)
 		return DKHASH_EINVAL;
 
-	for (i = 0; i < t->num_buckets; i++) {
-		dkhash_bucket *b, *next;
-		for (b = t->buckets[i]; b; b = next) {
-			next = b->next;
-			free(b);
-		}
-	}
-	free(t->buckets);
+	free(t->old);
+	free(t->slots);
 	free(t);
 	return DKHASH_OK;
 }
 
-static inline void *dkhash_destroy_bucket(dkhash_bucket *bkt)
+static inline void *dkhash_delete_entry(dkhash_table *t, dkhash_entry *e)
 {
-	void *data;
-
-	data = bkt->data;
-	free(bkt);
-	return data;
+	t->entries--;
+	t->removed++;
+	if (t->old && e >= t->old && e < t->old + t->old_num_slots)
+		t->old_live--;
+	e->hash = DKHASH_DELETED;
+	e->key = e->key2 = NULL;
+	return e->data;
 }
 
 void *dkhash_remove(dkhash_table *t, const char *k1, const char *k2)
 {
-	unsigned int slot;
-	dkhash_bucket *bkt, *prev;
+	dkhash_entry *e;
 
 	if (!t || !k1)
 		return NULL;
 
-	slot = dkhash_slot(t, k1, k2);
-	if (!(bkt = t->buckets[slot]))
+	dkhash_migrate(t, DKHASH_MIGRATE_STEP);
+	if (!(e = dkhash_find(t, dkhash_func(k1, k2), k1, k2)))
 		return NULL;
 
-	prev = bkt; /* pay attention */
-	for (; bkt; bkt = bkt->next) {
-		if (strcmp(k1, bkt->key))
+	return dkhash_delete_entry(t, e);
+}
+
+static int dkhash_walk_slots(dkhash_table *t, dkhash_entry *slots, unsigned int num_slots, int (*walker)(void *))
+{
+	unsigned int i;
+
+	for (i = 0; i < num_slots && t->entries; i++) {
+		int ret;
+
+		if (slots[i].hash <= DKHASH_DELETED)
 			continue;
-		if ((!k2 && !bkt->key2) || !strcmp(k2, bkt->key2)) {
-			if (prev == bkt) {
-				/* first entry deleted */
-				t->buckets[slot] = bkt->next;
-			}
-			else {
-				prev->next = bkt->next;
-			}
-			t->entries--;
-			t->removed++;
-			return dkhash_destroy_bucket(bkt);
-		}
+
+		ret = walker(slots[i].data);
+		if (ret & DKHASH_WALK_REMOVE)
+			dkhash_delete_entry(t, &slots[i]);
+		if (ret & DKHASH_WALK_STOP)
+			return DKHASH_WALK_STOP;
 	}
 
-	return NULL;
+	return 0;
 }
 
 void dkhash_walk_data(dkhash_table *t, int (*walker)(void *)) {
-	dkhash_bucket *bkt, *prev;
-	unsigned int i;
-
 	if (!t->entries)
 		return;
 
-	for (i = 0; i < t->num_buckets; i++) {
-		int depth = 0;
-
-		prev = t->buckets[i];
-		dkhash_bucket *next;
-		for (bkt = t->buckets[i]; bkt; bkt = next) {
-			next = bkt->next;
-
-			if (walker(bkt->data) != DKHASH_WALK_REMOVE) {
-				/* only update prev if we don't remove current */
-				prev = bkt;
-				depth++;
-				continue;
-			}
-			t->removed++;
-			t->entries--;
-			dkhash_destroy_bucket(bkt);
-			if (depth) {
-				prev->next = next;
-			}
-			else {
-				t->buckets[i] = next;
-			}
-		}
-	}
+	/* don't move entries around under our own feet */
+	t->walking++;
+	if (!t->old || !dkhash_walk_slots(t, t->old, t->old_num_slots, walker))
+		dkhash_walk_slots(t, t->slots, t->num_slots, walker);
+	t->walking--;
 }
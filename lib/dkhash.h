@@ -32,6 +32,8 @@ typedef struct dkhash_table dkhash_table;
  * Note that it's generally useful to make the table 25-30% larger
  * than the number of items you intend to store, and also note that
  * the 'size' arguments gets rounded up to the nearest power of 2.
+ * Tables that fill up beyond 75% grow on their own, a little at a
+ * time, so getting it wrong only costs a bit of time while they do.
  * @param size The desired size of the hash-table.
  */
 extern dkhash_table *dkhash_create(unsigned int size);
@@ -123,9 +125,10 @@ extern unsigned int dkhash_num_entries_added(dkhash_table *t);
 extern unsigned int dkhash_num_entries_removed(dkhash_table *t);
 
 /**
- * Get actual table size (in number of buckets)
+ * Get actual table size (in number of slots)
+ * This changes as the table grows.
  * @param t The hash table
- * @return Number of bucket-slots in hash table
+ * @return Number of slots in hash table
  */
 extern unsigned int dkhash_table_size(dkhash_table *t);
 #endif /* LIBNAGIOS_dkhash_h__ */
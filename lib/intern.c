@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "intern.h"
+#include "dkhash.h"
+
+/* the shared copy lives right after its reference count */
+struct intern_entry {
+	unsigned int refs;
+	unsigned int len;
+	char str[1];
+};
+
+static dkhash_table *intern_table;
+static unsigned long intern_refs, intern_used, intern_saved;
+
+const char *intern_str(const char *str)
+{
+	struct intern_entry *e;
+	size_t len;
+
+	if (!str)
+		return NULL;
+
+	if (!intern_table && !(intern_table = dkhash_create(4096)))
+		return NULL;
+
+	if ((e = dkhash_get(intern_table, str, NULL))) {
+		e->refs++;
+		intern_refs++;
+		intern_saved += e->len + 1;
+		return e->str;
+	}
+
+	len = strlen(str);
+	if (!(e = malloc(offsetof(struct intern_entry, str) + len + 1)))
+		return NULL;
+	e->refs = 1;
+	e->len = len;
+	memcpy(e->str, str, len + 1);
+	if (dkhash_insert(intern_table, e->str, NULL, e) < 0) {
+		free(e);
+		return NULL;
+	}
+	intern_refs++;
+	intern_used += len + 1;
+
+	return e->str;
+}
+
+const char *intern_get(const char *str)
+{
+	struct intern_entry *e;
+
+	if (!str || !intern_table || !(e = dkhash_get(intern_table, str, NULL)))
+		return NULL;
+
+	return e->str;
+}
+
+void intern_release(const char *str)
+{
+	struct intern_entry *e;
+
+	if (!str)
+		return;
+
+	/* not ours, so it's just some string we were asked to free() */
+	if (!intern_table || !(e = dkhash_get(intern_table, str, NULL)) || e->str != str) {
+		free((char *)str);
+		return;
+	}
+
+	intern_refs--;
+	if (--e->refs) {
+		intern_saved -= e->len + 1;
+		return;
+	}
+
+	dkhash_remove(intern_table, e->str, NULL);
+	intern_used -= e->len + 1;
+	free(e);
+}
+
+unsigned int intern_num_strings(void)
+{
+	return dkhash_num_entries(intern_table);
+}
+
+unsigned long intern_num_refs(void)
+{
+	return intern_refs;
+}
+
+unsigned long intern_bytes(void)
+{
+	return intern_used;
+}
+
+unsigned long intern_bytes_saved(void)
+{
+	return intern_saved;
+}
@@ -0,0 +1,83 @@
+#ifndef LIBNAGIOS_intern_h__
+#define LIBNAGIOS_intern_h__
+#include <string.h>
+
+/**
+ * @file intern.h
+ * @brief String interning
+ *
+ * Host names, service descriptions, contact names and check commands
+ * get copied into objects, group members, comments, downtimes and
+ * check results. With interning, all copies of the same string are
+ * one shared, immutable, reference counted copy, which saves a lot
+ * of memory on large configurations and lets equality tests start
+ * with a pointer comparison.
+ *
+ * Interned strings must never be modified or free()'d directly.
+ * This is not thread safe.
+ * @{
+ */
+
+/**
+ * Get the shared copy of a string, creating it if need be
+ * Every call takes a reference that must be given back with
+ * intern_release() when the caller is done with the string.
+ * @param str The string to intern
+ * @return The shared copy on success, NULL on errors
+ */
+extern const char *intern_str(const char *str);
+
+/**
+ * Look up the shared copy of a string without taking a reference
+ * @param str The string to look for
+ * @return The shared copy if there is one, otherwise NULL
+ */
+extern const char *intern_get(const char *str);
+
+/**
+ * Release a reference taken with intern_str()
+ * The shared copy is freed when its last reference is released.
+ * Strings that didn't come from intern_str() are free()'d, so
+ * this can safely replace free() for anything that might have
+ * been strdup()'d by someone else instead.
+ * @param str The string to release
+ */
+extern void intern_release(const char *str);
+
+/**
+ * Get the number of distinct strings currently interned
+ * @return The number of shared copies
+ */
+extern unsigned int intern_num_strings(void);
+
+/**
+ * Get the number of references currently held on interned strings
+ * @return Number of references
+ */
+extern unsigned long intern_num_refs(void);
+
+/**
+ * Get the number of bytes used by interned strings
+ * @return Bytes used by the shared copies, nul bytes included
+ */
+extern unsigned long intern_bytes(void);
+
+/**
+ * Get the number of bytes saved by interning
+ * @return Bytes that one copy per reference would have used on top
+ * of what the shared copies use
+ */
+extern unsigned long intern_bytes_saved(void);
+
+/** Release an interned string and set the pointer to NULL */
+#define intern_free(ptr) { if(ptr) { intern_release(ptr); ptr = NULL; } } (void)1
+
+/**
+ * Compare strings, at least one of which is likely to be interned
+ * Equal interned strings are the same pointer, so most matches are
+ * found without looking at the strings at all.
+ */
+#define intern_streq(a, b) ((a) == (b) || !strcmp((a), (b)))
+
+/** @} */
+#endif /* LIBNAGIOS_intern_h__ */
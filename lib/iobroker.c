@@ -241,6 +241,34 @@ int iobroker_register_out(iobroker_set *iobs, int fd, void *arg, int (*handler)(
 #endif
 }
 
+int iobroker_watch_out(iobroker_set *iobs, int fd, int on)
+{
+	iobroker_fd *s;
+	int events;
+
+	if (!iobs)
+		return IOBROKER_ENOSET;
+
+	if (fd < 0 || fd >= iobs->max_fds || !(s = iobs->iobroker_fds[fd]))
+		return IOBROKER_EINVAL;
+
+#ifdef IOBROKER_USES_EPOLL
+	events = on ? s->events | EPOLLOUT : s->events & ~EPOLLOUT;
+	if (events != s->events) {
+		struct epoll_event ev;
+		ev.events = events;
+		ev.data.fd = fd;
+		if (epoll_ctl(iobs->epfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+			return IOBROKER_ELIB;
+	}
+#else
+	events = on ? s->events | POLLOUT : s->events & ~POLLOUT;
+#endif
+	s->events = events;
+
+	return 0;
+}
+
 int iobroker_is_registered(iobroker_set *iobs, int fd)
 {
 	if (!iobs || fd < 0 || fd > iobs->max_fds || !iobs->iobroker_fds[fd])
@@ -371,42 +399,48 @@ int iobroker_poll(iobroker_set *iobs, int timeout)
 	 * used if epoll() or poll() doesn't work properly.
 	 */
 	{
-		fd_set read_fds;
+		fd_set read_fds, write_fds;
 		int num_fds = 0;
 		struct timeval tv;
 
 		FD_ZERO(&read_fds);
+		FD_ZERO(&write_fds);
 		for (i = 0; i < iobs->max_fds; i++) {
 			if (!iobs->iobroker_fds[i])
 				continue;
 			num_fds++;
-			FD_SET(iobs->iobroker_fds[i]->fd, &read_fds);
+			if (iobs->iobroker_fds[i]->events & POLLIN)
+				FD_SET(iobs->iobroker_fds[i]->fd, &read_fds);
+			if (iobs->iobroker_fds[i]->events & POLLOUT)
+				FD_SET(iobs->iobroker_fds[i]->fd, &write_fds);
 			if (num_fds == iobs->num_fds)
 				break;
 		}
 		if (timeout >= 0) {
 			tv.tv_sec = timeout / 1000;
 			tv.tv_usec = (timeout % 1000) * 1000;
-			nfds = select(iobs->max_fds, &read_fds, NULL, NULL, &tv);
+			nfds = select(iobs->max_fds, &read_fds, &write_fds, NULL, &tv);
 		} else { /* timeout of -1 means poll indefinitely */
-			nfds = select(iobs->max_fds, &read_fds, NULL, NULL, NULL);
+			nfds = select(iobs->max_fds, &read_fds, &write_fds, NULL, NULL);
 		}
 		if (nfds < 0) {
 			return IOBROKER_ELIB;
 		}
 		num_fds = 0;
 		for (i = 0; i < iobs->max_fds; i++) {
-			if (!iobs->iobroker_fds[i])
+			iobroker_fd *s = iobs->iobroker_fds[i];
+			int events = 0;
+
+			if (!s)
 				continue;
-			if (FD_ISSET(iobs->iobroker_fds[i]->fd, &read_fds)) {
-				iobroker_fd *s = iobs->iobroker_fds[i];
-				if (!s) {
-					/* this should be logged somehow */
-					continue;
-				}
-				s->handler(s->fd, POLLIN, s->arg);
-				ret++;
-			}
+			if (FD_ISSET(s->fd, &read_fds))
+				events |= POLLIN;
+			if (FD_ISSET(s->fd, &write_fds))
+				events |= POLLOUT;
+			if (!events)
+				continue;
+			s->handler(s->fd, events, s->arg);
+			ret++;
 		}
 	}
 #else
@@ -421,7 +455,7 @@ int iobroker_poll(iobroker_set *iobs, int timeout)
 			if (!iobs->iobroker_fds[i])
 				continue;
 			iobs->pfd[p].fd = iobs->iobroker_fds[i]->fd;
-			iobs->pfd[p].events = POLLIN;
+			iobs->pfd[p].events = iobs->iobroker_fds[i]->events;
 			p++;
 		}
 		nfds = poll(iobs->pfd, iobs->num_fds, timeout);
@@ -430,7 +464,7 @@ int iobroker_poll(iobroker_set *iobs, int timeout)
 		}
 		for (i = 0; i < iobs->num_fds; i++) {
 			iobroker_fd *s;
-			if ((iobs->pfd[i].revents & POLLIN) != POLLIN) {
+			if (!(iobs->pfd[i].revents & (POLLIN | POLLOUT))) {
 				continue;
 			}
 
@@ -91,6 +91,21 @@ extern int iobroker_register(iobroker_set *iobs, int sd, void *arg, int (*handle
  */
 extern int iobroker_register_out(iobroker_set *iobs, int sd, void *arg, int (*handler)(int, int, void *));
 
+/**
+ * Start or stop polling an already registered socket for output
+ * The socket's handler is called with IOBROKER_POLLOUT set in its
+ * events when writing to it won't block, in addition to whatever
+ * it's registered for. This lets one handler read from a socket
+ * and finish writes that didn't make it all the way.
+ *
+ * @param iobs The socket set the socket is registered with
+ * @param sd The socket descriptor
+ * @param on Nonzero to start polling for output, zero to stop
+ *
+ * @return 0 on success. < 0 on errors
+ */
+extern int iobroker_watch_out(iobroker_set *iobs, int sd, int on);
+
 /**
  * Check if a particular filedescriptor is registered with the iobroker set
  * @param[in] iobs The iobroker set the filedescriptor should be member of
@@ -13,11 +13,15 @@
 #include "iobroker.h"
 #include "iocache.h"
 #include "runcmd.h"
+#include "probe.h"
 #include "bitmap.h"
 #include "dkhash.h"
+#include "intern.h"
 #include "worker.h"
 #include "skiplist.h"
 #include "nsock.h"
 #include "nspath.h"
+#include "trace.h"
+#include "twheel.h"
 #include "snprintf.h"
 #endif /* LIB_libnagios_h__ */
@@ -0,0 +1,505 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "iobroker.h"
+#include "runcmd.h"
+#include "probe.h"
+
+#define PROBE_TCP  0
+#define PROBE_HTTP 1
+
+#define PROBE_OK       0
+#define PROBE_WARNING  1
+#define PROBE_CRITICAL 2
+#define PROBE_UNKNOWN  3
+
+#define PROBE_BUFSIZE 4096 /* we only look at the start of responses */
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+static const char *state_name[] = { "OK", "WARNING", "CRITICAL", "UNKNOWN" };
+
+struct probe {
+	int type;
+	int sd;
+	iobroker_set *iobs;
+	probe_callback cb;
+	void *arg;
+	char *host, *port, *uri, *expect;
+	char *send; /* what to write once connected */
+	size_t send_len, sent;
+	double warn, crit;
+	int have_warn, have_crit;
+	struct timeval start;
+	char buf[PROBE_BUFSIZE];
+	size_t len; /* bytes kept in buf */
+	unsigned long total; /* bytes received */
+};
+
+int probe_is_native(const char *cmd)
+{
+	return cmd && *cmd == PROBE_PREFIX;
+}
+
+static void probe_destroy(probe *p)
+{
+	if (p->sd >= 0) {
+		if (iobroker_is_registered(p->iobs, p->sd))
+			iobroker_close(p->iobs, p->sd);
+		else
+			close(p->sd);
+	}
+	free(p->host);
+	free(p->port);
+	free(p->uri);
+	free(p->expect);
+	free(p->send);
+	free(p);
+}
+
+void probe_cancel(probe *p)
+{
+	if (p)
+		probe_destroy(p);
+}
+
+/* hands the result to our caller and gets rid of the probe */
+static void probe_finish(probe *p, int state, const char *fmt, ...)
+	__attribute__((__format__(__printf__, 3, 4)));
+static void probe_finish(probe *p, int state, const char *fmt, ...)
+{
+	char output[PROBE_BUFSIZE * 2];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(output, sizeof(output), fmt, ap);
+	va_end(ap);
+
+	p->cb(state, output, p->arg);
+	probe_destroy(p);
+}
+
+static double probe_elapsed(probe *p)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - p->start.tv_sec) + ((now.tv_usec - p->start.tv_usec) / 1000000.0);
+}
+
+static int probe_time_state(probe *p, double elapsed)
+{
+	if (p->have_crit && elapsed > p->crit)
+		return PROBE_CRITICAL;
+	if (p->have_warn && elapsed > p->warn)
+		return PROBE_WARNING;
+	return PROBE_OK;
+}
+
+/* "time=0.001234s;<warn>;<crit>;0.000000", like the plugins print it */
+static const char *probe_perf_time(probe *p, double elapsed)
+{
+	static char perf[128];
+	char warn[32] = "", crit[32] = "";
+
+	if (p->have_warn)
+		sprintf(warn, "%f", p->warn);
+	if (p->have_crit)
+		sprintf(crit, "%f", p->crit);
+	snprintf(perf, sizeof(perf), "time=%fs;%s;%s;0.000000", elapsed, warn, crit);
+	return perf;
+}
+
+/* the first line of whatever we've received */
+static const char *probe_first_line(probe *p)
+{
+	static char line[PROBE_BUFSIZE];
+	size_t len;
+
+	len = strcspn(p->buf, "\r\n");
+	memcpy(line, p->buf, len);
+	line[len] = 0;
+	return line;
+}
+
+static void probe_tcp_done(probe *p)
+{
+	double elapsed = probe_elapsed(p);
+	int state;
+
+	if (p->expect && !strstr(p->buf, p->expect)) {
+		probe_finish(p, PROBE_WARNING, "TCP WARNING - Unexpected response from host/socket on port %s: %s|%s\n",
+		             p->port, probe_first_line(p), probe_perf_time(p, elapsed));
+		return;
+	}
+
+	state = probe_time_state(p, elapsed);
+	probe_finish(p, state, "TCP %s - %.3f second response time on %s port %s%s%s%s|%s\n",
+	             state_name[state], elapsed, p->host, p->port,
+	             p->expect ? " [" : "", p->expect ? probe_first_line(p) : "", p->expect ? "]" : "",
+	             probe_perf_time(p, elapsed));
+}
+
+/* does any of the comma-separated strings in 'expect' occur in 'str'? */
+static int probe_expect_any(const char *expect, const char *str)
+{
+	const char *comma;
+	char want[256];
+	size_t len;
+
+	for (;;) {
+		comma = strchr(expect, ',');
+		len = comma ? (size_t)(comma - expect) : strlen(expect);
+		if (len && len < sizeof(want)) {
+			memcpy(want, expect, len);
+			want[len] = 0;
+			if (strstr(str, want))
+				return 1;
+		}
+		if (!comma)
+			return 0;
+		expect = comma + 1;
+	}
+}
+
+static void probe_http_done(probe *p)
+{
+	double elapsed = probe_elapsed(p);
+	const char *status;
+	char *space;
+	int state, code, time_state;
+
+	status = probe_first_line(p);
+	space = strchr(status, ' ');
+	if (strncmp(status, "HTTP/", 5) || !space) {
+		probe_finish(p, PROBE_CRITICAL, "HTTP CRITICAL - Invalid HTTP response received from host on port %s\n", p->port);
+		return;
+	}
+
+	if (p->expect) {
+		if (!probe_expect_any(p->expect, status)) {
+			probe_finish(p, PROBE_CRITICAL, "HTTP CRITICAL - Invalid HTTP response received from host on port %s: %s\n",
+			             p->port, status);
+			return;
+		}
+		state = PROBE_OK;
+	} else {
+		code = atoi(space + 1);
+		if (code >= 500)
+			state = PROBE_CRITICAL;
+		else if (code >= 400)
+			state = PROBE_WARNING;
+		else if (code >= 100)
+			state = PROBE_OK;
+		else
+			state = PROBE_CRITICAL;
+	}
+
+	time_state = probe_time_state(p, elapsed);
+	if (time_state > state)
+		state = time_state;
+
+	probe_finish(p, state, "HTTP %s: %s - %lu bytes in %.3f second response time |%s size=%luB;;;0\n",
+	             state_name[state], status, p->total, elapsed, probe_perf_time(p, elapsed), p->total);
+}
+
+static int probe_read_handler(int sd, int events, void *arg)
+{
+	probe *p = (probe *)arg;
+	char discard[PROBE_BUFSIZE];
+	char *dst = discard;
+	size_t room = sizeof(discard);
+	ssize_t rd;
+
+	if (p->len < sizeof(p->buf) - 1) {
+		dst = p->buf + p->len;
+		room = sizeof(p->buf) - 1 - p->len;
+	}
+
+	rd = read(sd, dst, room);
+	if (rd < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		probe_finish(p, PROBE_CRITICAL, "Error receiving from %s port %s: %s\n", p->host, p->port, strerror(errno));
+		return 0;
+	}
+
+	p->total += rd;
+	if (dst != discard) {
+		p->len += rd;
+		p->buf[p->len] = 0;
+	}
+
+	if (p->type == PROBE_HTTP) {
+		if (!rd)
+			probe_http_done(p);
+		return 0;
+	}
+
+	/* banners are one line, so wait for that unless we match first */
+	if (!rd || strstr(p->buf, p->expect) || strchr(p->buf, '\n') || p->len == sizeof(p->buf) - 1)
+		probe_tcp_done(p);
+
+	return 0;
+}
+
+/* returns 1 if the probe is done, and 0 if we're waiting for more */
+static int probe_wait_reply(probe *p)
+{
+	if (p->type == PROBE_TCP && !p->expect) {
+		probe_tcp_done(p);
+		return 1;
+	}
+
+	if (iobroker_register(p->iobs, p->sd, p, probe_read_handler) < 0) {
+		probe_finish(p, PROBE_UNKNOWN, "Failed to register socket with iobroker\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int probe_write_handler(int sd, int events, void *arg)
+{
+	probe *p = (probe *)arg;
+	ssize_t wr;
+
+	/* a peer hanging up on us mustn't SIGPIPE our caller */
+	wr = send(sd, p->send + p->sent, p->send_len - p->sent, MSG_NOSIGNAL);
+	if (wr < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		probe_finish(p, PROBE_CRITICAL, "Error sending to %s port %s: %s\n", p->host, p->port, strerror(errno));
+		return 0;
+	}
+
+	p->sent += wr;
+	if (p->sent < p->send_len)
+		return 0;
+
+	iobroker_unregister(p->iobs, sd);
+	probe_wait_reply(p);
+	return 0;
+}
+
+static int probe_connected(probe *p)
+{
+	if (p->sent < p->send_len) {
+		if (iobroker_register_out(p->iobs, p->sd, p, probe_write_handler) < 0) {
+			probe_finish(p, PROBE_UNKNOWN, "Failed to register socket with iobroker\n");
+			return 1;
+		}
+		return 0;
+	}
+
+	return probe_wait_reply(p);
+}
+
+static int probe_connect_handler(int sd, int events, void *arg)
+{
+	probe *p = (probe *)arg;
+	int error = 0;
+	socklen_t optlen = sizeof(error);
+
+	if (getsockopt(sd, SOL_SOCKET, SO_ERROR, &error, &optlen) < 0)
+		error = errno;
+	if (error) {
+		probe_finish(p, PROBE_CRITICAL, "connect to address %s and port %s: %s\n", p->host, p->port, strerror(error));
+		return 0;
+	}
+
+	iobroker_unregister(p->iobs, sd);
+	probe_connected(p);
+	return 0;
+}
+
+/* returns 1 if the probe is done, and 0 if it's under way */
+static int probe_connect(probe *p)
+{
+	struct addrinfo hints, *ai;
+	int ret;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_NUMERICSERV;
+	if ((ret = getaddrinfo(p->host, p->port, &hints, &ai))) {
+		probe_finish(p, PROBE_CRITICAL, "Invalid hostname, address or socket: %s (%s)\n", p->host, gai_strerror(ret));
+		return 1;
+	}
+
+	p->sd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+	if (p->sd < 0) {
+		freeaddrinfo(ai);
+		probe_finish(p, PROBE_UNKNOWN, "Failed to create socket: %s\n", strerror(errno));
+		return 1;
+	}
+	fcntl(p->sd, F_SETFD, FD_CLOEXEC);
+	fcntl(p->sd, F_SETFL, O_NONBLOCK);
+
+	gettimeofday(&p->start, NULL);
+	ret = connect(p->sd, ai->ai_addr, ai->ai_addrlen);
+	freeaddrinfo(ai);
+	if (!ret)
+		return probe_connected(p);
+
+	if (errno != EINPROGRESS) {
+		probe_finish(p, PROBE_CRITICAL, "connect to address %s and port %s: %s\n", p->host, p->port, strerror(errno));
+		return 1;
+	}
+
+	if (iobroker_register_out(p->iobs, p->sd, p, probe_connect_handler) < 0) {
+		probe_finish(p, PROBE_UNKNOWN, "Failed to register socket with iobroker\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/* parses the arguments. Returns an error message, or NULL on success */
+static const char *probe_parse(probe *p, const char *cmd)
+{
+	static char msg[128];
+	char **argv;
+	int argc = 0, i;
+	const char *ret = NULL;
+
+	argv = calloc(strlen(cmd) / 2 + 2, sizeof(char *));
+	if (!argv)
+		return "Failed to allocate memory";
+
+	if (runcmd_cmd2strv(cmd + 1, &argc, argv) || !argc) {
+		ret = "Could not parse arguments";
+		goto out;
+	}
+
+	if (!strcmp(argv[0], "check_tcp")) {
+		p->type = PROBE_TCP;
+	} else if (!strcmp(argv[0], "check_http")) {
+		p->type = PROBE_HTTP;
+	} else {
+		snprintf(msg, sizeof(msg), "Unknown probe '%s'", argv[0]);
+		ret = msg;
+		goto out;
+	}
+
+	for (i = 1; i < argc; i++) {
+		const char *opt = argv[i], *val = argv[i + 1];
+
+		if (opt[0] != '-' || !opt[1] || opt[2] || i + 1 >= argc) {
+			snprintf(msg, sizeof(msg), "Invalid argument '%s'", opt);
+			ret = msg;
+			goto out;
+		}
+		i++;
+
+		switch (opt[1]) {
+		case 'H': case 'I':
+			free(p->host);
+			p->host = strdup(val);
+			break;
+		case 'p':
+			free(p->port);
+			p->port = strdup(val);
+			break;
+		case 'u':
+			free(p->uri);
+			p->uri = strdup(val);
+			break;
+		case 's':
+			free(p->send);
+			p->send = strdup(val);
+			break;
+		case 'e':
+			free(p->expect);
+			p->expect = strdup(val);
+			break;
+		case 'w':
+			p->warn = strtod(val, NULL);
+			p->have_warn = 1;
+			break;
+		case 'c':
+			p->crit = strtod(val, NULL);
+			p->have_crit = 1;
+			break;
+		case 't':
+			/* the caller takes care of timeouts */
+			break;
+		default:
+			snprintf(msg, sizeof(msg), "Invalid argument '%s'", opt);
+			ret = msg;
+			goto out;
+		}
+	}
+
+	if (!p->host) {
+		ret = "No host specified";
+		goto out;
+	}
+	if (!p->port) {
+		if (p->type == PROBE_TCP) {
+			ret = "No port specified";
+			goto out;
+		}
+		p->port = strdup("80");
+	}
+
+	if (p->type == PROBE_HTTP) {
+		const char *uri = p->uri ? p->uri : "/";
+		size_t len = strlen(uri) + strlen(p->host) + 128;
+
+		free(p->send);
+		if (!(p->send = malloc(len))) {
+			ret = "Failed to allocate memory";
+			goto out;
+		}
+		snprintf(p->send, len, "GET %s HTTP/1.0\r\nHost: %s\r\nUser-Agent: nagios-probe\r\nConnection: close\r\n\r\n",
+		         uri, p->host);
+	}
+	if (p->send)
+		p->send_len = strlen(p->send);
+
+out:
+	if (argc)
+		free(argv[0]);
+	free(argv);
+	return ret;
+}
+
+probe *probe_start(iobroker_set *iobs, const char *cmd, probe_callback cb, void *arg)
+{
+	const char *error;
+	probe *p;
+
+	if (!(p = calloc(1, sizeof(*p)))) {
+		cb(PROBE_UNKNOWN, "Failed to allocate memory for probe\n", arg);
+		return NULL;
+	}
+	p->sd = -1;
+	p->iobs = iobs;
+	p->cb = cb;
+	p->arg = arg;
+
+	if (!probe_is_native(cmd)) {
+		probe_finish(p, PROBE_UNKNOWN, "Not a native probe: %s\n", cmd);
+		return NULL;
+	}
+	if ((error = probe_parse(p, cmd))) {
+		probe_finish(p, PROBE_UNKNOWN, "%s\n", error);
+		return NULL;
+	}
+
+	if (probe_connect(p))
+		return NULL;
+
+	return p;
+}
@@ -0,0 +1,69 @@
+#ifndef INCLUDE_probe_h__
+#define INCLUDE_probe_h__
+
+/**
+ * @file probe.h
+ * @brief Native network probes
+ *
+ * Most network checks are a plugin doing one connect() and maybe a
+ * read() and a write(), which is dwarfed by the cost of starting the
+ * plugin in the first place. These probes do the same work inside
+ * the calling process, driven by an iobroker set, and report the
+ * same kind of output and performance data the plugins would.
+ *
+ * Probes are selected by prefixing the plugin name with
+ * PROBE_PREFIX in the command line, and take a subset of the
+ * arguments the real plugins do:
+ * @verbatim
+ * @check_tcp -H <address> -p <port> [-s <send>] [-e <expect>] [-w <warn>] [-c <crit>]
+ * @check_http -H <address> [-p <port>] [-u <uri>] [-e <expect>] [-w <warn>] [-c <crit>]
+ * @endverbatim
+ * Host names are resolved synchronously, so addresses are preferred.
+ * Probes have no timeout of their own. Callers cancel probes that
+ * take too long.
+ *
+ * @{
+ */
+
+#define PROBE_PREFIX '@' /**< commands starting with this are probes */
+
+/** Opaque type. Callers needn't worry about this */
+struct probe;
+typedef struct probe probe;
+
+/**
+ * Called once when a probe finishes
+ * @param state The plugin return code (0 = OK, 1 = WARNING, ...)
+ * @param output Plugin output, including performance data
+ * @param arg The argument passed to probe_start()
+ */
+typedef void (*probe_callback)(int state, const char *output, void *arg);
+
+/**
+ * Check if a command should be run as a native probe
+ * @param cmd The command line to check
+ * @return 1 if the command names a probe, 0 otherwise
+ */
+extern int probe_is_native(const char *cmd);
+
+/**
+ * Start a native probe.
+ * If this returns NULL, the probe finished right away and the
+ * callback has already been called, so the caller must not touch
+ * anything the callback might have released.
+ * @param iobs The iobroker set driving the probe
+ * @param cmd The command line of the probe
+ * @param cb Function to call with the result
+ * @param arg Argument passed to the callback
+ * @return The running probe, or NULL if it's already done
+ */
+extern probe *probe_start(iobroker_set *iobs, const char *cmd, probe_callback cb, void *arg);
+
+/**
+ * Abort a running probe without calling its callback
+ * @param p The probe to abort
+ */
+extern void probe_cancel(probe *p);
+
+#endif /* INCLUDE_probe_h__ */
+/** @} */
@@ -17,18 +17,31 @@
  */
 
 #define NAGIOSPLUG_API_C 1
+#define _GNU_SOURCE 1 /* for posix_spawn_file_actions_addclosefrom_np() */
 
 /* includes **/
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
 #include <errno.h>
 #include "runcmd.h"
 
+extern char **environ;
+
+/* glibc can close inherited descriptors as part of posix_spawn() */
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+# define RUNCMD_HAVE_SPAWN_CLOSEFROM 1
+#endif
+
 
 /** macros **/
 #ifndef WEXITSTATUS
@@ -53,6 +66,8 @@
  * occur in any number of threads simultaneously. */
 static pid_t *pids = NULL;
 
+static int spawn_method = RUNCMD_SPAWN_POSIX;
+
 /* If OPEN_MAX isn't defined, we try the sysconf syscall first.
  * If that fails, we fall back to an educated guess which is accurate
  * on Linux and some other systems. There's no guarantee that our guess is
@@ -88,6 +103,13 @@ const char *runcmd_strerror(int code)
 	return "unknown";
 }
 
+int runcmd_set_spawn_method(int method)
+{
+	int old = spawn_method;
+	spawn_method = method;
+	return old;
+}
+
 /* yield the pid belonging to a particular file descriptor */
 pid_t runcmd_pid(int fd)
 {
@@ -278,15 +300,129 @@ void runcmd_init(void)
 }
 
 
+/*
+ * Our ends of the pipes must never leak into other children,
+ * so we mark them close-on-exec instead of hunting them down
+ * in every child we start.
+ */
+static int runcmd_pipe(int *fds)
+{
+	if (pipe(fds) < 0)
+		return -1;
+	(void)fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	(void)fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	return 0;
+}
+
+/*
+ * Closes everything but stdin, stdout and stderr in a forked child.
+ * The pipes are all close-on-exec already, so this only catches
+ * descriptors our caller forgot to mark.
+ */
+static void runcmd_close_fds(void)
+{
+	int i;
+
+#if defined(__linux__) && defined(SYS_close_range)
+	if (!syscall(SYS_close_range, 3, ~0U, 0))
+		return;
+#endif
+
+	/* close all descriptors in pids[]
+	 * This is executed in a separate address space (pure child),
+	 * so we don't have to worry about async safety */
+	for (i = 0; i < maxfd; i++)
+		if(pids[i] > 0)
+			close (i);
+}
+
+#ifndef RUNCMD_HAVE_SPAWN_CLOSEFROM
+/*
+ * Without posix_spawn_file_actions_addclosefrom_np() we have to name
+ * each descriptor to close. Ours are close-on-exec, so only the ones
+ * that aren't would leak.
+ */
+static int runcmd_spawn_close_inherited(posix_spawn_file_actions_t *fa)
+{
+	int fd, flags, ret;
+
+	for (fd = STDERR_FILENO + 1; fd < maxfd; fd++) {
+		if ((flags = fcntl(fd, F_GETFD)) < 0 || (flags & FD_CLOEXEC))
+			continue;
+		if ((ret = posix_spawn_file_actions_addclose(fa, fd)))
+			return ret;
+	}
+	return 0;
+}
+#endif
+
+/*
+ * Launch a command with posix_spawn(), which is vfork()-based on
+ * most systems, so the cost doesn't grow with the size of the caller.
+ * fds[] are stdin, stdout and stderr for the child, -1 to leave one
+ * alone. Where we can't close everything else as part of the spawn,
+ * only callers that asked for it get inherited descriptors closed,
+ * since finding them costs a syscall per possible descriptor.
+ */
+static pid_t runcmd_spawn_fds(char **argv, const int *fds, int close_inherited)
+{
+	posix_spawn_file_actions_t fa;
+	pid_t pid;
+	int i, ret;
+
+	if ((ret = posix_spawn_file_actions_init(&fa))) {
+		errno = ret;
+		return -1;
+	}
+	for (i = STDIN_FILENO; !ret && i <= STDERR_FILENO; i++) {
+		if (fds[i] >= 0)
+			ret = posix_spawn_file_actions_adddup2(&fa, fds[i], i);
+	}
+#ifdef RUNCMD_HAVE_SPAWN_CLOSEFROM
+	if (!ret)
+		ret = posix_spawn_file_actions_addclosefrom_np(&fa, STDERR_FILENO + 1);
+#else
+	if (!ret && close_inherited)
+		ret = runcmd_spawn_close_inherited(&fa);
+#endif
+	if (!ret)
+		ret = posix_spawnp(&pid, argv[0], &fa, NULL, argv, environ);
+	posix_spawn_file_actions_destroy(&fa);
+
+	if (ret) {
+		errno = ret;
+		return -1;
+	}
+	return pid;
+}
+
+pid_t runcmd_spawn(char **argv, int infd, int outfd, int errfd)
+{
+	int fds[3];
+
+	if (!argv || !argv[0] || (infd >= 0 && infd <= STDERR_FILENO) ||
+	    (outfd >= 0 && outfd <= STDERR_FILENO) || (errfd >= 0 && errfd <= STDERR_FILENO))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (!pids)
+		runcmd_init();
+
+	fds[STDIN_FILENO] = infd;
+	fds[STDOUT_FILENO] = outfd;
+	fds[STDERR_FILENO] = errfd;
+	return runcmd_spawn_fds(argv, fds, 1);
+}
+
 /* Start running a command */
 int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env)
 {
 	char **argv = NULL;
 	int cmd2strv_errors, argc = 0;
 	size_t cmdlen;
-	pid_t pid;
-
-	int i = 0;
+	pid_t pid = -1;
 
 	if(!pids)
 		runcmd_init();
@@ -317,7 +453,7 @@ int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env)
 		argv[3] = NULL;
 	}
 
-	if (pipe(pfd) < 0) {
+	if (runcmd_pipe(pfd) < 0) {
 		if (!cmd2strv_errors)
 			free(argv[0]);
 		else
@@ -325,7 +461,7 @@ int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env)
 		free(argv);
 		return RUNCMD_ECMD;
 	}
-	if (pipe(pfderr) < 0) {
+	if (runcmd_pipe(pfderr) < 0) {
 		if (!cmd2strv_errors)
 			free(argv[0]);
 		else
@@ -335,7 +471,41 @@ int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env)
 		close(pfd[1]);
 		return RUNCMD_EFD;
 	}
-	pid = fork();
+
+	/*
+	 * dup2()'ing a close-on-exec descriptor onto itself would leave
+	 * the child without stdout or stderr, so if our caller runs
+	 * without those we let the fork() path sort it out instead.
+	 */
+	if (spawn_method == RUNCMD_SPAWN_POSIX &&
+	    pfd[1] > STDERR_FILENO && pfderr[1] > STDERR_FILENO)
+	{
+		int fds[3] = { -1, pfd[1], pfderr[1] };
+
+		pid = runcmd_spawn_fds(argv, fds, 0);
+
+		/*
+		 * a command that can't be executed is reported by the
+		 * child in the fork() path, so plugins that are missing
+		 * or not executable get the same output and exit code
+		 * regardless of how they were launched.
+		 */
+		if (pid < 0 && (errno == EAGAIN || errno == ENOMEM)) {
+			if (!cmd2strv_errors)
+				free(argv[0]);
+			else
+				free(argv[2]);
+			free(argv);
+			close(pfd[0]);
+			close(pfd[1]);
+			close(pfderr[0]);
+			close(pfderr[1]);
+			return RUNCMD_EFORK;
+		}
+	}
+
+	if (pid < 0)
+		pid = fork();
 	if (pid < 0) {
 		if (!cmd2strv_errors)
 			free(argv[0]);
@@ -355,21 +525,20 @@ int runcmd_open(const char *cmd, int *pfd, int *pfderr, char **env)
 		if (pfd[1] != STDOUT_FILENO) {
 			dup2 (pfd[1], STDOUT_FILENO);
 			close (pfd[1]);
+		} else {
+			(void)fcntl(STDOUT_FILENO, F_SETFD, 0);
 		}
 		close (pfderr[0]);
 		if (pfderr[1] != STDERR_FILENO) {
 			dup2 (pfderr[1], STDERR_FILENO);
 			close (pfderr[1]);
+		} else {
+			(void)fcntl(STDERR_FILENO, F_SETFD, 0);
 		}
 
-		/* close all descriptors in pids[]
-		 * This is executed in a separate address space (pure child),
-		 * so we don't have to worry about async safety */
-		for (i = 0; i < maxfd; i++)
-			if(pids[i] > 0)
-				close (i);
+		runcmd_close_fds();
 
-		i = execvp(argv[0], argv);
+		execvp(argv[0], argv);
 		fprintf(stderr, "execvp(%s, ...) failed. errno is %d: %s\n", argv[0], errno, strerror(errno));
 		if (!cmd2strv_errors)
 			free(argv[0]);
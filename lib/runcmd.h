@@ -28,6 +28,9 @@
 #define RUNCMD_EINVAL (-5)  /**< Invalid parameters */
 #define RUNCMD_EWAIT  (-6)  /**< Failed to wait() */
 
+#define RUNCMD_SPAWN_POSIX 0 /**< launch commands with posix_spawn() (default) */
+#define RUNCMD_SPAWN_FORK  1 /**< launch commands with fork() and execvp() */
+
 /**
  * Initialize the runcmd library.
  *
@@ -37,6 +40,31 @@
  */
 extern void runcmd_init(void);
 
+/**
+ * Pick how runcmd_open() launches commands.
+ * posix_spawn() doesn't have to copy the caller's page tables the
+ * way fork() does, so it's a lot cheaper for large processes. If it
+ * can't be used for a particular command, fork() is used instead.
+ * @param[in] method One of the RUNCMD_SPAWN_* constants
+ * @return The previously used method
+ */
+extern int runcmd_set_spawn_method(int method);
+
+/**
+ * Launch a program with posix_spawn()
+ * The child gets infd, outfd and errfd as its stdin, stdout and
+ * stderr, and none of the caller's other descriptors. This is for
+ * programs that outlive a single command, so the caller reaps it
+ * and nothing is tracked for runcmd_close().
+ * @param[in] argv Program and arguments. argv[0] is looked up in $PATH
+ * @param[in] infd Descriptor to use as stdin, or -1 to inherit it
+ * @param[in] outfd Descriptor to use as stdout, or -1 to inherit it
+ * @param[in] errfd Descriptor to use as stderr, or -1 to inherit it
+ * @return pid of the child on success, -1 with errno set on errors.
+ *         Descriptors 0 to 2 can't be handed over (EINVAL).
+ */
+extern pid_t runcmd_spawn(char **argv, int infd, int outfd, int errfd);
+
 /**
  * Return pid of a command with a specific file descriptor
  * @param[in] fd stdout filedescriptor of the child to get pid from
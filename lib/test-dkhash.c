@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include "dkhash.c"
 #include "t-utils.h"
 
@@ -26,9 +27,12 @@ unsigned int dkhash_count_entries(dkhash_table *table)
 {
 	unsigned int i, count = 0;
 
-	for (i = 0; i < table->num_buckets; i++) {
-		dkhash_bucket *bkt;
-		for (bkt = table->buckets[i]; bkt; bkt = bkt->next)
+	for (i = 0; i < table->num_slots; i++) {
+		if (table->slots[i].hash > DKHASH_DELETED)
+			count++;
+	}
+	for (i = 0; table->old && i < table->old_num_slots; i++) {
+		if (table->old[i].hash > DKHASH_DELETED)
 			count++;
 	}
 
@@ -72,6 +76,175 @@ struct dkhash_check {
 	int ent_delta, addrm_delta;
 };
 
+/*
+ * The chained table dkhash used to be, with its hash function, so
+ * we can tell how much faster the current one is.
+ */
+struct chained_bucket {
+	const char *key;
+	const char *key2;
+	void *data;
+	struct chained_bucket *next;
+};
+
+struct chained_table {
+	struct chained_bucket **buckets;
+	unsigned int num_buckets;
+};
+
+static inline unsigned int chained_hash(register const unsigned char *k)
+{
+	register unsigned int h = 0x123;
+
+	while (*k)
+		h = *k++ + 509 * h;
+
+	return h;
+}
+
+static unsigned int chained_slot(struct chained_table *t, const char *k1, const char *k2)
+{
+	unsigned int h = chained_hash((unsigned char *)k1);
+
+	if (k2)
+		h ^= chained_hash((unsigned char *)k2);
+	return h % t->num_buckets;
+}
+
+static void *chained_get(struct chained_table *t, const char *k1, const char *k2)
+{
+	struct chained_bucket *bkt;
+
+	for (bkt = t->buckets[chained_slot(t, k1, k2)]; bkt; bkt = bkt->next) {
+		if (!strcmp(k1, bkt->key) && bkt->key2 && !strcmp(k2, bkt->key2))
+			return bkt->data;
+	}
+
+	return NULL;
+}
+
+static int chained_insert(struct chained_table *t, const char *k1, const char *k2, void *data)
+{
+	struct chained_bucket *bkt;
+	unsigned int slot = chained_slot(t, k1, k2);
+
+	if (chained_get(t, k1, k2) || !(bkt = malloc(sizeof(*bkt))))
+		return -1;
+	bkt->key = k1;
+	bkt->key2 = k2;
+	bkt->data = data;
+	bkt->next = t->buckets[slot];
+	t->buckets[slot] = bkt;
+	return 0;
+}
+
+static void chained_destroy(struct chained_table *t)
+{
+	unsigned int i;
+
+	for (i = 0; i < t->num_buckets; i++) {
+		struct chained_bucket *bkt, *next;
+		for (bkt = t->buckets[i]; bkt; bkt = next) {
+			next = bkt->next;
+			free(bkt);
+		}
+	}
+	free(t->buckets);
+}
+
+static double usec_since(struct timeval *start)
+{
+	struct timeval stop;
+
+	gettimeofday(&stop, NULL);
+	return (double)(stop.tv_sec - start->tv_sec) * 1000000 + (stop.tv_usec - start->tv_usec);
+}
+
+/*
+ * Services are what we look up the most, and their descriptions
+ * tend to repeat across hosts, so that's what we benchmark with.
+ */
+#define BENCH_HOSTS 50000
+#define BENCH_SERVICES 20
+
+static void benchmark(void)
+{
+	static const char *services[BENCH_SERVICES] = {
+		"PING", "SSH", "HTTP", "HTTPS", "Disk Usage /", "Disk Usage /var",
+		"Load", "Memory", "Swap", "Total Processes", "Zombie Processes",
+		"Users", "NTP Time Offset", "DNS Lookup", "SMTP", "IMAP",
+		"MySQL Connections", "Apt Updates", "Uptime", "Network Interface eth0",
+	};
+	struct chained_table ct;
+	dkhash_table *t;
+	char **hosts;
+	struct timeval start;
+	double c_insert, c_get, d_insert, d_get, d_grow;
+	unsigned int i, j, found = 0, total = BENCH_HOSTS * BENCH_SERVICES;
+
+	hosts = malloc(BENCH_HOSTS * sizeof(char *));
+	for (i = 0; i < BENCH_HOSTS; i++) {
+		hosts[i] = malloc(32);
+		sprintf(hosts[i], "host-%u.dc%u.example.com", i, i % 7);
+	}
+
+	/* sized the way create_object_tables() does it */
+	ct.num_buckets = total * 1.5;
+	ct.buckets = calloc(ct.num_buckets, sizeof(*ct.buckets));
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_HOSTS; i++)
+		for (j = 0; j < BENCH_SERVICES; j++)
+			chained_insert(&ct, hosts[i], services[j], hosts[i]);
+	c_insert = usec_since(&start);
+	gettimeofday(&start, NULL);
+	for (j = 0; j < BENCH_SERVICES; j++)
+		for (i = 0; i < BENCH_HOSTS; i++)
+			found += chained_get(&ct, hosts[i], services[j]) == hosts[i];
+	c_get = usec_since(&start);
+	ok_uint(found, total, "chained table must find all services");
+	chained_destroy(&ct);
+
+	found = 0;
+	t = dkhash_create(total * 1.5);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_HOSTS; i++)
+		for (j = 0; j < BENCH_SERVICES; j++)
+			dkhash_insert(t, hosts[i], services[j], hosts[i]);
+	d_insert = usec_since(&start);
+	gettimeofday(&start, NULL);
+	for (j = 0; j < BENCH_SERVICES; j++)
+		for (i = 0; i < BENCH_HOSTS; i++)
+			found += dkhash_get(t, hosts[i], services[j]) == hosts[i];
+	d_get = usec_since(&start);
+	ok_uint(found, total, "dkhash must find all services");
+	ok_uint(dkhash_num_entries(t), total, "dkhash must hold all services");
+	dkhash_destroy(t);
+
+	/* objects added at runtime, to a table that's much too small */
+	found = 0;
+	t = dkhash_create(1024);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_HOSTS; i++)
+		for (j = 0; j < BENCH_SERVICES; j++)
+			dkhash_insert(t, hosts[i], services[j], hosts[i]);
+	d_grow = usec_since(&start);
+	for (j = 0; j < BENCH_SERVICES; j++)
+		for (i = 0; i < BENCH_HOSTS; i++)
+			found += dkhash_get(t, hosts[i], services[j]) == hosts[i];
+	ok_uint(found, total, "grown dkhash must find all services");
+	test(dkhash_table_size(t) >= total, "grown dkhash must be big enough for all services");
+	test(!t->old, "grown dkhash must be done moving entries after all those lookups");
+	dkhash_destroy(t);
+
+	t_diag("%u services, usec per op: chained insert %.3f, get %.3f; dkhash insert %.3f, get %.3f, insert with growing %.3f",
+	       total, c_insert / total, c_get / total, d_insert / total, d_get / total, d_grow / total);
+	t_diag("dkhash lookups are %.1f times as fast as chained ones", c_get / (d_get ? d_get : 1));
+
+	for (i = 0; i < BENCH_HOSTS; i++)
+		free(hosts[i]);
+	free(hosts);
+}
+
 static int del_matching(void *data)
 {
 	struct test_data *d = (struct test_data *)data;
@@ -84,10 +257,33 @@ static int del_matching(void *data)
 	return 0;
 }
 
+static int remove_all(void *data)
+{
+	removed++;
+	return DKHASH_WALK_REMOVE;
+}
+
+static dkhash_table *walk_table;
+static char walk_keys[64][8];
+static unsigned int walk_next, walk_inserted;
+
+static int insert_while_walking(void *data)
+{
+	unsigned int i;
+
+	for (i = 0; i < 4 && walk_next < ARRAY_SIZE(walk_keys); i++, walk_next++) {
+		if (dkhash_insert(walk_table, walk_keys[walk_next], "walk", walk_keys[walk_next]) == DKHASH_OK)
+			walk_inserted++;
+	}
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	dkhash_table *tx, *t;
-	unsigned int x;
+	unsigned int x, size, grew = 0, lost = 0;
+	static char growth[4096][8], growth2[4096][8];
 	struct test_data s;
 	char *p1, *p2;
 
@@ -143,6 +339,84 @@ int main(int argc, char **argv)
 	test(0 == dkhash_num_entries(tx), "x table post all ops");
 	test(0 == dkhash_check_table(tx), "x table consistency post all ops");
 	dkhash_debug_table(tx, 0);
+	t_end();
+
+	t_start("dkhash growth test");
+	t = dkhash_create(4);
+	size = dkhash_table_size(t);
+	for (x = 0; x < ARRAY_SIZE(growth); x++) {
+		sprintf(growth[x], "%u", x);
+		/* every other one with two keys, one of which is the same */
+		dkhash_insert(t, growth[x], x & 1 ? "same" : NULL, growth[x]);
+		if (dkhash_table_size(t) != size) {
+			grew++;
+			size = dkhash_table_size(t);
+		}
+		if (dkhash_get(t, growth[x / 2], x / 2 & 1 ? "same" : NULL) != growth[x / 2])
+			lost++;
+		if (dkhash_insert(t, growth[x / 3], x / 3 & 1 ? "same" : NULL, NULL) != DKHASH_EDUPE)
+			lost++;
+	}
+	test(grew >= 8, "table must grow as entries are added (grew %u times)", grew);
+	ok_uint(lost, 0, "no entries may get lost or duplicated while growing");
+	ok_uint(dkhash_num_entries(t), ARRAY_SIZE(growth), "all entries must be there after growing");
+	test(0 == dkhash_check_table(t), "grown table consistency");
+	test(dkhash_get(t, growth[1], NULL) == NULL, "one key must not find entries with two");
+	test(dkhash_get(t, growth[2], "same") == NULL, "two keys must not find entries with one");
+
+	/* grow once more, then walk and remove while entries are being moved */
+	for (x = 0; x < ARRAY_SIZE(growth); x++) {
+		sprintf(growth2[x], "%u", x);
+		dkhash_insert(t, growth2[x], "other", growth2[x]);
+		if (t->old)
+			break;
+	}
+	test(t->old != NULL, "table must be moving entries before walking it");
+	del.x = -1;
+	removed = 0;
+	dkhash_walk_data(t, remove_all);
+	ok_uint(removed, ARRAY_SIZE(growth) + x + 1, "walking must visit all entries once while growing");
+	ok_uint(dkhash_num_entries(t), 0, "walking must remove all entries while growing");
+	test(0 == dkhash_check_table(t), "table consistency after removing everything");
+
+	/* deleted slots must not keep tables growing */
+	size = dkhash_table_size(t);
+	for (x = 0; x < 100000; x++) {
+		dkhash_insert(t, growth[x % ARRAY_SIZE(growth)], NULL, &x);
+		dkhash_remove(t, growth[x % ARRAY_SIZE(growth)], NULL);
+	}
+	ok_uint(dkhash_table_size(t), size, "table must not grow when there's only churn");
+	ok_uint(dkhash_num_entries(t), 0, "churned table must be empty");
+	dkhash_destroy(t);
+
+	/* inserting from a walker must neither lose entries nor the array being walked */
+	walk_table = t = dkhash_create(8);
+	for (x = 0; x < 5; x++)
+		dkhash_insert(t, keys[x].k1, keys[x].k2, &keys[x]);
+	for (x = 0; x < ARRAY_SIZE(walk_keys); x++)
+		sprintf(walk_keys[x], "%u", x);
+	dkhash_walk_data(t, insert_while_walking);
+	test(walk_inserted > 3, "walker must be able to grow the table (inserted %u)", walk_inserted);
+	ok_uint(dkhash_num_entries(t), 5 + walk_inserted, "entries inserted while walking must be counted");
+	for (lost = 0, x = 0; x < 5; x++) {
+		if (dkhash_get(t, keys[x].k1, keys[x].k2) != &keys[x])
+			lost++;
+	}
+	for (grew = 0, x = 0; x < walk_next; x++) {
+		if (dkhash_get(t, walk_keys[x], "walk") == walk_keys[x])
+			grew++;
+	}
+	ok_uint(lost, 0, "entries that were there must survive inserts while walking");
+	ok_uint(grew, walk_inserted, "entries inserted while walking must be found");
+	for (x = 0; x < 1000 && t->old; x++)
+		dkhash_get(t, keys[0].k1, keys[0].k2);
+	test(!t->old, "table must be done moving entries after the walk");
+	test(0 == dkhash_check_table(t), "table consistency after inserting while walking");
+	dkhash_destroy(t);
+	t_end();
+
+	t_start("dkhash benchmark");
+	benchmark();
 
 	return t_end();
 }
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.c"
+#include "t-utils.h"
+
+int main(int argc, char **argv)
+{
+	const char *a, *b, *c;
+	char buf[32], *dup;
+	const char *many[1000];
+	unsigned int i;
+
+	t_set_colors(0);
+	t_start("string interning tests");
+
+	strcpy(buf, "localhost");
+	a = intern_str(buf);
+	test(a != NULL && a != buf, "interning must make a copy");
+	ok_str(a, "localhost", "interned copy must be equal to the original");
+	b = intern_str("localhost");
+	test(a == b, "equal strings must share one copy");
+	strcpy(buf, "PING");
+	c = intern_str(buf);
+	test(c != a, "different strings must not share a copy");
+	ok_str(a, "localhost", "interned strings must not change when the original does");
+	ok_uint(intern_num_strings(), 2, "two distinct strings");
+	ok_uint(intern_num_refs(), 3, "three references");
+	ok_uint(intern_bytes(), sizeof("localhost") + sizeof("PING"), "bytes used");
+	ok_uint(intern_bytes_saved(), sizeof("localhost"), "bytes saved");
+
+	test(intern_get("localhost") == a, "lookups must find interned strings");
+	test(intern_get("nosuchhost") == NULL, "lookups must not intern anything");
+	ok_uint(intern_num_refs(), 3, "lookups must not take references");
+	test(intern_streq(a, b), "same pointers must be equal");
+	test(intern_streq(a, "localhost"), "equal strings must be equal");
+	test(!intern_streq(a, "PING"), "different strings must differ");
+
+	intern_release(b);
+	test(intern_get("localhost") == a, "strings must stay while there are references");
+	ok_uint(intern_bytes_saved(), 0, "nothing saved with one reference each");
+	intern_free(a);
+	test(a == NULL, "intern_free() must clear the pointer");
+	test(intern_get("localhost") == NULL, "strings must go away with their last reference");
+	intern_release(c);
+	test(intern_get("PING") == NULL, "strings must go away with their last reference");
+	ok_uint(intern_num_strings(), 0, "no strings left");
+	ok_uint(intern_num_refs(), 0, "no references left");
+	ok_uint(intern_bytes(), 0, "no bytes left");
+
+	/* strings from strdup() must be freed, even when an equal one is interned */
+	c = intern_str("web01");
+	dup = strdup("web01");
+	intern_release(dup);
+	test(intern_get("web01") == c, "releasing a non-interned copy must not touch the interned one");
+	dup = strdup("web02");
+	intern_release(dup);
+	intern_release(NULL);
+	intern_release(c);
+	ok_uint(intern_num_strings(), 0, "releasing non-interned strings must leave the table alone");
+
+	for (i = 0; i < ARRAY_SIZE(many); i++) {
+		sprintf(buf, "host-%u", i % 100);
+		many[i] = intern_str(buf);
+	}
+	ok_uint(intern_num_strings(), 100, "100 distinct strings");
+	ok_uint(intern_num_refs(), ARRAY_SIZE(many), "one reference per intern_str() call");
+	for (i = 0; i < ARRAY_SIZE(many); i++) {
+		if (many[i] != many[i % 100])
+			break;
+	}
+	ok_uint(i, ARRAY_SIZE(many), "all copies of a string must be the same pointer");
+	for (i = 0; i < ARRAY_SIZE(many); i++)
+		intern_release(many[i]);
+	ok_uint(intern_num_strings(), 0, "all strings released");
+
+	return t_end();
+}
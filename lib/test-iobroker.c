@@ -102,6 +102,54 @@ static int listen_handler(int fd, int events, void *arg)
 	return 0;
 }
 
+static int watched_events;
+static int watch_handler(int fd, int events, void *arg)
+{
+	char buf[64];
+
+	watched_events |= events;
+	if (events & IOBROKER_POLLIN)
+		read(fd, buf, sizeof(buf));
+	return 0;
+}
+
+/* one handler gets both input and, when asked for, output events */
+static void test_watch_out(void)
+{
+	int sv[2];
+
+	ok_int(iobroker_watch_out(NULL, 0, 1), IOBROKER_ENOSET, "watching output needs a set");
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		t_fail("socketpair() failed: %s", strerror(errno));
+		return;
+	}
+	ok_int(iobroker_watch_out(iobs, sv[0], 1), IOBROKER_EINVAL, "unregistered sockets can't be watched for output");
+	iobroker_register(iobs, sv[0], NULL, watch_handler);
+
+	watched_events = 0;
+	iobroker_poll(iobs, 0);
+	ok_int(watched_events, 0, "no events without input or output interest");
+
+	ok_int(iobroker_watch_out(iobs, sv[0], 1), 0, "watching output of a registered socket");
+	watched_events = 0;
+	iobroker_poll(iobs, 1000);
+	test(watched_events & IOBROKER_POLLOUT, "handler is told the socket is writable");
+
+	write(sv[1], "x", 1);
+	watched_events = 0;
+	iobroker_poll(iobs, 1000);
+	test((watched_events & (IOBROKER_POLLIN | IOBROKER_POLLOUT)) == (IOBROKER_POLLIN | IOBROKER_POLLOUT), "input and output both reach the handler");
+
+	ok_int(iobroker_watch_out(iobs, sv[0], 0), 0, "stop watching output");
+	write(sv[1], "x", 1);
+	watched_events = 0;
+	iobroker_poll(iobs, 1000);
+	test(watched_events && !(watched_events & IOBROKER_POLLOUT), "input is still handled, output no longer is");
+
+	iobroker_close(iobs, sv[0]);
+	close(sv[1]);
+}
+
 int sighandler(int sig)
 {
 	/* test failed */
@@ -168,6 +216,7 @@ int main(int argc, char **argv)
 	sain.sin_family = AF_INET;
 	bind(listen_fd, (struct sockaddr *)&sain, sizeof(sain));
 	listen(listen_fd, 128);
+	test_watch_out();
 	iobroker_register(iobs, listen_fd, iobs, listen_handler);
 
 	if (argc == 1)
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "probe.c"
+#include "t-utils.h"
+
+/* what our fake server does with connections it accepts */
+#define SRV_SILENT 0 /* nothing at all */
+#define SRV_BANNER 1 /* greets the client */
+#define SRV_ECHO   2 /* echoes what it gets */
+#define SRV_HTTP   3 /* answers a request, then hangs up */
+
+static iobroker_set *iobs;
+static int srv_mode, srv_conns[16], num_conns;
+static const char *srv_reply;
+static char srv_request[4096];
+static size_t srv_request_len;
+
+struct result {
+	int done;
+	int state;
+	char output[8192];
+};
+
+static int server_input(int fd, int events, void *arg)
+{
+	char buf[1024];
+	int len;
+
+	len = read(fd, buf, sizeof(buf));
+	if (len <= 0) {
+		iobroker_unregister(iobs, fd);
+		return 0;
+	}
+
+	if (srv_mode == SRV_ECHO) {
+		(void)write(fd, buf, len);
+		return 0;
+	}
+
+	if (srv_request_len + len < sizeof(srv_request)) {
+		memcpy(srv_request + srv_request_len, buf, len);
+		srv_request_len += len;
+		srv_request[srv_request_len] = 0;
+	}
+	if (strstr(srv_request, "\r\n\r\n")) {
+		(void)write(fd, srv_reply, strlen(srv_reply));
+		iobroker_unregister(iobs, fd);
+		shutdown(fd, SHUT_WR);
+	}
+	return 0;
+}
+
+static int server_accept(int fd, int events, void *arg)
+{
+	int sd;
+
+	sd = accept(fd, NULL, NULL);
+	if (sd < 0)
+		return 0;
+	srv_conns[num_conns++] = sd;
+
+	if (srv_mode == SRV_BANNER)
+		(void)write(sd, srv_reply, strlen(srv_reply));
+	else if (srv_mode != SRV_SILENT)
+		iobroker_register(iobs, sd, NULL, server_input);
+
+	return 0;
+}
+
+static void server_reset(int mode, const char *reply)
+{
+	int i;
+
+	for (i = 0; i < num_conns; i++) {
+		if (iobroker_is_registered(iobs, srv_conns[i]))
+			iobroker_close(iobs, srv_conns[i]);
+		else
+			close(srv_conns[i]);
+	}
+	num_conns = 0;
+	srv_mode = mode;
+	srv_reply = reply;
+	srv_request_len = 0;
+	srv_request[0] = 0;
+}
+
+/* a local listening socket on some free port */
+static int server_listen(int *port)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	int sd;
+
+	sd = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (sd < 0 || bind(sd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+		return -1;
+	getsockname(sd, (struct sockaddr *)&sin, &len);
+	*port = ntohs(sin.sin_port);
+	return sd;
+}
+
+static void probe_result(int state, const char *output, void *arg)
+{
+	struct result *r = (struct result *)arg;
+
+	r->done++;
+	r->state = state;
+	snprintf(r->output, sizeof(r->output), "%s", output);
+}
+
+static struct result *run_probe(const char *fmt, ...)
+{
+	static struct result r;
+	char cmd[1024];
+	va_list ap;
+	probe *p;
+	int i;
+
+	va_start(ap, fmt);
+	vsnprintf(cmd, sizeof(cmd), fmt, ap);
+	va_end(ap);
+
+	memset(&r, 0, sizeof(r));
+	r.state = -1;
+	p = probe_start(iobs, cmd, probe_result, &r);
+	for (i = 0; p && !r.done && i < 50; i++)
+		iobroker_poll(iobs, 100);
+
+	if (!r.done) {
+		t_fail("probe '%s' never finished", cmd);
+		probe_cancel(p);
+	}
+	ok_int(r.done, 1, "callback must run exactly once");
+	return &r;
+}
+
+#define ok_probe(r, want_state, want_output) \
+	do { \
+		ok_int(r->state, want_state, want_output); \
+		test(strstr(r->output, want_output) != NULL, "output '%s' must contain '%s'", r->output, want_output); \
+	} while (0)
+
+int main(int argc, char **argv)
+{
+	struct result *r, cancelled;
+	int port, dead_port, lsd, dsd;
+	char want[256];
+	probe *p;
+	int i;
+
+	t_set_colors(0);
+	t_start("native probe tests");
+
+	iobs = iobroker_create();
+	lsd = server_listen(&port);
+	dsd = server_listen(&dead_port);
+	if (lsd < 0 || dsd < 0 || listen(lsd, 16) < 0)
+		crash("can't test without a local listening socket");
+	/* nobody listens on dead_port, so connecting to it must fail */
+	close(dsd);
+	iobroker_register(iobs, lsd, NULL, server_accept);
+
+	test(probe_is_native("@check_tcp -H 127.0.0.1 -p 80"), "'@' prefix must select probes");
+	test(!probe_is_native("/usr/lib/nagios/plugins/check_tcp -H 127.0.0.1 -p 80"), "plugins must not be probes");
+
+	t_start("argument errors");
+	r = run_probe("@check_tcp -H 127.0.0.1");
+	ok_probe(r, 3, "No port specified");
+	r = run_probe("@check_tcp -p %d", port);
+	ok_probe(r, 3, "No host specified");
+	r = run_probe("@check_smtp -H 127.0.0.1 -p %d", port);
+	ok_probe(r, 3, "Unknown probe 'check_smtp'");
+	r = run_probe("@check_tcp -H 127.0.0.1 -p %d -x", port);
+	ok_probe(r, 3, "Invalid argument '-x'");
+	t_end();
+
+	t_start("tcp connect");
+	server_reset(SRV_SILENT, NULL);
+	r = run_probe("@check_tcp -H 127.0.0.1 -p %d", port);
+	sprintf(want, "TCP OK - ");
+	ok_probe(r, 0, want);
+	sprintf(want, "second response time on 127.0.0.1 port %d|time=", port);
+	ok_probe(r, 0, want);
+	r = run_probe("@check_tcp -H 127.0.0.1 -p %d -w 0 -c 10", port);
+	ok_probe(r, 1, "TCP WARNING - ");
+	ok_probe(r, 1, ";0.000000;10.000000;0.000000\n");
+	r = run_probe("@check_tcp -H 127.0.0.1 -p %d", dead_port);
+	ok_probe(r, 2, "Connection refused");
+	r = run_probe("@check_tcp -H no-such-host.invalid -p %d", port);
+	ok_probe(r, 2, "Invalid hostname");
+	t_end();
+
+	t_start("banners");
+	server_reset(SRV_BANNER, "SSH-2.0-OpenSSH_test\r\nmore stuff\r\n");
+	r = run_probe("@check_tcp -H 127.0.0.1 -p %d -e SSH-2.0", port);
+	ok_probe(r, 0, "[SSH-2.0-OpenSSH_test]|time=");
+	server_reset(SRV_BANNER, "220 mail ESMTP\r\n");
+	r = run_probe("@check_tcp -H 127.0.0.1 -p %d -e SSH-2.0", port);
+	ok_probe(r, 1, "Unexpected response from host/socket on port");
+	ok_probe(r, 1, ": 220 mail ESMTP|time=");
+	server_reset(SRV_ECHO, NULL);
+	r = run_probe("@check_tcp -H 127.0.0.1 -p %d -s 'PING me\n' -e PING", port);
+	ok_probe(r, 0, "[PING me]");
+	t_end();
+
+	t_start("http");
+	server_reset(SRV_HTTP, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello");
+	r = run_probe("@check_http -H 127.0.0.1 -p %d -u /status", port);
+	sprintf(want, "HTTP OK: HTTP/1.1 200 OK - %d bytes in ", (int)strlen(srv_reply));
+	ok_probe(r, 0, want);
+	sprintf(want, "size=%dB;;;0\n", (int)strlen(srv_reply));
+	ok_probe(r, 0, want);
+	test(!strncmp(srv_request, "GET /status HTTP/1.0\r\n", 22), "request line must be sane");
+	test(strstr(srv_request, "\r\nHost: 127.0.0.1\r\n") != NULL, "request must name the host");
+
+	server_reset(SRV_HTTP, "HTTP/1.0 404 Not Found\r\n\r\n");
+	r = run_probe("@check_http -H 127.0.0.1 -p %d", port);
+	ok_probe(r, 1, "HTTP WARNING: HTTP/1.0 404 Not Found");
+	test(!strncmp(srv_request, "GET / HTTP/1.0\r\n", 16), "uri must default to /");
+	server_reset(SRV_HTTP, "HTTP/1.0 404 Not Found\r\n\r\n");
+	r = run_probe("@check_http -H 127.0.0.1 -p %d -e 200,302", port);
+	ok_probe(r, 2, "Invalid HTTP response received from host on port");
+	server_reset(SRV_HTTP, "HTTP/1.0 302 Found\r\n\r\n");
+	r = run_probe("@check_http -H 127.0.0.1 -p %d -e 200,302", port);
+	ok_probe(r, 0, "HTTP OK: HTTP/1.0 302 Found");
+	server_reset(SRV_HTTP, "HTTP/1.0 503 Service Unavailable\r\n\r\n");
+	r = run_probe("@check_http -H 127.0.0.1 -p %d", port);
+	ok_probe(r, 2, "HTTP CRITICAL: HTTP/1.0 503");
+	server_reset(SRV_HTTP, "SSH-2.0-OpenSSH_test\r\n\r\n");
+	r = run_probe("@check_http -H 127.0.0.1 -p %d", port);
+	ok_probe(r, 2, "Invalid HTTP response");
+	r = run_probe("@check_http -H 127.0.0.1 -p %d", dead_port);
+	ok_probe(r, 2, "Connection refused");
+	t_end();
+
+	t_start("cancelling");
+	server_reset(SRV_SILENT, NULL);
+	memset(&cancelled, 0, sizeof(cancelled));
+	sprintf(want, "@check_tcp -H 127.0.0.1 -p %d -e foo", port);
+	p = probe_start(iobs, want, probe_result, &cancelled);
+	test(p != NULL, "probe waiting for a banner must be running");
+	for (i = 0; i < 5; i++)
+		iobroker_poll(iobs, 10);
+	ok_int(cancelled.done, 0, "silent server must keep the probe waiting");
+	i = iobroker_get_num_fds(iobs);
+	probe_cancel(p);
+	ok_int(iobroker_get_num_fds(iobs), i - 1, "cancelled probe must release its socket");
+	iobroker_poll(iobs, 10);
+	ok_int(cancelled.done, 0, "cancelled probe must not call back");
+	t_end();
+
+	server_reset(SRV_SILENT, NULL);
+	iobroker_close(iobs, lsd);
+	iobroker_destroy(iobs, 0);
+	return t_end();
+}
@@ -0,0 +1,157 @@
+#include "runcmd.c"
+#include "t-utils.h"
+
+static const char *method_name[] = { "posix_spawn()", "fork()" };
+
+/* reads everything from fd into buf and closes it */
+static int slurp(int fd, char *buf, size_t size)
+{
+	size_t len = 0;
+	ssize_t ret;
+
+	while (len < size - 1) {
+		ret = read(fd, buf + len, size - 1 - len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		len += ret;
+	}
+	buf[len] = 0;
+	return len;
+}
+
+/* runs a command to completion, collecting its output and exit code */
+static int run(const char *cmd, char *out, char *err, size_t size)
+{
+	int pfd[2], pfderr[2], fd;
+
+	fd = runcmd_open(cmd, pfd, pfderr, NULL);
+	if (fd < 0)
+		return fd;
+	slurp(pfderr[0], err, size);
+	close(pfderr[0]);
+	slurp(fd, out, size);
+	return runcmd_close(fd);
+}
+
+struct run_test {
+	const char *cmd;
+	const char *out;
+	const char *err;
+	int code;
+};
+
+static void test_method(int method)
+{
+	struct run_test rt[] = {
+		{ "/bin/echo hello world", "hello world\n", "", 0 },
+		{ "/bin/echo 'single quoted' \"double quoted\"", "single quoted double quoted\n", "", 0 },
+		{ "echo found in path", "found in path\n", "", 0 },
+		{ "/bin/sh -c 'echo to stderr >&2; exit 3'", "", "to stderr\n", 3 },
+		/* these need the /bin/sh -c fallback */
+		{ "echo piped | tr a-z A-Z", "PIPED\n", "", 0 },
+		{ "echo one; echo two", "one\ntwo\n", "", 0 },
+		{ "false && echo nope", "", "", 1 },
+	};
+	char out[4096], err[4096];
+	int i, ret, pfd[2], pfderr[2], fd, leaked;
+
+	t_start("Launching commands with %s", method_name[method]);
+	runcmd_set_spawn_method(method);
+
+	for (i = 0; i < ARRAY_SIZE(rt); i++) {
+		ret = run(rt[i].cmd, out, err, sizeof(out));
+		ok_int(ret, rt[i].code, rt[i].cmd);
+		ok_str(out, rt[i].out, "stdout must match");
+		ok_str(err, rt[i].err, "stderr must match");
+	}
+
+	/* missing plugins must look the same regardless of how we launch */
+	ret = run("/nonexistent/check_foo -H localhost", out, err, sizeof(out));
+	ok_int(ret, ENOENT, "missing command must exit with ENOENT");
+	test(strstr(err, "execvp(/nonexistent/check_foo") != NULL, "missing command must be reported on stderr");
+
+	/*
+	 * neither our end of another child's pipes nor descriptors
+	 * our caller forgot to mark close-on-exec may leak into
+	 * the commands we launch
+	 */
+	fd = runcmd_open("/bin/echo still running", pfd, pfderr, NULL);
+	t_req(fd >= 0);
+	leaked = open("/dev/null", O_RDONLY);
+	if (!access("/proc/self/fd", R_OK)) {
+		int check[] = { fd, pfderr[0], leaked };
+		for (i = 0; i < ARRAY_SIZE(check); i++) {
+			char cmd[64];
+			sprintf(cmd, "/bin/sh -c 'readlink /proc/$$/fd/%d'", check[i]);
+			run(cmd, out, err, sizeof(out));
+			ok_str(out, "", "descriptors must not be inherited");
+		}
+	}
+	close(leaked);
+	close(pfderr[0]);
+	ok_int(runcmd_close(fd), 0, "first command must still be reapable");
+
+	t_end();
+}
+
+/* one simulated check per iteration: launch, read output, reap */
+static double bench_method(int method, int count)
+{
+	struct timeval start, stop;
+	char out[256], err[256];
+	int i;
+
+	runcmd_set_spawn_method(method);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; i++)
+		run("/bin/true", out, err, sizeof(out));
+	gettimeofday(&stop, NULL);
+
+	return count / ((stop.tv_sec - start.tv_sec) + ((stop.tv_usec - start.tv_usec) / 1000000.0));
+}
+
+/*
+ * Benchmark with "./test-runcmd bench [count] [rss in MB]". The
+ * optional rss is allocated and touched before starting, since the
+ * cost of fork() grows with the size of the process calling it.
+ */
+static int benchmark(int count, unsigned long rss_mb)
+{
+	double spawn_rate, fork_rate;
+
+	if (rss_mb) {
+		size_t size = rss_mb * 1024 * 1024;
+		char *mem = malloc(size);
+		if (!mem) {
+			printf("Failed to allocate %luMB\n", rss_mb);
+			return 1;
+		}
+		memset(mem, 1, size);
+	}
+
+	/* warm up page and dentry caches */
+	bench_method(RUNCMD_SPAWN_FORK, count / 10 + 1);
+
+	fork_rate = bench_method(RUNCMD_SPAWN_FORK, count);
+	spawn_rate = bench_method(RUNCMD_SPAWN_POSIX, count);
+	printf("%d checks, %luMB extra rss, maxfd=%d\n", count, rss_mb, (int)maxfd);
+	printf("  fork():        %8.1f checks/sec\n", fork_rate);
+	printf("  posix_spawn(): %8.1f checks/sec (%.2fx)\n", spawn_rate, spawn_rate / fork_rate);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		return benchmark(argc > 2 ? atoi(argv[2]) : 2000,
+		                 argc > 3 ? strtoul(argv[3], NULL, 10) : 0);
+	}
+
+	t_set_colors(0);
+	t_start("runcmd tests");
+	test_method(RUNCMD_SPAWN_POSIX);
+	test_method(RUNCMD_SPAWN_FORK);
+	return t_end();
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <sys/wait.h>
+#include "trace.c"
+#include "t-utils.h"
+
+#define TEST_TRACE_FILE "/tmp/test-trace.ring"
+#define MAX_EXPECTED 64
+
+static char *expected[MAX_EXPECTED];
+static int expected_level[MAX_EXPECTED];
+static int num_expected, num_seen;
+
+/* logs to the trace ring and remembers what printf() made of it */
+static void check_log(trace_ring *tr, int level, const char *fmt, ...)
+	__attribute__((__format__(__printf__, 3, 4)));
+static void check_log(trace_ring *tr, int level, const char *fmt, ...)
+{
+	va_list ap;
+	char buf[4096];
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	expected_level[num_expected] = level;
+	expected[num_expected++] = strdup(buf);
+
+	va_start(ap, fmt);
+	trace_vlog(tr, level, num_expected, fmt, ap);
+	va_end(ap);
+}
+
+static int compare_walker(const struct timeval *tv, int pid, int level, int verbosity, const char *msg, void *arg)
+{
+	int i = verbosity - 1;
+
+	if (pid != getpid())
+		t_fail("message '%s' logged by pid %d, not %d", msg, pid, (int)getpid());
+
+	if (verbosity == 99) {
+		ok_int(strlen(msg), TRACE_MAX_STRING + 8, "long strings must be truncated");
+		return 0;
+	}
+	if (verbosity == 97) {
+		ok_str(msg, "null '(null)'\n", "NULL strings must render as (null)");
+		return 0;
+	}
+	if (verbosity == 98) {
+		ok_str(msg, "errno: No such file or directory\n", "%m must render errno at the time of logging");
+		return 0;
+	}
+	if (i < 0 || i >= num_expected) {
+		t_fail("bogus verbosity %d for message '%s'", verbosity, msg);
+		return 0;
+	}
+	ok_int(level, expected_level[i], "level must be preserved");
+	ok_str(msg, expected[i], "message must render like printf()");
+	num_seen++;
+	return 0;
+}
+
+static int count_walker(const struct timeval *tv, int pid, int level, int verbosity, const char *msg, void *arg)
+{
+	unsigned long *last = (unsigned long *)arg;
+	unsigned long seq = strtoul(msg + 4, NULL, 10);
+
+	if (*last && seq != *last + 1)
+		t_fail("expected message %lu, got %lu", *last + 1, seq);
+	*last = seq;
+	return 0;
+}
+
+static int pid_walker(const struct timeval *tv, int pid, int level, int verbosity, const char *msg, void *arg)
+{
+	int *pids = (int *)arg;
+
+	if (!strcmp(msg, "from parent\n"))
+		pids[0] = pid;
+	else if (!strcmp(msg, "from child\n"))
+		pids[1] = pid;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	trace_ring *tr, *ro;
+	char longstr[TRACE_MAX_STRING * 2];
+	/* keep the compiler from spotting the NULL string */
+	const char *nullstr = argc > 1000 ? argv[0] : NULL;
+	unsigned long i, seen, last = 0;
+
+	t_set_colors(0);
+	t_start("trace ring tests");
+
+	unlink(TEST_TRACE_FILE);
+	tr = trace_open(TEST_TRACE_FILE, 0);
+	if (!test(tr != NULL, "trace_open() must work"))
+		crash("can't test without a trace ring");
+	ok_int(trace_pid(tr), getpid(), "writer pid must be stored");
+
+	memset(longstr, 'x', sizeof(longstr) - 1);
+	longstr[sizeof(longstr) - 1] = 0;
+
+	check_log(tr, 1 << 0, "plain message\n");
+	check_log(tr, 1 << 1, "int %d, negative %i, unsigned %u, hex %x/%X, octal %o\n",
+	          42, -17, 3000000000U, 0xdead, 0xbeef, 0755);
+	check_log(tr, 1 << 2, "long %ld, ulong %lu, llong %lld, ullong %llu, short %hd, char %hhu\n",
+	          LONG_MIN, ULONG_MAX, LLONG_MIN, ULLONG_MAX, (short)-3, (unsigned char)250);
+	check_log(tr, 1 << 3, "size %zu, ssize %zd, ptrdiff %td, intmax %jd\n",
+	          (size_t)12345, (ssize_t)-12345, (ptrdiff_t)-1, (intmax_t)INT64_MAX);
+	check_log(tr, 1 << 4, "doubles %f %.2f %e %g %10.3f|\n", 1.5, 3.14159, 12345.678, 0.0001, -2.5);
+	check_log(tr, 1 << 5, "strings '%s' '%-8s' '%8s' '%.3s' '%s'\n", "host01", "left", "right", "truncated", "");
+	check_log(tr, 1 << 6, "stars '%*d' '%-*d' '%.*s' '%*.*f'\n", 6, 42, 6, 42, 4, "abcdefgh", 8, 2, 2.71828);
+	check_log(tr, 1 << 7, "char '%c', percent %%, pointer %p\n", 'Z', (void *)0x1234);
+	trace_log(tr, 1 << 0, 97, "null '%s'\n", nullstr);
+	check_log(tr, 1 << 1, "%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %s %s %s\n",
+	          1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, "seventeen", "eighteen", "nineteen");
+	check_log(tr, 1 << 2, "%s", "long strings are spread over several records, which is fine as long as they come back");
+
+	/* long strings are truncated, so we can't compare those directly */
+	trace_log(tr, 1 << 3, 99, "long '%s'\n", longstr);
+
+	errno = ENOENT;
+	trace_log(tr, 1 << 4, 98, "errno: %m\n");
+
+	/* %n and positional arguments get stored pre-formatted */
+	check_log(tr, 1 << 3, "%2$s %1$s\n", "world", "hello");
+
+	ro = trace_open_ro(TEST_TRACE_FILE);
+	if (!test(ro != NULL, "trace_open_ro() must work"))
+		crash("can't test without a readable trace ring");
+
+	seen = trace_walk(ro, compare_walker, NULL);
+	ok_int(num_seen, num_expected, "all checked messages must be walked");
+	ok_int(seen, num_expected + 3, "all messages must be walked");
+	trace_close(ro);
+	trace_close(tr);
+
+	/* reopening must keep what's there */
+	tr = trace_open(TEST_TRACE_FILE, 0);
+	t_req(tr != NULL);
+	num_seen = 0;
+	trace_walk(tr, compare_walker, NULL);
+	ok_int(num_seen, num_expected, "reopened ring must keep old messages");
+
+	/* wrap the ring several times over */
+	for (i = 1; i <= TRACE_MIN_SLOTS * 5; i++)
+		trace_log(tr, 1, 0, "seq %lu %s\n", i, i % 3 ? "short" : longstr);
+	seen = trace_walk(tr, count_walker, &last);
+	ok_int(last, TRACE_MIN_SLOTS * 5, "last message must be the most recent one");
+	test(seen > 0 && seen < TRACE_MIN_SLOTS, "wrapped ring must only hold the newest messages");
+	trace_close(tr);
+
+	/* a process that reopens the ring logs with its own pid */
+	{
+		int pids[2] = { 0, 0 }, status;
+		pid_t child;
+
+		unlink(TEST_TRACE_FILE);
+		tr = trace_open(TEST_TRACE_FILE, 0);
+		t_req(tr != NULL);
+		trace_log(tr, 1, 0, "from parent\n");
+		trace_close(tr);
+		if (!(child = fork())) {
+			tr = trace_open(TEST_TRACE_FILE, 0);
+			trace_log(tr, 1, 0, "from child\n");
+			trace_close(tr);
+			_exit(0);
+		}
+		waitpid(child, &status, 0);
+		ro = trace_open_ro(TEST_TRACE_FILE);
+		t_req(ro != NULL);
+		trace_walk(ro, pid_walker, pids);
+		ok_int(pids[0], getpid(), "each message keeps the pid of its writer");
+		ok_int(pids[1], child, "messages from a process that reopened the ring get its pid");
+		ok_int(trace_pid(ro), child, "the header holds the last writer's pid");
+		trace_close(ro);
+	}
+
+	test(trace_open_ro("/dev/null") == NULL, "trace_open_ro() must reject non-rings");
+	unlink(TEST_TRACE_FILE);
+
+	for (i = 0; i < num_expected; i++)
+		free(expected[i]);
+
+	return t_end();
+}
@@ -0,0 +1,136 @@
+#include "t-utils.h"
+#include "lnag-utils.h"
+#include "twheel.c"
+
+#define OBJECTS 5000
+#define SLOTS 64
+
+static time_t ref[OBJECTS];
+static unsigned char seen[OBJECTS];
+
+/*
+ * Walk the expired list and compare it to what the reference
+ * deadlines say. Everything due must be on it, and nothing that
+ * isn't due yet may be.
+ */
+static int check_expired(twheel *tw, time_t now, unsigned int *missing, unsigned int *extra)
+{
+	unsigned int id, i, n = 0;
+
+	memset(seen, 0, sizeof(seen));
+	for (id = twheel_expire(tw, now); id != TWHEEL_NONE; id = twheel_next_expired(tw, id)) {
+		if (id >= OBJECTS || seen[id] || !ref[id] || ref[id] > now)
+			(*extra)++;
+		else
+			seen[id] = 1;
+		n++;
+	}
+	for (i = 0; i < OBJECTS; i++) {
+		if (ref[i] && ref[i] <= now && !seen[i])
+			(*missing)++;
+	}
+	return n;
+}
+
+int main(int argc, char **argv)
+{
+	twheel *tw;
+	time_t now = 1000000;
+	unsigned int i, id, next, n, missing = 0, extra = 0, entries = 0, mismatch = 0;
+
+	t_set_colors(0);
+	t_start("timing wheel tests");
+
+	ok_uint(twheel_expire(NULL, now), TWHEEL_NONE, "NULL wheel has nothing expired");
+	tw = twheel_create(OBJECTS, SLOTS - 1);
+	t_req(tw != NULL);
+	ok_uint(tw->slots, SLOTS, "slots are rounded up to a power of two");
+	ok_int(twheel_set(tw, OBJECTS, now), -1, "setting an out of range id must fail");
+	ok_uint(twheel_expire(tw, now), TWHEEL_NONE, "empty wheel has nothing expired");
+
+	twheel_set(tw, 1, now + 10);
+	twheel_set(tw, 2, now + 10 + SLOTS);
+	twheel_set(tw, 3, now + 5);
+	ok_uint(twheel_num_entries(tw), 3, "three entries");
+	ok_uint(twheel_expire(tw, now + 4), TWHEEL_NONE, "nothing is due yet");
+	ok_uint(twheel_expire(tw, now + 5), 3, "3 expires first");
+	ok_uint(twheel_next_expired(tw, 3), TWHEEL_NONE, "and alone");
+	id = twheel_expire(tw, now + 10);
+	ok_uint(id, 3, "expired entries stay until they're set again");
+	ok_uint(twheel_next_expired(tw, id), 1, "1 comes after it");
+	ok_uint(twheel_num_expired(tw), 2, "two are expired");
+	twheel_set(tw, 3, 0);
+	twheel_set(tw, 1, now + 20);
+	ok_uint(twheel_expire(tw, now + 10), TWHEEL_NONE, "moving or removing them takes them off the list");
+	ok_uint(twheel_expire(tw, now + 10 + SLOTS - 1), 1, "1 expires in time, one turn later");
+	ok_uint(twheel_next_expired(tw, 1), TWHEEL_NONE, "2 only shares its slot, and is one turn further away");
+	ok_uint(twheel_expire(tw, now + 10 + SLOTS), 1, "2 expires a full turn after its slot came up first");
+	ok_uint(twheel_next_expired(tw, 1), 2, "both are expired");
+	twheel_set(tw, 4, now);
+	ok_uint(twheel_expire(tw, now + 10 + SLOTS), 4, "deadlines already passed go first on the expired list");
+	ok_uint(twheel_get(tw, 4), now, "the deadline is kept");
+	twheel_set(tw, 4, now);
+	ok_uint(twheel_num_expired(tw), 3, "setting the same deadline again is a no-op");
+	for (i = 1; i < 5; i++)
+		twheel_set(tw, i, 0);
+	ok_uint(twheel_num_entries(tw), 0, "all entries removed");
+	ok_uint(twheel_num_expired(tw), 0, "nothing is expired");
+	twheel_destroy(tw);
+
+	/* lots of random deadlines and moves against a plain array */
+	tw = twheel_create(OBJECTS, SLOTS);
+	t_req(tw != NULL);
+	srand(4711);
+	for (i = 0; i < 2000; i++) {
+		unsigned int k;
+
+		/* mostly short steps, sometimes more than a turn of the wheel */
+		now += (rand() % 20) ? rand() % 4 : rand() % (SLOTS * 3);
+		for (k = 0; k < 50; k++) {
+			id = rand() % OBJECTS;
+			ref[id] = (rand() % 8) ? now - 5 + (rand() % (SLOTS * 4)) : 0;
+			twheel_set(tw, id, ref[id]);
+		}
+
+		check_expired(tw, now, &missing, &extra);
+
+		/* deal with some of what expired, the way the daemon does */
+		for (id = twheel_expire(tw, now); id != TWHEEL_NONE; id = next) {
+			next = twheel_next_expired(tw, id);
+			if (rand() % 3)
+				continue;
+			ref[id] = (rand() % 2) ? now + 1 + rand() % 100 : 0;
+			twheel_set(tw, id, ref[id]);
+		}
+	}
+	ok_uint(missing, 0, "every due entry is on the expired list");
+	ok_uint(extra, 0, "no entry that isn't due is on the expired list");
+
+	for (i = 0; i < OBJECTS; i++) {
+		if (ref[i])
+			entries++;
+		if (twheel_get(tw, i) != ref[i])
+			mismatch++;
+	}
+	ok_uint(twheel_num_entries(tw), entries, "number of entries matches");
+	ok_uint(mismatch, 0, "all deadlines are what they were set to");
+
+	/* the clock going backwards must not lose anything */
+	now -= 3600;
+	missing = extra = 0;
+	twheel_set(tw, 0, now + 2);
+	ref[0] = now + 2;
+	n = twheel_num_expired(tw);
+	twheel_expire(tw, now);
+	ok_uint(twheel_num_expired(tw), n, "nothing new expires when time goes backwards");
+	now += 2;
+	twheel_expire(tw, now);
+	for (id = twheel_expire(tw, now); id != TWHEEL_NONE; id = twheel_next_expired(tw, id)) {
+		if (id == 0)
+			break;
+	}
+	ok_uint(id, 0, "deadlines after the jump still expire");
+
+	twheel_destroy(tw);
+	return t_end();
+}
@@ -0,0 +1,783 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "trace.h"
+
+#define TRACE_MAGIC "NAGTRACE"
+#define TRACE_VERSION 2
+#define TRACE_HEADER_SIZE 4096
+#define TRACE_SITES_SIZE (256 * 1024)
+#define TRACE_MIN_SLOTS 1024
+#define TRACE_MAX_ARGS 32
+#define TRACE_NULL_STRING (~(uint64_t)0)
+#define TRACE_SITE_CACHE 4096 /* must be a power of 2 */
+
+/* record types */
+#define TRACE_REC_EVENT  1
+#define TRACE_REC_ARGS   2
+#define TRACE_REC_STRING 3
+
+#define TRACE_EVENT_ARGS 4
+#define TRACE_CONT_ARGS 7
+#define TRACE_STRING_BYTES (TRACE_RECORD_SIZE - 8)
+
+struct trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t rec_size;
+	uint32_t sites_offset;
+	uint32_t sites_size;
+	uint32_t sites_used;
+	uint32_t pid;
+	uint64_t ring_offset;
+	uint64_t slots;
+	uint64_t head; /* total number of records ever written */
+};
+
+struct trace_record {
+	uint32_t seq; /* low 32 bits of (record index + 1) */
+	uint8_t type;
+	uint8_t verbosity;
+	uint16_t len; /* argument count for events, byte count for strings */
+	union {
+		struct {
+			uint64_t usec;
+			int32_t level;
+			uint32_t site; /* offset + 1 of the format in the sites area */
+			uint32_t pid; /* rings are reopened by the daemonized process */
+			uint32_t unused;
+			uint64_t arg[TRACE_EVENT_ARGS];
+		} ev;
+		uint64_t arg[TRACE_CONT_ARGS];
+		char str[TRACE_STRING_BYTES];
+	} u;
+};
+
+struct trace_site {
+	const char *fmt;
+	uint32_t id;
+};
+
+struct trace_ring {
+	int fd;
+	int writable;
+	uint32_t pid; /* of the writer, so we don't ask for every message */
+	void *map;
+	size_t map_size;
+	struct trace_header *hdr;
+	char *sites;
+	struct trace_record *ring;
+	struct trace_site *cache;
+};
+
+/* length modifiers */
+enum {
+	MOD_NONE, MOD_HH, MOD_H, MOD_L, MOD_LL, MOD_LD, MOD_J, MOD_Z, MOD_T,
+};
+
+#define SPEC_NONE -1
+#define SPEC_STAR -2
+struct trace_spec {
+	const char *flags;
+	int nflags;
+	int width;
+	int prec;
+	int mod;
+	char conv;
+};
+
+/*
+ * Parses the conversion specification 'p' points to and returns
+ * a pointer to the first character after it, or NULL if it's one
+ * we can't store (positional arguments, wide characters and %n).
+ */
+static const char *parse_spec(const char *p, struct trace_spec *spec)
+{
+	const char *s;
+
+	spec->width = spec->prec = SPEC_NONE;
+	spec->mod = MOD_NONE;
+
+	/* positional arguments would need two passes to decode */
+	for (s = ++p; *s >= '0' && *s <= '9'; s++)
+		;
+	if (*s == '$')
+		return NULL;
+
+	spec->flags = p;
+	while (*p && strchr("-+ #0'", *p))
+		p++;
+	spec->nflags = p - spec->flags;
+
+	if (*p == '*') {
+		spec->width = SPEC_STAR;
+		p++;
+	} else if (*p >= '0' && *p <= '9') {
+		for (spec->width = 0; *p >= '0' && *p <= '9'; p++)
+			spec->width = (spec->width * 10) + *p - '0';
+	}
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->prec = SPEC_STAR;
+			p++;
+		} else {
+			for (spec->prec = 0; *p >= '0' && *p <= '9'; p++)
+				spec->prec = (spec->prec * 10) + *p - '0';
+		}
+	}
+
+	switch (*p) {
+	case 'h':
+		spec->mod = p[1] == 'h' ? MOD_HH : MOD_H;
+		p += 1 + (spec->mod == MOD_HH);
+		break;
+	case 'l':
+		spec->mod = p[1] == 'l' ? MOD_LL : MOD_L;
+		p += 1 + (spec->mod == MOD_LL);
+		break;
+	case 'q': spec->mod = MOD_LL; p++; break;
+	case 'L': spec->mod = MOD_LD; p++; break;
+	case 'j': spec->mod = MOD_J; p++; break;
+	case 'z': spec->mod = MOD_Z; p++; break;
+	case 't': spec->mod = MOD_T; p++; break;
+	}
+
+	if (!*p || !strchr("diouxXcseEfFgGaApm", *p))
+		return NULL;
+	if (spec->mod == MOD_L && (*p == 'c' || *p == 's'))
+		return NULL;
+	spec->conv = *p;
+	return p + 1;
+}
+
+static inline struct trace_record *trace_record(trace_ring *tr, uint64_t idx)
+{
+	return &tr->ring[idx % tr->hdr->slots];
+}
+
+static void trace_init_header(trace_ring *tr, unsigned long slots)
+{
+	struct trace_header *hdr = tr->hdr;
+
+	memset(hdr, 0, sizeof(*hdr));
+	memcpy(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic));
+	hdr->version = TRACE_VERSION;
+	hdr->rec_size = TRACE_RECORD_SIZE;
+	hdr->sites_offset = TRACE_HEADER_SIZE;
+	hdr->sites_size = TRACE_SITES_SIZE;
+	hdr->ring_offset = TRACE_HEADER_SIZE + TRACE_SITES_SIZE;
+	hdr->slots = slots;
+}
+
+static int trace_header_ok(struct trace_header *hdr, size_t size)
+{
+	if (memcmp(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic)))
+		return 0;
+	if (hdr->version != TRACE_VERSION || hdr->rec_size != TRACE_RECORD_SIZE)
+		return 0;
+	if (hdr->sites_offset < sizeof(*hdr) || hdr->sites_used > hdr->sites_size)
+		return 0;
+	if ((uint64_t)hdr->sites_offset + hdr->sites_size > hdr->ring_offset)
+		return 0;
+	if (!hdr->slots || hdr->ring_offset + (hdr->slots * TRACE_RECORD_SIZE) != size)
+		return 0;
+	return 1;
+}
+
+static trace_ring *trace_map(int fd, size_t size, int writable)
+{
+	trace_ring *tr;
+	int prot = PROT_READ | (writable ? PROT_WRITE : 0);
+
+	if (!(tr = calloc(1, sizeof(*tr))))
+		return NULL;
+
+	tr->map = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+	if (tr->map == MAP_FAILED) {
+		free(tr);
+		return NULL;
+	}
+	tr->fd = fd;
+	tr->writable = writable;
+	tr->map_size = size;
+	tr->hdr = tr->map;
+	return tr;
+}
+
+static void trace_set_areas(trace_ring *tr)
+{
+	tr->sites = (char *)tr->map + tr->hdr->sites_offset;
+	tr->ring = (struct trace_record *)((char *)tr->map + tr->hdr->ring_offset);
+}
+
+trace_ring *trace_open(const char *path, unsigned long size)
+{
+	trace_ring *tr;
+	struct stat st;
+	unsigned long slots;
+	size_t total;
+	int fd, reuse = 0;
+
+	if (!path)
+		return NULL;
+
+	slots = size / TRACE_RECORD_SIZE;
+	if (slots < TRACE_MIN_SLOTS)
+		slots = TRACE_MIN_SLOTS;
+	total = TRACE_HEADER_SIZE + TRACE_SITES_SIZE + (slots * TRACE_RECORD_SIZE);
+
+	if ((fd = open(path, O_RDWR | O_CREAT, 0644)) < 0)
+		return NULL;
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	/*
+	 * Reuse an existing ring of the right size, unless its call
+	 * site area is filling up. Each process that writes to the
+	 * ring adds its own copy of every format it uses, so a ring
+	 * that's reused over and over would eventually run out.
+	 */
+	if ((size_t)st.st_size == total) {
+		struct trace_header hdr;
+		if (pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr)) {
+			reuse = trace_header_ok(&hdr, total) && hdr.slots == slots &&
+				hdr.sites_used < hdr.sites_size / 2;
+		}
+	}
+
+	if (!reuse && (ftruncate(fd, 0) < 0 || ftruncate(fd, total) < 0)) {
+		close(fd);
+		return NULL;
+	}
+
+	if (!(tr = trace_map(fd, total, 1))) {
+		close(fd);
+		return NULL;
+	}
+	if (!(tr->cache = calloc(TRACE_SITE_CACHE, sizeof(*tr->cache)))) {
+		trace_close(tr);
+		return NULL;
+	}
+
+	if (!reuse)
+		trace_init_header(tr, slots);
+	tr->pid = getpid();
+	tr->hdr->pid = tr->pid;
+	trace_set_areas(tr);
+
+	return tr;
+}
+
+trace_ring *trace_open_ro(const char *path)
+{
+	trace_ring *tr;
+	struct stat st;
+	int fd;
+
+	if (!path)
+		return NULL;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < TRACE_HEADER_SIZE) {
+		close(fd);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (!(tr = trace_map(fd, st.st_size, 0))) {
+		close(fd);
+		return NULL;
+	}
+
+	if (!trace_header_ok(tr->hdr, tr->map_size)) {
+		trace_close(tr);
+		errno = EINVAL;
+		return NULL;
+	}
+	trace_set_areas(tr);
+
+	return tr;
+}
+
+void trace_close(trace_ring *tr)
+{
+	if (!tr)
+		return;
+
+	munmap(tr->map, tr->map_size);
+	close(tr->fd);
+	free(tr->cache);
+	free(tr);
+}
+
+int trace_pid(trace_ring *tr)
+{
+	return tr ? (int)tr->hdr->pid : -1;
+}
+
+/*
+ * Returns the id of the call site using 'fmt', adding the format
+ * to the ring if we haven't seen it before. Formats are keyed on
+ * their address, so looking one up is cheap. 0 means there's no
+ * room for it.
+ */
+static uint32_t trace_site_id(trace_ring *tr, const char *fmt)
+{
+	struct trace_header *hdr = tr->hdr;
+	unsigned int slot, i;
+	size_t len;
+
+	slot = (unsigned int)(((uintptr_t)fmt >> 3) * 2654435761U);
+	for (i = 0; i < TRACE_SITE_CACHE; i++) {
+		struct trace_site *site = &tr->cache[(slot + i) & (TRACE_SITE_CACHE - 1)];
+
+		if (site->fmt == fmt)
+			return site->id;
+		if (site->fmt)
+			continue;
+
+		len = strlen(fmt) + 1;
+		if (hdr->sites_used + len > hdr->sites_size)
+			return 0;
+		memcpy(tr->sites + hdr->sites_used, fmt, len);
+		site->fmt = fmt;
+		site->id = hdr->sites_used + 1;
+		hdr->sites_used += len;
+		return site->id;
+	}
+
+	return 0;
+}
+
+int trace_vlog(trace_ring *tr, int level, int verbosity, const char *fmt, va_list ap)
+{
+	struct trace_spec spec;
+	struct trace_record *rec;
+	struct timeval tv;
+	uint64_t args[TRACE_MAX_ARGS], idx;
+	const char *strs[TRACE_MAX_ARGS], *p;
+	char preformatted[TRACE_MAX_STRING + 1];
+	unsigned int nargs = 0, i, off;
+	uint32_t site = 0;
+	int saved_errno = errno, ok = 1;
+	va_list ap2;
+
+	if (!tr || !tr->writable || !fmt)
+		return -1;
+
+	va_copy(ap2, ap);
+	gettimeofday(&tv, NULL);
+
+	for (p = fmt; ok && (p = strchr(p, '%')); ) {
+		if (p[1] == '%') {
+			p += 2;
+			continue;
+		}
+		/* worst case is width, precision and the value itself */
+		if (nargs + 3 > TRACE_MAX_ARGS || !(p = parse_spec(p, &spec))) {
+			ok = 0;
+			break;
+		}
+		if (spec.width == SPEC_STAR) {
+			strs[nargs] = NULL;
+			args[nargs++] = (int64_t)va_arg(ap, int);
+		}
+		if (spec.prec == SPEC_STAR) {
+			spec.prec = va_arg(ap, int);
+			strs[nargs] = NULL;
+			args[nargs++] = (int64_t)spec.prec;
+			if (spec.prec < 0)
+				spec.prec = SPEC_NONE;
+		}
+
+		strs[nargs] = NULL;
+		switch (spec.conv) {
+		case 'd': case 'i':
+			switch (spec.mod) {
+			case MOD_HH: args[nargs] = (int64_t)(signed char)va_arg(ap, int); break;
+			case MOD_H: args[nargs] = (int64_t)(short)va_arg(ap, int); break;
+			case MOD_L: args[nargs] = (int64_t)va_arg(ap, long); break;
+			case MOD_LL: args[nargs] = (int64_t)va_arg(ap, long long); break;
+			case MOD_J: args[nargs] = (int64_t)va_arg(ap, intmax_t); break;
+			case MOD_Z: args[nargs] = (int64_t)va_arg(ap, ssize_t); break;
+			case MOD_T: args[nargs] = (int64_t)va_arg(ap, ptrdiff_t); break;
+			default: args[nargs] = (int64_t)va_arg(ap, int); break;
+			}
+			break;
+		case 'o': case 'u': case 'x': case 'X':
+			switch (spec.mod) {
+			case MOD_HH: args[nargs] = (unsigned char)va_arg(ap, unsigned int); break;
+			case MOD_H: args[nargs] = (unsigned short)va_arg(ap, unsigned int); break;
+			case MOD_L: args[nargs] = va_arg(ap, unsigned long); break;
+			case MOD_LL: args[nargs] = va_arg(ap, unsigned long long); break;
+			case MOD_J: args[nargs] = va_arg(ap, uintmax_t); break;
+			case MOD_Z: args[nargs] = va_arg(ap, size_t); break;
+			case MOD_T: args[nargs] = (uint64_t)va_arg(ap, ptrdiff_t); break;
+			default: args[nargs] = va_arg(ap, unsigned int); break;
+			}
+			break;
+		case 'c':
+			args[nargs] = (int64_t)va_arg(ap, int);
+			break;
+		case 'e': case 'E': case 'f': case 'F':
+		case 'g': case 'G': case 'a': case 'A':
+			{
+				double d;
+				if (spec.mod == MOD_LD)
+					d = (double)va_arg(ap, long double);
+				else
+					d = va_arg(ap, double);
+				memcpy(&args[nargs], &d, sizeof(d));
+			}
+			break;
+		case 's':
+			strs[nargs] = va_arg(ap, const char *);
+			if (!strs[nargs]) {
+				args[nargs] = TRACE_NULL_STRING;
+			} else {
+				size_t max = TRACE_MAX_STRING;
+				if (spec.prec >= 0 && (size_t)spec.prec < max)
+					max = spec.prec;
+				args[nargs] = strnlen(strs[nargs], max);
+			}
+			break;
+		case 'p':
+			args[nargs] = (uintptr_t)va_arg(ap, void *);
+			break;
+		case 'm':
+			args[nargs] = saved_errno;
+			break;
+		}
+		nargs++;
+	}
+
+	if (ok)
+		site = trace_site_id(tr, fmt);
+
+	/* fall back to storing the message pre-formatted */
+	if (!site) {
+		int len;
+		errno = saved_errno;
+		len = vsnprintf(preformatted, sizeof(preformatted), fmt, ap2);
+		if (len < 0)
+			len = 0;
+		else if (len > TRACE_MAX_STRING)
+			len = TRACE_MAX_STRING;
+		nargs = 1;
+		args[0] = len;
+		strs[0] = preformatted;
+	}
+	va_end(ap2);
+
+	idx = tr->hdr->head;
+	rec = trace_record(tr, idx);
+	rec->type = TRACE_REC_EVENT;
+	rec->verbosity = verbosity;
+	rec->len = nargs;
+	rec->u.ev.usec = ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+	rec->u.ev.level = level;
+	rec->u.ev.site = site;
+	rec->u.ev.pid = tr->pid;
+	rec->u.ev.unused = 0;
+	for (i = 0; i < nargs && i < TRACE_EVENT_ARGS; i++)
+		rec->u.ev.arg[i] = args[i];
+	rec->seq = (uint32_t)++idx;
+
+	for (; i < nargs; ) {
+		unsigned int n;
+		rec = trace_record(tr, idx);
+		rec->type = TRACE_REC_ARGS;
+		for (n = 0; n < TRACE_CONT_ARGS && i < nargs; n++)
+			rec->u.arg[n] = args[i++];
+		rec->len = n;
+		rec->seq = (uint32_t)++idx;
+	}
+
+	/* strings are packed back to back into string records */
+	rec = NULL;
+	off = 0;
+	for (i = 0; i < nargs; i++) {
+		size_t len, done = 0;
+
+		if (!strs[i] || args[i] == TRACE_NULL_STRING)
+			continue;
+		len = args[i];
+		while (done < len) {
+			size_t chunk;
+			if (!rec || off == TRACE_STRING_BYTES) {
+				rec = trace_record(tr, idx);
+				rec->type = TRACE_REC_STRING;
+				rec->seq = (uint32_t)++idx;
+				off = 0;
+			}
+			chunk = len - done;
+			if (chunk > TRACE_STRING_BYTES - off)
+				chunk = TRACE_STRING_BYTES - off;
+			memcpy(rec->u.str + off, strs[i] + done, chunk);
+			done += chunk;
+			off += chunk;
+			rec->len = off;
+		}
+	}
+
+	tr->hdr->head = idx;
+	errno = saved_errno;
+	return 0;
+}
+
+int trace_log(trace_ring *tr, int level, int verbosity, const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	ret = trace_vlog(tr, level, verbosity, fmt, ap);
+	va_end(ap);
+	return ret;
+}
+
+struct trace_out {
+	char *buf;
+	size_t len, size;
+};
+
+static void out_printf(struct trace_out *out, const char *fmt, ...)
+	__attribute__((__format__(__printf__, 2, 3)));
+static void out_printf(struct trace_out *out, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+
+	if (out->len >= out->size - 1)
+		return;
+	va_start(ap, fmt);
+	len = vsnprintf(out->buf + out->len, out->size - out->len, fmt, ap);
+	va_end(ap);
+	if (len > 0)
+		out->len += len;
+	if (out->len >= out->size)
+		out->len = out->size - 1;
+}
+
+/*
+ * Renders a stored message using its format. We rebuild each
+ * conversion specification with normalized length modifiers and
+ * let snprintf() do the actual formatting.
+ */
+static void trace_render(const char *fmt, const uint64_t *args, unsigned int nargs,
+                         const char *strbuf, size_t strlen_total, struct trace_out *out)
+{
+	struct trace_spec spec;
+	const char *p, *next;
+	unsigned int ai = 0;
+	size_t soff = 0;
+
+	for (p = fmt; *p; p = next) {
+		char cspec[64], *c, *str;
+		int prec = SPEC_NONE;
+
+		if (*p != '%') {
+			next = strchr(p, '%');
+			if (!next)
+				next = p + strlen(p);
+			out_printf(out, "%.*s", (int)(next - p), p);
+			continue;
+		}
+		if (p[1] == '%') {
+			out_printf(out, "%%");
+			next = p + 2;
+			continue;
+		}
+		if (!(next = parse_spec(p, &spec)))
+			break;
+
+		c = cspec;
+		*c++ = '%';
+		memcpy(c, spec.flags, spec.nflags < 8 ? spec.nflags : 8);
+		c += spec.nflags < 8 ? spec.nflags : 8;
+		if (spec.width == SPEC_STAR) {
+			if (ai >= nargs)
+				break;
+			c += sprintf(c, "%d", (int)(int64_t)args[ai++]);
+		} else if (spec.width != SPEC_NONE) {
+			c += sprintf(c, "%d", spec.width);
+		}
+		if (spec.prec == SPEC_STAR) {
+			if (ai >= nargs)
+				break;
+			prec = (int)(int64_t)args[ai++];
+		} else {
+			prec = spec.prec;
+		}
+		if (prec >= 0)
+			c += sprintf(c, ".%d", prec);
+		if (ai >= nargs)
+			break;
+
+		switch (spec.conv) {
+		case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+			*c++ = 'l';
+			*c++ = 'l';
+			*c++ = spec.conv;
+			*c = 0;
+			if (spec.conv == 'd' || spec.conv == 'i')
+				out_printf(out, cspec, (long long)args[ai]);
+			else
+				out_printf(out, cspec, (unsigned long long)args[ai]);
+			break;
+		case 'c':
+			*c++ = 'c';
+			*c = 0;
+			out_printf(out, cspec, (int)args[ai]);
+			break;
+		case 'e': case 'E': case 'f': case 'F':
+		case 'g': case 'G': case 'a': case 'A':
+			{
+				double d;
+				memcpy(&d, &args[ai], sizeof(d));
+				*c++ = spec.conv;
+				*c = 0;
+				out_printf(out, cspec, d);
+			}
+			break;
+		case 's':
+			*c++ = 's';
+			*c = 0;
+			if (args[ai] == TRACE_NULL_STRING) {
+				out_printf(out, cspec, "(null)");
+				break;
+			}
+			{
+				size_t len = args[ai];
+				if (soff + len > strlen_total)
+					len = soff < strlen_total ? strlen_total - soff : 0;
+				str = malloc(len + 1);
+				if (str) {
+					memcpy(str, strbuf + soff, len);
+					str[len] = 0;
+					out_printf(out, cspec, str);
+					free(str);
+				}
+				soff += len;
+			}
+			break;
+		case 'p':
+			*c++ = 'p';
+			*c = 0;
+			out_printf(out, cspec, (void *)(uintptr_t)args[ai]);
+			break;
+		case 'm':
+			*c++ = 's';
+			*c = 0;
+			out_printf(out, cspec, strerror((int)args[ai]));
+			break;
+		}
+		ai++;
+	}
+}
+
+unsigned long trace_walk(trace_ring *tr, int (*walker)(const struct timeval *, int, int, int, const char *, void *), void *arg)
+{
+	struct trace_header *hdr;
+	uint64_t head, idx, args[TRACE_MAX_ARGS];
+	unsigned long count = 0;
+	char *strbuf, *msg;
+	size_t strbuf_size = TRACE_MAX_ARGS * TRACE_MAX_STRING;
+	size_t msg_size = strbuf_size + 8192;
+
+	if (!tr || !walker)
+		return 0;
+
+	hdr = tr->hdr;
+	strbuf = malloc(strbuf_size);
+	msg = malloc(msg_size);
+	if (!strbuf || !msg) {
+		free(strbuf);
+		free(msg);
+		return 0;
+	}
+
+	head = hdr->head;
+	idx = head > hdr->slots ? head - hdr->slots : 0;
+	while (idx < head) {
+		struct trace_record *rec = trace_record(tr, idx);
+		struct trace_out out = { msg, 0, msg_size };
+		struct timeval tv;
+		const char *fmt;
+		unsigned int nargs, i;
+		size_t slen = 0;
+
+		/* skip continuations whose events have been overwritten */
+		if (rec->seq != (uint32_t)(idx + 1) || rec->type != TRACE_REC_EVENT) {
+			idx++;
+			continue;
+		}
+
+		nargs = rec->len > TRACE_MAX_ARGS ? TRACE_MAX_ARGS : rec->len;
+		for (i = 0; i < nargs && i < TRACE_EVENT_ARGS; i++)
+			args[i] = rec->u.ev.arg[i];
+		idx++;
+		while (i < nargs && idx < head) {
+			struct trace_record *cont = trace_record(tr, idx);
+			unsigned int n;
+			if (cont->seq != (uint32_t)(idx + 1) || cont->type != TRACE_REC_ARGS)
+				break;
+			for (n = 0; n < cont->len && n < TRACE_CONT_ARGS && i < nargs; n++)
+				args[i++] = cont->u.arg[n];
+			idx++;
+		}
+		nargs = i;
+		while (idx < head) {
+			struct trace_record *cont = trace_record(tr, idx);
+			size_t len = cont->len;
+			if (cont->seq != (uint32_t)(idx + 1) || cont->type != TRACE_REC_STRING)
+				break;
+			if (len > TRACE_STRING_BYTES)
+				len = TRACE_STRING_BYTES;
+			if (slen + len <= strbuf_size) {
+				memcpy(strbuf + slen, cont->u.str, len);
+				slen += len;
+			}
+			idx++;
+		}
+
+		if (!rec->u.ev.site) {
+			/* pre-formatted message */
+			fmt = "%s";
+		} else if (rec->u.ev.site - 1 >= hdr->sites_used) {
+			continue;
+		} else {
+			fmt = tr->sites + rec->u.ev.site - 1;
+			/* the sites area is only NUL-terminated by its users */
+			if (!memchr(fmt, 0, hdr->sites_used - (rec->u.ev.site - 1)))
+				continue;
+		}
+		trace_render(fmt, args, nargs, strbuf, slen, &out);
+		msg[out.len] = 0;
+
+		tv.tv_sec = rec->u.ev.usec / 1000000;
+		tv.tv_usec = rec->u.ev.usec % 1000000;
+		count++;
+		if (walker(&tv, (int)rec->u.ev.pid, rec->u.ev.level, rec->verbosity, msg, arg))
+			break;
+	}
+
+	free(strbuf);
+	free(msg);
+	return count;
+}
@@ -0,0 +1,98 @@
+#ifndef LIBNAGIOS_trace_h__
+#define LIBNAGIOS_trace_h__
+#include <stdarg.h>
+#include <sys/time.h>
+
+/**
+ * @file trace.h
+ * @brief Binary trace ring API
+ *
+ * A trace ring is a file mapped into memory that printf()-style
+ * messages are logged into without formatting them. Each message
+ * is stored as a fixed-size record holding a timestamp, the pid of
+ * the writer, a level, a verbosity, the id of its call site (the
+ * format string) and the raw arguments, with strings and extra arguments spilling over into
+ * continuation records. Once the ring is full, the oldest records
+ * are overwritten.
+ *
+ * Since the ring is a shared file mapping, whatever was logged
+ * survives the logging process crashing, and formatting is left
+ * to whoever reads the ring later.
+ *
+ * A ring must only be written to by a single thread in a single
+ * process. Child processes must open a ring of their own.
+ * @{
+ */
+
+/** Size of a single trace record */
+#define TRACE_RECORD_SIZE 64
+
+/** Strings longer than this are truncated when logged */
+#define TRACE_MAX_STRING 512
+
+struct trace_ring;
+typedef struct trace_ring trace_ring;
+
+/**
+ * Open a trace ring for writing, creating it if necessary.
+ * If 'path' already holds a ring of the same size it's reused,
+ * so new records are appended to the ones already there.
+ * @param path Path to the ring file
+ * @param size Number of bytes to set aside for records
+ * @return A trace ring on success, NULL on errors
+ */
+extern trace_ring *trace_open(const char *path, unsigned long size);
+
+/**
+ * Open an existing trace ring for reading
+ * @param path Path to the ring file
+ * @return A trace ring on success, NULL on errors
+ */
+extern trace_ring *trace_open_ro(const char *path);
+
+/**
+ * Unmap a trace ring and release all resources associated with it.
+ * This never removes the ring file.
+ * @param tr The trace ring to close
+ */
+extern void trace_close(trace_ring *tr);
+
+/**
+ * Log a message to a trace ring.
+ * All printf() conversions except %n are supported, as is %m.
+ * @param tr The trace ring to log to
+ * @param level The debug level of the message
+ * @param verbosity The verbosity of the message
+ * @param fmt printf()-style format string. Must remain valid and
+ *            unchanged for as long as the ring is open, which is
+ *            always the case for string literals.
+ * @param ap Arguments for the format string
+ * @return 0 on success, -1 on errors
+ */
+extern int trace_vlog(trace_ring *tr, int level, int verbosity, const char *fmt, va_list ap);
+
+/**
+ * Same as trace_vlog(), but with variadic arguments
+ */
+extern int trace_log(trace_ring *tr, int level, int verbosity, const char *fmt, ...)
+	__attribute__((__format__(__printf__, 4, 5)));
+
+/**
+ * Get the pid of the process that last opened a ring for writing
+ * @param tr The trace ring
+ * @return The pid of the writer
+ */
+extern int trace_pid(trace_ring *tr);
+
+/**
+ * Render all messages in a trace ring, oldest first
+ * @param tr The trace ring to walk
+ * @param walker Called with the timestamp, writer pid, level,
+ *               verbosity and formatted text of each message.
+ *               Returning non-zero stops the walk.
+ * @param arg Passed unmodified to walker
+ * @return The number of messages rendered
+ */
+extern unsigned long trace_walk(trace_ring *tr, int (*walker)(const struct timeval *, int, int, int, const char *, void *), void *arg);
+/** @} */
+#endif /* LIBNAGIOS_trace_h__ */
@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include "twheel.h"
+
+/*
+ * Every object and every list head is a node in one set of next and
+ * prev arrays. Objects are 0 to objects - 1, the heads of the slot
+ * lists come right after them and the head of the expired list is
+ * last. The lists are circular, so unlinking a node never has to
+ * know which list it's on.
+ */
+struct twheel {
+	unsigned int objects;
+	unsigned int slots; /* power of two */
+	unsigned int entries, expired;
+	time_t swept; /* everything due up to and including this is expired */
+	time_t *when; /* per object, 0 for no deadline */
+	unsigned int *next, *prev;
+	unsigned char *on_expired;
+};
+
+#define slot_head(tw, t) ((tw)->objects + (unsigned int)((unsigned long)(t) & ((tw)->slots - 1)))
+#define expired_head(tw) ((tw)->objects + (tw)->slots)
+
+static inline void twheel_unlink(twheel *tw, unsigned int id)
+{
+	tw->next[tw->prev[id]] = tw->next[id];
+	tw->prev[tw->next[id]] = tw->prev[id];
+}
+
+static inline void twheel_link_after(twheel *tw, unsigned int id, unsigned int pos)
+{
+	tw->next[id] = tw->next[pos];
+	tw->prev[id] = pos;
+	tw->prev[tw->next[pos]] = id;
+	tw->next[pos] = id;
+}
+
+twheel *twheel_create(unsigned int objects, unsigned int slots)
+{
+	twheel *tw;
+	unsigned int i, nodes, s = 1;
+
+	while (s < slots && s < 1U << 20)
+		s <<= 1;
+
+	if (!(tw = calloc(1, sizeof(*tw))))
+		return NULL;
+
+	tw->objects = objects;
+	tw->slots = s;
+	nodes = objects + s + 1;
+	tw->when = calloc(objects ? objects : 1, sizeof(*tw->when));
+	tw->on_expired = calloc(objects ? objects : 1, sizeof(*tw->on_expired));
+	tw->next = malloc(nodes * sizeof(*tw->next));
+	tw->prev = malloc(nodes * sizeof(*tw->prev));
+	if (!tw->when || !tw->on_expired || !tw->next || !tw->prev) {
+		twheel_destroy(tw);
+		return NULL;
+	}
+
+	for (i = objects; i < nodes; i++)
+		tw->next[i] = tw->prev[i] = i;
+
+	return tw;
+}
+
+void twheel_destroy(twheel *tw)
+{
+	if (!tw)
+		return;
+
+	free(tw->when);
+	free(tw->on_expired);
+	free(tw->next);
+	free(tw->prev);
+	free(tw);
+}
+
+int twheel_set(twheel *tw, unsigned int id, time_t when)
+{
+	if (!tw || id >= tw->objects || when < 0)
+		return -1;
+
+	if (tw->when[id]) {
+		/* already where it belongs */
+		if (tw->when[id] == when && (tw->on_expired[id] || when > tw->swept))
+			return 0;
+		twheel_unlink(tw, id);
+		if (tw->on_expired[id]) {
+			tw->on_expired[id] = 0;
+			tw->expired--;
+		}
+		tw->entries--;
+	}
+
+	tw->when[id] = when;
+	if (!when)
+		return 0;
+
+	tw->entries++;
+	if (when <= tw->swept) {
+		twheel_link_after(tw, id, expired_head(tw));
+		tw->on_expired[id] = 1;
+		tw->expired++;
+	} else {
+		twheel_link_after(tw, id, tw->prev[slot_head(tw, when)]);
+	}
+
+	return 0;
+}
+
+time_t twheel_get(twheel *tw, unsigned int id)
+{
+	if (!tw || id >= tw->objects)
+		return 0;
+
+	return tw->when[id];
+}
+
+static void twheel_expire_slot(twheel *tw, unsigned int head, time_t now)
+{
+	unsigned int id, next;
+
+	for (id = tw->next[head]; id != head; id = next) {
+		next = tw->next[id];
+		if (tw->when[id] > now)
+			continue;
+		twheel_unlink(tw, id);
+		twheel_link_after(tw, id, tw->prev[expired_head(tw)]);
+		tw->on_expired[id] = 1;
+		tw->expired++;
+	}
+}
+
+unsigned int twheel_expire(twheel *tw, time_t now)
+{
+	if (!tw)
+		return TWHEEL_NONE;
+
+	/* the clock went backwards, so nothing new has come due */
+	if (now < tw->swept) {
+		tw->swept = now;
+	} else if (now > tw->swept) {
+		unsigned int i;
+
+		if ((unsigned long)(now - tw->swept) >= tw->slots) {
+			for (i = 0; i < tw->slots; i++)
+				twheel_expire_slot(tw, tw->objects + i, now);
+		} else {
+			time_t t;
+			for (t = tw->swept + 1; t <= now; t++)
+				twheel_expire_slot(tw, slot_head(tw, t), now);
+		}
+		tw->swept = now;
+	}
+
+	return twheel_next_expired(tw, expired_head(tw));
+}
+
+unsigned int twheel_next_expired(twheel *tw, unsigned int id)
+{
+	unsigned int next;
+
+	if (!tw || id > tw->objects + tw->slots)
+		return TWHEEL_NONE;
+
+	next = tw->next[id];
+	return next == expired_head(tw) ? TWHEEL_NONE : next;
+}
+
+unsigned int twheel_num_entries(twheel *tw)
+{
+	return tw ? tw->entries : 0;
+}
+
+unsigned int twheel_num_expired(twheel *tw)
+{
+	return tw ? tw->expired : 0;
+}
@@ -0,0 +1,102 @@
+#ifndef LIBNAGIOS_twheel_h__
+#define LIBNAGIOS_twheel_h__
+#include <time.h>
+
+/**
+ * @file twheel.h
+ * @brief Timing wheel of per-object deadlines
+ *
+ * Keeps at most one deadline for each of a fixed number of objects,
+ * identified by small integers (like the id's of hosts or services),
+ * and hands back the ones that have passed. Objects are kept in one
+ * list per second on a wheel, so setting, moving and removing a
+ * deadline is constant time, and finding the expired ones means
+ * looking at the seconds that have gone by since last time rather
+ * than at every object. Deadlines further away than one turn of the
+ * wheel are passed over on each turn until their time comes.
+ *
+ * Expired objects are moved to a list of their own, where they stay
+ * until their deadline is set again or removed, so objects that
+ * can't be dealt with right away are handed back every time.
+ * This is not thread safe.
+ * @{
+ */
+
+/** Marks the end of the expired list */
+#define TWHEEL_NONE (~0U)
+
+struct twheel;
+typedef struct twheel twheel;
+
+/**
+ * Create a timing wheel
+ * @param objects The number of objects, with id's 0 to objects - 1
+ * @param slots The number of seconds one turn of the wheel covers.
+ *              It's rounded up to a power of two.
+ * @return A new timing wheel on success, NULL on errors
+ */
+extern twheel *twheel_create(unsigned int objects, unsigned int slots);
+
+/**
+ * Destroy a timing wheel, freeing all memory it uses
+ * @param tw The timing wheel to destroy
+ */
+extern void twheel_destroy(twheel *tw);
+
+/**
+ * Set, move or remove the deadline of an object
+ * An object whose deadline has already passed goes straight to the
+ * expired list, ahead of the ones already there, so setting the
+ * deadline of the object being looked at while walking that list
+ * never makes the walk see it again.
+ * @param tw The timing wheel
+ * @param id The object
+ * @param when The new deadline, or 0 to remove it
+ * @return 0 on success, -1 on errors
+ */
+extern int twheel_set(twheel *tw, unsigned int id, time_t when);
+
+/**
+ * Get the deadline of an object
+ * @param tw The timing wheel
+ * @param id The object
+ * @return The object's deadline, or 0 if it has none
+ */
+extern time_t twheel_get(twheel *tw, unsigned int id);
+
+/**
+ * Move all objects whose deadline is 'now' or earlier to the
+ * expired list, and get the first of them
+ * Walk the rest with twheel_next_expired(), fetching the next one
+ * before doing anything that might change the deadline of the
+ * current one.
+ * @param tw The timing wheel
+ * @param now The current time
+ * @return The first expired object, or TWHEEL_NONE if there are none
+ */
+extern unsigned int twheel_expire(twheel *tw, time_t now);
+
+/**
+ * Get the next object on the expired list
+ * @param tw The timing wheel
+ * @param id An object on the expired list
+ * @return The next expired object, or TWHEEL_NONE at the end
+ */
+extern unsigned int twheel_next_expired(twheel *tw, unsigned int id);
+
+/**
+ * Get the number of objects that have a deadline
+ * @param tw The timing wheel
+ * @return Number of objects with a deadline, expired or not
+ */
+extern unsigned int twheel_num_entries(twheel *tw);
+
+/**
+ * Get the number of objects on the expired list
+ * @param tw The timing wheel
+ * @return Number of expired objects
+ */
+extern unsigned int twheel_num_expired(twheel *tw);
+
+/** @} */
+#endif /* LIBNAGIOS_twheel_h__ */
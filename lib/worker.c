@@ -6,19 +6,101 @@
 #include <errno.h>
 #include <string.h>
 #include <time.h>
+#include <poll.h>
+#include <sys/uio.h>
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
 #include "libnagios.h"
 
 struct execution_information {
-	squeue_event *sq_event;
+	child_process *cp; /* the job we belong to */
+	time_t expires; /* when the job times out. Whole seconds */
+	struct execution_information *wheel_next, *wheel_prev;
 	pid_t pid;
+	int pidfd; /* tells us when the child exits. -1 if we have none */
+	struct execution_information *pid_next; /* pid_table chain */
 	struct timeval start;
 	struct timeval stop;
 	float runtime;
 	struct rusage rusage;
+	const char *resident; /* helper command, if any. Points into the request */
+	struct resident_helper *rh; /* helper running this job */
+	unsigned int rh_slot; /* our slot in rh->slots */
+	probe *probe; /* native probe running this job */
+};
+
+/*
+ * A resident helper is a long-lived plugin that reads jobs from
+ * stdin and writes their results to stdout, so running a check
+ * doesn't cost us a fork()+exec(). Each job gets a slot number
+ * that the helper echoes back with the result, so it's free to
+ * run many jobs concurrently and answer them in any order.
+ */
+struct resident_helper {
+	char *cmd;
+	pid_t pid;
+	int in_fd, out_fd;
+	time_t started, broken_until;
+	iocache *ioc;
+	char *wbuf; /* requests the pipe couldn't take yet */
+	unsigned long wbuf_len, wbuf_size;
+	child_process **slots;
+	unsigned int num_slots, used_slots, next_slot, abandoned;
+	int resp_pending; /* we have a response header, but not the body */
+	unsigned int resp_slot, resp_code;
+	unsigned long resp_outlen, resp_errlen;
+	struct resident_helper *next;
 };
 
+#define RESIDENT_MIN_SLOTS 16
+#define RESIDENT_MAX_OUTPUT (64 * 1024) /* per stream and job */
+#define RESIDENT_MAX_ABANDONED 16 /* timed out jobs before we restart a helper */
+#define RESIDENT_MIN_LIFETIME 5 /* helpers dying sooner than this are broken */
+#define RESIDENT_RETRY_DELAY 60 /* how long to run jobs normally for broken helpers */
+
+/*
+ * Output buffers of finished jobs are kept around for the next ones,
+ * so the common case of a few hundred bytes of output costs no
+ * malloc() at all. Buffers that had to grow are freed instead.
+ */
+#define IOBUF_POOL_BUFSIZE 8192
+#define IOBUF_POOL_MAX 256
+static char *iobuf_pool[IOBUF_POOL_MAX];
+static unsigned int iobuf_pool_len;
+
+/*
+ * Job timeouts live in a hashed timer wheel with one slot per
+ * second, so adding, removing and expiring a job costs the same
+ * no matter how many are running. Timeouts longer than the wheel
+ * is wide just go round it more than once.
+ */
+#define WHEEL_SLOTS 512 /* must be a power of two */
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+static struct execution_information *wheel[WHEEL_SLOTS];
+static time_t wheel_clock; /* slots for earlier seconds have been expired */
+
+/*
+ * Every child gets a pidfd in our iobroker set, so we hear about
+ * it exiting as soon as that happens and reap exactly that child.
+ * Kernels without pidfds get a SIGCHLD handler that pokes a pipe
+ * instead, and we look up the pids we reap in pid_table. We can't
+ * block SIGCHLD to use a signalfd, since the plugins we start would
+ * inherit the signal mask.
+ */
+#define PID_TABLE_SIZE 4096 /* must be a power of two */
+static struct execution_information *pid_table[PID_TABLE_SIZE];
+static int use_pidfds = 1;
+static int sigchld_pipe[2] = { -1, -1 };
+
+/* counters we report to the master every now and then */
+#define STATS_INTERVAL 5
+static struct {
+	unsigned long reaped, timed_out, orphaned;
+} wstats, wstats_sent;
+static time_t wstats_next;
+
 static iobroker_set *iobs;
-static squeue_t *sq;
 static unsigned int started, running_jobs;
 static int master_sd;
 static int parent_pid;
@@ -35,8 +117,7 @@ struct request {
 
 static void exit_worker(int code, const char *msg)
 {
-	child_process *cp;
-	int discard;
+	int i, discard;
 
 	if (msg) {
 		perror(msg);
@@ -53,8 +134,13 @@ static void exit_worker(int code, const char *msg)
 	while (waitpid(-1, &discard, WNOHANG) > 0)
 		; /* do nothing */
 	sleep(1);
-	while ((cp = (child_process *)squeue_pop(sq))) {
-		(void)kill(cp->ei->pid, SIGKILL);
+	for (i = 0; i < WHEEL_SLOTS; i++) {
+		struct execution_information *ei;
+		for (ei = wheel[i]; ei; ei = ei->wheel_next) {
+			/* resident jobs have no pid, and kill(0) would hit us too */
+			if (ei->pid)
+				(void)kill(ei->pid, SIGKILL);
+		}
 	}
 	while (waitpid(-1, &discard, WNOHANG) > 0)
 		; /* do nothing */
@@ -197,6 +283,174 @@ int send_kvvec(int sd, struct kvvec *kvv)
 	return ret;
 }
 
+/* makes sure there's room for at least one more byte and a nul */
+static int iobuf_grow(iobuf *io)
+{
+	char *buf;
+	unsigned int size;
+
+	if (!io->buf) {
+		if (iobuf_pool_len) {
+			io->buf = iobuf_pool[--iobuf_pool_len];
+		} else if (!(io->buf = malloc(IOBUF_POOL_BUFSIZE))) {
+			return -1;
+		}
+		io->size = IOBUF_POOL_BUFSIZE;
+		io->len = 0;
+		return 0;
+	}
+
+	size = io->size ? io->size * 2 : IOBUF_POOL_BUFSIZE;
+	if (!(buf = realloc(io->buf, size)))
+		return -1;
+	io->buf = buf;
+	io->size = size;
+	return 0;
+}
+
+static void iobuf_release(iobuf *io)
+{
+	if (!io->buf)
+		return;
+
+	if (io->size == IOBUF_POOL_BUFSIZE && iobuf_pool_len < IOBUF_POOL_MAX)
+		iobuf_pool[iobuf_pool_len++] = io->buf;
+	else
+		free(io->buf);
+	io->buf = NULL;
+	io->len = io->size = 0;
+}
+
+/* like writev(), but doesn't give up on short writes */
+static int writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t wr;
+	int total = 0;
+
+	while (iovcnt > 0) {
+		wr = writev(fd, iov, iovcnt);
+		if (wr < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+				/* the socket is non-blocking, but we mustn't send half a message */
+				struct pollfd pfd = { fd, POLLOUT, 0 };
+				poll(&pfd, 1, -1);
+				continue;
+			}
+			return -1;
+		}
+
+		total += wr;
+		while (iovcnt && (size_t)wr >= iov->iov_len) {
+			wr -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt) {
+			iov->iov_base = (char *)iov->iov_base + wr;
+			iov->iov_len -= wr;
+		}
+	}
+
+	return total;
+}
+
+/*
+ * Sends a job result to the master. The output buffers go to
+ * writev() as they are, so they're never copied on their way out.
+ */
+static int send_job_result(struct kvvec *kvv, child_process *cp)
+{
+	static char kv_sep = KV_SEP, pair_sep = PAIR_SEP;
+	struct kvvec_buf *kvvb;
+	struct iovec iov[10];
+	int n = 0, ret;
+
+#define add_iov(b, l) \
+	do { \
+		iov[n].iov_base = (void *)(b); \
+		iov[n++].iov_len = (l); \
+	} while (0)
+
+	kvvb = kvvec2buf(kvv, KV_SEP, PAIR_SEP, 0);
+	if (!kvvb)
+		return -1;
+	add_iov(kvvb->buf, kvvb->buflen);
+	add_iov("outstd", 6);
+	add_iov(&kv_sep, 1);
+	add_iov(cp->outstd.buf, cp->outstd.len);
+	add_iov(&pair_sep, 1);
+	add_iov("outerr", 6);
+	add_iov(&kv_sep, 1);
+	add_iov(cp->outerr.buf, cp->outerr.len);
+	add_iov(&pair_sep, 1);
+	add_iov(MSG_DELIM, MSG_DELIM_LEN_SEND);
+#undef add_iov
+
+	ret = writev_all(master_sd, iov, n);
+	free(kvvb->buf);
+	free(kvvb);
+	return ret;
+}
+
+static void wheel_add(child_process *cp)
+{
+	struct execution_information *ei = cp->ei;
+	unsigned int slot;
+
+	/* round up, so we never kill a job early */
+	ei->expires = ei->start.tv_sec + cp->timeout + (ei->start.tv_usec ? 1 : 0);
+	slot = ei->expires & WHEEL_MASK;
+	ei->wheel_prev = NULL;
+	ei->wheel_next = wheel[slot];
+	if (wheel[slot])
+		wheel[slot]->wheel_prev = ei;
+	wheel[slot] = ei;
+}
+
+static void wheel_remove(child_process *cp)
+{
+	struct execution_information *ei = cp->ei;
+
+	if (ei->wheel_prev)
+		ei->wheel_prev->wheel_next = ei->wheel_next;
+	else if (wheel[ei->expires & WHEEL_MASK] == ei)
+		wheel[ei->expires & WHEEL_MASK] = ei->wheel_next;
+	else
+		return; /* not on the wheel */
+	if (ei->wheel_next)
+		ei->wheel_next->wheel_prev = ei->wheel_prev;
+	ei->wheel_next = ei->wheel_prev = NULL;
+}
+
+static void pid_table_add(child_process *cp)
+{
+	unsigned int slot = cp->ei->pid & (PID_TABLE_SIZE - 1);
+
+	cp->ei->pid_next = pid_table[slot];
+	pid_table[slot] = cp->ei;
+}
+
+static child_process *pid_table_remove(pid_t pid)
+{
+	struct execution_information *ei, *prev = NULL;
+	unsigned int slot = pid & (PID_TABLE_SIZE - 1);
+
+	for (ei = pid_table[slot]; ei; prev = ei, ei = ei->pid_next) {
+		if (ei->pid != pid)
+			continue;
+		if (prev)
+			prev->pid_next = ei->pid_next;
+		else
+			pid_table[slot] = ei->pid_next;
+		ei->pid_next = NULL;
+		return ei->cp;
+	}
+
+	return NULL;
+}
+
 #define kvvec_add_long(kvv, key, value) \
 	do { \
 		char *buf = (char *)mkstr("%ld", value); \
@@ -223,22 +477,19 @@ int finish_job(child_process *cp, int reason)
 
 	gettimeofday(&cp->ei->stop, NULL);
 
-	if (running_jobs != squeue_size(sq)) {
-		wlog("running_jobs(%d) != squeue_size(sq) (%d)\n",
-			 running_jobs, squeue_size(sq));
-		wlog("started: %d; running: %d; finished: %d\n",
-			 started, running_jobs, started - running_jobs);
-	}
-
 	/*
-	 * we must remove the job's timeout ticker,
-	 * or we'll end up accessing an already free()'d
+	 * we must take the job off the timer wheel and out of the
+	 * pid table, or we'll end up accessing an already free()'d
 	 * pointer, or the pointer to a different child.
 	 */
-	squeue_remove(sq, cp->ei->sq_event);
+	wheel_remove(cp);
+	if (cp->ei->pid && !use_pidfds)
+		pid_table_remove(cp->ei->pid);
 	running_jobs--;
 
 	/* get rid of still open filedescriptors */
+	if (cp->ei->pidfd != -1)
+		iobroker_close(iobs, cp->ei->pidfd);
 	if (cp->outstd.fd != -1)
 		iobroker_close(iobs, cp->outstd.fd);
 	if (cp->outerr.fd != -1)
@@ -256,11 +507,13 @@ int finish_job(child_process *cp, int reason)
 		if (kv->key_len == 3 && !strcmp(kv->key, "env")) {
 			continue;
 		}
+		/* nagios knows which helper it asked for */
+		if (kv->key_len == 8 && !strcmp(kv->key, "resident")) {
+			continue;
+		}
 		kvvec_addkv_wlen(&resp, kv->key, kv->key_len, kv->value, kv->value_len);
 	}
 	kvvec_addkv(&resp, "wait_status", (char *)mkstr("%d", cp->ret));
-	kvvec_addkv_wlen(&resp, "outstd", 6, cp->outstd.buf, cp->outstd.len);
-	kvvec_addkv_wlen(&resp, "outerr", 6, cp->outerr.buf, cp->outerr.len);
 	kvvec_add_tv(&resp, "start", cp->ei->start);
 	kvvec_add_tv(&resp, "stop", cp->ei->stop);
 	kvvec_addkv(&resp, "runtime", (char *)mkstr("%f", cp->ei->runtime));
@@ -278,18 +531,13 @@ int finish_job(child_process *cp, int reason)
 		kvvec_addkv(&resp, "exited_ok", "0");
 		kvvec_addkv(&resp, "error_code", (char *)mkstr("%d", reason));
 	}
-	ret = send_kvvec(master_sd, &resp);
+	/* outstd and outerr are sent straight from their buffers */
+	ret = send_job_result(&resp, cp);
 	if (ret < 0 && errno == EPIPE)
-		exit_worker(1, "Failed to send_kvvec()");
+		exit_worker(1, "Failed to send job result");
 
-	if (cp->outstd.buf) {
-		free(cp->outstd.buf);
-		cp->outstd.buf = NULL;
-	}
-	if (cp->outerr.buf) {
-		free(cp->outerr.buf);
-		cp->outerr.buf = NULL;
-	}
+	iobuf_release(&cp->outstd);
+	iobuf_release(&cp->outerr);
 
 	kvvec_destroy(cp->request, KVVEC_FREE_ALL);
 	free(cp->cmd);
@@ -299,38 +547,364 @@ int finish_job(child_process *cp, int reason)
 	return 0;
 }
 
-static int check_completion(child_process *cp, int flags)
+/*
+ * Resident helpers.
+ *
+ * Requests look like this:
+ *   "<slot> <timeout> <command length>\n<command>"
+ * and the helper answers each of them with:
+ *   "<slot> <exit code> <stdout length> <stderr length>\n<stdout><stderr>"
+ */
+static struct resident_helper *resident_helpers;
+
+/* placeholder for slots of jobs that timed out before the helper answered */
+static child_process resident_abandoned;
+
+static int resident_output(int fd, int events, void *arg);
+
+static struct resident_helper *resident_get(const char *cmd)
 {
-	int result, status;
-	time_t max_time;
+	struct resident_helper *rh;
 
-	if (!cp || !cp->ei->pid) {
+	for (rh = resident_helpers; rh; rh = rh->next) {
+		if (!strcmp(rh->cmd, cmd))
+			return rh;
+	}
+
+	rh = calloc(1, sizeof(*rh));
+	if (!rh)
+		return NULL;
+	rh->cmd = strdup(cmd);
+	rh->ioc = iocache_create(4 * RESIDENT_MAX_OUTPUT);
+	if (!rh->cmd || !rh->ioc) {
+		iocache_destroy(rh->ioc);
+		free(rh->cmd);
+		free(rh);
+		return NULL;
+	}
+	rh->in_fd = rh->out_fd = -1;
+	rh->next = resident_helpers;
+	resident_helpers = rh;
+	return rh;
+}
+
+/* runcmd_spawn() won't hand over stdio, so keep the child's ends clear of it */
+static int fd_above_stdio(int fd)
+{
+	int nfd;
+
+	if (fd < 0 || fd > STDERR_FILENO)
+		return fd;
+	nfd = fcntl(fd, F_DUPFD, STDERR_FILENO + 1);
+	close(fd);
+	return nfd;
+}
+
+static int resident_spawn(struct resident_helper *rh)
+{
+	int in[2], out[2], devnull;
+	char *argv[4], *shcmd;
+
+	if (pipe(in) < 0)
+		return -1;
+	if (pipe(out) < 0) {
+		close(in[0]);
+		close(in[1]);
+		return -1;
+	}
+	fcntl(in[1], F_SETFD, FD_CLOEXEC);
+	fcntl(out[0], F_SETFD, FD_CLOEXEC);
+	in[0] = fd_above_stdio(in[0]);
+	out[1] = fd_above_stdio(out[1]);
+
+	/* helpers speak through stdout, so stderr goes nowhere */
+	devnull = fd_above_stdio(open("/dev/null", O_WRONLY));
+	shcmd = malloc(strlen(rh->cmd) + 6);
+	if (shcmd && in[0] >= 0 && out[1] >= 0) {
+		sprintf(shcmd, "exec %s", rh->cmd);
+		argv[0] = "/bin/sh";
+		argv[1] = "-c";
+		argv[2] = shcmd;
+		argv[3] = NULL;
+		rh->pid = runcmd_spawn(argv, in[0], out[1], devnull);
+	} else {
+		rh->pid = -1;
+	}
+	free(shcmd);
+	if (devnull >= 0)
+		close(devnull);
+
+	if (rh->pid < 0) {
+		rh->pid = 0;
+		close(in[0]);
+		close(in[1]);
+		close(out[0]);
+		close(out[1]);
+		return -1;
+	}
+
+	close(in[0]);
+	close(out[1]);
+	rh->in_fd = in[1];
+	rh->out_fd = out[0];
+	fcntl(rh->in_fd, F_SETFL, O_NONBLOCK);
+	fcntl(rh->out_fd, F_SETFL, O_NONBLOCK);
+	iobroker_register(iobs, rh->out_fd, rh, resident_output);
+	rh->started = time(NULL);
+	rh->wbuf_len = 0;
+	rh->resp_pending = 0;
+	iocache_reset(rh->ioc);
+	wlog("Started resident helper '%s' with pid %d", rh->cmd, rh->pid);
+
+	return 0;
+}
+
+/* takes a helper down, failing whatever jobs it was running */
+static void resident_stop(struct resident_helper *rh, int reason)
+{
+	unsigned int i;
+	int status;
+
+	if (!rh->pid)
+		return;
+
+	iobroker_close(iobs, rh->out_fd);
+	if (rh->wbuf_len)
+		iobroker_unregister(iobs, rh->in_fd);
+	close(rh->in_fd);
+	rh->in_fd = rh->out_fd = -1;
+	kill(rh->pid, SIGKILL);
+	while (waitpid(rh->pid, &status, 0) < 0 && errno == EINTR)
+		;
+	rh->pid = 0;
+
+	if (time(NULL) - rh->started < RESIDENT_MIN_LIFETIME) {
+		wlog("Resident helper '%s' died right after starting. Running its jobs the normal way for %d seconds",
+		     rh->cmd, RESIDENT_RETRY_DELAY);
+		rh->broken_until = time(NULL) + RESIDENT_RETRY_DELAY;
+	}
+
+	for (i = 0; i < rh->num_slots; i++) {
+		child_process *cp = rh->slots[i];
+
+		rh->slots[i] = NULL;
+		if (!cp || cp == &resident_abandoned)
+			continue;
+		cp->ei->rh = NULL;
+		finish_job(cp, reason);
+	}
+	rh->used_slots = rh->abandoned = 0;
+}
+
+static int resident_flush(int fd, int events, void *arg)
+{
+	struct resident_helper *rh = (struct resident_helper *)arg;
+	int wr;
+
+	wr = write(rh->in_fd, rh->wbuf, rh->wbuf_len);
+	if (wr < 0) {
+		if (errno == EAGAIN || errno == EINTR)
+			return 0;
+		wlog("Failed to write to resident helper '%s': %s", rh->cmd, strerror(errno));
+		resident_stop(rh, EPIPE);
 		return 0;
 	}
 
-	max_time = time(NULL) + 1;
+	rh->wbuf_len -= wr;
+	if (rh->wbuf_len)
+		memmove(rh->wbuf, rh->wbuf + wr, rh->wbuf_len);
+	else
+		iobroker_unregister(iobs, rh->in_fd);
 
-	/*
-	 * we mustn't let EINTR interrupt us, since it could well
-	 * be a SIGCHLD from the properly exiting process doing it
-	 */
-	do {
-		errno = 0;
-		result = wait4(cp->ei->pid, &status, flags, &cp->ei->rusage);
-	} while (result == -1 && errno == EINTR && time(NULL) < max_time);
-
-	if (result == cp->ei->pid) {
-		cp->ret = status;
-		finish_job(cp, 0);
+	return 0;
+}
+
+/* writes what the pipe will take and queues the rest */
+static int resident_write(struct resident_helper *rh, const char *buf, unsigned long len)
+{
+	int wr;
+
+	if (!rh->wbuf_len) {
+		wr = write(rh->in_fd, buf, len);
+		if (wr < 0) {
+			if (errno != EAGAIN && errno != EINTR)
+				return -1;
+			wr = 0;
+		}
+		buf += wr;
+		len -= wr;
+		if (!len)
+			return 0;
+		if (iobroker_register_out(iobs, rh->in_fd, rh, resident_flush) < 0)
+			return -1;
+	}
+
+	if (rh->wbuf_len + len > rh->wbuf_size) {
+		unsigned long size = (rh->wbuf_len + len) * 2;
+		char *wbuf = realloc(rh->wbuf, size);
+		if (!wbuf)
+			return -1;
+		rh->wbuf = wbuf;
+		rh->wbuf_size = size;
+	}
+	memcpy(rh->wbuf + rh->wbuf_len, buf, len);
+	rh->wbuf_len += len;
+
+	return 0;
+}
+
+static void resident_result(struct resident_helper *rh, char *body)
+{
+	child_process *cp = NULL;
+
+	if (rh->resp_slot < rh->num_slots)
+		cp = rh->slots[rh->resp_slot];
+	if (!cp) {
+		wlog("Resident helper '%s' answered unknown job slot %u", rh->cmd, rh->resp_slot);
+		return;
+	}
+
+	rh->slots[rh->resp_slot] = NULL;
+	rh->used_slots--;
+	if (cp == &resident_abandoned) {
+		/* the job timed out already and has been reported */
+		rh->abandoned--;
+		return;
+	}
+
+	cp->outstd.buf = malloc(rh->resp_outlen + 1);
+	cp->outerr.buf = malloc(rh->resp_errlen + 1);
+	if (!cp->outstd.buf || !cp->outerr.buf) {
+		cp->ei->rh = NULL;
+		finish_job(cp, ENOMEM);
+		return;
+	}
+	memcpy(cp->outstd.buf, body, rh->resp_outlen);
+	cp->outstd.buf[rh->resp_outlen] = 0;
+	cp->outstd.len = rh->resp_outlen;
+	memcpy(cp->outerr.buf, body + rh->resp_outlen, rh->resp_errlen);
+	cp->outerr.buf[rh->resp_errlen] = 0;
+	cp->outerr.len = rh->resp_errlen;
+
+	/* make it look like the plugin exited with that code */
+	cp->ret = (rh->resp_code & 0xff) << 8;
+	cp->ei->rh = NULL;
+	finish_job(cp, 0);
+}
+
+static int resident_output(int fd, int events, void *arg)
+{
+	struct resident_helper *rh = (struct resident_helper *)arg;
+	unsigned long size;
+	char *buf, *end;
+	int ret;
+
+	ret = iocache_read(rh->ioc, fd);
+	if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EINTR)) {
+		wlog("Resident helper '%s' with pid %d went away", rh->cmd, rh->pid);
+		resident_stop(rh, EPIPE);
 		return 0;
 	}
 
-	if (errno == ECHILD) {
-		cp->ret = status;
-		finish_job(cp, errno);
+	for (;;) {
+		if (!rh->resp_pending) {
+			buf = iocache_use_delim(rh->ioc, "\n", 1, &size);
+			if (!buf)
+				break;
+			buf[size] = 0; /* overwrites the newline */
+			rh->resp_slot = strtoul(buf, &end, 10);
+			rh->resp_code = strtoul(end, &end, 10);
+			rh->resp_outlen = strtoul(end, &end, 10);
+			rh->resp_errlen = strtoul(end, &end, 10);
+			if (*end || end == buf ||
+			    rh->resp_outlen > RESIDENT_MAX_OUTPUT || rh->resp_errlen > RESIDENT_MAX_OUTPUT)
+			{
+				wlog("Resident helper '%s' sent a malformed response. Restarting it", rh->cmd);
+				resident_stop(rh, EPROTO);
+				return 0;
+			}
+			rh->resp_pending = 1;
+		}
+
+		if (iocache_available(rh->ioc) < rh->resp_outlen + rh->resp_errlen)
+			break;
+		buf = iocache_use_size(rh->ioc, rh->resp_outlen + rh->resp_errlen);
+		rh->resp_pending = 0;
+		resident_result(rh, buf);
 	}
 
-	return -errno;
+	return 0;
+}
+
+/*
+ * Ships a job to its resident helper, starting the helper if needed.
+ * Returns -1 if the job should be run the normal way instead.
+ */
+static int resident_start(child_process *cp)
+{
+	struct resident_helper *rh;
+	char hdr[64];
+	unsigned long cmdlen;
+	unsigned int slot;
+	int len;
+
+	if (!(rh = resident_get(cp->ei->resident)))
+		return -1;
+	if (rh->broken_until > time(NULL))
+		return -1;
+	if (!rh->pid && resident_spawn(rh) < 0) {
+		wlog("Failed to start resident helper '%s': %s", rh->cmd, strerror(errno));
+		rh->broken_until = time(NULL) + RESIDENT_RETRY_DELAY;
+		return -1;
+	}
+
+	if (rh->used_slots == rh->num_slots) {
+		unsigned int num = rh->num_slots ? rh->num_slots * 2 : RESIDENT_MIN_SLOTS;
+		child_process **slots = realloc(rh->slots, num * sizeof(*slots));
+		if (!slots)
+			return -1;
+		memset(slots + rh->num_slots, 0, (num - rh->num_slots) * sizeof(*slots));
+		rh->next_slot = rh->num_slots;
+		rh->slots = slots;
+		rh->num_slots = num;
+	}
+	for (slot = rh->next_slot % rh->num_slots; rh->slots[slot]; slot = (slot + 1) % rh->num_slots)
+		;
+
+	cmdlen = strlen(cp->cmd);
+	len = snprintf(hdr, sizeof(hdr), "%u %u %lu\n", slot, cp->timeout, cmdlen);
+	if (resident_write(rh, hdr, len) < 0 || resident_write(rh, cp->cmd, cmdlen) < 0) {
+		wlog("Failed to write to resident helper '%s': %s", rh->cmd, strerror(errno));
+		resident_stop(rh, EPIPE);
+		return -1;
+	}
+
+	rh->slots[slot] = cp;
+	rh->used_slots++;
+	rh->next_slot = slot + 1;
+	cp->ei->rh = rh;
+	cp->ei->rh_slot = slot;
+	cp->ei->pid = 0;
+	cp->outstd.fd = cp->outerr.fd = -1;
+
+	return 0;
+}
+
+/* the job timed out, so we stop waiting for the helper to answer it */
+static void resident_abandon(child_process *cp, int reason)
+{
+	struct resident_helper *rh = cp->ei->rh;
+
+	rh->slots[cp->ei->rh_slot] = &resident_abandoned;
+	rh->abandoned++;
+	cp->ei->rh = NULL;
+	finish_job(cp, reason);
+
+	/* a helper that keeps dropping jobs is probably wedged */
+	if (rh->abandoned >= RESIDENT_MAX_ABANDONED) {
+		wlog("Resident helper '%s' timed out %u jobs. Restarting it", rh->cmd, rh->abandoned);
+		resident_stop(rh, EPIPE);
+	}
 }
 
 static void kill_job(child_process *cp, int reason)
@@ -338,8 +912,20 @@ static void kill_job(child_process *cp, int reason)
 	int ret;
 	struct rusage ru;
 
+	if (cp->ei->rh) {
+		resident_abandon(cp, reason);
+		return;
+	}
+	if (cp->ei->probe) {
+		probe_cancel(cp->ei->probe);
+		cp->ei->probe = NULL;
+		finish_job(cp, reason);
+		return;
+	}
+
 	if (!cp->ei->pid) {
 		wlog("No pid for job %d (%u running); '%s'", cp->id, running_jobs, cp->cmd);
+		finish_job(cp, reason);
 		return;
 	}
 
@@ -355,73 +941,180 @@ static void kill_job(child_process *cp, int reason)
 
 	ret = wait4(cp->ei->pid, &cp->ret, 0, &ru);
 	finish_job(cp, reason);
+}
 
-#ifdef PLAY_NICE_IN_kill_job
-	int i, sig = SIGTERM;
-
-	pid = cp->ei->pid;
+/*
+ * Read whatever the child has written to one of its pipes.
+ * Returns 0 once the pipe is closed, 1 if more may come later and
+ * -1 if we can't make room for the output.
+ */
+static int read_output(child_process *cp, iobuf *io)
+{
+	for (;;) {
+		int rd;
 
-	for (i = 0; i < 2; i++) {
-		/* check one last time if the job is done */
-		ret = check_completion(cp, WNOHANG);
-		if (!ret || ret == -ECHILD) {
-			/* check_completion ran finish_job() */
-			return;
+		/* read straight into the tail of the job's buffer */
+		if (io->size - io->len < 2 && iobuf_grow(io) < 0) {
+			wlog("Failed to grow output buffer for job %d: %s", cp->id, strerror(errno));
+			return -1;
 		}
 
-		/* not done, so signal it. SIGTERM first and check again */
-		errno = 0;
-		ret = kill(pid, sig);
-		if (ret < 0) {
-			finish_job(cp, -errno);
+		rd = read(io->fd, io->buf + io->len, io->size - io->len - 1);
+		if (rd < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				return 1;
+			wlog("Failed to read output of job %d: %s", cp->id, strerror(errno));
+			rd = 0; /* treat it like end of file */
 		}
-		sig = SIGKILL;
-		check_completion(cp, WNOHANG);
-		if (ret < 0) {
-			finish_job(cp, errno);
+
+		if (!rd) {
+			iobroker_close(iobs, io->fd);
+			io->fd = -1;
+			return 0;
 		}
-		usleep(50000);
+
+		/* we read some data */
+		io->len += rd;
+		io->buf[io->len] = '\0';
 	}
-#endif /* PLAY_NICE_IN_kill_job */
 }
 
 static void gather_output(child_process *cp, iobuf *io)
 {
-	iobuf *other_io;
+	/* the job finishes when we've reaped the child, not at EOF */
+	if (read_output(cp, io) < 0)
+		kill_job(cp, ENOMEM);
+}
 
-	other_io = io == &cp->outstd ? &cp->outerr : &cp->outstd;
+/* the child is gone, so whatever output it wrote is in the pipes */
+static void job_exited(child_process *cp, int status)
+{
+	int reason = 0;
 
-	for (;;) {
-		char buf[4096];
-		int rd;
+	cp->ret = status;
+	cp->ei->pid = 0;
+	wstats.reaped++;
 
-		rd = read(io->fd, buf, sizeof(buf));
-		if (rd < 0) {
-			if (errno == EINTR)
-				continue;
-			/* XXX: handle the error somehow */
-			check_completion(cp, WNOHANG);
-		}
+	if (cp->outstd.fd >= 0 && read_output(cp, &cp->outstd) < 0)
+		reason = ENOMEM;
+	if (cp->outerr.fd >= 0 && read_output(cp, &cp->outerr) < 0)
+		reason = ENOMEM;
 
-		if (rd) {
-			/* we read some data */
-			io->buf = realloc(io->buf, rd + io->len + 1);
-			memcpy(&io->buf[io->len], buf, rd);
-			io->len += rd;
-			io->buf[io->len] = '\0';
-		} else {
-			iobroker_close(iobs, io->fd);
-			io->fd = -1;
-			if (other_io->fd < 0) {
-				check_completion(cp, 0);
-			} else {
-				check_completion(cp, WNOHANG);
-			}
-		}
-		break;
+	/*
+	 * Pipes that are still open are held by something the
+	 * plugin left behind. We don't wait for those.
+	 */
+	if (cp->outstd.fd >= 0 || cp->outerr.fd >= 0)
+		wstats.orphaned++;
+
+	finish_job(cp, reason);
+}
+
+static int reap_job(int fd, int events, void *cp_)
+{
+	child_process *cp = (child_process *)cp_;
+	int status = 0;
+	pid_t ret;
+
+	ret = wait4(cp->ei->pid, &status, WNOHANG, &cp->ei->rusage);
+	if (!ret || (ret < 0 && errno == EINTR))
+		return 0;
+	if (ret < 0) {
+		/* someone else reaped it */
+		wlog("Failed to reap child %d of job %u: %s", cp->ei->pid, cp->id, strerror(errno));
+		cp->ret = 0;
+		cp->ei->pid = 0;
+		finish_job(cp, errno);
+		return 0;
+	}
+
+	job_exited(cp, status);
+	return 0;
+}
+
+static void sigchld_handler(int sig)
+{
+	int saved_errno = errno;
+
+	(void)write(sigchld_pipe[1], "", 1);
+	errno = saved_errno;
+}
+
+static int reap_children(int fd, int events, void *arg)
+{
+	char buf[256];
+	int status;
+	pid_t pid;
+	struct rusage ru;
+
+	while (read(fd, buf, sizeof(buf)) > 0)
+		;
+
+	while ((pid = wait4(-1, &status, WNOHANG, &ru)) > 0) {
+		child_process *cp = pid_table_remove(pid);
+
+		/* resident helpers are reaped when they're stopped */
+		if (!cp)
+			continue;
+		cp->ei->rusage = ru;
+		job_exited(cp, status);
 	}
+
+	return 0;
 }
 
+static int open_pidfd(pid_t pid)
+{
+#ifdef __NR_pidfd_open
+	return syscall(__NR_pidfd_open, pid, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/* arrange for us to notice when the child exits */
+static int watch_child(child_process *cp)
+{
+	if (use_pidfds) {
+		cp->ei->pidfd = open_pidfd(cp->ei->pid);
+		if (cp->ei->pidfd >= 0) {
+			fcntl(cp->ei->pidfd, F_SETFD, FD_CLOEXEC);
+			return iobroker_register(iobs, cp->ei->pidfd, cp, reap_job);
+		}
+		if (errno != ENOSYS && errno != EPERM)
+			return -1;
+
+		wlog("pidfd_open() unavailable (%s). Reaping children on SIGCHLD instead", strerror(errno));
+		use_pidfds = 0;
+	}
+
+	if (sigchld_pipe[0] < 0) {
+		struct sigaction sa;
+
+		if (pipe(sigchld_pipe) < 0)
+			return -1;
+		fcntl(sigchld_pipe[0], F_SETFL, O_NONBLOCK);
+		fcntl(sigchld_pipe[1], F_SETFL, O_NONBLOCK);
+		fcntl(sigchld_pipe[0], F_SETFD, FD_CLOEXEC);
+		fcntl(sigchld_pipe[1], F_SETFD, FD_CLOEXEC);
+		iobroker_register(iobs, sigchld_pipe[0], NULL, reap_children);
+
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = sigchld_handler;
+		sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+		sigemptyset(&sa.sa_mask);
+		sigaction(SIGCHLD, &sa, NULL);
+
+		/* it may have exited before the handler was in place */
+		(void)write(sigchld_pipe[1], "", 1);
+	}
+
+	pid_table_add(cp);
+	return 0;
+}
 
 static int stderr_handler(int fd, int events, void *cp_)
 {
@@ -437,10 +1130,42 @@ static int stdout_handler(int fd, int events, void *cp_)
 	return 0;
 }
 
+static void probe_done(int state, const char *output, void *arg)
+{
+	child_process *cp = (child_process *)arg;
+
+	cp->ei->probe = NULL;
+	cp->outstd.buf = strdup(output);
+	cp->outstd.len = cp->outstd.buf ? strlen(cp->outstd.buf) : 0;
+	/* make it look like a plugin exited with that code */
+	cp->ret = (state & 0xff) << 8;
+	finish_job(cp, 0);
+}
+
+static int start_probe(child_process *cp)
+{
+	probe *p;
+
+	cp->outstd.fd = cp->outerr.fd = -1;
+	cp->ei->pid = 0;
+	p = probe_start(iobs, cp->cmd, probe_done, cp);
+
+	/* without a probe, the job is finished and cp is gone */
+	if (p)
+		cp->ei->probe = p;
+	return 0;
+}
+
 int start_cmd(child_process *cp)
 {
 	int pfd[2] = {-1, -1}, pfderr[2] = {-1, -1};
 
+	if (probe_is_native(cp->cmd))
+		return start_probe(cp);
+
+	if (cp->ei->resident && !resident_start(cp))
+		return 0;
+
 	cp->outstd.fd = runcmd_open(cp->cmd, pfd, pfderr, NULL);
 	if (cp->outstd.fd < 0) {
 		return -1;
@@ -452,6 +1177,21 @@ int start_cmd(child_process *cp)
 	if (!cp->ei->pid) {
 		return -1;
 	}
+	if (watch_child(cp) < 0) {
+		int status;
+		kill(cp->ei->pid, SIGKILL);
+		while (waitpid(cp->ei->pid, &status, 0) < 0 && errno == EINTR)
+			;
+		close(cp->outstd.fd);
+		close(cp->outerr.fd);
+		cp->outstd.fd = cp->outerr.fd = -1;
+		cp->ei->pid = 0;
+		return -1;
+	}
+
+	/* we only read what's there, and reap the child when it exits */
+	fcntl(cp->outstd.fd, F_SETFL, O_NONBLOCK);
+	fcntl(cp->outerr.fd, F_SETFL, O_NONBLOCK);
 	iobroker_register(iobs, cp->outstd.fd, cp, stdout_handler);
 	iobroker_register(iobs, cp->outerr.fd, cp, stderr_handler);
 
@@ -476,6 +1216,8 @@ child_process *parse_command_kvvec(struct kvvec *kvv)
 		wlog("Failed to calloc() a execution_information struct");
 		return NULL;
 	}
+	cp->ei->cp = cp;
+	cp->ei->pidfd = -1;
 
 	/*
 	 * we must copy from the vector, since it points to data
@@ -500,6 +1242,12 @@ child_process *parse_command_kvvec(struct kvvec *kvv)
 			cp->timeout = (unsigned int)strtoul(value, &endptr, 0);
 			continue;
 		}
+		if (!strcmp(key, "resident")) {
+			/* the request outlives the job, so no need to copy */
+			if (*value)
+				cp->ei->resident = value;
+			continue;
+		}
 	}
 
 	/* jobs without a timeout get a default of 60 seconds. */
@@ -532,13 +1280,13 @@ static void spawn_job(struct kvvec *kvv, int(*cb)(child_process *))
 
 	gettimeofday(&cp->ei->start, NULL);
 	cp->request = kvv;
-	cp->ei->sq_event = squeue_add(sq, cp->timeout + time(NULL), cp);
+	wheel_add(cp);
 	started++;
 	running_jobs++;
 	result = cb(cp);
 	if (result < 0) {
 		job_error(cp, kvv, "Failed to start child: %s: %s", runcmd_strerror(result), strerror(errno));
-		squeue_remove(sq, cp->ei->sq_event);
+		wheel_remove(cp);
 		running_jobs--;
 		return;
 	}
@@ -601,6 +1349,60 @@ int set_socket_options(int sd, int bufsize)
 }
 
 
+static void send_stats(time_t now)
+{
+	static struct kvvec kvv = KVVEC_INITIALIZER;
+
+	if (kvvec_init(&kvv, 4) == NULL)
+		return;
+	kvvec_addkv(&kvv, "stats", "1");
+	kvvec_add_long(&kvv, "reaped", wstats.reaped);
+	kvvec_add_long(&kvv, "timed_out", wstats.timed_out);
+	kvvec_add_long(&kvv, "orphaned", wstats.orphaned);
+	if (send_kvvec(master_sd, &kvv) < 0 && errno == EPIPE)
+		exit_worker(1, "Failed to send stats to master");
+	wstats_sent = wstats;
+	wstats_next = now + STATS_INTERVAL;
+}
+
+/* kill jobs that are due, turning the wheel up to now */
+static void expire_jobs(time_t now)
+{
+	unsigned int turned;
+
+	for (turned = 0; wheel_clock <= now && turned < WHEEL_SLOTS; wheel_clock++, turned++) {
+		struct execution_information *ei;
+		unsigned int slot = wheel_clock & WHEEL_MASK;
+
+		/*
+		 * killing a job can finish others (restarting a helper
+		 * does), so we start over with the slot each time
+		 */
+	again:
+		for (ei = wheel[slot]; ei; ei = ei->wheel_next) {
+			child_process *cp = ei->cp;
+
+			/* it's got more laps to go */
+			if (ei->expires > now)
+				continue;
+
+			if (ei->rh)
+				wlog("job %u on resident helper '%s' timed out. Abandoning it", cp->id, ei->rh->cmd);
+			else if (ei->probe)
+				wlog("native probe for job %u timed out. Aborting it", cp->id);
+			else
+				wlog("job with pid %d timed out. Killing it", ei->pid);
+			wstats.timed_out++;
+			kill_job(cp, ETIME);
+			goto again;
+		}
+	}
+
+	/* after a full turn, every slot has been looked at */
+	if (wheel_clock <= now)
+		wheel_clock = now + 1;
+}
+
 void enter_worker(int sd, int (*cb)(child_process*))
 {
 	/* created with socketpair(), usually */
@@ -625,43 +1427,26 @@ void enter_worker(int sd, int (*cb)(child_process*))
 		exit_worker(EXIT_FAILURE, "Worker failed to create io broker socket set");
 	}
 
-	/*
-	 * Create a modest scheduling queue that will be
-	 * more than enough for our needs
-	 */
-	sq = squeue_create(1024);
+	wheel_clock = time(NULL);
 	set_socket_options(master_sd, 256 * 1024);
 
 	iobroker_register(iobs, master_sd, cb, receive_command);
 	while (iobroker_get_num_fds(iobs) > 0) {
 		int poll_time = -1;
+		struct timeval now;
 
-		/* check for timed out jobs */
-		while (running_jobs) {
-			child_process *cp;
-			struct timeval now, tmo;
-
-			/* stop when scheduling queue is empty */
-			cp = (child_process *)squeue_peek(sq);
-			if (!cp)
-				break;
-
-			tmo.tv_usec = cp->ei->start.tv_usec;
-			tmo.tv_sec = cp->ei->start.tv_sec + cp->timeout;
-			gettimeofday(&now, NULL);
-			poll_time = tv_delta_msec(&now, &tmo);
-			/*
-			 * A little extra takes care of rounding errors and
-			 * ensures we never kill a job before it times out.
-			 * 5 milliseconds is enough to take care of that.
-			 */
-			poll_time += 5;
-			if (poll_time > 0)
-				break;
+		gettimeofday(&now, NULL);
+		if (running_jobs) {
+			expire_jobs(now.tv_sec);
+			/* wake up for the next tick of the wheel */
+			poll_time = 1000 - now.tv_usec / 1000;
+		}
 
-			/* this job timed out, so kill it */
-			wlog("job with pid %d timed out. Killing it", cp->ei->pid);
-			kill_job(cp, ETIME);
+		if (memcmp(&wstats, &wstats_sent, sizeof(wstats))) {
+			if (now.tv_sec >= wstats_next)
+				send_stats(now.tv_sec);
+			else if (poll_time < 0 || poll_time > (wstats_next - now.tv_sec) * 1000)
+				poll_time = (wstats_next - now.tv_sec) * 1000;
 		}
 
 		iobroker_poll(iobs, poll_time);
@@ -717,8 +1502,8 @@ struct worker_process *spawn_worker(void (*init_func)(void *), void *init_arg)
 		worker->pid = pid;
 		worker->ioc = iocache_create(1 * 1024 * 1024);
 
-		/* 1 socket for master, 2 fd's for each child */
-		worker->max_jobs = (iobroker_max_usable_fds() - 1) / 2;
+		/* 1 socket for master, 2 pipes and a pidfd for each child */
+		worker->max_jobs = (iobroker_max_usable_fds() - 1) / 3;
 		worker->jobs = calloc(worker->max_jobs, sizeof(worker_job *));
 
 		return worker;
@@ -44,6 +44,7 @@ typedef struct worker_job {
 	char *command;  /**< command string for this job */
 	struct worker_process *wp; /**< worker process running this job */
 	void *arg;      /**< any random argument */
+	struct timeval start; /**< when the job was shipped to its worker */
 } worker_job;
 
 /** A worker process as seen from its controller */
@@ -59,6 +60,9 @@ typedef struct worker_process {
 	iocache *ioc; /**< iocache for reading from worker */
 	worker_job **jobs; /**< array of jobs */
 	int job_index; /**< round-robin slot allocator (this wraps) */
+	unsigned long reaped; /**< child processes the worker has reaped */
+	unsigned long timed_out; /**< jobs the worker has killed for timing out */
+	unsigned long orphaned; /**< jobs that left something holding their output pipes */
 	struct worker_process *prev_wp; /**< previous worker in list */
 	struct worker_process *next_wp; /**< next worker in list */
 } worker_process;
@@ -67,6 +71,7 @@ typedef struct iobuf {
 	int fd;
 	unsigned int len;
 	char *buf;
+	unsigned int size; /* allocated size of buf. 0 if malloc()'d elsewhere */
 } iobuf;
 
 typedef struct execution_information execution_information;
@@ -83,6 +88,21 @@ typedef struct child_process {
 
 /**
  * Callback for enter_worker that simply runs a command
+ *
+ * If the request has a "resident" key, its value is the command
+ * for a long-lived helper that runs the job instead, so no process
+ * has to be created for it. The helper is started on first use
+ * and gets one request per job on its stdin:
+ * @verbatim "<slot> <timeout> <command length>\n<command>" @endverbatim
+ * It answers each of them on stdout, in any order, with:
+ * @verbatim "<slot> <exit code> <stdout length> <stderr length>\n<stdout><stderr>" @endverbatim
+ * Jobs the helper doesn't answer in time are reported as timed out,
+ * and helpers that die, misbehave or keep timing out are restarted.
+ * Helpers that won't start are bypassed for a while, running their
+ * jobs the normal way. contrib/resident-dummy.c is an example.
+ *
+ * Commands starting with PROBE_PREFIX are run as native probes
+ * on the worker's iobroker set instead. See probe.h.
  */
 extern int start_cmd(child_process *cp);
 
@@ -0,0 +1,195 @@
+/*****************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#define NSCORE 1
+#include "config.h"
+#include "common.h"
+#include "nagios.h"
+#include "comments.h"
+#include "stub_broker.c"
+#include "stub_events.c"
+#include "tap.h"
+
+void logit(int data_type, int display, const char *fmt, ...) {}
+int log_debug_info(int level, int verbosity, const char *fmt, ...) {
+	return OK;
+	}
+
+unsigned long next_comment_id = 1L;
+
+void broker_comment_data(int type, int flags, int attr, int comment_type, int entry_type, char *host_name, char *svc_description, time_t entry_time, char *author_name, char *comment_data, int persistent, int source, int expires, time_t expire_time, unsigned long comment_id, struct timeval *timestamp) {}
+
+static int count_comments(void) {
+	comment *temp_comment;
+	int i;
+	for(temp_comment = comment_list, i = 0; temp_comment != NULL; temp_comment = temp_comment->next, i++) {}
+	return i;
+	}
+
+static int count_host_comments(char *host_name) {
+	comment *temp_comment;
+	int i = 0;
+	for(temp_comment = get_first_comment_by_host(host_name); temp_comment != NULL; temp_comment = get_next_comment_by_host(host_name, temp_comment))
+		i++;
+	return i;
+	}
+
+/* the list must stay sorted by id, whatever order things were added in */
+static int comment_list_is_sorted(void) {
+	comment *temp_comment;
+	for(temp_comment = comment_list; temp_comment != NULL && temp_comment->next != NULL; temp_comment = temp_comment->next) {
+		if(temp_comment->comment_id >= temp_comment->next->comment_id)
+			return FALSE;
+		}
+	return TRUE;
+	}
+
+#define SCALE_COMMENTS 20000
+
+/*
+ * Enough comments to make the id index grow several times, deleted
+ * out of order, so the chains through id_next get relinked a lot.
+ */
+static void test_comments_at_scale(time_t now) {
+	unsigned long id;
+	int missing = 0, wrong = 0, left = 0;
+
+	for(id = 1; id <= SCALE_COMMENTS; id++) {
+		char host_name[32];
+		sprintf(host_name, "scale%lu", id % 100);
+		add_host_comment(USER_COMMENT, host_name, now, "author", "data", id, TRUE, FALSE, 0, COMMENTSOURCE_INTERNAL);
+		}
+	ok(count_comments() == SCALE_COMMENTS, "lots of comments added");
+	ok(number_of_host_comments("scale42") == SCALE_COMMENTS / 100, "each host has its share of them");
+
+	for(id = 1; id <= SCALE_COMMENTS; id++) {
+		comment *temp_comment = find_host_comment(id);
+		if(temp_comment == NULL)
+			missing++;
+		else if(temp_comment->comment_id != id)
+			wrong++;
+		}
+	ok(missing == 0 && wrong == 0, "every comment is found by its id");
+
+	/* every third one, then the rest backwards */
+	for(id = 3; id <= SCALE_COMMENTS; id += 3)
+		delete_host_comment(id);
+	for(id = 1; id <= SCALE_COMMENTS; id++) {
+		if((find_host_comment(id) != NULL) != (id % 3 != 0))
+			wrong++;
+		}
+	ok(wrong == 0, "deleted comments are gone, the others are still found");
+	for(id = SCALE_COMMENTS; id > 0; id--)
+		delete_host_comment(id);
+	for(id = 1; id <= SCALE_COMMENTS; id++) {
+		if(find_host_comment(id) != NULL)
+			left++;
+		}
+	ok(left == 0 && comment_list == NULL, "all comments deleted");
+	ok(get_first_comment_by_host("scale42") == NULL, "and their hosts have none left");
+	}
+
+int main(int argc, char **argv) {
+	time_t now = time(NULL);
+	unsigned long new_id = 0L;
+	comment *temp_comment;
+
+	plan_tests(42);
+
+	ok(find_comment(1, HOST_COMMENT) == NULL, "nothing to find before anything is added");
+	ok(get_first_comment_by_host("host1") == NULL, "no comments for a host before anything is added");
+
+	add_host_comment(USER_COMMENT, "host1", now, "author", "host comment", 10, TRUE, FALSE, 0, COMMENTSOURCE_INTERNAL);
+	add_service_comment(USER_COMMENT, "host1", "svc1", now, "author", "service comment", 5, TRUE, FALSE, 0, COMMENTSOURCE_INTERNAL);
+	add_service_comment(ACKNOWLEDGEMENT_COMMENT, "host1", "svc1", now, "author", "service ack", 7, FALSE, FALSE, 0, COMMENTSOURCE_INTERNAL);
+	add_host_comment(ACKNOWLEDGEMENT_COMMENT, "host1", now, "author", "host ack", 3, FALSE, FALSE, 0, COMMENTSOURCE_INTERNAL);
+	add_host_comment(ACKNOWLEDGEMENT_COMMENT, "host1", now, "author", "sticky host ack", 4, TRUE, FALSE, 0, COMMENTSOURCE_INTERNAL);
+	add_service_comment(USER_COMMENT, "host1", "svc2", now, "author", "other service", 8, TRUE, FALSE, 0, COMMENTSOURCE_INTERNAL);
+	add_host_comment(USER_COMMENT, "host2", now, "author", "other host", 6, TRUE, FALSE, 0, COMMENTSOURCE_INTERNAL);
+	ok(count_comments() == 7, "seven comments added");
+	ok(comment_list_is_sorted(), "comment list is sorted by id");
+	ok(add_host_comment(USER_COMMENT, "host1", now, NULL, "no author", 11, TRUE, FALSE, 0, COMMENTSOURCE_INTERNAL) == ERROR, "comments without an author are refused");
+	ok(add_service_comment(USER_COMMENT, "host1", NULL, now, "author", "no service", 12, TRUE, FALSE, 0, COMMENTSOURCE_INTERNAL) == ERROR, "service comments without a service are refused");
+
+	/* the id index */
+	temp_comment = find_host_comment(10);
+	ok(temp_comment != NULL && !strcmp(temp_comment->comment_data, "host comment"), "host comment found by id");
+	temp_comment = find_service_comment(5);
+	ok(temp_comment != NULL && !strcmp(temp_comment->comment_data, "service comment"), "service comment found by id");
+	ok(find_service_comment(10) == NULL, "a host comment isn't found as a service comment");
+	ok(find_host_comment(5) == NULL, "a service comment isn't found as a host comment");
+	ok(find_comment(9, HOST_COMMENT) == NULL && find_comment(9, SERVICE_COMMENT) == NULL, "unknown ids aren't found");
+
+	/* the per-object chains */
+	ok(number_of_host_comments("host1") == 3, "host1 has three host comments");
+	ok(number_of_service_comments("host1", "svc1") == 2, "svc1 has two comments");
+	ok(number_of_service_comments("host1", "svc2") == 1, "svc2 has one comment");
+	ok(number_of_service_comments("host1", "svc3") == 0, "svc3 has none");
+	ok(number_of_host_comments("host2") == 1, "host2 has one comment");
+	ok(count_host_comments("host1") == 6, "host1 has six comments counting those of its services");
+	temp_comment = get_first_comment_by_object("host1", NULL);
+	ok(temp_comment != NULL && temp_comment->comment_id == 3 && temp_comment->obj_next != NULL && temp_comment->obj_next->comment_id == 4 && temp_comment->obj_next->obj_next->comment_id == 10, "host comments are chained by id");
+	temp_comment = get_first_comment_by_object("host1", "svc1");
+	ok(temp_comment != NULL && temp_comment->comment_id == 5 && temp_comment->obj_next != NULL && temp_comment->obj_next->comment_id == 7 && temp_comment->obj_next->obj_next == NULL, "service comments are chained by id");
+
+	/* deleting */
+	ok(delete_comment(HOST_COMMENT, 5) == ERROR, "deleting a service comment as a host comment fails");
+	ok(delete_service_comment(5) == OK, "service comment deleted by id");
+	ok(find_service_comment(5) == NULL && number_of_service_comments("host1", "svc1") == 1, "and it's gone from the index and its chain");
+	ok(count_host_comments("host1") == 5 && count_comments() == 6, "and from the host's chain and the list");
+	ok(delete_service_comment(5) == ERROR, "deleting it again fails");
+
+	{
+		host hst;
+		service svc;
+		memset(&hst, 0, sizeof(hst));
+		memset(&svc, 0, sizeof(svc));
+		hst.name = "host1";
+		svc.host_name = "host1";
+		svc.description = "svc1";
+		delete_host_acknowledgement_comments(&hst);
+		ok(find_host_comment(3) == NULL, "non-persistent host acknowledgement deleted");
+		ok(find_host_comment(4) != NULL && find_host_comment(10) != NULL, "persistent acknowledgements and other comments are kept");
+		delete_service_acknowledgement_comments(&svc);
+		ok(find_service_comment(7) == NULL && number_of_service_comments("host1", "svc1") == 0, "non-persistent service acknowledgement deleted");
+	}
+
+	delete_all_service_comments("host1", "svc2");
+	ok(find_service_comment(8) == NULL && get_first_comment_by_object("host1", "svc2") == NULL, "all comments for a service deleted");
+	delete_all_host_comments("host1");
+	ok(number_of_host_comments("host1") == 0 && get_first_comment_by_host("host1") == NULL, "all comments for a host deleted");
+	ok(count_comments() == 1 && find_host_comment(6) != NULL, "comments for other hosts are kept");
+	ok(comment_list_is_sorted(), "comment list is still sorted");
+
+	/* expiry, and ids handed out for new comments */
+	add_new_host_comment(USER_COMMENT, "host2", now, "author", "expired", TRUE, COMMENTSOURCE_INTERNAL, TRUE, now - 1, &new_id);
+	ok(new_id != 0 && find_host_comment(new_id) != NULL, "new comment gets an id of its own");
+	check_for_expired_comment(new_id);
+	ok(find_host_comment(new_id) == NULL, "expired comment deleted");
+	add_new_host_comment(USER_COMMENT, "host2", now, "author", "not yet", TRUE, COMMENTSOURCE_INTERNAL, TRUE, now + 3600, &new_id);
+	check_for_expired_comment(new_id);
+	ok(find_host_comment(new_id) != NULL, "comment that hasn't expired is kept");
+	free_comment_data();
+	ok(comment_list == NULL && find_host_comment(6) == NULL && get_first_comment_by_host("host2") == NULL, "freeing comment data empties the indexes");
+
+	test_comments_at_scale(now);
+	free_comment_data();
+	ok(intern_num_strings() == 0, "all interned names released");
+
+	return exit_status();
+	}
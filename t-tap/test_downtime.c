@@ -23,7 +23,6 @@
 #include "downtime.h"
 #include "stub_broker.c"
 #include "stub_comments.c"
-#include "stub_objects.c"
 #include "stub_statusdata.c"
 #include "stub_notifications.c"
 #include "stub_shared.c"
@@ -38,13 +37,184 @@ int log_debug_info(int level, int verbosity, const char *fmt, ...) {
 	va_end(ap);
 	}
 
-timed_event *event_list_high = NULL;
-timed_event *event_list_high_tail = NULL;
+squeue_t *nagios_squeue = NULL;
 
 unsigned long next_downtime_id = 1L;
 
 extern scheduled_downtime *scheduled_downtime_list;
 
+/* every downtime is for the same couple of objects, as far as the code we test can tell */
+static host test_host;
+static service test_service;
+host *find_host(const char *name) {
+	return &test_host;
+	}
+service *find_service(const char *host_name, const char *svc_desc) {
+	return &test_service;
+	}
+
+static double elapsed(struct timeval *start) {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (now.tv_sec - start->tv_sec) + ((now.tv_usec - start->tv_usec) / 1000000.0);
+	}
+
+static int count_downtimes(void) {
+	scheduled_downtime *temp_downtime;
+	int i;
+	for(temp_downtime = scheduled_downtime_list, i = 0; temp_downtime != NULL; temp_downtime = temp_downtime->next, i++) {}
+	return i;
+	}
+
+#define SCALE_HOSTS 1000
+#define SCALE_SERVICES 10
+#define SCALE_PER_SERVICE 10
+#define SCALE_DOWNTIMES (SCALE_HOSTS * SCALE_SERVICES * SCALE_PER_SERVICE)
+#define SCALE_FIRST_ID 1000L
+
+/*
+ * Lots of downtime, as seen during large maintenance windows. Every
+ * fifth entry is flexible, every tenth has already ended without
+ * taking effect.
+ */
+static void test_downtime_at_scale(time_t now) {
+	char host_name[32], svc_description[32];
+	scheduled_downtime *temp_downtime, *prev_downtime;
+	struct timeval start;
+	unsigned long id;
+	int i, found, sorted, started, expected, flex_matches;
+
+	defer_downtime_sorting = 1;
+	gettimeofday(&start, NULL);
+	for(i = 0; i < SCALE_DOWNTIMES; i++) {
+		sprintf(host_name, "host%d", i % SCALE_HOSTS);
+		sprintf(svc_description, "svc%d", (i / SCALE_HOSTS) % SCALE_SERVICES);
+		add_service_downtime(host_name, svc_description, now, "user", "maintenance", now - 3600 + (i % 7200), (i % 10 == 9) ? now - 60 : now + 3600 + (i % 3600), (i % 5) ? TRUE : FALSE, 0, 600, SCALE_FIRST_ID + i, FALSE);
+		}
+	sort_downtime();
+	diag("Added %d downtimes in %.3fs", SCALE_DOWNTIMES, elapsed(&start));
+	ok(count_downtimes() == SCALE_DOWNTIMES, "Got %d downtimes", SCALE_DOWNTIMES);
+
+	for(sorted = TRUE, prev_downtime = NULL, temp_downtime = scheduled_downtime_list; temp_downtime != NULL; prev_downtime = temp_downtime, temp_downtime = temp_downtime->next) {
+		if(temp_downtime->prev != prev_downtime || (prev_downtime && prev_downtime->start_time > temp_downtime->start_time))
+			sorted = FALSE;
+		}
+	ok(sorted == TRUE, "Downtime list is sorted by start time and linked both ways");
+
+	gettimeofday(&start, NULL);
+	for(found = 0, id = SCALE_FIRST_ID; id < SCALE_FIRST_ID + SCALE_DOWNTIMES; id++) {
+		temp_downtime = find_service_downtime(id);
+		if(temp_downtime && temp_downtime->downtime_id == id)
+			found++;
+		}
+	diag("Looked up %d downtimes by id in %.3fs", SCALE_DOWNTIMES, elapsed(&start));
+	ok(found == SCALE_DOWNTIMES, "Found all downtimes by id: %d", found);
+	ok(find_host_downtime(SCALE_FIRST_ID) == NULL, "Service downtime isn't found as host downtime");
+	ok(find_downtime(ANY_DOWNTIME, SCALE_FIRST_ID + SCALE_DOWNTIMES) == NULL, "Unknown id isn't found");
+
+	/* flexible downtime should only start for the service that has a problem */
+	test_service.host_name = "host5";
+	test_service.description = "svc3";
+	test_service.current_state = STATE_CRITICAL;
+	for(expected = 0, temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
+		if(temp_downtime->fixed == FALSE && temp_downtime->start_time <= now && now <= temp_downtime->end_time && !strcmp(temp_downtime->host_name, "host5") && !strcmp(temp_downtime->service_description, "svc3"))
+			expected++;
+		}
+	gettimeofday(&start, NULL);
+	for(i = 0; i < 10000; i++)
+		check_pending_flex_service_downtime(&test_service);
+	diag("Checked for pending flexible downtime 10000 times in %.3fs", elapsed(&start));
+	for(started = 0, flex_matches = TRUE, temp_downtime = scheduled_downtime_list; temp_downtime != NULL; temp_downtime = temp_downtime->next) {
+		if(temp_downtime->is_in_effect == FALSE)
+			continue;
+		started++;
+		if(strcmp(temp_downtime->host_name, "host5") || strcmp(temp_downtime->service_description, "svc3") || temp_downtime->fixed == TRUE)
+			flex_matches = FALSE;
+		}
+	ok(expected > 0 && started == expected, "Started %d flexible downtimes, expected %d", started, expected);
+	ok(flex_matches == TRUE, "Only flexible downtime for the problem service was started");
+
+	/* the ones that ended without taking effect go when their expiry event runs */
+	gettimeofday(&start, NULL);
+	for(expected = 0, id = SCALE_FIRST_ID; id < SCALE_FIRST_ID + SCALE_DOWNTIMES; id++) {
+		temp_downtime = find_service_downtime(id);
+		if(temp_downtime->is_in_effect == FALSE && temp_downtime->end_time < now) {
+			check_for_expired_downtime(id);
+			expected++;
+			}
+		}
+	diag("Expired %d downtimes in %.3fs", expected, elapsed(&start));
+	ok(count_downtimes() == SCALE_DOWNTIMES - expected, "Expired %d downtimes", expected);
+	for(id = SCALE_FIRST_ID; id < SCALE_FIRST_ID + SCALE_DOWNTIMES; id++)
+		check_for_expired_downtime(id + SCALE_DOWNTIMES);
+	ok(count_downtimes() == SCALE_DOWNTIMES - expected, "Events for unknown downtime do nothing");
+	for(found = 0, id = SCALE_FIRST_ID; id < SCALE_FIRST_ID + SCALE_DOWNTIMES; id++) {
+		if(find_service_downtime(id))
+			found++;
+		}
+	ok(found == SCALE_DOWNTIMES - expected, "Expired downtimes can't be found by id anymore");
+
+	/* the end event of flexible downtime that took effect stops it */
+	for(temp_downtime = scheduled_downtime_list; temp_downtime != NULL && temp_downtime->is_in_effect == FALSE; temp_downtime = temp_downtime->next) {}
+	id = temp_downtime ? temp_downtime->downtime_id : 0;
+	i = test_service.scheduled_downtime_depth;
+	check_for_expired_downtime(id);
+	ok(id && find_service_downtime(id) == NULL && test_service.scheduled_downtime_depth == i - 1, "Downtime in effect is stopped when it ends");
+
+	/* delete every other one, then the rest, in an order unrelated to the list */
+	gettimeofday(&start, NULL);
+	for(id = SCALE_FIRST_ID; id < SCALE_FIRST_ID + SCALE_DOWNTIMES; id += 2)
+		delete_service_downtime(id);
+	for(id = SCALE_FIRST_ID + SCALE_DOWNTIMES - 1; id > SCALE_FIRST_ID; id -= 2)
+		delete_service_downtime(id);
+	diag("Deleted all downtimes in %.3fs", elapsed(&start));
+	ok(scheduled_downtime_list == NULL, "No downtimes left");
+	test_service.current_state = STATE_OK;
+	test_service.scheduled_downtime_depth = 0;
+	}
+
+/*
+ * Downtime scheduled through external commands is added one entry at
+ * a time, without deferring the sorting, and in no particular order.
+ */
+static void test_downtime_bulk_import(time_t now) {
+	char host_name[32];
+	scheduled_downtime *temp_downtime, *prev_downtime;
+	struct timeval start;
+	unsigned long id;
+	int i, sorted;
+
+	gettimeofday(&start, NULL);
+	for(i = 0; i < SCALE_DOWNTIMES; i++) {
+		sprintf(host_name, "host%d", i % SCALE_HOSTS);
+		add_host_downtime(host_name, now, "user", "import", now + ((i * 7919) % 86400), now + 86400 * 2, TRUE, 0, 0, SCALE_FIRST_ID + i, FALSE);
+		}
+	diag("Added %d downtimes one by one in %.3fs", SCALE_DOWNTIMES, elapsed(&start));
+	ok(count_downtimes() == SCALE_DOWNTIMES, "Got %d downtimes", SCALE_DOWNTIMES);
+
+	for(sorted = TRUE, prev_downtime = NULL, temp_downtime = scheduled_downtime_list; temp_downtime != NULL; prev_downtime = temp_downtime, temp_downtime = temp_downtime->next) {
+		if(temp_downtime->prev != prev_downtime || (prev_downtime && prev_downtime->start_time > temp_downtime->start_time))
+			sorted = FALSE;
+		}
+	ok(sorted == TRUE, "Downtime list is sorted by start time and linked both ways");
+
+	/* removing entries must keep the rest in order, and new ones must still find their place */
+	for(id = SCALE_FIRST_ID; id < SCALE_FIRST_ID + SCALE_DOWNTIMES; id += 3)
+		delete_host_downtime(id);
+	for(i = 0; i < 1000; i++)
+		add_host_downtime("late", now, "user", "import", now + ((i * 104729) % 86400), now + 86400 * 2, TRUE, 0, 0, SCALE_FIRST_ID + SCALE_DOWNTIMES + i, FALSE);
+	add_host_downtime("last", now, "user", "import", now + 86400, now + 86400 * 2, TRUE, 0, 0, SCALE_FIRST_ID + SCALE_DOWNTIMES + i, FALSE);
+	for(sorted = TRUE, prev_downtime = NULL, temp_downtime = scheduled_downtime_list; temp_downtime != NULL; prev_downtime = temp_downtime, temp_downtime = temp_downtime->next) {
+		if(temp_downtime->prev != prev_downtime || (prev_downtime && prev_downtime->start_time > temp_downtime->start_time))
+			sorted = FALSE;
+		}
+	ok(sorted == TRUE && prev_downtime && !strcmp(prev_downtime->host_name, "last"), "Still sorted after deleting and adding more");
+
+	while(scheduled_downtime_list != NULL)
+		delete_downtime(ANY_DOWNTIME, scheduled_downtime_list->downtime_id);
+	ok(find_host_downtime(SCALE_FIRST_ID + 1) == NULL, "No downtimes left");
+	}
+
 int
 main(int argc, char **argv) {
 	time_t now = 0L;
@@ -54,7 +224,7 @@ main(int argc, char **argv) {
 	scheduled_downtime *temp_downtime;
 	int i = 0;
 
-	plan_tests(38);
+	plan_tests(54);
 
 	time(&now);
 
@@ -172,7 +342,8 @@ main(int argc, char **argv) {
 	for(temp_downtime = scheduled_downtime_list, i = 0; temp_downtime != NULL; temp_downtime = temp_downtime->next, i++) {}
 	ok(i == 0, "No downtimes left") || diag("Left: %d", i);
 
-
+	test_downtime_at_scale(now);
+	test_downtime_bulk_import(now);
 
 	return exit_status();
 	}
@@ -94,7 +94,7 @@ int perform_scheduled_host_check(host *temp_host, int int1, double double1) {
 	time(&now);
 	temp_host->last_check = now;
 	}
-int check_for_expired_downtime(void) {}
+int check_for_expired_downtime(unsigned long downtime_id) {}
 int reap_check_results(void) {}
 void check_host_result_freshness() {}
 int check_for_nagios_updates(int int1, int int2) {}
@@ -103,6 +103,7 @@ int save_state_information(int int1) {}
 void get_time_breakdown(unsigned long long1, int *int1, int *int2, int *int3, int *int4) {}
 int check_for_external_commands(void) {}
 void check_for_orphaned_hosts() {}
+void check_for_stale_parent_check_waits(void) {}
 void check_service_result_freshness() {}
 int check_time_against_period(time_t time_t1, timeperiod *timeperiod) {}
 time_t get_next_log_rotation_time(void) {}
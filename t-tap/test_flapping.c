@@ -0,0 +1,204 @@
+/*****************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#define NSCORE 1
+#include "config.h"
+#include "common.h"
+#include "nagios.h"
+#include "comments.h"
+#include "broker.h"
+#include "stub_broker.c"
+#include "stub_comments.c"
+#include "stub_statusdata.c"
+#include "stub_notifications.c"
+#include "tap.h"
+
+void logit(int data_type, int display, const char *fmt, ...) {}
+int log_debug_info(int level, int verbosity, const char *fmt, ...) {
+	return OK;
+	}
+void broker_flapping_data(int type, int flags, int attr, int flapping_type, void *data, double percent_change, double high_threshold, double low_threshold, struct timeval *timestamp) {}
+
+int enable_flap_detection = TRUE;
+double low_service_flap_threshold = 20.0;
+double high_service_flap_threshold = 30.0;
+double low_host_flap_threshold = 20.0;
+double high_host_flap_threshold = 30.0;
+int interval_length = 60;
+unsigned long modified_host_process_attributes = MODATTR_NONE;
+unsigned long modified_service_process_attributes = MODATTR_NONE;
+struct object_count num_objects;
+host **host_ary = NULL;
+service **service_ary = NULL;
+
+/* the state history as it was kept before, and the loop that used to compute its percent change */
+struct old_history {
+	int state_history[MAX_STATE_HISTORY_ENTRIES];
+	int state_history_index;
+	};
+
+static void old_update(struct old_history *h, int state) {
+	h->state_history[h->state_history_index] = state;
+	h->state_history_index++;
+	if(h->state_history_index >= MAX_STATE_HISTORY_ENTRIES)
+		h->state_history_index = 0;
+	}
+
+static double old_percent_change(struct old_history *h) {
+	register int x = 0;
+	register int y = 0;
+	int last_state_history_value = STATE_OK;
+	double curved_changes = 0.0;
+	double low_curve_value = 0.75;
+	double high_curve_value = 1.25;
+
+	for(x = 0, y = h->state_history_index; x < MAX_STATE_HISTORY_ENTRIES; x++) {
+
+		if(x == 0) {
+			last_state_history_value = h->state_history[y];
+			y++;
+			if(y >= MAX_STATE_HISTORY_ENTRIES)
+				y = 0;
+			continue;
+			}
+
+		if(last_state_history_value != h->state_history[y])
+			curved_changes += (((double)(x - 1) * (high_curve_value - low_curve_value)) / ((double)(MAX_STATE_HISTORY_ENTRIES - 2))) + low_curve_value;
+
+		last_state_history_value = h->state_history[y];
+
+		y++;
+		if(y >= MAX_STATE_HISTORY_ENTRIES)
+			y = 0;
+		}
+
+	return (double)(((double)curved_changes * 100.0) / (double)(MAX_STATE_HISTORY_ENTRIES - 1));
+	}
+
+/* the flap state the old code would have ended up in */
+static int old_is_flapping(double percent, double low, double high, int was_flapping) {
+	if(percent > low && percent < high)
+		return was_flapping;
+	return (percent >= high) ? TRUE : FALSE;
+	}
+
+int main(int argc, char **argv) {
+	struct old_history old;
+	int states[MAX_STATE_HISTORY_ENTRIES];
+	unsigned int changes = 0;
+	unsigned int state_history = 0;
+	int percent_mismatches = 0;
+	int roundtrip_mismatches = 0;
+	int flap_mismatches = 0;
+	int flap_changes = 0;
+	int x = 0;
+	int i = 0;
+	service svc;
+	host hst;
+
+	plan_tests(8);
+
+	/* every combination of transitions, as restored from retention data */
+	for(changes = 0; changes < (1U << (MAX_STATE_HISTORY_ENTRIES - 1)); changes++) {
+		old.state_history[0] = changes % 3;
+		for(x = 1; x < MAX_STATE_HISTORY_ENTRIES; x++) {
+			if(changes & (1U << (x - 1)))
+				old.state_history[x] = (old.state_history[x - 1] + 1 + (x % 2)) % 4;
+			else
+				old.state_history[x] = old.state_history[x - 1];
+			}
+		old.state_history_index = 0;
+
+		state_history = state_history_from_states(old.state_history);
+		if(get_state_history_percent_change(state_history) != old_percent_change(&old))
+			percent_mismatches++;
+
+		state_history_to_states(state_history, states);
+		if(state_history_from_states(states) != state_history || states[MAX_STATE_HISTORY_ENTRIES - 1] != old.state_history[MAX_STATE_HISTORY_ENTRIES - 1])
+			roundtrip_mismatches++;
+		}
+	ok(percent_mismatches == 0, "Percent state change is identical for all %u transition patterns (%d mismatches)", 1U << (MAX_STATE_HISTORY_ENTRIES - 1), percent_mismatches);
+	ok(roundtrip_mismatches == 0, "States written to retention data give the same history back (%d mismatches)", roundtrip_mismatches);
+
+	state_history = 0;
+	ok(get_state_history_percent_change(state_history) == 0.0, "Empty history has no state change");
+	for(x = 0; x < MAX_STATE_HISTORY_ENTRIES; x++)
+		update_state_history(&state_history, x % 2);
+	ok(get_state_history_percent_change(state_history) == 100.0, "Changing every time is 100%% state change");
+
+	/* random runs of service states, through the real thing */
+	memset(&old, 0, sizeof(old));
+	memset(&svc, 0, sizeof(svc));
+	svc.host_name = "host1";
+	svc.description = "service1";
+	svc.flap_detection_enabled = TRUE;
+	svc.flap_detection_options = ~0;
+	svc.state_type = HARD_STATE;
+	srand(4711);
+	percent_mismatches = 0;
+	for(i = 0; i < 200000; i++) {
+		int was_flapping = svc.is_flapping;
+
+		/* stretches of stable states and stretches of flapping */
+		if((i / 500) % 2)
+			svc.current_state = rand() % 4;
+		else if(rand() % 10 == 0)
+			svc.current_state = rand() % 2 ? STATE_OK : STATE_CRITICAL;
+
+		old_update(&old, svc.current_state);
+		check_for_service_flapping(&svc, TRUE, FALSE);
+
+		if(svc.percent_state_change != old_percent_change(&old))
+			percent_mismatches++;
+		if(svc.is_flapping != old_is_flapping(old_percent_change(&old), low_service_flap_threshold, high_service_flap_threshold, was_flapping))
+			flap_mismatches++;
+		if(svc.is_flapping != was_flapping)
+			flap_changes++;
+		}
+	ok(percent_mismatches == 0, "Service percent state change is identical over %d checks (%d mismatches)", i, percent_mismatches);
+	ok(flap_mismatches == 0 && flap_changes > 0, "Service started and stopped flapping at the same checks (%d flap changes, %d mismatches)", flap_changes, flap_mismatches);
+
+	memset(&old, 0, sizeof(old));
+	memset(&hst, 0, sizeof(hst));
+	hst.name = "host1";
+	hst.flap_detection_enabled = TRUE;
+	hst.flap_detection_options = ~0;
+	percent_mismatches = flap_mismatches = flap_changes = 0;
+	for(i = 0; i < 200000; i++) {
+		int was_flapping = hst.is_flapping;
+
+		if((i / 300) % 3 == 1)
+			hst.current_state = rand() % 3;
+		else if(rand() % 20 == 0)
+			hst.current_state = rand() % 2 ? HOST_UP : HOST_DOWN;
+
+		old_update(&old, hst.current_state);
+		check_for_host_flapping(&hst, TRUE, TRUE, FALSE);
+
+		if(hst.percent_state_change != old_percent_change(&old))
+			percent_mismatches++;
+		if(hst.is_flapping != old_is_flapping(old_percent_change(&old), low_host_flap_threshold, high_host_flap_threshold, was_flapping))
+			flap_mismatches++;
+		if(hst.is_flapping != was_flapping)
+			flap_changes++;
+		}
+	ok(percent_mismatches == 0, "Host percent state change is identical over %d checks (%d mismatches)", i, percent_mismatches);
+	ok(flap_mismatches == 0 && flap_changes > 0, "Host started and stopped flapping at the same checks (%d flap changes, %d mismatches)", flap_changes, flap_mismatches);
+
+	return exit_status();
+	}
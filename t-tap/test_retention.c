@@ -0,0 +1,185 @@
+/*****************************************************************************
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*
+*****************************************************************************/
+
+#define NSCORE 1
+#include "config.h"
+#include "common.h"
+#include "nagios.h"
+#include "objects.h"
+#include "comments.h"
+#include "downtime.h"
+#include "macros.h"
+#include "../xdata/xrddefault.h"
+#include "stub_statusdata.c"
+#include "tap.h"
+
+void logit(int data_type, int display, const char *fmt, ...) {}
+int log_debug_info(int level, int verbosity, const char *fmt, ...) {
+	return OK;
+	}
+void timing_point(const char *fmt, ...) {}
+int my_rename(char *source, char *dest) {
+	return rename(source, dest);
+	}
+int xodtemplate_read_config_data(char *main_config_file, int options) {
+	return OK;
+	}
+nagios_macros *get_global_macros(void) {
+	return NULL;
+	}
+int add_comment(int comment_type, int entry_type, char *host_name, char *svc_description, time_t entry_time, char *author, char *comment_data, unsigned long comment_id, int persistent, int expires, time_t expire_time, int source) {
+	return OK;
+	}
+int delete_comment(int type, unsigned long comment_id) {
+	return OK;
+	}
+int sort_comments(void) {
+	return OK;
+	}
+int add_host_downtime(char *host_name, time_t entry_time, char *author, char *comment_data, time_t start_time, time_t end_time, int fixed, unsigned long triggered_by, unsigned long duration, unsigned long downtime_id, int is_in_effect) {
+	return OK;
+	}
+int add_service_downtime(char *host_name, char *svc_description, time_t entry_time, char *author, char *comment_data, time_t start_time, time_t end_time, int fixed, unsigned long triggered_by, unsigned long duration, unsigned long downtime_id, int is_in_effect) {
+	return OK;
+	}
+int register_downtime(int type, unsigned long downtime_id) {
+	return OK;
+	}
+int sort_downtime(void) {
+	return OK;
+	}
+void check_for_host_flapping(host *hst, int update, int actual_check, int allow_flapstart_notification) {}
+void check_for_service_flapping(service *svc, int update, int allow_flapstart_notification) {}
+unsigned int state_history_from_states(int *states) {
+	return 0;
+	}
+void state_history_to_states(unsigned int state_history, int *states) {}
+time_t get_next_host_notification_time(host *hst, time_t offset) {
+	return offset;
+	}
+time_t get_next_service_notification_time(service *svc, time_t offset) {
+	return offset;
+	}
+
+struct comment *comment_list = NULL;
+struct scheduled_downtime *scheduled_downtime_list = NULL;
+int defer_comment_sorting = 0;
+int defer_downtime_sorting = 0;
+int check_host_freshness = FALSE;
+int check_service_freshness = FALSE;
+char *global_host_event_handler = NULL;
+char *global_service_event_handler = NULL;
+time_t last_program_stop = 0L;
+char *last_program_version = NULL;
+time_t last_update_check = 0L;
+char *new_program_version = NULL;
+int update_available = FALSE;
+unsigned long update_uid = 0L;
+unsigned long modified_host_process_attributes = MODATTR_NONE;
+unsigned long modified_service_process_attributes = MODATTR_NONE;
+unsigned long next_comment_id = 0L;
+unsigned long next_downtime_id = 0L;
+unsigned long next_event_id = 0L;
+unsigned long next_notification_id = 0L;
+unsigned long next_problem_id = 0L;
+unsigned long retained_host_attribute_mask = 0L;
+unsigned long retained_service_attribute_mask = 0L;
+unsigned long retained_contact_host_attribute_mask = 0L;
+unsigned long retained_contact_service_attribute_mask = 0L;
+unsigned long retained_process_host_attribute_mask = 0L;
+unsigned long retained_process_service_attribute_mask = 0L;
+int retention_scheduling_horizon = 900;
+int test_scheduling = FALSE;
+int use_large_installation_tweaks = FALSE;
+int use_retained_program_state = TRUE;
+int use_retained_scheduling_info = FALSE;
+
+extern char *xrddefault_retention_file;
+
+static host *test_host(char *name, char *check_command) {
+	return add_host(name, NULL, NULL, "127.0.0.1", NULL, HOST_UP, 5.0, 1.0, 3, 0, 60.0, 0.0, NULL, TRUE, check_command, TRUE, TRUE, NULL, TRUE, TRUE, 0.0, 0.0, 0, 0, TRUE, FALSE, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, FALSE, 0.0, 0.0, 0.0, FALSE, TRUE, TRUE, TRUE, FALSE, 0);
+	}
+
+static service *test_service(char *host_name, char *description, char *check_command) {
+	return add_service(host_name, description, NULL, NULL, STATE_OK, 3, TRUE, TRUE, 5.0, 1.0, 60.0, 0.0, NULL, 0, TRUE, FALSE, NULL, TRUE, check_command, TRUE, TRUE, 0.0, 0.0, 0, 0, TRUE, FALSE, 0, NULL, NULL, NULL, NULL, NULL, TRUE, TRUE, FALSE, 0);
+	}
+
+static int write_retention_file(const char *path, const char *host_cmd, const char *svc_cmd) {
+	FILE *fp;
+
+	if((fp = fopen(path, "w")) == NULL)
+		return ERROR;
+	fprintf(fp, "host {\n\thost_name=host1\n\tmodified_attributes=%d\n\tcheck_command=%s\n\t}\n", MODATTR_CHECK_COMMAND, host_cmd);
+	fprintf(fp, "service {\n\thost_name=host1\n\tservice_description=svc1\n\tmodified_attributes=%d\n\tcheck_command=%s\n\t}\n", MODATTR_CHECK_COMMAND, svc_cmd);
+	fclose(fp);
+	return OK;
+	}
+
+int main(int argc, char **argv) {
+	unsigned int ocount[NUM_OBJECT_SKIPLISTS];
+	char retention_file[] = "/tmp/test_retention.XXXXXX";
+	host *h;
+	service *s;
+	int fd;
+
+	plan_tests(13);
+
+	memset(ocount, 0, sizeof(ocount));
+	ocount[COMMAND_SKIPLIST] = 3;
+	ocount[HOST_SKIPLIST] = 1;
+	ocount[SERVICE_SKIPLIST] = 1;
+	create_object_tables(ocount);
+
+	add_command("check_a", "/bin/true");
+	add_command("check_b", "/bin/true");
+	add_command("check_c", "/bin/true");
+	h = test_host("host1", "check_a");
+	s = test_service("host1", "svc1", "check_a");
+	ok(h != NULL && s != NULL, "host and service added");
+	ok(h->check_command == intern_get("check_a"), "host check command is interned");
+	ok(s->check_command == h->check_command, "host and service share the interned check command");
+
+	fd = mkstemp(retention_file);
+	ok(fd >= 0, "created temporary retention file");
+	close(fd);
+	xrddefault_retention_file = retention_file;
+
+	/* changing the check command must release the interned one, not free() it */
+	write_retention_file(retention_file, "check_b!1", "check_b!2");
+	ok(xrddefault_read_state_information() == OK, "read retention data");
+	ok(!strcmp(h->check_command, "check_b!1"), "host check command changed");
+	ok(h->check_command == intern_get("check_b!1"), "new host check command is interned");
+	ok(!strcmp(s->check_command, "check_b!2"), "service check command changed");
+	ok(s->check_command == intern_get("check_b!2"), "new service check command is interned");
+
+	/* and again, the way a second external command would */
+	write_retention_file(retention_file, "check_c", "check_c");
+	ok(xrddefault_read_state_information() == OK, "read retention data again");
+	ok(h->check_command == s->check_command && !strcmp(h->check_command, "check_c"), "check commands changed again and are shared");
+
+	/* unknown commands leave things as they are */
+	write_retention_file(retention_file, "check_none", "check_none");
+	xrddefault_read_state_information();
+	ok(!strcmp(h->check_command, "check_c") && !strcmp(s->check_command, "check_c"), "unknown check commands are ignored");
+
+	unlink(retention_file);
+	free_object_data();
+	ok(intern_num_strings() == 0, "all interned strings released when objects are freed");
+
+	return exit_status();
+	}
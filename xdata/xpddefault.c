@@ -69,6 +69,15 @@ FILE    *xpddefault_service_perfdata_fp = NULL;
 int     xpddefault_host_perfdata_fd = -1;
 int     xpddefault_service_perfdata_fd = -1;
 
+unsigned long xpddefault_perfdata_file_buffer_size = DEFAULT_PERFDATA_FILE_BUFFER_SIZE;
+unsigned long xpddefault_perfdata_file_flush_interval = DEFAULT_PERFDATA_FILE_FLUSH_INTERVAL;
+
+/* the file templates, compiled once, and the results not yet written out */
+static xpddefault_template xpddefault_host_template;
+static xpddefault_template xpddefault_service_template;
+static xpddefault_file_buffer xpddefault_host_buffer;
+static xpddefault_file_buffer xpddefault_service_buffer;
+
 
 /******************************************************************/
 /***************** COMMON CONFIG INITIALIZATION  ******************/
@@ -193,6 +202,12 @@ int xpddefault_grab_config_directives(char *input) {
 	else if(!strcmp(varname,"service_perfdata_process_empty_results"))
 	        xpddefault_service_perfdata_process_empty_results=(atoi(varvalue)>0)?TRUE:FALSE;
 
+	else if(!strcmp(varname, "perfdata_file_buffer_size"))
+		xpddefault_perfdata_file_buffer_size = strtoul(varvalue, NULL, 0);
+
+	else if(!strcmp(varname, "perfdata_file_flush_interval"))
+		xpddefault_perfdata_file_flush_interval = strtoul(varvalue, NULL, 0);
+
 	/* free memory */
 	my_free(varname);
 	my_free(varvalue);
@@ -237,6 +252,12 @@ int xpddefault_initialize_performance_data(char *config_file) {
 	xpddefault_preprocess_file_templates(xpddefault_host_perfdata_file_template);
 	xpddefault_preprocess_file_templates(xpddefault_service_perfdata_file_template);
 
+	/* split the templates into text and macros once, rather than for every result */
+	if(xpddefault_compile_file_template(&xpddefault_host_template, xpddefault_host_perfdata_file_template) == ERROR)
+		my_free(xpddefault_host_perfdata_file_template);
+	if(xpddefault_compile_file_template(&xpddefault_service_template, xpddefault_service_perfdata_file_template) == ERROR)
+		my_free(xpddefault_service_perfdata_file_template);
+
 	/* open the performance data files */
 	xpddefault_open_host_perfdata_file();
 	xpddefault_open_service_perfdata_file();
@@ -327,6 +348,10 @@ int xpddefault_initialize_performance_data(char *config_file) {
 	if(xpddefault_service_perfdata_file_processing_interval > 0 && xpddefault_service_perfdata_file_processing_command != NULL)
 		schedule_new_event(EVENT_USER_FUNCTION, TRUE, current_time + xpddefault_service_perfdata_file_processing_interval, TRUE, xpddefault_service_perfdata_file_processing_interval, NULL, TRUE, (void *)xpddefault_process_service_perfdata_file, NULL, 0);
 
+	/* periodically write out buffered results, so they don't sit around when few come in */
+	if(xpddefault_perfdata_file_buffer_size > 0 && xpddefault_perfdata_file_flush_interval > 0 && (xpddefault_host_perfdata_fp != NULL || xpddefault_service_perfdata_fp != NULL))
+		schedule_new_event(EVENT_USER_FUNCTION, TRUE, current_time + xpddefault_perfdata_file_flush_interval, TRUE, xpddefault_perfdata_file_flush_interval, NULL, TRUE, (void *)xpddefault_flush_perfdata_files, NULL, 0);
+
 	/* save the host perf data file macro */
 	my_free(mac->x[MACRO_HOSTPERFDATAFILE]);
 	if(xpddefault_host_perfdata_file != NULL) {
@@ -367,6 +392,13 @@ int xpddefault_cleanup_performance_data(char *config_file) {
 	xpddefault_close_host_perfdata_file();
 	xpddefault_close_service_perfdata_file();
 
+	xpddefault_free_file_template(&xpddefault_host_template);
+	xpddefault_free_file_template(&xpddefault_service_template);
+	my_free(xpddefault_host_buffer.buf);
+	my_free(xpddefault_service_buffer.buf);
+	xpddefault_host_buffer.len = xpddefault_host_buffer.size = 0;
+	xpddefault_service_buffer.len = xpddefault_service_buffer.size = 0;
+
 	return OK;
 	}
 
@@ -622,8 +654,15 @@ int xpddefault_open_service_perfdata_file(void) {
 /* close the host performance data file */
 int xpddefault_close_host_perfdata_file(void) {
 
-	if(xpddefault_host_perfdata_fp != NULL)
+	/* write out whatever is still buffered */
+	xpddefault_flush_file_buffer(&xpddefault_host_buffer, xpddefault_host_perfdata_fp);
+
+	/* fclose() closes the descriptor of a pipe too */
+	if(xpddefault_host_perfdata_fp != NULL) {
 		fclose(xpddefault_host_perfdata_fp);
+		xpddefault_host_perfdata_fp = NULL;
+		xpddefault_host_perfdata_fd = -1;
+		}
 	if(xpddefault_host_perfdata_fd >= 0) {
 		close(xpddefault_host_perfdata_fd);
 		xpddefault_host_perfdata_fd = -1;
@@ -636,8 +675,15 @@ int xpddefault_close_host_perfdata_file(void) {
 /* close the service performance data file */
 int xpddefault_close_service_perfdata_file(void) {
 
-	if(xpddefault_service_perfdata_fp != NULL)
+	/* write out whatever is still buffered */
+	xpddefault_flush_file_buffer(&xpddefault_service_buffer, xpddefault_service_perfdata_fp);
+
+	/* fclose() closes the descriptor of a pipe too */
+	if(xpddefault_service_perfdata_fp != NULL) {
 		fclose(xpddefault_service_perfdata_fp);
+		xpddefault_service_perfdata_fp = NULL;
+		xpddefault_service_perfdata_fd = -1;
+		}
 	if(xpddefault_service_perfdata_fd >= 0) {
 		close(xpddefault_service_perfdata_fd);
 		xpddefault_service_perfdata_fd = -1;
@@ -691,11 +737,261 @@ int xpddefault_preprocess_file_templates(char *template) {
 	}
 
 
+/* adds a template part, merging text with any text before it */
+static int xpddefault_add_template_part(xpddefault_template *tmpl, int type, int clean_options, const char *text) {
+	xpddefault_template_part *part = NULL;
+	size_t len = strlen(text);
+
+	if(type == XPDDEFAULT_TEXT_PART && len == 0)
+		return OK;
+
+	/* more text after text */
+	if(type == XPDDEFAULT_TEXT_PART && tmpl->num_parts > 0 && tmpl->parts[tmpl->num_parts - 1].type == XPDDEFAULT_TEXT_PART) {
+		part = &tmpl->parts[tmpl->num_parts - 1];
+		if((part->text = (char *)realloc(part->text, part->len + len + 1)) == NULL)
+			return ERROR;
+		memcpy(part->text + part->len, text, len + 1);
+		part->len += len;
+		return OK;
+		}
+
+	if((part = (xpddefault_template_part *)realloc(tmpl->parts, (tmpl->num_parts + 1) * sizeof(*part))) == NULL)
+		return ERROR;
+	tmpl->parts = part;
+	part = &tmpl->parts[tmpl->num_parts];
+	if((part->text = (char *)strdup(text)) == NULL)
+		return ERROR;
+	part->len = len;
+	part->type = type;
+	part->clean_options = clean_options;
+	tmpl->num_parts++;
+
+	return OK;
+	}
+
+
+/*
+ * splits a file template into text and macros, the same way
+ * process_macros_r() does it, so writing a result only has to
+ * look up the macro values. standard macros are looked up by
+ * their code, the others (on-demand, custom, $ARGx$, $USERx$)
+ * by name every time.
+ */
+int xpddefault_compile_file_template(xpddefault_template *tmpl, char *template) {
+	char *buf = NULL;
+	char *buf_ptr = NULL;
+	char *temp_buffer = NULL;
+	char *delim_ptr = NULL;
+	int in_macro = FALSE;
+	int result = OK;
+	int code = 0;
+	int clean_options = 0;
+
+	xpddefault_free_file_template(tmpl);
+
+	if(template == NULL)
+		return OK;
+
+	if((buf = (char *)strdup(template)) == NULL)
+		return ERROR;
+
+	for(buf_ptr = buf; buf_ptr != NULL && result == OK;) {
+
+		temp_buffer = buf_ptr;
+
+		/* find the next delimiter */
+		if((delim_ptr = strchr(buf_ptr, '$'))) {
+			delim_ptr[0] = '\x0';
+			buf_ptr = (char *)delim_ptr + 1;
+			}
+		else
+			buf_ptr = NULL;
+
+		/* plain text */
+		if(in_macro == FALSE) {
+			result = xpddefault_add_template_part(tmpl, XPDDEFAULT_TEXT_PART, 0, temp_buffer);
+			in_macro = TRUE;
+			continue;
+			}
+
+		/* an escaped $ */
+		if(temp_buffer[0] == '\x0')
+			result = xpddefault_add_template_part(tmpl, XPDDEFAULT_TEXT_PART, 0, "$");
+		else if((code = get_macro_code(temp_buffer, &clean_options)) >= 0)
+			result = xpddefault_add_template_part(tmpl, code, clean_options, temp_buffer);
+		else
+			result = xpddefault_add_template_part(tmpl, XPDDEFAULT_NAMED_MACRO_PART, 0, temp_buffer);
+
+		in_macro = FALSE;
+		}
+
+	my_free(buf);
+
+	if(result == ERROR) {
+		logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: Could not compile performance data file template '%s' - performance data will not be written to file!\n", template);
+		xpddefault_free_file_template(tmpl);
+		}
+
+	return result;
+	}
+
+
+/* frees a compiled file template */
+void xpddefault_free_file_template(xpddefault_template *tmpl) {
+	int x = 0;
+
+	for(x = 0; x < tmpl->num_parts; x++)
+		my_free(tmpl->parts[x].text);
+	my_free(tmpl->parts);
+	tmpl->num_parts = 0;
+	}
+
+
+/* adds output to a file buffer */
+static int xpddefault_append_file_buffer(xpddefault_file_buffer *fb, const char *str, size_t len) {
+	char *buf = NULL;
+	size_t size = 0;
+
+	if(fb->len + len + 1 > fb->size) {
+		size = fb->size ? fb->size * 2 : 4096;
+		while(size < fb->len + len + 1)
+			size *= 2;
+		if((buf = (char *)realloc(fb->buf, size)) == NULL)
+			return ERROR;
+		fb->buf = buf;
+		fb->size = size;
+		}
+
+	memcpy(fb->buf + fb->len, str, len);
+	fb->len += len;
+	fb->buf[fb->len] = '\x0';
+
+	return OK;
+	}
+
+
+/* writes one line of output for a compiled file template to a file buffer */
+int xpddefault_render_file_template(nagios_macros *mac, xpddefault_template *tmpl, xpddefault_file_buffer *fb) {
+	xpddefault_template_part *part = NULL;
+	char *selected_macro = NULL;
+	char *original_macro = NULL;
+	char *cleaned_macro = NULL;
+	size_t start = fb->len;
+	int clean_options = 0;
+	int free_macro = FALSE;
+	int result = OK;
+	int x = 0;
+
+	for(x = 0; x < tmpl->num_parts && result == OK; x++) {
+		part = &tmpl->parts[x];
+
+		if(part->type == XPDDEFAULT_TEXT_PART) {
+			result = xpddefault_append_file_buffer(fb, part->text, part->len);
+			continue;
+			}
+
+		/* grab the macro value */
+		selected_macro = NULL;
+		free_macro = FALSE;
+		if(part->type == XPDDEFAULT_NAMED_MACRO_PART) {
+			clean_options = 0;
+			result = grab_macro_value_r(mac, part->text, &selected_macro, &clean_options, &free_macro);
+			}
+		else {
+			clean_options = part->clean_options;
+			result = grab_macrox_value_r(mac, part->type, NULL, NULL, &selected_macro, &free_macro);
+			}
+
+		/* an error occurred - we couldn't parse the macro, so keep the text as it was */
+		if(result == ERROR) {
+			logit(NSLOG_RUNTIME_WARNING, TRUE, "Warning: An error occurred processing macro '%s'!\n", part->text);
+			if(free_macro == TRUE)
+				my_free(selected_macro);
+			result = xpddefault_append_file_buffer(fb, "$", 1);
+			if(result == OK)
+				result = xpddefault_append_file_buffer(fb, part->text, part->len);
+			if(result == OK)
+				result = xpddefault_append_file_buffer(fb, "$", 1);
+			continue;
+			}
+
+		if(selected_macro == NULL)
+			continue;
+
+		/* URL encode the macro if requested - this allocates new memory */
+		if(clean_options & URL_ENCODE_MACRO_CHARS) {
+			original_macro = selected_macro;
+			selected_macro = get_url_encoded_string(selected_macro);
+			if(free_macro == TRUE)
+				my_free(original_macro);
+			free_macro = TRUE;
+			}
+
+		/* some macros are cleaned... */
+		if(clean_options & STRIP_ILLEGAL_MACRO_CHARS || clean_options & ESCAPE_MACRO_CHARS) {
+			if(selected_macro != NULL && (cleaned_macro = clean_macro_chars(selected_macro, clean_options)) != NULL) {
+				result = xpddefault_append_file_buffer(fb, cleaned_macro, strlen(cleaned_macro));
+				if(*cleaned_macro)
+					free(cleaned_macro);
+				}
+			}
+
+		/* others are not */
+		else if(selected_macro != NULL)
+			result = xpddefault_append_file_buffer(fb, selected_macro, strlen(selected_macro));
+
+		if(free_macro == TRUE)
+			my_free(selected_macro);
+		}
+
+	/* a newline is added after each result */
+	if(result == OK)
+		result = xpddefault_append_file_buffer(fb, "\n", 1);
+
+	/* don't leave half a line behind */
+	if(result == ERROR)
+		fb->len = start;
+
+	return result;
+	}
+
+
+/* writes out a file buffer */
+int xpddefault_flush_file_buffer(xpddefault_file_buffer *fb, FILE *fp) {
+	int result = OK;
+
+	if(fb->len == 0)
+		return OK;
+
+	/* without a file, there's nowhere for it to go */
+	if(fp != NULL) {
+		if(fwrite(fb->buf, 1, fb->len, fp) != fb->len)
+			result = ERROR;
+		if(fflush(fp) != 0)
+			result = ERROR;
+		}
+
+	fb->len = 0;
+
+	return result;
+	}
+
+
+/* periodically write out buffered host and service results */
+int xpddefault_flush_perfdata_files(void) {
+
+	log_debug_info(DEBUGL_FUNCTIONS, 0, "flush_perfdata_files()\n");
+
+	xpddefault_flush_file_buffer(&xpddefault_host_buffer, xpddefault_host_perfdata_fp);
+	xpddefault_flush_file_buffer(&xpddefault_service_buffer, xpddefault_service_perfdata_fp);
+
+	return OK;
+	}
+
+
 /* updates service performance data file */
 int xpddefault_update_service_performance_data_file(nagios_macros *mac, service *svc) {
-	char *raw_output = NULL;
-	char *processed_output = NULL;
-	int result = OK;
+	size_t start = xpddefault_service_buffer.len;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "update_service_performance_data_file()\n");
 
@@ -706,36 +1002,23 @@ int xpddefault_update_service_performance_data_file(nagios_macros *mac, service
 	if(xpddefault_service_perfdata_fp == NULL || xpddefault_service_perfdata_file_template == NULL)
 		return OK;
 
-	/* get the raw line to write */
-	raw_output = (char *)strdup(xpddefault_service_perfdata_file_template);
-
-	log_debug_info(DEBUGL_PERFDATA, 2, "Raw service performance data file output: %s\n", raw_output);
-
-	/* process any macros in the raw output line */
-	process_macros_r(mac, raw_output, &processed_output, 0);
-	if(processed_output == NULL)
+	/* add the line for this result to the buffer */
+	if(xpddefault_render_file_template(mac, &xpddefault_service_template, &xpddefault_service_buffer) == ERROR)
 		return ERROR;
 
-	log_debug_info(DEBUGL_PERFDATA, 2, "Processed service performance data file output: %s\n", processed_output);
-
-	/* write to host performance data file */
-	fputs(processed_output, xpddefault_service_perfdata_fp);
-	fputc('\n', xpddefault_service_perfdata_fp);
-	fflush(xpddefault_service_perfdata_fp);
+	log_debug_info(DEBUGL_PERFDATA, 2, "Processed service performance data file output: %s", xpddefault_service_buffer.buf + start);
 
-	/* free memory */
-	my_free(raw_output);
-	my_free(processed_output);
+	/* write to service performance data file once enough has piled up */
+	if(xpddefault_service_buffer.len >= xpddefault_perfdata_file_buffer_size)
+		return xpddefault_flush_file_buffer(&xpddefault_service_buffer, xpddefault_service_perfdata_fp);
 
-	return result;
+	return OK;
 	}
 
 
 /* updates host performance data file */
 int xpddefault_update_host_performance_data_file(nagios_macros *mac, host *hst) {
-	char *raw_output = NULL;
-	char *processed_output = NULL;
-	int result = OK;
+	size_t start = xpddefault_host_buffer.len;
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "update_host_performance_data_file()\n");
 
@@ -746,28 +1029,17 @@ int xpddefault_update_host_performance_data_file(nagios_macros *mac, host *hst)
 	if(xpddefault_host_perfdata_fp == NULL || xpddefault_host_perfdata_file_template == NULL)
 		return OK;
 
-	/* get the raw output */
-	raw_output = (char *)strdup(xpddefault_host_perfdata_file_template);
-
-	log_debug_info(DEBUGL_PERFDATA, 2, "Raw host performance file output: %s\n", raw_output);
-
-	/* process any macros in the raw output */
-	process_macros_r(mac, raw_output, &processed_output, 0);
-	if(processed_output == NULL)
+	/* add the line for this result to the buffer */
+	if(xpddefault_render_file_template(mac, &xpddefault_host_template, &xpddefault_host_buffer) == ERROR)
 		return ERROR;
 
-	log_debug_info(DEBUGL_PERFDATA, 2, "Processed host performance data file output: %s\n", processed_output);
+	log_debug_info(DEBUGL_PERFDATA, 2, "Processed host performance data file output: %s", xpddefault_host_buffer.buf + start);
 
-	/* write to host performance data file */
-	fputs(processed_output, xpddefault_host_perfdata_fp);
-	fputc('\n', xpddefault_host_perfdata_fp);
-	fflush(xpddefault_host_perfdata_fp);
+	/* write to host performance data file once enough has piled up */
+	if(xpddefault_host_buffer.len >= xpddefault_perfdata_file_buffer_size)
+		return xpddefault_flush_file_buffer(&xpddefault_host_buffer, xpddefault_host_perfdata_fp);
 
-	/* free memory */
-	my_free(raw_output);
-	my_free(processed_output);
-
-	return result;
+	return OK;
 	}
 
 
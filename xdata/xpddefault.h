@@ -32,6 +32,34 @@
 #define DEFAULT_HOST_PERFDATA_PROCESS_EMPTY_RESULTS 1
 #define DEFAULT_SERVICE_PERFDATA_PROCESS_EMPTY_RESULTS 1
 
+#define DEFAULT_PERFDATA_FILE_BUFFER_SIZE 65536
+#define DEFAULT_PERFDATA_FILE_FLUSH_INTERVAL 1
+
+/* template parts that aren't standard macros */
+#define XPDDEFAULT_TEXT_PART -1
+#define XPDDEFAULT_NAMED_MACRO_PART -2
+
+/* a piece of text or a macro in a perfdata file template */
+typedef struct xpddefault_template_part {
+	int type;               /* macro code, or one of the above */
+	int clean_options;
+	char *text;             /* the text, or the macro name */
+	size_t len;
+	} xpddefault_template_part;
+
+/* a perfdata file template, split into text and macros */
+typedef struct xpddefault_template {
+	int num_parts;
+	xpddefault_template_part *parts;
+	} xpddefault_template;
+
+/* results waiting to be written to a perfdata file */
+typedef struct xpddefault_file_buffer {
+	char *buf;
+	size_t len;
+	size_t size;
+	} xpddefault_file_buffer;
+
 
 int xpddefault_initialize_performance_data(char *);
 int xpddefault_cleanup_performance_data(char *);
@@ -48,6 +76,11 @@ int xpddefault_update_service_performance_data_file(nagios_macros *mac, service
 int xpddefault_update_host_performance_data_file(nagios_macros *mac, host *);
 
 int xpddefault_preprocess_file_templates(char *);
+int xpddefault_compile_file_template(xpddefault_template *, char *);
+void xpddefault_free_file_template(xpddefault_template *);
+int xpddefault_render_file_template(nagios_macros *mac, xpddefault_template *, xpddefault_file_buffer *);
+int xpddefault_flush_file_buffer(xpddefault_file_buffer *, FILE *);
+int xpddefault_flush_perfdata_files(void);
 
 int xpddefault_open_host_perfdata_file(void);
 int xpddefault_open_service_perfdata_file(void);
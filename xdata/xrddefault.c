@@ -195,6 +195,7 @@ int xrddefault_save_state_information(void) {
 	contact *temp_contact = NULL;
 	comment *temp_comment = NULL;
 	scheduled_downtime *temp_downtime = NULL;
+	int states[MAX_STATE_HISTORY_ENTRIES];
 	int x = 0;
 	int fd = 0;
 	unsigned long host_attribute_mask = 0L;
@@ -348,8 +349,9 @@ int xrddefault_save_state_information(void) {
 		fprintf(fp, "check_flapping_recovery_notification=%d\n", temp_host->check_flapping_recovery_notification);
 
 		fprintf(fp, "state_history=");
+		state_history_to_states(temp_host->state_history, states);
 		for(x = 0; x < MAX_STATE_HISTORY_ENTRIES; x++)
-			fprintf(fp, "%s%d", (x > 0) ? "," : "", temp_host->state_history[(x + temp_host->state_history_index) % MAX_STATE_HISTORY_ENTRIES]);
+			fprintf(fp, "%s%d", (x > 0) ? "," : "", states[x]);
 		fprintf(fp, "\n");
 
 		/* custom variables */
@@ -421,8 +423,9 @@ int xrddefault_save_state_information(void) {
 		fprintf(fp, "check_flapping_recovery_notification=%d\n", temp_service->check_flapping_recovery_notification);
 
 		fprintf(fp, "state_history=");
+		state_history_to_states(temp_service->state_history, states);
 		for(x = 0; x < MAX_STATE_HISTORY_ENTRIES; x++)
-			fprintf(fp, "%s%d", (x > 0) ? "," : "", temp_service->state_history[(x + temp_service->state_history_index) % MAX_STATE_HISTORY_ENTRIES]);
+			fprintf(fp, "%s%d", (x > 0) ? "," : "", states[x]);
 		fprintf(fp, "\n");
 
 		/* custom variables */
@@ -554,6 +557,7 @@ int xrddefault_read_state_information(void) {
 	char *author = NULL;
 	char *comment_data = NULL;
 	int data_type = XRDDEFAULT_NO_DATA;
+	int states[MAX_STATE_HISTORY_ENTRIES];
 	int x = 0;
 	host *temp_host = NULL;
 	service *temp_service = NULL;
@@ -1184,13 +1188,14 @@ int xrddefault_read_state_information(void) {
 								temp_host->check_flapping_recovery_notification = atoi(val);
 							else if(!strcmp(var, "state_history")) {
 								temp_ptr = val;
+								state_history_to_states(temp_host->state_history, states);
 								for(x = 0; x < MAX_STATE_HISTORY_ENTRIES; x++) {
 									if((ch = my_strsep(&temp_ptr, ",")) != NULL)
-										temp_host->state_history[x] = atoi(ch);
+										states[x] = atoi(ch);
 									else
 										break;
 									}
-								temp_host->state_history_index = 0;
+								temp_host->state_history = state_history_from_states(states);
 								}
 							else
 								found_directive = FALSE;
@@ -1238,12 +1243,12 @@ int xrddefault_read_state_information(void) {
 									tempval = (char *)strdup(val);
 									temp_ptr = my_strtok(tempval, "!");
 									temp_command = find_command(temp_ptr);
-									temp_ptr = (char *)strdup(val);
 									my_free(tempval);
 
-									if(temp_command != NULL && temp_ptr != NULL) {
-										my_free(temp_host->check_command);
-										temp_host->check_command = temp_ptr;
+									/* check commands are interned, see add_host() and add_service() */
+									if(temp_command != NULL) {
+										intern_free(temp_host->check_command);
+										temp_host->check_command = (char *)intern_str(val);
 										}
 									else
 										temp_host->modified_attributes -= MODATTR_CHECK_COMMAND;
@@ -1459,13 +1464,14 @@ int xrddefault_read_state_information(void) {
 								temp_service->check_flapping_recovery_notification = atoi(val);
 							else if(!strcmp(var, "state_history")) {
 								temp_ptr = val;
+								state_history_to_states(temp_service->state_history, states);
 								for(x = 0; x < MAX_STATE_HISTORY_ENTRIES; x++) {
 									if((ch = my_strsep(&temp_ptr, ",")) != NULL)
-										temp_service->state_history[x] = atoi(ch);
+										states[x] = atoi(ch);
 									else
 										break;
 									}
-								temp_service->state_history_index = 0;
+								temp_service->state_history = state_history_from_states(states);
 								}
 							else
 								found_directive = FALSE;
@@ -1513,12 +1519,12 @@ int xrddefault_read_state_information(void) {
 									tempval = (char *)strdup(val);
 									temp_ptr = my_strtok(tempval, "!");
 									temp_command = find_command(temp_ptr);
-									temp_ptr = (char *)strdup(val);
 									my_free(tempval);
 
-									if(temp_command != NULL && temp_ptr != NULL) {
-										my_free(temp_service->check_command);
-										temp_service->check_command = temp_ptr;
+									/* check commands are interned, see add_host() and add_service() */
+									if(temp_command != NULL) {
+										intern_free(temp_service->check_command);
+										temp_service->check_command = (char *)intern_str(val);
 										}
 									else
 										temp_service->modified_attributes -= MODATTR_CHECK_COMMAND;
@@ -32,6 +32,9 @@
 
 #ifdef NSCORE
 #include "../include/nagios.h"
+#ifdef USE_EVENT_BROKER
+#include "../include/nebmods.h"
+#endif
 #endif
 
 #ifdef NSCGI
@@ -277,6 +280,10 @@ int xsddefault_save_status_data(void) {
 	int fd = 0;
 	FILE *fp = NULL;
 	int result = OK;
+#ifdef USE_EVENT_BROKER
+	struct neb_async_stats async_stats;
+	struct neb_callback_profile cb_profile;
+#endif
 
 	log_debug_info(DEBUGL_FUNCTIONS, 0, "save_status_data()\n");
 
@@ -380,6 +387,14 @@ int xsddefault_save_status_data(void) {
 
 	fprintf(fp, "\tparallel_host_check_stats=%d,%d,%d\n", check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[0], check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[1], check_statistics[PARALLEL_HOST_CHECK_STATS].minute_stats[2]);
 	fprintf(fp, "\tserial_host_check_stats=%d,%d,%d\n", check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[0], check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[1], check_statistics[SERIAL_HOST_CHECK_STATS].minute_stats[2]);
+#ifdef USE_EVENT_BROKER
+	neb_get_async_stats(&async_stats);
+	fprintf(fp, "\tneb_async_queue_depth=%lu,%lu\n", async_stats.depth, async_stats.max_depth);
+	fprintf(fp, "\tneb_async_events_delivered=%lu\n", async_stats.delivered);
+	fprintf(fp, "\tneb_async_events_dropped=%lu\n", async_stats.dropped);
+	neb_get_profile_summary(&cb_profile);
+	fprintf(fp, "\tneb_callback_stats=%lu,%llu,%lu\n", cb_profile.calls, cb_profile.usec_total, cb_profile.usec_max);
+#endif
 	fprintf(fp, "\t}\n\n");
 
 
@@ -586,6 +601,8 @@ int xsddefault_save_status_data(void) {
 		fprintf(fp, "\t}\n\n");
 		}
 
+	/* save per-command resource usage */
+	cmdstats_write_status(fp);
 
 	/* reset file permissions */
 	fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
@@ -919,7 +936,7 @@ int xsddefault_read_status_data(char *config_file, int options) {
 					/* NOTE: some vars are not read, as they are not used by the CGIs (modified attributes, event handler commands, etc.) */
 					if(temp_hoststatus != NULL) {
 						if(!strcmp(var, "host_name"))
-							temp_hoststatus->host_name = (char *)strdup(val);
+							temp_hoststatus->host_name = (char *)intern_str(val);
 						else if(!strcmp(var, "has_been_checked"))
 							temp_hoststatus->has_been_checked = (atoi(val) > 0) ? TRUE : FALSE;
 						else if(!strcmp(var, "should_be_scheduled"))
@@ -1011,9 +1028,9 @@ int xsddefault_read_status_data(char *config_file, int options) {
 					/* NOTE: some vars are not read, as they are not used by the CGIs (modified attributes, event handler commands, etc.) */
 					if(temp_servicestatus != NULL) {
 						if(!strcmp(var, "host_name"))
-							temp_servicestatus->host_name = (char *)strdup(val);
+							temp_servicestatus->host_name = (char *)intern_str(val);
 						else if(!strcmp(var, "service_description"))
-							temp_servicestatus->description = (char *)strdup(val);
+							temp_servicestatus->description = (char *)intern_str(val);
 						else if(!strcmp(var, "has_been_checked"))
 							temp_servicestatus->has_been_checked = (atoi(val) > 0) ? TRUE : FALSE;
 						else if(!strcmp(var, "should_be_scheduled"))